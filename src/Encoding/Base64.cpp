@@ -0,0 +1,288 @@
+#include "pch.h"
+#include "Base64.h"
+#include "../OS/CPU.h"
+
+#ifdef BMHPAL_SSE2
+#include <tmmintrin.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace base64 {
+
+static const char AlphabetStd[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+static const char AlphabetURL[65] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// Maps a character to its 6 bit value, or -1 if the character is not part of the alphabet
+struct DecodeTable {
+	int8_t V[256];
+
+	DecodeTable(const char* alphabet) {
+		memset(V, -1, sizeof(V));
+		for (int i = 0; i < 64; i++)
+			V[(uint8_t) alphabet[i]] = (int8_t) i;
+	}
+};
+
+static const DecodeTable DecodeStd(AlphabetStd);
+static const DecodeTable DecodeURL(AlphabetURL);
+
+#ifdef BMHPAL_SSE2
+// SSSE3 kernels, from Wojciech Muła's "Base64 encoding and decoding with SIMD instructions"
+// http://0x80.pl/notesen/2016-01-12-sse-base64-encoding.html
+// http://0x80.pl/notesen/2016-01-17-sse-base64-decoding.html
+
+// Returns the number of input bytes consumed, which is always a multiple of 12.
+// Writes 16 characters for every 12 bytes consumed.
+BMHPAL_TARGET("ssse3")
+static size_t EncodeSSSE3(const uint8_t* in, size_t len, char* out, bool url) {
+	const __m128i shuf    = _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+	const __m128i shiftLU = url ? _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0)
+	                            : _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+	size_t i = 0;
+	// We load 16 bytes, but only consume 12
+	for (; i + 16 <= len; i += 12) {
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (in + i)), shuf);
+		// Split every 3 bytes into 4 x 6 bit indices, one per byte
+		__m128i t0  = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+		__m128i t1  = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+		__m128i idx = _mm_or_si128(t0, t1);
+		// Translate indices to ASCII, by adding an offset that depends on which range the index is in
+		__m128i r    = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+		__m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), idx);
+		r            = _mm_or_si128(r, _mm_and_si128(less, _mm_set1_epi8(13)));
+		r            = _mm_add_epi8(_mm_shuffle_epi8(shiftLU, r), idx);
+		_mm_storeu_si128((__m128i*) (out + i / 3 * 4), r);
+	}
+	return i;
+}
+
+// Returns the number of characters consumed, which is always a multiple of 16.
+// Writes 12 bytes for every 16 characters consumed, but each store is 16 bytes wide, so the caller
+// must guarantee 4 bytes of slack after the final output position.
+// Stops at the first block that contains anything other than alphabet characters, including padding.
+BMHPAL_TARGET("ssse3")
+static size_t DecodeSSSE3(const char* in, size_t len, uint8_t* out, bool url) {
+	const __m128i lutLo   = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lutHi   = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask2F  = _mm_set1_epi8(0x2f);
+	const __m128i zero    = _mm_setzero_si128();
+	size_t        i       = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i s   = _mm_loadu_si128((const __m128i*) (in + i));
+		__m128i bad = zero;
+		if (url) {
+			// Rewrite '-' and '_' to '+' and '/', and reject the standard alphabet's '+' and '/'
+			bad           = _mm_or_si128(_mm_cmpeq_epi8(s, _mm_set1_epi8('+')), _mm_cmpeq_epi8(s, _mm_set1_epi8('/')));
+			__m128i minus = _mm_and_si128(_mm_cmpeq_epi8(s, _mm_set1_epi8('-')), _mm_set1_epi8('-' - '+'));
+			__m128i under = _mm_and_si128(_mm_cmpeq_epi8(s, _mm_set1_epi8('_')), _mm_set1_epi8('_' - '/'));
+			s             = _mm_sub_epi8(s, _mm_or_si128(minus, under));
+		}
+		__m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(s, 4), mask2F);
+		__m128i loNibbles = _mm_and_si128(s, mask2F);
+		__m128i hi        = _mm_shuffle_epi8(lutHi, hiNibbles);
+		__m128i lo        = _mm_shuffle_epi8(lutLo, loNibbles);
+		bad               = _mm_or_si128(bad, _mm_xor_si128(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), zero), _mm_set1_epi8(-1)));
+		if (_mm_movemask_epi8(bad) != 0)
+			break;
+		__m128i eq2F = _mm_cmpeq_epi8(s, mask2F);
+		__m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(eq2F, hiNibbles));
+		s            = _mm_add_epi8(s, roll);
+		// Pack 4 x 6 bits into 3 bytes
+		__m128i merged = _mm_maddubs_epi16(s, _mm_set1_epi32(0x01400140));
+		__m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+		packed         = _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+		_mm_storeu_si128((__m128i*) (out + i / 4 * 3), packed);
+	}
+	return i;
+}
+#endif
+
+BMHPAL_API size_t Encode(const void* _raw, size_t rawLen, char* out, Flags flags) {
+	auto        raw      = (const uint8_t*) _raw;
+	bool        url      = !!(flags & Flags::URL);
+	const char* alphabet = url ? AlphabetURL : AlphabetStd;
+	size_t      i        = 0;
+#ifdef BMHPAL_SSE2
+	if (rawLen >= 16 && os::CPUHasSSSE3())
+		i = EncodeSSSE3(raw, rawLen, out, url);
+#endif
+	char* o = out + i / 3 * 4;
+	for (; i + 3 <= rawLen; i += 3) {
+		uint32_t v = ((uint32_t) raw[i] << 16) | ((uint32_t) raw[i + 1] << 8) | raw[i + 2];
+		o[0]       = alphabet[v >> 18];
+		o[1]       = alphabet[(v >> 12) & 63];
+		o[2]       = alphabet[(v >> 6) & 63];
+		o[3]       = alphabet[v & 63];
+		o += 4;
+	}
+	size_t remain = rawLen - i;
+	if (remain != 0) {
+		uint32_t v = (uint32_t) raw[i] << 16;
+		if (remain == 2)
+			v |= (uint32_t) raw[i + 1] << 8;
+		*o++ = alphabet[v >> 18];
+		*o++ = alphabet[(v >> 12) & 63];
+		if (remain == 2)
+			*o++ = alphabet[(v >> 6) & 63];
+		if (!(flags & Flags::NoPad)) {
+			*o++ = '=';
+			if (remain == 1)
+				*o++ = '=';
+		}
+	}
+	return o - out;
+}
+
+BMHPAL_API void EncodeAppend(const void* raw, size_t rawLen, std::string& out, Flags flags) {
+	size_t pos = out.size();
+	out.resize(pos + EncodedLen(rawLen, flags));
+	Encode(raw, rawLen, &out[pos], flags);
+}
+
+BMHPAL_API std::string Encode(const void* raw, size_t rawLen, Flags flags) {
+	std::string s;
+	EncodeAppend(raw, rawLen, s, flags);
+	return s;
+}
+
+BMHPAL_API std::string Encode(const std::string& raw, Flags flags) {
+	return Encode(raw.data(), raw.size(), flags);
+}
+
+BMHPAL_API Error Decode(const char* enc, size_t encLen, void* _out, size_t& outLen, Flags flags) {
+	auto          out   = (uint8_t*) _out;
+	bool          url   = !!(flags & Flags::URL);
+	const int8_t* table = url ? DecodeURL.V : DecodeStd.V;
+	outLen              = 0;
+
+	size_t len = encLen;
+	if (len != 0 && enc[len - 1] == '=')
+		len--;
+	if (len != 0 && enc[len - 1] == '=')
+		len--;
+	if (len != encLen && encLen % 4 != 0)
+		return Error("Invalid base64 padding");
+	if (len % 4 == 1)
+		return Error("Invalid base64 length");
+
+	size_t full = len - len % 4;
+	size_t i    = 0;
+#ifdef BMHPAL_SSE2
+	// Leave at least 8 characters for the scalar loop, which guarantees that the 16 byte SIMD stores stay inside the output buffer
+	if (full >= 24 && os::CPUHasSSSE3())
+		i = DecodeSSSE3(enc, full - 8, out, url);
+#endif
+	uint8_t* o = out + i / 4 * 3;
+	for (; i < full; i += 4) {
+		int a = table[(uint8_t) enc[i]];
+		int b = table[(uint8_t) enc[i + 1]];
+		int c = table[(uint8_t) enc[i + 2]];
+		int d = table[(uint8_t) enc[i + 3]];
+		if ((a | b | c | d) < 0)
+			return Error::Fmt("Invalid base64 character near position %v", i);
+		uint32_t v = ((uint32_t) a << 18) | ((uint32_t) b << 12) | ((uint32_t) c << 6) | (uint32_t) d;
+		o[0]       = (uint8_t) (v >> 16);
+		o[1]       = (uint8_t) (v >> 8);
+		o[2]       = (uint8_t) v;
+		o += 3;
+	}
+	size_t remain = len - full;
+	if (remain != 0) {
+		int a = table[(uint8_t) enc[i]];
+		int b = table[(uint8_t) enc[i + 1]];
+		int c = remain == 3 ? table[(uint8_t) enc[i + 2]] : 0;
+		if ((a | b | c) < 0)
+			return Error::Fmt("Invalid base64 character near position %v", i);
+		uint32_t v = ((uint32_t) a << 18) | ((uint32_t) b << 12) | ((uint32_t) c << 6);
+		*o++       = (uint8_t) (v >> 16);
+		if (remain == 3)
+			*o++ = (uint8_t) (v >> 8);
+	}
+	outLen = o - out;
+	return Error();
+}
+
+BMHPAL_API Error DecodeAppend(const char* enc, size_t encLen, std::string& out, Flags flags) {
+	size_t pos = out.size();
+	size_t n   = 0;
+	out.resize(pos + MaxDecodedLen(encLen));
+	auto err = Decode(enc, encLen, &out[pos], n, flags);
+	out.resize(pos + n);
+	return err;
+}
+
+BMHPAL_API Error Decode(const std::string& enc, std::string& out, Flags flags) {
+	out.clear();
+	return DecodeAppend(enc.data(), enc.size(), out, flags);
+}
+
+Encoder::Encoder(Flags flags) : F(flags) {
+}
+
+void Encoder::Write(const void* _raw, size_t rawLen, std::string& out) {
+	auto raw = (const uint8_t*) _raw;
+	if (NPending != 0) {
+		for (; NPending < 3 && rawLen != 0; rawLen--)
+			Pending[NPending++] = *raw++;
+		if (NPending < 3)
+			return;
+		EncodeAppend(Pending, 3, out, F);
+		NPending = 0;
+	}
+	size_t full = rawLen - rawLen % 3;
+	EncodeAppend(raw, full, out, F);
+	for (size_t i = full; i < rawLen; i++)
+		Pending[NPending++] = raw[i];
+}
+
+void Encoder::Finish(std::string& out) {
+	EncodeAppend(Pending, NPending, out, F);
+	NPending = 0;
+}
+
+Decoder::Decoder(Flags flags) : F(flags) {
+}
+
+Error Decoder::Write(const char* enc, size_t encLen, std::string& out) {
+	if (encLen == 0)
+		return Error();
+	if (Done)
+		return Error("Unexpected base64 data after padding");
+	if (NPending != 0) {
+		for (; NPending < 4 && encLen != 0; encLen--)
+			Pending[NPending++] = *enc++;
+		if (NPending < 4)
+			return Error();
+		NPending = 0;
+		Done     = Pending[3] == '=';
+		auto err = DecodeAppend(Pending, 4, out, F);
+		if (!err.OK())
+			return err;
+		if (Done && encLen != 0)
+			return Error("Unexpected base64 data after padding");
+	}
+	size_t full = encLen - encLen % 4;
+	if (full != 0) {
+		Done     = enc[full - 1] == '=';
+		auto err = DecodeAppend(enc, full, out, F);
+		if (!err.OK())
+			return err;
+		if (Done && full != encLen)
+			return Error("Unexpected base64 data after padding");
+	}
+	for (size_t i = full; i < encLen; i++)
+		Pending[NPending++] = enc[i];
+	return Error();
+}
+
+Error Decoder::Finish(std::string& out) {
+	size_t n = NPending;
+	NPending = 0;
+	return DecodeAppend(Pending, n, out, F);
+}
+
+} // namespace base64
+} // namespace bmhpal
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../Error/Error.h"
+
+namespace bmhpal {
+namespace base64 {
+
+enum class Flags {
+	None  = 0,
+	URL   = 1, // Use the URL and filename safe alphabet (RFC 4648 section 5), which has '-' and '_' instead of '+' and '/'
+	NoPad = 2, // Don't emit trailing '=' padding when encoding. Decoding always accepts input with or without padding.
+};
+inline Flags operator|(Flags a, Flags b) {
+	return Flags((uint32_t) a | (uint32_t) b);
+}
+inline uint32_t operator&(Flags a, Flags b) {
+	return (uint32_t) a & (uint32_t) b;
+}
+
+// Number of characters produced by encoding rawLen bytes
+inline size_t EncodedLen(size_t rawLen, Flags flags = Flags::None) {
+	if (!!(flags & Flags::NoPad))
+		return (rawLen * 4 + 2) / 3;
+	return (rawLen + 2) / 3 * 4;
+}
+
+// Upper bound on the number of bytes produced by decoding encLen characters
+inline size_t MaxDecodedLen(size_t encLen) {
+	return (encLen + 3) / 4 * 3;
+}
+
+BMHPAL_API size_t      Encode(const void* raw, size_t rawLen, char* out, Flags flags = Flags::None); // out must have space for EncodedLen(rawLen) characters. No null terminator is written. Returns number of characters written.
+BMHPAL_API void        EncodeAppend(const void* raw, size_t rawLen, std::string& out, Flags flags = Flags::None);
+BMHPAL_API std::string Encode(const void* raw, size_t rawLen, Flags flags = Flags::None);
+BMHPAL_API std::string Encode(const std::string& raw, Flags flags = Flags::None);
+
+// out must have space for MaxDecodedLen(encLen) bytes. outLen receives the number of bytes written.
+BMHPAL_API Error Decode(const char* enc, size_t encLen, void* out, size_t& outLen, Flags flags = Flags::None);
+BMHPAL_API Error DecodeAppend(const char* enc, size_t encLen, std::string& out, Flags flags = Flags::None);
+BMHPAL_API Error Decode(const std::string& enc, std::string& out, Flags flags = Flags::None);
+
+// Chunked encoder, for data that is too large to hold in memory at once.
+// Every call to Write appends the encoded form of all complete 3 byte groups to 'out', so the caller
+// can flush and clear 'out' between calls. Call Finish once, after the last Write.
+class BMHPAL_API Encoder {
+public:
+	Encoder(Flags flags = Flags::None);
+	void Write(const void* raw, size_t rawLen, std::string& out);
+	void Finish(std::string& out);
+
+private:
+	Flags   F;
+	uint8_t Pending[3];
+	size_t  NPending = 0;
+};
+
+// Chunked decoder. Analogue of Encoder.
+class BMHPAL_API Decoder {
+public:
+	Decoder(Flags flags = Flags::None);
+	Error Write(const char* enc, size_t encLen, std::string& out);
+	Error Finish(std::string& out);
+
+private:
+	Flags  F;
+	char   Pending[4];
+	size_t NPending = 0;
+	bool   Done     = false; // We've seen padding, so no more input is allowed
+};
+
+} // namespace base64
+} // namespace bmhpal
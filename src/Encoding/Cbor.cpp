@@ -0,0 +1,844 @@
+#include "pch.h"
+#include "Cbor.h"
+#include "../OS/OS.h"
+#include <cfloat>
+#include <cmath>
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace cbor {
+
+// Major types
+enum : uint8_t {
+	MajorUInt   = 0,
+	MajorNegInt = 1,
+	MajorBytes  = 2,
+	MajorText   = 3,
+	MajorArray  = 4,
+	MajorMap    = 5,
+	MajorTag    = 6,
+	MajorSimple = 7,
+};
+
+// Initial bytes of major type 7, and of indefinite length items
+enum : uint8_t {
+	ByteFalse     = 0xF4,
+	ByteTrue      = 0xF5,
+	ByteNull      = 0xF6,
+	ByteUndefined = 0xF7,
+	ByteHalf      = 0xF9,
+	ByteFloat     = 0xFA,
+	ByteDouble    = 0xFB,
+	ByteBreak     = 0xFF,
+};
+
+static const int      MaxDepth         = 1000;
+static const uint8_t  InfoIndefinite   = 31;
+static const uint64_t RemainingForever = UINT64_MAX;
+
+static inline uint64_t LoadBE(const uint8_t* p, int n) {
+	uint64_t v = 0;
+	for (int i = 0; i < n; i++)
+		v = (v << 8) | p[i];
+	return v;
+}
+
+// Decode an IEEE 754 half precision float
+static double HalfToDouble(uint16_t h) {
+	int    exp  = (h >> 10) & 0x1f;
+	int    mant = h & 0x3ff;
+	double v;
+	if (exp == 0)
+		v = ldexp(mant, -24);
+	else if (exp != 31)
+		v = ldexp(mant + 1024, exp - 25);
+	else
+		v = mant == 0 ? INFINITY : NAN;
+	return (h & 0x8000) ? -v : v;
+}
+
+Writer::Writer(std::string& out) : Out(&out) {
+}
+
+Writer::Writer(int fd, size_t bufferSize) : Out(&Buf), Fd(fd), BufferSize(bufferSize) {
+	// Leave some slack, so that we don't need to grow the buffer just before flushing
+	Buf.reserve(bufferSize + bufferSize / 8);
+}
+
+Writer::~Writer() {
+}
+
+// Emit the initial byte(s) of an item, using the shortest encoding of v
+void Writer::Head(uint8_t major, uint64_t v) {
+	uint8_t buf[9];
+	int     n;
+	major <<= 5;
+	if (v < 24) {
+		buf[0] = major | (uint8_t) v;
+		n      = 1;
+	} else if (v <= 0xff) {
+		buf[0] = major | 24;
+		n      = 2;
+	} else if (v <= 0xffff) {
+		buf[0] = major | 25;
+		n      = 3;
+	} else if (v <= 0xffffffff) {
+		buf[0] = major | 26;
+		n      = 5;
+	} else {
+		buf[0] = major | 27;
+		n      = 9;
+	}
+	for (int i = n - 1; i > 0; i--) {
+		buf[i] = (uint8_t) v;
+		v >>= 8;
+	}
+	Out->append((const char*) buf, n);
+}
+
+void Writer::BeginObject(size_t n) {
+	if (n == Indefinite)
+		Out->push_back((char) ((MajorMap << 5) | InfoIndefinite));
+	else
+		Head(MajorMap, n);
+	IsIndefinite.push_back(n == Indefinite);
+}
+
+void Writer::EndObject() {
+	if (IsIndefinite.back())
+		Out->push_back((char) ByteBreak);
+	IsIndefinite.pop_back();
+	MaybeFlush();
+}
+
+void Writer::BeginArray(size_t n) {
+	if (n == Indefinite)
+		Out->push_back((char) ((MajorArray << 5) | InfoIndefinite));
+	else
+		Head(MajorArray, n);
+	IsIndefinite.push_back(n == Indefinite);
+}
+
+void Writer::EndArray() {
+	EndObject();
+}
+
+void Writer::String(const char* s, size_t len) {
+	Head(MajorText, len);
+	Out->append(s, len);
+	MaybeFlush();
+}
+
+void Writer::Int(int64_t v) {
+	if (v >= 0)
+		Head(MajorUInt, (uint64_t) v);
+	else
+		Head(MajorNegInt, (uint64_t) (-1 - v));
+	MaybeFlush();
+}
+
+void Writer::UInt(uint64_t v) {
+	Head(MajorUInt, v);
+	MaybeFlush();
+}
+
+void Writer::Double(double v) {
+	uint8_t buf[9];
+	// Converting a finite double that is outside the range of float is undefined, so check that first
+	bool fits = !std::isfinite(v) || fabs(v) <= FLT_MAX;
+	float f   = fits ? (float) v : 0;
+	if (fits && ((double) f == v || v != v)) {
+		// No precision is lost by storing this as a float, which is common for things like coordinates and 0.5
+		uint32_t u;
+		memcpy(&u, &f, 4);
+		buf[0] = ByteFloat;
+		for (int i = 4; i > 0; i--, u >>= 8)
+			buf[i] = (uint8_t) u;
+		Out->append((const char*) buf, 5);
+	} else {
+		uint64_t u;
+		memcpy(&u, &v, 8);
+		buf[0] = ByteDouble;
+		for (int i = 8; i > 0; i--, u >>= 8)
+			buf[i] = (uint8_t) u;
+		Out->append((const char*) buf, 9);
+	}
+	MaybeFlush();
+}
+
+void Writer::Bool(bool v) {
+	Out->push_back((char) (v ? ByteTrue : ByteFalse));
+	MaybeFlush();
+}
+
+void Writer::Null() {
+	Out->push_back((char) ByteNull);
+	MaybeFlush();
+}
+
+void Writer::Write(const nlohmann::json& j) {
+	switch (j.type()) {
+	case nlohmann::json::value_t::object:
+		BeginObject(j.size());
+		for (auto it = j.begin(); it != j.end(); ++it) {
+			Key(it.key());
+			Write(it.value());
+		}
+		EndObject();
+		break;
+	case nlohmann::json::value_t::array:
+		BeginArray(j.size());
+		for (const auto& v : j)
+			Write(v);
+		EndArray();
+		break;
+	case nlohmann::json::value_t::string: String(j.get_ref<const std::string&>()); break;
+	case nlohmann::json::value_t::boolean: Bool(j.get<bool>()); break;
+	case nlohmann::json::value_t::number_integer: Int(j.get<int64_t>()); break;
+	case nlohmann::json::value_t::number_unsigned: UInt(j.get<uint64_t>()); break;
+	case nlohmann::json::value_t::number_float: Double(j.get<double>()); break;
+	default: Null(); break;
+	}
+}
+
+Error Writer::Flush() {
+	if (Fd == -1)
+		return Error();
+	if (Err.OK() && Buf.size() != 0)
+		Err = os::WriteAll(Fd, Buf.data(), Buf.size());
+	Buf.clear();
+	return Err;
+}
+
+Reader::Reader(const void* buf, size_t len) : Src((const uint8_t*) buf), End((const uint8_t*) buf + len), P((const uint8_t*) buf) {
+}
+
+bool Reader::Fail(const char* msg) {
+	if (Failure.OK())
+		Failure = Error::Fmt("Error decoding cbor: %v at offset %v", msg, P - Src);
+	return false;
+}
+
+bool Reader::Truncate() {
+	IsTruncated = Failure.OK();
+	return Fail("unexpected end of input");
+}
+
+// Tags carry semantic information (eg dates, bignums), which we don't interpret
+bool Reader::SkipTags() {
+	while (P != End && (*P >> 5) == MajorTag) {
+		uint8_t  major, info;
+		uint64_t v;
+		if (!ReadHead(major, info, v))
+			return false;
+	}
+	return true;
+}
+
+// Consume the initial byte(s) of an item. For indefinite lengths, v is RemainingForever.
+bool Reader::ReadHead(uint8_t& major, uint8_t& info, uint64_t& v) {
+	if (P == End)
+		return Truncate();
+	major = *P >> 5;
+	info  = *P & 0x1f;
+	if (info < 24) {
+		v = info;
+		P++;
+		return true;
+	} else if (info <= 27) {
+		int n = 1 << (info - 24);
+		if (End - P < 1 + n)
+			return Truncate();
+		v = LoadBE(P + 1, n);
+		P += 1 + n;
+		return true;
+	} else if (info == InfoIndefinite && major >= MajorBytes && major <= MajorMap) {
+		v = RemainingForever;
+		P++;
+		return true;
+	} else if (info == InfoIndefinite && major == MajorSimple) {
+		return Fail("unexpected break");
+	}
+	return Fail("invalid initial byte");
+}
+
+Reader::Token Reader::Peek() {
+	if (!Failure.OK() || !SkipTags() || P == End)
+		return Token::End;
+	switch (*P >> 5) {
+	case MajorUInt:
+	case MajorNegInt: return Token::Number;
+	case MajorBytes: return Token::Bytes;
+	case MajorText: return Token::String;
+	case MajorArray: return Token::Array;
+	case MajorMap: return Token::Object;
+	case MajorTag: return Token::End; // Unreachable, because of SkipTags
+	case MajorSimple:
+		switch (*P) {
+		case ByteFalse:
+		case ByteTrue: return Token::Bool;
+		case ByteNull:
+		case ByteUndefined: return Token::Null;
+		case ByteHalf:
+		case ByteFloat:
+		case ByteDouble: return Token::Number;
+		}
+	}
+	return Token::End;
+}
+
+bool Reader::BeginObject() {
+	if (Peek() != Token::Object)
+		return Failure.OK() && P == End ? Truncate() : Fail("expected object");
+	if (Remaining.size() >= MaxDepth)
+		return Fail("nesting too deep");
+	uint8_t  major, info;
+	uint64_t n;
+	if (!ReadHead(major, info, n))
+		return false;
+	if (n != RemainingForever && n > (uint64_t) (End - P) / 2)
+		return Truncate(); // Every key/value pair needs at least 2 bytes
+	Remaining.push_back(n);
+	return true;
+}
+
+bool Reader::BeginArray() {
+	if (Peek() != Token::Array)
+		return Failure.OK() && P == End ? Truncate() : Fail("expected array");
+	if (Remaining.size() >= MaxDepth)
+		return Fail("nesting too deep");
+	uint8_t  major, info;
+	uint64_t n;
+	if (!ReadHead(major, info, n))
+		return false;
+	if (n != RemainingForever && n > (uint64_t) (End - P))
+		return Truncate(); // Every element needs at least 1 byte
+	Remaining.push_back(n);
+	return true;
+}
+
+// Returns true if there is another item in the current container. Pops the container when it's finished.
+bool Reader::Next() {
+	if (!Failure.OK())
+		return false;
+	uint64_t& n = Remaining.back();
+	if (n == RemainingForever) {
+		if (P == End)
+			return Truncate();
+		if (*P == ByteBreak) {
+			P++;
+			Remaining.pop_back();
+			return false;
+		}
+		return true;
+	}
+	if (n == 0) {
+		Remaining.pop_back();
+		return false;
+	}
+	n--;
+	return true;
+}
+
+bool Reader::NextMember(const char*& key, size_t& keyLen) {
+	if (!Next())
+		return false;
+	// Only string keys are supported, because that's all that json has
+	if (Peek() != Token::String)
+		return Failure.OK() && P == End ? Truncate() : Fail("expected string key");
+	return String(key, keyLen);
+}
+
+bool Reader::NextElement() {
+	return Next();
+}
+
+bool Reader::Null() {
+	if (Peek() != Token::Null)
+		return false;
+	P++;
+	return true;
+}
+
+bool Reader::Bool(bool& v) {
+	if (Peek() != Token::Bool)
+		return Failure.OK() && P == End ? Truncate() : Fail("expected bool");
+	v = *P++ == ByteTrue;
+	return true;
+}
+
+bool Reader::Number(NumberType& type, int64_t& i, uint64_t& u, double& d) {
+	if (Peek() != Token::Number)
+		return Failure.OK() && P == End ? Truncate() : Fail("expected number");
+	uint8_t major = *P >> 5;
+	if (major == MajorUInt || major == MajorNegInt) {
+		uint8_t info;
+		if (!ReadHead(major, info, u))
+			return false;
+		if (major == MajorUInt) {
+			type = NumberType::UInt;
+		} else if (u > (uint64_t) INT64_MAX) {
+			// -1 - u doesn't fit into an int64
+			type = NumberType::Float;
+			d    = -1.0 - (double) u;
+		} else {
+			type = NumberType::NegInt;
+			i    = -1 - (int64_t) u;
+		}
+		return true;
+	}
+	type    = NumberType::Float;
+	int len = *P == ByteHalf ? 2 : *P == ByteFloat ? 4 : 8;
+	if (End - P < 1 + len)
+		return Truncate();
+	uint64_t bits = LoadBE(P + 1, len);
+	P += 1 + len;
+	if (len == 2) {
+		d = HalfToDouble((uint16_t) bits);
+	} else if (len == 4) {
+		uint32_t b32 = (uint32_t) bits;
+		float    f;
+		memcpy(&f, &b32, 4);
+		d = f;
+	} else {
+		memcpy(&d, &bits, 8);
+	}
+	return true;
+}
+
+bool Reader::Int64(int64_t& v) {
+	NumberType type;
+	int64_t    i;
+	uint64_t   u;
+	double     d;
+	if (!Number(type, i, u, d))
+		return false;
+	switch (type) {
+	case NumberType::UInt:
+		if (u > (uint64_t) INT64_MAX)
+			return Fail("number out of range");
+		v = (int64_t) u;
+		break;
+	case NumberType::NegInt: v = i; break;
+	case NumberType::Float:
+		// The comparisons are false for NaN. 2^63 is exact as a double, and INT64_MAX is not.
+		if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0))
+			return Fail("number out of range");
+		v = (int64_t) d;
+		break;
+	}
+	return true;
+}
+
+bool Reader::UInt64(uint64_t& v) {
+	NumberType type;
+	int64_t    i;
+	uint64_t   u;
+	double     d;
+	if (!Number(type, i, u, d))
+		return false;
+	switch (type) {
+	case NumberType::UInt: v = u; break;
+	case NumberType::NegInt: return Fail("expected unsigned number");
+	case NumberType::Float:
+		if (d < 0)
+			return Fail("expected unsigned number");
+		if (!(d < 18446744073709551616.0))
+			return Fail("number out of range");
+		v = (uint64_t) d;
+		break;
+	}
+	return true;
+}
+
+bool Reader::Double(double& v) {
+	NumberType type;
+	int64_t    i;
+	uint64_t   u;
+	if (!Number(type, i, u, v))
+		return false;
+	switch (type) {
+	case NumberType::UInt: v = (double) u; break;
+	case NumberType::NegInt: v = (double) i; break;
+	case NumberType::Float: break;
+	}
+	return true;
+}
+
+bool Reader::String(const char*& s, size_t& len) {
+	if (Peek() != Token::String)
+		return Failure.OK() && P == End ? Truncate() : Fail("expected string");
+	uint8_t  major, info;
+	uint64_t n;
+	if (!ReadHead(major, info, n))
+		return false;
+	if (n != RemainingForever) {
+		if (n > (uint64_t) (End - P))
+			return Truncate();
+		s   = (const char*) P;
+		len = (size_t) n;
+		P += n;
+		return true;
+	}
+
+	// Slow path, for indefinite length strings, which are a sequence of definite length chunks
+	Scratch.clear();
+	while (true) {
+		if (P == End)
+			return Truncate();
+		if (*P == ByteBreak) {
+			P++;
+			break;
+		}
+		if (*P >> 5 != MajorText)
+			return Fail("invalid string chunk");
+		if (!ReadHead(major, info, n))
+			return false;
+		if (n == RemainingForever)
+			return Fail("nested indefinite length string");
+		if (n > (uint64_t) (End - P))
+			return Truncate();
+		Scratch.append((const char*) P, (size_t) n);
+		P += n;
+	}
+	s   = Scratch.data();
+	len = Scratch.size();
+	return true;
+}
+
+bool Reader::String(std::string& v) {
+	const char* s;
+	size_t      len;
+	if (!String(s, len))
+		return false;
+	v.assign(s, len);
+	return true;
+}
+
+bool Reader::Skip() {
+	switch (Peek()) {
+	case Token::Object: {
+		const char* key;
+		size_t      keyLen;
+		BeginObject();
+		while (NextMember(key, keyLen)) {
+			if (!Skip())
+				return false;
+		}
+		return Failure.OK();
+	}
+	case Token::Array:
+		BeginArray();
+		while (NextElement()) {
+			if (!Skip())
+				return false;
+		}
+		return Failure.OK();
+	case Token::String: {
+		const char* s;
+		size_t      len;
+		return String(s, len);
+	}
+	case Token::Bytes: {
+		uint8_t  major, info;
+		uint64_t n;
+		if (!ReadHead(major, info, n))
+			return false;
+		if (n == RemainingForever) {
+			while (P != End && *P != ByteBreak) {
+				if (*P >> 5 != MajorBytes || !ReadHead(major, info, n) || n == RemainingForever)
+					return Fail("invalid byte string chunk");
+				if (n > (uint64_t) (End - P))
+					return Truncate();
+				P += n;
+			}
+			if (P == End)
+				return Truncate();
+			P++;
+			return true;
+		}
+		if (n > (uint64_t) (End - P))
+			return Truncate();
+		P += n;
+		return true;
+	}
+	case Token::Number: {
+		NumberType type;
+		int64_t    i;
+		uint64_t   u;
+		double     d;
+		return Number(type, i, u, d);
+	}
+	case Token::Bool:
+	case Token::Null:
+		P++;
+		return true;
+	case Token::End:
+		if (!Failure.OK())
+			return false;
+		if (P == End)
+			return Truncate();
+		// Simple values that have no json equivalent
+		uint8_t  major, info;
+		uint64_t v;
+		if (!ReadHead(major, info, v))
+			return false;
+		if (major != MajorSimple)
+			return Fail("invalid initial byte");
+		return true;
+	}
+	return false;
+}
+
+bool Reader::Finish() {
+	if (!Failure.OK())
+		return false;
+	if (P != End)
+		return Fail("unexpected trailing bytes");
+	return true;
+}
+
+// Build a DOM from the reader
+static bool DecodeDom(Reader& r, nlohmann::json& j) {
+	switch (r.Peek()) {
+	case Reader::Token::Object: {
+		j = nlohmann::json::object();
+		const char* key;
+		size_t      keyLen;
+		r.BeginObject();
+		while (r.NextMember(key, keyLen)) {
+			if (!DecodeDom(r, j[std::string(key, keyLen)]))
+				return false;
+		}
+		return r.OK();
+	}
+	case Reader::Token::Array: {
+		j = nlohmann::json::array();
+		r.BeginArray();
+		while (r.NextElement()) {
+			j.push_back(nullptr);
+			if (!DecodeDom(r, j.back()))
+				return false;
+		}
+		return r.OK();
+	}
+	case Reader::Token::String: {
+		const char* s;
+		size_t      len;
+		if (!r.String(s, len))
+			return false;
+		j = std::string(s, len);
+		return true;
+	}
+	case Reader::Token::Number: {
+		// Preserve the distinction between signed, unsigned, and float, the same as from_cbor
+		Reader::NumberType type;
+		int64_t            i;
+		uint64_t           u;
+		double             d;
+		if (!r.Number(type, i, u, d))
+			return false;
+		switch (type) {
+		case Reader::NumberType::UInt: j = u; break;
+		case Reader::NumberType::NegInt: j = i; break;
+		case Reader::NumberType::Float: j = d; break;
+		}
+		return true;
+	}
+	case Reader::Token::Bool: {
+		bool b;
+		r.Bool(b);
+		j = b;
+		return true;
+	}
+	case Reader::Token::Null:
+		r.Null();
+		j = nullptr;
+		return true;
+	case Reader::Token::Bytes:
+		return r.Fail("byte strings are not supported");
+	case Reader::Token::End:
+		if (!r.OK())
+			return false;
+		return r.Skip() && r.Fail("unsupported simple value");
+	}
+	return false;
+}
+
+BMHPAL_API void Encode(const nlohmann::json& j, std::string& out) {
+	Writer w(out);
+	w.Write(j);
+}
+
+BMHPAL_API Error Decode(const void* buf, size_t len, nlohmann::json& j) {
+	Reader r(buf, len);
+	DecodeDom(r, j);
+	r.Finish();
+	return r.Err();
+}
+
+BMHPAL_API Error Decode(const std::string& buf, nlohmann::json& j) {
+	return Decode(buf.data(), buf.size(), j);
+}
+
+BMHPAL_API Error LoadFile(const std::string& filename, nlohmann::json& j) {
+	std::string raw;
+	auto        err = os::ReadFile(filename, raw);
+	if (!err.OK())
+		return err;
+	return Decode(raw, j);
+}
+
+BMHPAL_API Error SaveFile(const std::string& filename, const nlohmann::json& j) {
+	int  fd;
+	auto err = os::OpenForWrite(filename, fd);
+	if (!err.OK())
+		return err;
+	Writer w(fd);
+	w.Write(j);
+	err = w.Flush();
+	if (close(fd) == -1 && err.OK())
+		err = os::ErrorFrom_errno(errno);
+	return err;
+}
+
+Decoder::Decoder(ItemCallback onItem) : OnItem(onItem) {
+}
+
+// Read the initial byte(s) of an item at buf[pos], and advance pos past them.
+// Returns 1 if they were read, 0 if they're not all there yet, and -1 if they are invalid.
+static int PeekHead(const uint8_t* buf, size_t len, size_t& pos, uint8_t& major, uint8_t& info, uint64_t& v) {
+	if (pos == len)
+		return 0;
+	major = buf[pos] >> 5;
+	info  = buf[pos] & 0x1f;
+	if (info < 24) {
+		v = info;
+		pos++;
+		return 1;
+	} else if (info <= 27) {
+		size_t n = (size_t) 1 << (info - 24);
+		if (len - pos < 1 + n)
+			return 0;
+		v = LoadBE(buf + pos + 1, (int) n);
+		pos += 1 + n;
+		return 1;
+	} else if (info == InfoIndefinite && major >= MajorBytes && major <= MajorMap) {
+		v = RemainingForever;
+		pos++;
+		return 1;
+	}
+	return -1;
+}
+
+// Find the end of the item at Start, carrying on from where the previous call stopped, so that an item
+// that arrives in many pieces is only scanned once. Only the initial bytes of each item are examined, and
+// string contents are jumped over. Returns true when the item is complete, at Start + ScanLen.
+// Malformed input is also reported as complete, so that Decode can produce the error.
+bool Decoder::Scan() {
+	const uint8_t* buf = (const uint8_t*) Pending.data() + Start;
+	size_t         len = Pending.size() - Start;
+	while (true) {
+		size_t pos = ScanLen;
+		if (!ScanStack.empty() && ScanStack.back() == RemainingForever && pos != len && buf[pos] == ByteBreak) {
+			ScanLen++;
+			ScanStack.pop_back();
+		} else {
+			// Tags belong to the item that follows them, so they're consumed together
+			uint8_t  major, info;
+			uint64_t v;
+			int      r;
+			while ((r = PeekHead(buf, len, pos, major, info, v)) == 1 && major == MajorTag) {
+			}
+			if (r == 0)
+				return false;
+			bool indefinite = r == 1 && info == InfoIndefinite;
+			bool container  = indefinite || major == MajorArray || major == MajorMap;
+			if (r == -1 || (container && ScanStack.size() >= MaxDepth) || (major == MajorMap && !indefinite && v > UINT64_MAX / 2)) {
+				ScanLen = std::min(pos + 1, len);
+				return true;
+			}
+			if ((major == MajorBytes || major == MajorText) && !indefinite) {
+				if (v > len - pos)
+					return false; // Wait for the rest of the string
+				pos += (size_t) v;
+			}
+			if (!ScanStack.empty() && ScanStack.back() != RemainingForever)
+				ScanStack.back()--;
+			ScanLen = pos;
+			if (indefinite)
+				ScanStack.push_back(RemainingForever);
+			else if (major == MajorArray && v != 0)
+				ScanStack.push_back(v);
+			else if (major == MajorMap && v != 0)
+				ScanStack.push_back(v * 2);
+		}
+		while (!ScanStack.empty() && ScanStack.back() == 0)
+			ScanStack.pop_back();
+		if (ScanStack.empty())
+			return true;
+	}
+}
+
+Error Decoder::Write(const void* buf, size_t len) {
+	if (!Err.OK())
+		return Err;
+	Pending.append((const char*) buf, len);
+	while (Start != Pending.size()) {
+		nlohmann::json item;
+		size_t         itemLen = 0;
+		if (ScanLen == 0) {
+			// Usually the whole item is here, so decode it straight away
+			Reader r(Pending.data() + Start, Pending.size() - Start);
+			if (DecodeDom(r, item)) {
+				itemLen = r.Position();
+			} else if (!r.Truncated()) {
+				Err = r.Err();
+				return Err;
+			}
+		}
+		if (itemLen == 0) {
+			// The item is arriving in pieces. Decode it once all of it is here.
+			if (!Scan())
+				break;
+			itemLen = ScanLen;
+			ScanLen = 0;
+			ScanStack.clear();
+			Err = Decode(Pending.data() + Start, itemLen, item);
+			if (!Err.OK())
+				return Err;
+		}
+		Start += itemLen;
+		Err = OnItem(item);
+		if (!Err.OK())
+			return Err;
+	}
+	// Discard consumed items, but only once they're a significant fraction of the buffer, so that we're not
+	// constantly shuffling bytes down when many small items arrive at once.
+	if (Start == Pending.size()) {
+		Pending.clear();
+		Start = 0;
+	} else if (Start > Pending.size() / 2) {
+		Pending.erase(0, Start);
+		Start = 0;
+	}
+	return Error();
+}
+
+Error Decoder::Finish() {
+	if (!Err.OK())
+		return Err;
+	if (Start != Pending.size())
+		return Error::Fmt("Error decoding cbor: stream ended in the middle of an item (%v bytes left over)", Pending.size() - Start);
+	return Error();
+}
+
+} // namespace cbor
+} // namespace bmhpal
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <functional>
+#include "../Error/Error.h"
+
+namespace bmhpal {
+namespace cbor {
+
+/*
+
+	CBOR (RFC 7049)
+	===============
+
+	A compact binary equivalent of json. Integers and lengths are stored in as few bytes as possible,
+	strings are not escaped, and doubles are stored in 4 bytes when that loses no precision, so
+	documents are smaller than json text, and much faster to parse.
+
+	The API mirrors the json one: Writer/Reader are the streaming token interfaces (like jsonutil::Writer
+	and jsonutil::Reader), and Encode/Decode/LoadFile/SaveFile convert to and from nlohmann::json, so that
+	the decoded document can be read with the usual jsonser accessors.
+
+	Our output can be read by nlohmann::json::from_cbor, and we can read the output of to_cbor.
+	Tags are ignored, and byte strings are not supported.
+
+	*/
+
+static const size_t Indefinite = (size_t) -1;
+
+class BMHPAL_API Writer {
+public:
+	Writer(std::string& out);                       // Appends to out
+	Writer(int fd, size_t bufferSize = 256 * 1024); // Does not take ownership of fd
+	~Writer();
+
+	// If you don't know the number of items up front, then use the default, which emits an indefinite length container
+	void BeginObject(size_t n = Indefinite);
+	void EndObject();
+	void BeginArray(size_t n = Indefinite);
+	void EndArray();
+	void Key(const char* key, size_t len) { String(key, len); }
+	void Key(const char* key) { String(key, strlen(key)); }
+	void Key(const std::string& key) { String(key.data(), key.size()); }
+	void String(const char* s, size_t len);
+	void String(const char* s) { String(s, strlen(s)); }
+	void String(const std::string& s) { String(s.data(), s.size()); }
+	void Int(int64_t v);
+	void UInt(uint64_t v);
+	void Double(double v);
+	void Bool(bool v);
+	void Null();
+	void Write(const nlohmann::json& j);
+
+	Error Flush(); // Write any buffered output to the file descriptor
+
+private:
+	std::string*      Out;
+	std::string       Buf; // Used when writing to an fd
+	int               Fd         = -1;
+	size_t            BufferSize = 0;
+	std::vector<bool> IsIndefinite; // One entry per open container
+	Error             Err;
+
+	void Head(uint8_t major, uint64_t v);
+	void MaybeFlush() {
+		if (Fd != -1 && Out->size() >= BufferSize)
+			Flush();
+	}
+};
+
+// Pull parser. See jsonutil::Reader for usage, which is identical.
+class BMHPAL_API Reader {
+public:
+	enum class Token {
+		End, // End of input, or an error
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object,
+		Bytes, // Byte strings can only be skipped
+	};
+
+	enum class NumberType {
+		UInt,   // Positive integer
+		NegInt, // Negative integer
+		Float,  // Half, single, or double precision float
+	};
+
+	Reader(const void* buf, size_t len);
+
+	Token  Peek();
+	bool   OK() const { return Failure.OK(); }
+	Error  Err() const { return Failure; }
+	bool   Truncated() const { return IsTruncated; } // True if we failed because the input ended in the middle of an item
+	size_t Position() const { return P - Src; }      // Number of bytes consumed
+
+	bool BeginObject();
+	bool NextMember(const char*& key, size_t& keyLen); // Returns false at the end of the object. key is valid until the next call to the Reader.
+	bool BeginArray();
+	bool NextElement(); // Returns false at the end of the array
+
+	bool Null(); // Consumes a null (or undefined), if that's what is next. Returns false without failing if it's anything else.
+	bool Bool(bool& v);
+	bool Int64(int64_t& v);   // Doubles are truncated. Numbers that don't fit fail.
+	bool UInt64(uint64_t& v); // Doubles are truncated. Negative numbers, and numbers that don't fit, fail.
+	bool Double(double& v);
+	bool Number(NumberType& type, int64_t& i, uint64_t& u, double& d); // Read a number in its stored type. Negative integers below INT64_MIN are returned as Float.
+	bool String(std::string& v);
+	bool String(const char*& s, size_t& len); // s is valid until the next call to the Reader
+	bool Skip();
+	bool Finish(); // Fails if there are any bytes left
+
+	bool Fail(const char* msg);
+
+private:
+	const uint8_t*        Src;
+	const uint8_t*        End;
+	const uint8_t*        P;
+	std::vector<uint64_t> Remaining; // Items left in each open container, or UINT64_MAX if indefinite
+	std::string           Scratch;   // Concatenation of indefinite length strings
+	bool                  IsTruncated = false;
+	Error                 Failure;
+
+	bool SkipTags();
+	bool ReadHead(uint8_t& major, uint8_t& info, uint64_t& v);
+	bool Next();
+	bool Truncate();
+};
+
+BMHPAL_API void  Encode(const nlohmann::json& j, std::string& out); // Appends to out
+BMHPAL_API Error Decode(const void* buf, size_t len, nlohmann::json& j);
+BMHPAL_API Error Decode(const std::string& buf, nlohmann::json& j);
+BMHPAL_API Error LoadFile(const std::string& filename, nlohmann::json& j);
+BMHPAL_API Error SaveFile(const std::string& filename, const nlohmann::json& j);
+
+// Streaming decoder, for a sequence of CBOR items (RFC 8742) that arrives in chunks, such as from a socket
+// or http::Request::OnBody. Items are delivered to the callback as soon as they are complete. This is the
+// CBOR equivalent of ndjson::Reader.
+class BMHPAL_API Decoder {
+public:
+	typedef std::function<Error(nlohmann::json& item)> ItemCallback;
+
+	Decoder(ItemCallback onItem);
+	Error Write(const void* buf, size_t len);
+	Error Finish(); // Fails if the stream ended in the middle of an item
+
+private:
+	ItemCallback          OnItem;
+	std::string           Pending;
+	size_t                Start   = 0; // Start of the first undecoded item inside Pending
+	size_t                ScanLen = 0; // Bytes of the incomplete item at Start that have been scanned so far
+	std::vector<uint64_t> ScanStack;   // Items left in each container that the scan is inside of
+	Error                 Err;
+
+	bool Scan();
+};
+
+} // namespace cbor
+} // namespace bmhpal
@@ -1,52 +1,118 @@
 #include "pch.h"
 #include "Hex.h"
 
+#ifdef BMHPAL_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 namespace bmhpal {
 namespace hex {
 
-static const char* EncodeTable = "0123456789abcdef";
+// Python: print('"' + ''.join('%02x' % i for i in range(256)) + '"'), and '%02X' for the upper case table
+static const char EncodeTableLower[513] = "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9fa0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebfc0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedfe0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+static const char EncodeTableUpper[513] = "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9FA0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBFC0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDFE0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+// -1 for invalid characters, otherwise the nibble value
+// Python: print(', '.join(str(int(chr(c), 16)) if chr(c) in '0123456789abcdefABCDEF' else '-1' for c in range(256)))
+static const int8_t DecodeTable[256] = {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
 
 BMHPAL_API unsigned
 DecodeChar(char hex) {
-	if (hex >= '0' && hex <= '9')
-		return hex - '0';
-	else if (hex >= 'a' && hex <= 'f')
-		return 10 + hex - 'a';
-	else if (hex >= 'A' && hex <= 'F')
-		return 10 + hex - 'A';
-	else
-		return -1;
+	return (unsigned) (int) DecodeTable[(uint8_t) hex];
+}
+
+#ifdef BMHPAL_SSE2
+// Convert 16 nibbles (0..15) into their hex characters. alphaOffset is the distance from '0' + 10 to 'a' or 'A'.
+static inline __m128i NibblesToHex(__m128i n, __m128i alphaOffset) {
+	__m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(n, _mm_set1_epi8(9)), alphaOffset);
+	return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')), alpha);
+}
+
+// Convert 16 hex characters into nibbles. Sets 'valid' to false if any of the characters are not hex.
+static inline __m128i HexToNibbles(__m128i c, __m128i& valid) {
+	// Bytes >= 0x80 are negative in the signed compares, so they fail both range checks
+	__m128i lower   = _mm_or_si128(c, _mm_set1_epi8(0x20));
+	__m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	__m128i isAlpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+	__m128i digit   = _mm_and_si128(isDigit, _mm_sub_epi8(c, _mm_set1_epi8('0')));
+	__m128i alpha   = _mm_and_si128(isAlpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+	valid           = _mm_and_si128(valid, _mm_or_si128(isDigit, isAlpha));
+	return _mm_or_si128(digit, alpha);
+}
+
+// Combine 8 pairs of nibbles into 8 bytes, in the low byte of each 16-bit lane
+static inline __m128i CombineNibbles(__m128i n) {
+	__m128i hi = _mm_slli_epi16(_mm_and_si128(n, _mm_set1_epi16(0x00ff)), 4);
+	__m128i lo = _mm_srli_epi16(n, 8);
+	return _mm_or_si128(hi, lo);
+}
+#endif
+
+BMHPAL_API Error Decode(const char* hex, void* out, size_t outBufferSize) {
+	return Decode(hex, strlen(hex), out, outBufferSize);
 }
 
-BMHPAL_API Error Decode(const char* hex, void* _out, size_t outBufferSize) {
+BMHPAL_API Error Decode(const char* hex, size_t hexLen, void* _out, size_t outBufferSize) {
+	if (hexLen % 2 != 0)
+		return Error::Fmt("Hex string has odd length %v", hexLen);
+	if (hexLen / 2 > outBufferSize)
+		return Error::Fmt("Out of space decoding hex string");
+
 	uint8_t* out = (uint8_t*) _out;
-	uint8_t* end = out + outBufferSize;
-	for (size_t i = 0; hex[i]; i += 2) {
-		if (out >= end)
-			return Error::Fmt("Out of space decoding hex string");
-		unsigned c1 = DecodeChar(hex[i]);
-		unsigned c2 = DecodeChar(hex[i + 1]);
-		if (c1 == -1 || c2 == -1)
+	size_t   i   = 0;
+#ifdef BMHPAL_SSE2
+	for (; i + 32 <= hexLen; i += 32) {
+		__m128i valid = _mm_set1_epi8(-1);
+		__m128i n0    = HexToNibbles(_mm_loadu_si128((const __m128i*) (hex + i)), valid);
+		__m128i n1    = HexToNibbles(_mm_loadu_si128((const __m128i*) (hex + i + 16)), valid);
+		if (_mm_movemask_epi8(valid) != 0xffff)
+			break; // let the scalar loop find the bad pair and report it
+		_mm_storeu_si128((__m128i*) out, _mm_packus_epi16(CombineNibbles(n0), CombineNibbles(n1)));
+		out += 16;
+	}
+#endif
+	for (; i < hexLen; i += 2) {
+		int c1 = DecodeTable[(uint8_t) hex[i]];
+		int c2 = DecodeTable[(uint8_t) hex[i + 1]];
+		if ((c1 | c2) < 0)
 			return Error::Fmt("Invalid hex pair '%c%c'", hex[i], hex[i + 1]);
-		*out++ = (c1 << 4) | c2;
+		*out++ = (uint8_t) ((c1 << 4) | c2);
 	}
 	return Error();
 }
 
-BMHPAL_API std::string Encode(const void* _buf, size_t bufSize) {
-	auto        buf = (const uint8_t*) _buf;
-	std::string s;
-	s.resize(bufSize * 2);
-	size_t j = 0;
-	for (size_t i = 0; i < bufSize; i++) {
-		s[j]     = EncodeTable[buf[i] >> 4];
-		s[j + 1] = EncodeTable[buf[i] & 0xf];
-		j += 2;
+BMHPAL_API size_t Encode(const void* _buf, size_t bufSize, char* out, bool upperCase) {
+	auto        buf   = (const uint8_t*) _buf;
+	const char* table = upperCase ? EncodeTableUpper : EncodeTableLower;
+	size_t      i     = 0;
+#ifdef BMHPAL_SSE2
+	__m128i alphaOffset = _mm_set1_epi8(upperCase ? 'A' - '0' - 10 : 'a' - '0' - 10);
+	for (; i + 16 <= bufSize; i += 16) {
+		__m128i b  = _mm_loadu_si128((const __m128i*) (buf + i));
+		__m128i hi = NibblesToHex(_mm_and_si128(_mm_srli_epi16(b, 4), _mm_set1_epi8(0x0f)), alphaOffset);
+		__m128i lo = NibblesToHex(_mm_and_si128(b, _mm_set1_epi8(0x0f)), alphaOffset);
+		_mm_storeu_si128((__m128i*) (out + i * 2), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i*) (out + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
 	}
+#endif
+	for (; i < bufSize; i++)
+		memcpy(out + i * 2, table + buf[i] * 2, 2);
+	return bufSize * 2;
+}
+
+BMHPAL_API void EncodeAppend(const void* buf, size_t bufSize, std::string& out, bool upperCase) {
+	size_t pos = out.size();
+	out.resize(pos + bufSize * 2);
+	Encode(buf, bufSize, &out[pos], upperCase);
+}
+
+BMHPAL_API std::string Encode(const void* buf, size_t bufSize, bool upperCase) {
+	std::string s;
+	EncodeAppend(buf, bufSize, s, upperCase);
 	return s;
 }
 
 } // namespace hex
-} // namespace bmhpal
\ No newline at end of file
+} // namespace bmhpal
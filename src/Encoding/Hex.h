@@ -6,6 +6,9 @@ namespace bmhpal {
 namespace hex {
 BMHPAL_API unsigned DecodeChar(char hex); // Returns -1 if invalid
 BMHPAL_API Error    Decode(const char* hex, void* out, size_t outBufferSize);
-BMHPAL_API std::string Encode(const void* buf, size_t bufSize);
+BMHPAL_API Error    Decode(const char* hex, size_t hexLen, void* out, size_t outBufferSize); // hex does not need to be null terminated. hexLen must be even.
+BMHPAL_API size_t   Encode(const void* buf, size_t bufSize, char* out, bool upperCase = false);              // Writes exactly bufSize * 2 characters to out (no null terminator). Returns bufSize * 2
+BMHPAL_API void     EncodeAppend(const void* buf, size_t bufSize, std::string& out, bool upperCase = false); // Appends to out, without any temporary allocation
+BMHPAL_API std::string Encode(const void* buf, size_t bufSize, bool upperCase = false);
 } // namespace hex
 } // namespace bmhpal
@@ -15,8 +15,9 @@ BMHPAL_API Error LoadFile(const std::string& filename, nlohmann::json& j) {
 	return Decode(raw, j);
 }
 
-BMHPAL_API Error SaveFile(const std::string& filename, const nlohmann::json& j) {
-	return os::WriteFile(filename, j.dump(1, '\t'));
+BMHPAL_API Error SaveFile(const std::string& filename, const nlohmann::json& j, Format format) {
+	// Stream through a fixed size buffer, instead of building the whole document in memory first
+	return WriteFile(filename, format, [&](Writer& w) { w.Write(j); });
 }
 
 BMHPAL_API Error Decode(const std::string& raw, nlohmann::json& j) {
@@ -36,6 +37,11 @@ BMHPAL_API Error Decode(const void* raw, size_t rawLen, nlohmann::json& j) {
 	}
 	return Error();
 }
+
+BMHPAL_API void Encode(const nlohmann::json& j, std::string& out, Format format) {
+	Writer w(out, format);
+	w.Write(j);
+}
 } // namespace jsonutil
 
 namespace jsonser {
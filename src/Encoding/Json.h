@@ -2,14 +2,16 @@
 
 #include "../Error/Error.h"
 #include "../Time/Time_.h"
+#include "JsonWriter.h"
 
 namespace bmhpal {
 
 namespace jsonutil {
 BMHPAL_API Error LoadFile(const std::string& filename, nlohmann::json& j);
-BMHPAL_API Error SaveFile(const std::string& filename, const nlohmann::json& j);
+BMHPAL_API Error SaveFile(const std::string& filename, const nlohmann::json& j, Format format = Format::Pretty);
 BMHPAL_API Error Decode(const std::string& raw, nlohmann::json& j);
 BMHPAL_API Error Decode(const void* raw, size_t rawLen, nlohmann::json& j);
+BMHPAL_API void  Encode(const nlohmann::json& j, std::string& out, Format format = Format::Compact); // Appends to out
 } // namespace jsonutil
 
 // json serialization
@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "JsonBind.h"
+
+namespace bmhpal {
+namespace jsonbind {
+
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, bool& v) {
+	return r.Bool(v);
+}
+
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, float& v) {
+	double d;
+	if (!r.Double(d))
+		return false;
+	v = (float) d;
+	return true;
+}
+
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, double& v) {
+	return r.Double(v);
+}
+
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, std::string& v) {
+	return r.String(v);
+}
+
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, time::Time& v) {
+	double d;
+	if (!r.Double(d))
+		return false;
+	v = time::Time::FromUnix(d);
+	return true;
+}
+
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, nlohmann::json& v) {
+	const char* raw;
+	size_t      len;
+	if (!r.Raw(raw, len))
+		return false;
+	try {
+		v = nlohmann::json::parse(raw, raw + len);
+	} catch (std::exception& e) {
+		return r.Fail(e.what());
+	}
+	return true;
+}
+
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, bool v) {
+	w.Bool(v);
+}
+
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, float v) {
+	w.Double(v);
+}
+
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, double v) {
+	w.Double(v);
+}
+
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, const std::string& v) {
+	w.String(v);
+}
+
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, const time::Time& v) {
+	w.Double(v.ToUnix());
+}
+
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, const nlohmann::json& v) {
+	w.Write(v);
+}
+
+} // namespace jsonbind
+} // namespace bmhpal
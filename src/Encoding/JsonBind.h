@@ -0,0 +1,227 @@
+#pragma once
+
+#include <limits>
+#include <type_traits>
+#include "../Error/Error.h"
+#include "../Time/Time_.h"
+#include "../OS/OS.h"
+#include "JsonReader.h"
+#include "JsonWriter.h"
+
+namespace bmhpal {
+namespace jsonbind {
+
+/* Struct binding
+
+	Bind a struct to json by giving it a JsonFields member, which lists each field along with its json key:
+
+		struct Person {
+			std::string              Name;
+			int64_t                  Age = 0;
+			std::vector<std::string> Tags;
+
+			template <typename F>
+			void JsonFields(F& f) {
+				f("name", Name);
+				f("age", Age);
+				f("tags", Tags);
+			}
+		};
+
+		Person p;
+		auto err = jsonbind::Decode(text, p);
+		std::string out;
+		jsonbind::Encode(p, out);
+
+	JsonFields is instantiated separately for decoding and encoding, so the key lengths are compile time
+	constants, and the whole field list is inlined. Decoding reads the text once with a jsonutil::Reader,
+	and encoding emits text directly with a jsonutil::Writer, so no nlohmann::json DOM is ever built.
+
+	When decoding, keys that aren't listed are skipped, fields that are absent or null keep their existing
+	values, and a value of the wrong type is an error.
+
+	Supported field types are bool, integers, float, double, std::string, time::Time (as seconds since the
+	unix epoch, like jsonser::GetUnixTime), nlohmann::json, std::vector of any supported type, and any
+	struct that has its own JsonFields.
+
+	*/
+
+// All of the overloads are declared up front, so that they can refer to each other
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, bool& v);
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, float& v);
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, double& v);
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, std::string& v);
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, time::Time& v);
+BMHPAL_API bool DecodeValue(jsonutil::Reader& r, nlohmann::json& v);
+template <typename T>
+bool DecodeValue(jsonutil::Reader& r, std::vector<T>& v);
+template <typename T>
+bool DecodeValue(jsonutil::Reader& r, T& v); // Integers and structs
+
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, bool v);
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, float v);
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, double v);
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, const std::string& v);
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, const time::Time& v);
+BMHPAL_API void EncodeValue(jsonutil::Writer& w, const nlohmann::json& v);
+template <typename T>
+void EncodeValue(jsonutil::Writer& w, const std::vector<T>& v);
+template <typename T>
+void EncodeValue(jsonutil::Writer& w, const T& v); // Integers and structs
+
+// Decode a complete document into v
+template <typename T>
+Error Decode(const char* json, size_t len, T& v) {
+	jsonutil::Reader r(json, len);
+	DecodeValue(r, v);
+	r.Finish();
+	return r.Err();
+}
+
+template <typename T>
+Error Decode(const std::string& json, T& v) {
+	return Decode(json.data(), json.size(), v);
+}
+
+// Encode v, and append it to out
+template <typename T>
+void Encode(const T& v, std::string& out, jsonutil::Format format = jsonutil::Format::Compact) {
+	jsonutil::Writer w(out, format);
+	EncodeValue(w, v);
+}
+
+template <typename T>
+Error LoadFile(const std::string& filename, T& v) {
+	std::string raw;
+	auto        err = os::ReadFile(filename, raw);
+	if (!err.OK())
+		return err;
+	return Decode(raw, v);
+}
+
+template <typename T>
+Error SaveFile(const std::string& filename, const T& v, jsonutil::Format format = jsonutil::Format::Pretty) {
+	return jsonutil::WriteFile(filename, format, [&](jsonutil::Writer& w) { EncodeValue(w, v); });
+}
+
+namespace internal {
+
+class FieldDecoder {
+public:
+	jsonutil::Reader& R;
+	const char*       Key;
+	size_t            KeyLen;
+	bool              Found = false;
+
+	FieldDecoder(jsonutil::Reader& r, const char* key, size_t keyLen) : R(r), Key(key), KeyLen(keyLen) {}
+
+	template <size_t N, typename V>
+	void operator()(const char (&name)[N], V& field) {
+		if (Found || KeyLen != N - 1 || memcmp(Key, name, N - 1) != 0)
+			return;
+		Found = true;
+		if (!R.Null())
+			DecodeValue(R, field);
+	}
+};
+
+class FieldEncoder {
+public:
+	jsonutil::Writer& W;
+
+	FieldEncoder(jsonutil::Writer& w) : W(w) {}
+
+	template <size_t N, typename V>
+	void operator()(const char (&name)[N], V& field) {
+		W.Key(name, N - 1);
+		EncodeValue(W, field);
+	}
+};
+
+template <typename T>
+bool Decode(jsonutil::Reader& r, T& v, std::true_type /*integral*/) {
+	if (std::is_signed<T>::value) {
+		int64_t i;
+		if (!r.Int64(i))
+			return false;
+		if (i < (int64_t) std::numeric_limits<T>::min() || i > (int64_t) std::numeric_limits<T>::max())
+			return r.Fail("number out of range");
+		v = (T) i;
+	} else {
+		uint64_t u;
+		if (!r.UInt64(u))
+			return false;
+		if (u > (uint64_t) std::numeric_limits<T>::max())
+			return r.Fail("number out of range");
+		v = (T) u;
+	}
+	return true;
+}
+
+template <typename T>
+bool Decode(jsonutil::Reader& r, T& v, std::false_type /*integral*/) {
+	if (!r.BeginObject())
+		return false;
+	const char* key;
+	size_t      keyLen;
+	while (r.NextMember(key, keyLen)) {
+		FieldDecoder d(r, key, keyLen);
+		v.JsonFields(d);
+		if (!d.Found)
+			r.Skip();
+	}
+	return r.OK();
+}
+
+template <typename T>
+void Encode(jsonutil::Writer& w, const T& v, std::true_type /*integral*/) {
+	if (std::is_signed<T>::value)
+		w.Int((int64_t) v);
+	else
+		w.UInt((uint64_t) v);
+}
+
+template <typename T>
+void Encode(jsonutil::Writer& w, const T& v, std::false_type /*integral*/) {
+	FieldEncoder e(w);
+	w.BeginObject();
+	// JsonFields is non-const, so that one function can serve both directions. FieldEncoder only reads.
+	const_cast<T&>(v).JsonFields(e);
+	w.EndObject();
+}
+
+} // namespace internal
+
+template <typename T>
+bool DecodeValue(jsonutil::Reader& r, std::vector<T>& v) {
+	if (!r.BeginArray())
+		return false;
+	v.clear();
+	while (r.NextElement()) {
+		v.emplace_back();
+		if (!r.Null())
+			DecodeValue(r, v.back());
+	}
+	return r.OK();
+}
+
+template <typename T>
+bool DecodeValue(jsonutil::Reader& r, T& v) {
+	return internal::Decode(r, v, std::is_integral<T>());
+}
+
+template <typename T>
+void EncodeValue(jsonutil::Writer& w, const std::vector<T>& v) {
+	w.BeginArray();
+	for (const auto& item : v)
+		EncodeValue(w, item);
+	w.EndArray();
+}
+
+template <typename T>
+void EncodeValue(jsonutil::Writer& w, const T& v) {
+	internal::Encode(w, v, std::is_integral<T>());
+}
+
+} // namespace jsonbind
+} // namespace bmhpal
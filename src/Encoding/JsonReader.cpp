@@ -0,0 +1,334 @@
+#include "pch.h"
+#include "JsonReader.h"
+#include "JsonScan.h"
+
+using namespace std;
+
+namespace bmhpal {
+namespace jsonutil {
+
+static const int MaxDepth = 1000;
+
+static inline bool IsWhite(char c) {
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+Reader::Reader(const char* json, size_t len) : Src(json), End(json + len), P(json) {
+}
+
+bool Reader::Fail(const char* msg) {
+	if (Failure.OK())
+		Failure = Error::Fmt("Error decoding json: %v at offset %v", msg, P - Src);
+	return false;
+}
+
+void Reader::SkipWhite() {
+	while (P < End && IsWhite(*P))
+		P++;
+}
+
+Reader::Token Reader::Peek() {
+	SkipWhite();
+	if (P == End || !Failure.OK())
+		return Token::End;
+	switch (*P) {
+	case '{': return Token::Object;
+	case '[': return Token::Array;
+	case '"': return Token::String;
+	case 't':
+	case 'f': return Token::Bool;
+	case 'n': return Token::Null;
+	case '-':
+	case '0':
+	case '1':
+	case '2':
+	case '3':
+	case '4':
+	case '5':
+	case '6':
+	case '7':
+	case '8':
+	case '9': return Token::Number;
+	default: return Token::End;
+	}
+}
+
+bool Reader::BeginObject() {
+	if (!Failure.OK())
+		return false;
+	SkipWhite();
+	if (P == End || *P != '{')
+		return Fail("expected object");
+	if (++Depth > MaxDepth)
+		return Fail("nesting too deep");
+	P++;
+	First = true;
+	return true;
+}
+
+bool Reader::BeginArray() {
+	if (!Failure.OK())
+		return false;
+	SkipWhite();
+	if (P == End || *P != '[')
+		return Fail("expected array");
+	if (++Depth > MaxDepth)
+		return Fail("nesting too deep");
+	P++;
+	First = true;
+	return true;
+}
+
+// Consume the separator before the next member/element, or the closing brace
+bool Reader::Next(char close) {
+	if (!Failure.OK())
+		return false;
+	SkipWhite();
+	if (P == End)
+		return Fail("unexpected end of input");
+	if (*P == close) {
+		P++;
+		Depth--;
+		First = false;
+		return false;
+	}
+	if (!First) {
+		if (*P != ',')
+			return Fail(close == '}' ? "expected ',' or '}'" : "expected ',' or ']'");
+		P++;
+	}
+	First = false;
+	return true;
+}
+
+bool Reader::NextMember(const char*& key, size_t& keyLen) {
+	if (!Next('}'))
+		return false;
+	SkipWhite();
+	if (P == End || *P != '"')
+		return Fail("expected string key");
+	if (!String(key, keyLen))
+		return false;
+	SkipWhite();
+	if (P == End || *P != ':')
+		return Fail("expected ':'");
+	P++;
+	return true;
+}
+
+bool Reader::NextElement() {
+	return Next(']');
+}
+
+bool Reader::Null() {
+	if (!Failure.OK())
+		return false;
+	SkipWhite();
+	if (End - P >= 4 && memcmp(P, "null", 4) == 0) {
+		P += 4;
+		return true;
+	}
+	return false;
+}
+
+bool Reader::Bool(bool& v) {
+	if (!Failure.OK())
+		return false;
+	SkipWhite();
+	if (End - P >= 4 && memcmp(P, "true", 4) == 0) {
+		P += 4;
+		v = true;
+		return true;
+	} else if (End - P >= 5 && memcmp(P, "false", 5) == 0) {
+		P += 5;
+		v = false;
+		return true;
+	}
+	return Fail("expected bool");
+}
+
+bool Reader::ParseNumber(jsonscan::Number& n) {
+	if (!Failure.OK())
+		return false;
+	SkipWhite();
+	if (P == End || (*P != '-' && (*P < '0' || *P > '9')))
+		return Fail("expected number");
+	const char* err = nullptr;
+	P               = jsonscan::ParseNumber(P, End, n, err);
+	if (err)
+		return Fail(err);
+	return true;
+}
+
+bool Reader::Int64(int64_t& v) {
+	jsonscan::Number n;
+	if (!ParseNumber(n))
+		return false;
+	switch (n.Type) {
+	case jsonscan::Number::Int64: v = n.I; break;
+	case jsonscan::Number::UInt64:
+		if (n.U > (uint64_t) INT64_MAX)
+			return Fail("number out of range");
+		v = (int64_t) n.U;
+		break;
+	case jsonscan::Number::Double:
+		// The comparisons are false for NaN. 2^63 is exact as a double, and INT64_MAX is not.
+		if (!(n.D >= -9223372036854775808.0 && n.D < 9223372036854775808.0))
+			return Fail("number out of range");
+		v = (int64_t) n.D;
+		break;
+	}
+	return true;
+}
+
+bool Reader::UInt64(uint64_t& v) {
+	jsonscan::Number n;
+	if (!ParseNumber(n))
+		return false;
+	switch (n.Type) {
+	case jsonscan::Number::Int64:
+		if (n.I < 0)
+			return Fail("expected unsigned number");
+		v = (uint64_t) n.I;
+		break;
+	case jsonscan::Number::UInt64: v = n.U; break;
+	case jsonscan::Number::Double:
+		if (n.D < 0)
+			return Fail("expected unsigned number");
+		if (!(n.D < 18446744073709551616.0))
+			return Fail("number out of range");
+		v = (uint64_t) n.D;
+		break;
+	}
+	return true;
+}
+
+bool Reader::Double(double& v) {
+	jsonscan::Number n;
+	if (!ParseNumber(n))
+		return false;
+	switch (n.Type) {
+	case jsonscan::Number::Int64: v = (double) n.I; break;
+	case jsonscan::Number::UInt64: v = (double) n.U; break;
+	case jsonscan::Number::Double: v = n.D; break;
+	}
+	return true;
+}
+
+bool Reader::String(const char*& s, size_t& len) {
+	if (!Failure.OK())
+		return false;
+	SkipWhite();
+	if (P == End || *P != '"')
+		return Fail("expected string");
+	P++;
+	const char* start = P;
+	P                 = jsonscan::FindEscape(P, End);
+	if (P == End)
+		return Fail("unterminated string");
+	if (*P == '"') {
+		s   = start;
+		len = P - start;
+		P++;
+		return true;
+	}
+
+	// Slow path, for strings with escape sequences
+	Scratch.assign(start, P - start);
+	while (true) {
+		if (P == End)
+			return Fail("unterminated string");
+		char c = *P;
+		if (c == '"') {
+			P++;
+			break;
+		} else if (c == '\\') {
+			const char* err = nullptr;
+			P               = jsonscan::ParseEscape(P, End, Scratch, err);
+			if (err)
+				return Fail(err);
+		} else if ((uint8_t) c < 0x20) {
+			return Fail("control character in string");
+		} else {
+			const char* run = P;
+			P               = jsonscan::FindEscape(P, End);
+			Scratch.append(run, P - run);
+		}
+	}
+	s   = Scratch.data();
+	len = Scratch.size();
+	return true;
+}
+
+bool Reader::String(std::string& v) {
+	const char* s;
+	size_t      len;
+	if (!String(s, len))
+		return false;
+	v.assign(s, len);
+	return true;
+}
+
+bool Reader::Skip() {
+	switch (Peek()) {
+	case Token::Object: {
+		const char* key;
+		size_t      keyLen;
+		BeginObject();
+		while (NextMember(key, keyLen)) {
+			if (!Skip())
+				return false;
+		}
+		return Failure.OK();
+	}
+	case Token::Array:
+		BeginArray();
+		while (NextElement()) {
+			if (!Skip())
+				return false;
+		}
+		return Failure.OK();
+	case Token::String: {
+		const char* s;
+		size_t      len;
+		return String(s, len);
+	}
+	case Token::Number: {
+		jsonscan::Number n;
+		return ParseNumber(n);
+	}
+	case Token::Bool: {
+		bool b;
+		return Bool(b);
+	}
+	case Token::Null:
+		return Null() || Fail("invalid literal");
+	case Token::End:
+		if (!Failure.OK())
+			return false;
+		return Fail(P == End ? "unexpected end of input" : "unexpected character");
+	}
+	return false;
+}
+
+bool Reader::Raw(const char*& json, size_t& len) {
+	SkipWhite();
+	const char* start = P;
+	if (!Skip())
+		return false;
+	json = start;
+	len  = P - start;
+	return true;
+}
+
+bool Reader::Finish() {
+	if (!Failure.OK())
+		return false;
+	SkipWhite();
+	if (P != End)
+		return Fail("unexpected trailing characters");
+	return true;
+}
+
+} // namespace jsonutil
+} // namespace bmhpal
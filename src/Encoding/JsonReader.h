@@ -0,0 +1,88 @@
+#pragma once
+
+#include "../Error/Error.h"
+
+namespace bmhpal {
+namespace jsonscan {
+struct Number;
+}
+namespace jsonutil {
+
+/* Pull parser
+
+	Reader is the counterpart of Writer. Instead of building a DOM, you ask for the value that you
+	expect next, and it is parsed straight out of the text. This is the foundation of jsonbind.
+
+	Every function returns false if the next value is not of the requested type, or the text is invalid.
+	The first failure is remembered, and can be retrieved with Err(). After a failure, every function
+	returns false.
+
+	Example, which reads {"id": 5, "other": [...]}
+
+		jsonutil::Reader r(json, len);
+		const char* key;
+		size_t      keyLen;
+		int64_t     id;
+		r.BeginObject();
+		while (r.NextMember(key, keyLen)) {
+			if (keyLen == 2 && memcmp(key, "id", 2) == 0)
+				r.Int64(id);
+			else
+				r.Skip();
+		}
+		r.Finish();
+		return r.Err();
+
+	*/
+class BMHPAL_API Reader {
+public:
+	enum class Token {
+		End, // End of input, or an error
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object,
+	};
+
+	Reader(const char* json, size_t len);
+
+	Token Peek(); // Returns the type of the next value, without consuming it
+	bool  OK() const { return Failure.OK(); }
+	Error Err() const { return Failure; }
+
+	bool BeginObject();
+	bool NextMember(const char*& key, size_t& keyLen); // Returns false at the end of the object. key is valid until the next call to the Reader.
+	bool BeginArray();
+	bool NextElement(); // Returns false at the end of the array
+
+	bool Null(); // Consumes a null, if that's what is next. Returns false without failing if it's anything else.
+	bool Bool(bool& v);
+	bool Int64(int64_t& v);   // Doubles are truncated. Numbers that don't fit fail.
+	bool UInt64(uint64_t& v); // Doubles are truncated. Negative numbers, and numbers that don't fit, fail.
+	bool Double(double& v);
+	bool String(std::string& v);
+	bool String(const char*& s, size_t& len); // s is valid until the next call to the Reader
+	bool Skip();                              // Skip over the next value, whatever it is
+	bool Raw(const char*& json, size_t& len); // Skip over the next value, and return its encoded text
+	bool Finish();                            // Fails if there is anything other than whitespace left
+
+	bool Fail(const char* msg); // Set the error (if it's not already set), and return false
+
+private:
+	const char* Src;
+	const char* End;
+	const char* P;
+	bool        First = false; // True if we've just entered an object or array
+	int         Depth = 0;
+	std::string Scratch; // Decoded strings that contained escape sequences
+	Error       Failure;
+
+	void SkipWhite();
+	bool Next(char close);
+	bool ParseNumber(jsonscan::Number& n);
+};
+
+} // namespace jsonutil
+} // namespace bmhpal
@@ -0,0 +1,211 @@
+#include "pch.h"
+#include "JsonScan.h"
+#include "Hex.h"
+#include "../Math_.h"
+
+#ifdef BMHPAL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace bmhpal {
+namespace jsonscan {
+
+// Exact powers of 10 that can be represented by a double
+static const double Pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline bool IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+const char* FindEscape(const char* s, const char* end) {
+#ifdef BMHPAL_SSE2
+	const __m128i quote     = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i control   = _mm_set1_epi8(0x1f);
+	while (end - s >= 16) {
+		__m128i  c    = _mm_loadu_si128((const __m128i*) s);
+		__m128i  hit  = _mm_or_si128(_mm_cmpeq_epi8(c, quote), _mm_cmpeq_epi8(c, backslash));
+		hit           = _mm_or_si128(hit, _mm_cmpeq_epi8(_mm_max_epu8(c, control), control)); // c <= 0x1f
+		unsigned bits = (unsigned) _mm_movemask_epi8(hit);
+		if (bits != 0)
+			return s + CountTrailingZeros(bits);
+		s += 16;
+	}
+#endif
+	while (s != end && *s != '"' && *s != '\\' && (uint8_t) *s >= 0x20)
+		s++;
+	return s;
+}
+
+const char* ParseNumber(const char* p, const char* end, Number& n, const char*& err) {
+	const char* start = p;
+	bool        neg   = false;
+	if (*p == '-') {
+		neg = true;
+		p++;
+	}
+	if (p == end || !IsDigit(*p)) {
+		err = "invalid number";
+		return p;
+	}
+
+	uint64_t mantissa = 0;
+	int      exp10    = 0;
+	bool     overflow = false;
+	bool     isInt    = true;
+
+	auto addDigit = [&](char c) {
+		unsigned d = c - '0';
+		if (mantissa < UINT64_MAX / 10 || (mantissa == UINT64_MAX / 10 && d <= UINT64_MAX % 10)) {
+			mantissa = mantissa * 10 + d;
+		} else {
+			// we can't hold any more digits, so we're going to fall back to strtod
+			overflow = true;
+		}
+	};
+
+	if (*p == '0') {
+		p++;
+		if (p < end && IsDigit(*p)) {
+			err = "leading zeros are not allowed";
+			return p;
+		}
+	} else {
+		for (; p < end && IsDigit(*p); p++)
+			addDigit(*p);
+	}
+	if (p < end && *p == '.') {
+		isInt = false;
+		p++;
+		if (p == end || !IsDigit(*p)) {
+			err = "invalid number";
+			return p;
+		}
+		for (; p < end && IsDigit(*p); p++) {
+			addDigit(*p);
+			exp10--;
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		isInt = false;
+		p++;
+		bool expNeg = false;
+		if (p < end && (*p == '+' || *p == '-')) {
+			expNeg = *p == '-';
+			p++;
+		}
+		if (p == end || !IsDigit(*p)) {
+			err = "invalid number";
+			return p;
+		}
+		int e = 0;
+		for (; p < end && IsDigit(*p); p++) {
+			if (e < 100000)
+				e = e * 10 + (*p - '0');
+		}
+		exp10 += expNeg ? -e : e;
+	}
+
+	if (isInt && !overflow) {
+		if (!neg && mantissa <= (uint64_t) INT64_MAX) {
+			n.Type = Number::Int64;
+			n.I    = (int64_t) mantissa;
+			return p;
+		} else if (!neg) {
+			n.Type = Number::UInt64;
+			n.U    = mantissa;
+			return p;
+		} else if (mantissa <= (uint64_t) INT64_MAX + 1) {
+			n.Type = Number::Int64;
+			n.I    = (int64_t) (0 - mantissa);
+			return p;
+		}
+		// fall through, and represent as a double, which is what nlohmann::json does too
+	}
+
+	n.Type = Number::Double;
+	if (!overflow && mantissa <= ((uint64_t) 1 << 53) && exp10 >= -22 && exp10 <= 22) {
+		// Clinger's fast path. Both operands are exact, so the result is correctly rounded.
+		double d = (double) mantissa;
+		d        = exp10 < 0 ? d / Pow10[-exp10] : d * Pow10[exp10];
+		n.D      = neg ? -d : d;
+	} else {
+		// strtod needs a null terminated string, and our source buffer may end right after the number
+		char   buf[64];
+		size_t len = p - start;
+		if (len < sizeof(buf)) {
+			memcpy(buf, start, len);
+			buf[len] = 0;
+			n.D      = strtod(buf, nullptr);
+		} else {
+			n.D = strtod(std::string(start, len).c_str(), nullptr);
+		}
+	}
+	return p;
+}
+
+static const char* ParseHex4(const char* p, const char* end, unsigned& v, const char*& err) {
+	if (end - p < 4) {
+		err = "invalid unicode escape";
+		return p;
+	}
+	v = 0;
+	for (int i = 0; i < 4; i++) {
+		unsigned n = hex::DecodeChar(p[i]);
+		if (n == (unsigned) -1) {
+			err = "invalid unicode escape";
+			return p;
+		}
+		v = (v << 4) | n;
+	}
+	return p + 4;
+}
+
+const char* ParseEscape(const char* p, const char* end, std::string& out, const char*& err) {
+	if (end - p < 2) {
+		err = "unterminated string";
+		return p;
+	}
+	switch (p[1]) {
+	case '"': out += '"'; return p + 2;
+	case '\\': out += '\\'; return p + 2;
+	case '/': out += '/'; return p + 2;
+	case 'b': out += '\b'; return p + 2;
+	case 'f': out += '\f'; return p + 2;
+	case 'n': out += '\n'; return p + 2;
+	case 'r': out += '\r'; return p + 2;
+	case 't': out += '\t'; return p + 2;
+	case 'u': {
+		unsigned cp = 0;
+		p           = ParseHex4(p + 2, end, cp, err);
+		if (err)
+			return p;
+		if (cp >= 0xD800 && cp <= 0xDBFF) {
+			unsigned low = 0;
+			if (end - p < 2 || p[0] != '\\' || p[1] != 'u') {
+				err = "missing low surrogate";
+				return p;
+			}
+			p = ParseHex4(p + 2, end, low, err);
+			if (err)
+				return p;
+			if (low < 0xDC00 || low > 0xDFFF) {
+				err = "invalid low surrogate";
+				return p;
+			}
+			cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+		} else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+			err = "unexpected low surrogate";
+			return p;
+		}
+		utfz::encode(out, (int) cp);
+		return p;
+	}
+	default:
+		err = "invalid escape sequence";
+		return p;
+	}
+}
+
+} // namespace jsonscan
+} // namespace bmhpal
@@ -0,0 +1,34 @@
+#pragma once
+
+namespace bmhpal {
+namespace jsonscan {
+
+// Low level scanning routines shared by the json parsers and writers in this directory.
+// The parse functions return the position after the item, or the position of the
+// failure, in which case 'err' is set to a static error message.
+
+struct Number {
+	enum Types {
+		Int64,
+		UInt64, // Only used for positive values that don't fit into an int64
+		Double,
+	};
+	Types Type;
+	union {
+		int64_t  I;
+		uint64_t U;
+		double   D;
+	};
+};
+
+// Returns a pointer to the first quote, backslash, or control character in [s, end), or end if there is none
+const char* FindEscape(const char* s, const char* end);
+
+// p points at the first character of the number ('-' or a digit)
+const char* ParseNumber(const char* p, const char* end, Number& n, const char*& err);
+
+// p points at the backslash of an escape sequence. The decoded character is appended to out.
+const char* ParseEscape(const char* p, const char* end, std::string& out, const char*& err);
+
+} // namespace jsonscan
+} // namespace bmhpal
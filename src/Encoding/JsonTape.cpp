@@ -0,0 +1,477 @@
+#include "pch.h"
+#include "JsonTape.h"
+#include "JsonScan.h"
+
+using namespace std;
+
+namespace bmhpal {
+namespace jsontape {
+
+static const int MaxDepth = 1000;
+
+static inline uint64_t MakeWord(uint8_t tag, uint64_t payload) {
+	return ((uint64_t) tag << 56) | payload;
+}
+
+static inline bool IsWhite(char c) {
+	return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+class Parser {
+public:
+	Doc&        D;
+	const char* Src;
+	const char* End;
+	const char* P;
+	int         Depth = 0;
+	Error       Err;
+
+	Parser(Doc& d, const char* src, size_t len) : D(d), Src(src), End(src + len), P(src) {}
+
+	bool Fail(const char* msg) {
+		if (Err.OK())
+			Err = Error::Fmt("Error decoding json: %v at offset %v", msg, P - Src);
+		return false;
+	}
+
+	void SkipWhite() {
+		while (P < End && IsWhite(*P))
+			P++;
+	}
+
+	void Push(uint8_t tag, uint64_t payload) {
+		D.Tape.push_back(MakeWord(tag, payload));
+	}
+
+	void PushRaw(uint64_t v) {
+		D.Tape.push_back(v);
+	}
+
+	bool ParseDocument() {
+		if (!ParseValue())
+			return false;
+		SkipWhite();
+		if (P != End)
+			return Fail("unexpected trailing characters");
+		return true;
+	}
+
+	bool ParseValue() {
+		SkipWhite();
+		if (P == End)
+			return Fail("unexpected end of input");
+		switch (*P) {
+		case '{': return ParseContainer(Doc::TagObjectStart, Doc::TagObjectEnd, '}');
+		case '[': return ParseContainer(Doc::TagArrayStart, Doc::TagArrayEnd, ']');
+		case '"': return ParseString();
+		case 't': return ParseLiteral("true", 4, Doc::TagTrue);
+		case 'f': return ParseLiteral("false", 5, Doc::TagFalse);
+		case 'n': return ParseLiteral("null", 4, Doc::TagNull);
+		case '-':
+		case '0':
+		case '1':
+		case '2':
+		case '3':
+		case '4':
+		case '5':
+		case '6':
+		case '7':
+		case '8':
+		case '9': return ParseNumber();
+		default: return Fail("unexpected character");
+		}
+	}
+
+	bool ParseContainer(uint8_t startTag, uint8_t endTag, char close) {
+		if (++Depth > MaxDepth)
+			return Fail("nesting too deep");
+		size_t start = D.Tape.size();
+		Push(startTag, 0);
+		P++;
+		SkipWhite();
+		if (P < End && *P == close) {
+			P++;
+		} else {
+			while (true) {
+				if (startTag == Doc::TagObjectStart) {
+					SkipWhite();
+					if (P == End || *P != '"')
+						return Fail("expected string key");
+					if (!ParseString())
+						return false;
+					SkipWhite();
+					if (P == End || *P != ':')
+						return Fail("expected ':'");
+					P++;
+				}
+				if (!ParseValue())
+					return false;
+				SkipWhite();
+				if (P == End)
+					return Fail("unexpected end of input");
+				if (*P == ',') {
+					P++;
+					continue;
+				}
+				if (*P == close) {
+					P++;
+					break;
+				}
+				return Fail(startTag == Doc::TagObjectStart ? "expected ',' or '}'" : "expected ',' or ']'");
+			}
+		}
+		D.Tape[start] = MakeWord(startTag, D.Tape.size());
+		Push(endTag, start);
+		Depth--;
+		return true;
+	}
+
+	bool ParseLiteral(const char* lit, size_t len, uint8_t tag) {
+		if ((size_t) (End - P) < len || memcmp(P, lit, len) != 0)
+			return Fail("invalid literal");
+		P += len;
+		Push(tag, 0);
+		return true;
+	}
+
+	bool ParseString() {
+		P++;
+		const char* start = P;
+		P = jsonscan::FindEscape(P, End);
+		if (P == End)
+			return Fail("unterminated string");
+		if (*P == '"') {
+			Push(Doc::TagString, start - Src);
+			PushRaw(P - start);
+			P++;
+			return true;
+		}
+		if (*P != '\\')
+			return Fail("control character in string");
+
+		// Slow path, for strings with escape sequences
+		size_t bufStart = D.Strings.size();
+		D.Strings.append(start, P - start);
+		while (true) {
+			if (P == End)
+				return Fail("unterminated string");
+			char c = *P;
+			if (c == '"') {
+				P++;
+				break;
+			} else if (c == '\\') {
+				if (!ParseEscape())
+					return false;
+			} else if ((uint8_t) c < 0x20) {
+				return Fail("control character in string");
+			} else {
+				const char* runStart = P;
+				P = jsonscan::FindEscape(P, End);
+				D.Strings.append(runStart, P - runStart);
+			}
+		}
+		Push(Doc::TagStringBuf, bufStart);
+		PushRaw(D.Strings.size() - bufStart);
+		return true;
+	}
+
+	bool ParseEscape() {
+		const char* err = nullptr;
+		P               = jsonscan::ParseEscape(P, End, D.Strings, err);
+		return err ? Fail(err) : true;
+	}
+
+	bool ParseNumber() {
+		const char*      err = nullptr;
+		jsonscan::Number n;
+		P = jsonscan::ParseNumber(P, End, n, err);
+		if (err)
+			return Fail(err);
+		switch (n.Type) {
+		case jsonscan::Number::Int64: Push(Doc::TagInt64, 0); break;
+		case jsonscan::Number::UInt64: Push(Doc::TagUInt64, 0); break;
+		case jsonscan::Number::Double: Push(Doc::TagDouble, 0); break;
+		}
+		// All three members of the union are 8 bytes, so this copies the raw bits of any of them
+		PushRaw(n.U);
+		return true;
+	}
+};
+
+Doc::Doc() {
+}
+
+Doc::~Doc() {
+	Reset();
+}
+
+void Doc::Reset() {
+	File.Close();
+	Src    = nullptr;
+	SrcLen = 0;
+	Tape.clear();
+	Strings.clear();
+}
+
+Error Doc::Parse(const char* json, size_t len) {
+	if (json != File.Data()) {
+		// We're parsing an external buffer, so drop any file that we were holding on to
+		Reset();
+	} else {
+		Tape.clear();
+		Strings.clear();
+	}
+	Src    = json;
+	SrcLen = len;
+	// A rough guess, which avoids most of the reallocations for typical documents
+	Tape.reserve(len / 8 + 2);
+	Parser p(*this, json, len);
+	if (!p.ParseDocument()) {
+		Tape.clear();
+		return p.Err;
+	}
+	return Error();
+}
+
+Error Doc::LoadFile(const std::string& filename) {
+	Reset();
+	auto err = File.Open(filename);
+	if (!err.OK())
+		return err;
+	File.Advise(os::MapAdvice::Sequential);
+	return Parse(File.Data(), File.Size());
+}
+
+Value Doc::Root() const {
+	if (Tape.size() == 0)
+		return Value();
+	return Value(this, 0);
+}
+
+size_t Doc::Skip(size_t i) const {
+	switch (Tag(i)) {
+	case TagObjectStart:
+	case TagArrayStart:
+		return (size_t) Payload(i) + 1;
+	case TagString:
+	case TagStringBuf:
+	case TagInt64:
+	case TagUInt64:
+	case TagDouble:
+		return i + 2;
+	default:
+		return i + 1;
+	}
+}
+
+Type Value::GetType() const {
+	if (!D)
+		return Type::Missing;
+	switch (D->Tag(I)) {
+	case Doc::TagObjectStart: return Type::Object;
+	case Doc::TagArrayStart: return Type::Array;
+	case Doc::TagString:
+	case Doc::TagStringBuf: return Type::String;
+	case Doc::TagInt64: return Type::Int64;
+	case Doc::TagUInt64: return Type::UInt64;
+	case Doc::TagDouble: return Type::Double;
+	case Doc::TagTrue:
+	case Doc::TagFalse: return Type::Bool;
+	case Doc::TagNull: return Type::Null;
+	}
+	return Type::Missing;
+}
+
+bool Value::IsNumber() const {
+	auto t = GetType();
+	return t == Type::Int64 || t == Type::UInt64 || t == Type::Double;
+}
+
+bool Value::IsInteger() const {
+	auto t = GetType();
+	return t == Type::Int64 || t == Type::UInt64;
+}
+
+bool Value::Bool() const {
+	return D && D->Tag(I) == Doc::TagTrue;
+}
+
+int64_t Value::Int64() const {
+	switch (GetType()) {
+	case Type::Int64:
+	case Type::UInt64: return (int64_t) D->Tape[I + 1];
+	case Type::Double: {
+		// Casting a double that is out of range is undefined, so clamp first. 2^63 is exact as a double, and INT64_MAX is not.
+		double d = Double();
+		if (d != d)
+			return 0;
+		if (d < -9223372036854775808.0)
+			return INT64_MIN;
+		if (d >= 9223372036854775808.0)
+			return INT64_MAX;
+		return (int64_t) d;
+	}
+	default: return 0;
+	}
+}
+
+uint64_t Value::UInt64() const {
+	switch (GetType()) {
+	case Type::Int64:
+	case Type::UInt64: return D->Tape[I + 1];
+	case Type::Double: {
+		double d = Double();
+		if (!(d > -1.0)) // Negative, or NaN
+			return 0;
+		if (!(d < 18446744073709551616.0))
+			return UINT64_MAX;
+		return (uint64_t) d;
+	}
+	default: return 0;
+	}
+}
+
+double Value::Double() const {
+	switch (GetType()) {
+	case Type::Int64: return (double) (int64_t) D->Tape[I + 1];
+	case Type::UInt64: return (double) D->Tape[I + 1];
+	case Type::Double: {
+		double d;
+		memcpy(&d, &D->Tape[I + 1], 8);
+		return d;
+	}
+	default: return 0;
+	}
+}
+
+const char* Value::StrPtr() const {
+	if (!D)
+		return nullptr;
+	switch (D->Tag(I)) {
+	case Doc::TagString: return D->Source() + D->Payload(I);
+	case Doc::TagStringBuf: return D->Strings.data() + D->Payload(I);
+	default: return nullptr;
+	}
+}
+
+size_t Value::StrLen() const {
+	return IsString() ? (size_t) D->Tape[I + 1] : 0;
+}
+
+std::string Value::Str() const {
+	if (!IsString())
+		return "";
+	return std::string(StrPtr(), StrLen());
+}
+
+bool Value::StrEquals(const char* s, size_t len) const {
+	return IsString() && StrLen() == len && memcmp(StrPtr(), s, len) == 0;
+}
+
+size_t Value::Size() const {
+	size_t n = 0;
+	if (IsArray())
+		ForEachElement([&](const Value& v) { n++; });
+	else if (IsObject())
+		ForEachMember([&](const Value& k, const Value& v) { n++; });
+	return n;
+}
+
+Value Value::Find(const char* key) const {
+	return Find(key, strlen(key));
+}
+
+Value Value::Find(const char* key, size_t keyLen) const {
+	if (!IsObject())
+		return Value();
+	size_t end = (size_t) D->Payload(I);
+	for (size_t i = I + 1; i < end; i = D->Skip(i + 2)) {
+		if (Value(D, i).StrEquals(key, keyLen))
+			return Value(D, i + 2);
+	}
+	return Value();
+}
+
+Value Value::At(size_t idx) const {
+	if (!IsArray())
+		return Value();
+	size_t end = (size_t) D->Payload(I);
+	size_t n   = 0;
+	for (size_t i = I + 1; i < end; i = D->Skip(i), n++) {
+		if (n == idx)
+			return Value(D, i);
+	}
+	return Value();
+}
+
+void Value::ToJson(nlohmann::json& j) const {
+	switch (GetType()) {
+	case Type::Missing:
+	case Type::Null: j = nullptr; break;
+	case Type::Bool: j = Bool(); break;
+	case Type::Int64: j = Int64(); break;
+	case Type::UInt64: j = UInt64(); break;
+	case Type::Double: j = Double(); break;
+	case Type::String: j = Str(); break;
+	case Type::Array:
+		j = nlohmann::json::array();
+		ForEachElement([&](const Value& v) {
+			j.push_back(nullptr);
+			v.ToJson(j.back());
+		});
+		break;
+	case Type::Object:
+		j = nlohmann::json::object();
+		ForEachMember([&](const Value& k, const Value& v) {
+			v.ToJson(j[k.Str()]);
+		});
+		break;
+	}
+}
+
+} // namespace jsontape
+
+namespace jsonser {
+
+BMHPAL_API std::string GetStr(const jsontape::Value& j, const char* key, const std::string& _default) {
+	auto v = j.Find(key);
+	if (v.IsString())
+		return v.Str();
+	else
+		return _default;
+}
+
+BMHPAL_API int64_t GetInt64(const jsontape::Value& j, const char* key, const int64_t _default) {
+	auto v = j.Find(key);
+	if (v.IsNumber())
+		return v.Int64();
+	else
+		return _default;
+}
+
+BMHPAL_API int32_t GetInt32(const jsontape::Value& j, const char* key, const int32_t _default) {
+	auto v = j.Find(key);
+	if (v.IsNumber())
+		return (int32_t) v.Int64();
+	else
+		return _default;
+}
+
+BMHPAL_API bool GetBool(const jsontape::Value& j, const char* key, const bool _default) {
+	auto v = j.Find(key);
+	if (v.IsBool())
+		return v.Bool();
+	else
+		return _default;
+}
+
+BMHPAL_API time::Time GetUnixTime(const jsontape::Value& j, const char* key, const time::Time _default) {
+	auto v = j.Find(key);
+	if (v.IsNumber())
+		return time::Time::FromUnix(v.Double());
+	else
+		return _default;
+}
+
+} // namespace jsonser
+} // namespace bmhpal
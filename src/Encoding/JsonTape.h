@@ -0,0 +1,179 @@
+#pragma once
+
+#include "../Error/Error.h"
+#include "../Time/Time_.h"
+#include "../OS/MappedFile.h"
+
+namespace bmhpal {
+namespace jsontape {
+
+/*
+
+	Tape JSON parser
+	================
+
+	This is an alternative to jsonutil::Decode for large documents. Instead of building an nlohmann::json
+	DOM, with a heap allocation per node, we parse into a flat array of 64-bit words (the "tape"), in a
+	single pass. Every tape word has an 8-bit tag in the high byte and a 56-bit payload.
+
+		{ }   payload is the tape index of the matching brace, so a whole object can be skipped in O(1)
+		[ ]   same as for objects
+		"     payload is the offset of the string inside the source buffer. Next word is the length.
+		S     payload is the offset of the string inside Doc::Strings. Next word is the length.
+		      This is used for strings with escape sequences, which must be decoded.
+		l u d int64, uint64 and double. Next word holds the raw bits of the number.
+		t f n true, false, null
+
+	Strings without escapes are not copied. They point into the source buffer, so the source must outlive
+	the Doc. Doc::LoadFile memory maps the file with os::MappedFile, so a document is never copied into a std::string.
+
+	Use Value to read the document. A Value is just a Doc pointer and a tape index, so it's cheap to copy.
+	Object lookups are a linear scan over the keys of that object, skipping over nested values.
+
+	*/
+
+enum class Type {
+	Missing, // The value doesn't exist. This is returned when Find() or At() fails.
+	Null,
+	Bool,
+	Int64,
+	UInt64,
+	Double,
+	String,
+	Array,
+	Object,
+};
+
+class Doc;
+
+class BMHPAL_API Value {
+public:
+	Value() {}
+	Value(const Doc* doc, size_t index) : D(doc), I(index) {}
+
+	Type GetType() const;
+	bool IsMissing() const { return D == nullptr; }
+	bool IsNull() const { return GetType() == Type::Null; }
+	bool IsBool() const { return GetType() == Type::Bool; }
+	bool IsString() const { return GetType() == Type::String; }
+	bool IsArray() const { return GetType() == Type::Array; }
+	bool IsObject() const { return GetType() == Type::Object; }
+	bool IsNumber() const;
+	bool IsInteger() const; // True for Int64 and UInt64
+
+	bool        Bool() const;   // Returns false if not a bool
+	int64_t     Int64() const;  // Doubles are truncated, and clamped to the range of the result. Returns 0 if not a number, or NaN.
+	uint64_t    UInt64() const; // Doubles are truncated, and clamped to the range of the result. Returns 0 if not a number, or NaN.
+	double      Double() const; // Returns 0 if not a number
+	const char* StrPtr() const; // Not null terminated. Returns null if not a string
+	size_t      StrLen() const; // Returns 0 if not a string
+	std::string Str() const;    // Returns an empty string if not a string
+	bool        StrEquals(const char* s, size_t len) const;
+
+	size_t Size() const;                  // Number of elements in an array, or members in an object. Linear time.
+	Value  Find(const char* key) const;   // Returns a Missing value if this is not an object, or the key is not found
+	Value  Find(const char* key, size_t keyLen) const;
+	Value  At(size_t i) const;            // Returns a Missing value if this is not an array, or i is out of range. Linear time.
+	void   ToJson(nlohmann::json& j) const; // Materialize this value, and everything inside it, as an nlohmann DOM
+
+	// Calls f(const Value& val) for every element of an array
+	template <typename F>
+	void ForEachElement(F f) const;
+
+	// Calls f(const Value& key, const Value& val) for every member of an object
+	template <typename F>
+	void ForEachMember(F f) const;
+
+private:
+	const Doc* D = nullptr;
+	size_t     I = 0;
+};
+
+// A parsed document
+class BMHPAL_API Doc {
+public:
+	enum Tags : uint8_t {
+		TagObjectStart = '{',
+		TagObjectEnd   = '}',
+		TagArrayStart  = '[',
+		TagArrayEnd    = ']',
+		TagString      = '"',
+		TagStringBuf   = 'S',
+		TagInt64       = 'l',
+		TagUInt64      = 'u',
+		TagDouble      = 'd',
+		TagTrue        = 't',
+		TagFalse       = 'f',
+		TagNull        = 'n',
+	};
+	static const uint64_t PayloadMask = ((uint64_t) 1 << 56) - 1;
+
+	std::vector<uint64_t> Tape;
+	std::string           Strings; // Decoded strings that contained escape sequences
+
+	Doc();
+	~Doc();
+	Doc(const Doc&) = delete;
+	Doc& operator=(const Doc&) = delete;
+
+	// Parse json. The json buffer must remain alive and unchanged for the lifetime of this Doc.
+	Error Parse(const char* json, size_t len);
+	// Memory map the file and parse it. The mapping is held until the Doc is destroyed, or parses something else.
+	Error LoadFile(const std::string& filename);
+
+	Value Root() const;
+
+	uint8_t Tag(size_t i) const {
+		return (uint8_t) (Tape[i] >> 56);
+	}
+	uint64_t Payload(size_t i) const {
+		return Tape[i] & PayloadMask;
+	}
+	const char* Source() const {
+		return Src;
+	}
+	size_t Skip(size_t i) const; // Returns the tape index after the value at i
+
+private:
+	const char*    Src    = nullptr;
+	size_t         SrcLen = 0;
+	os::MappedFile File; // Used by LoadFile
+
+	void Reset();
+};
+
+template <typename F>
+void Value::ForEachElement(F f) const {
+	if (!IsArray())
+		return;
+	size_t end = (size_t) D->Payload(I);
+	for (size_t i = I + 1; i < end; i = D->Skip(i))
+		f(Value(D, i));
+}
+
+template <typename F>
+void Value::ForEachMember(F f) const {
+	if (!IsObject())
+		return;
+	size_t end = (size_t) D->Payload(I);
+	for (size_t i = I + 1; i < end; i = D->Skip(i + 2))
+		f(Value(D, i), Value(D, i + 2));
+}
+
+} // namespace jsontape
+
+// These are analogues of the nlohmann::json accessors in Json.h, so that code can move between
+// the two representations without changing its field access.
+namespace jsonser {
+BMHPAL_API std::string GetStr(const jsontape::Value& j, const char* key, const std::string& _default = "");
+BMHPAL_API int64_t     GetInt64(const jsontape::Value& j, const char* key, const int64_t _default = 0);
+BMHPAL_API int32_t     GetInt32(const jsontape::Value& j, const char* key, const int32_t _default = 0);
+BMHPAL_API bool        GetBool(const jsontape::Value& j, const char* key, const bool _default = false);
+BMHPAL_API time::Time GetUnixTime(const jsontape::Value& j, const char* key, const time::Time _default = time::Time());
+
+inline bool Has(const jsontape::Value& j, const char* key) {
+	return !j.Find(key).IsMissing();
+}
+} // namespace jsonser
+
+} // namespace bmhpal
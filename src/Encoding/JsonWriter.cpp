@@ -0,0 +1,226 @@
+#include "pch.h"
+#include "JsonWriter.h"
+#include "JsonScan.h"
+#include "../Text/Numeric.h"
+#include "../OS/OS.h"
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace jsonutil {
+
+static const char HexLower[] = "0123456789abcdef";
+
+Writer::Writer(std::string& out, Format format) : Out(&out), Fmt(format) {
+}
+
+Writer::Writer(int fd, Format format, size_t bufferSize) : Out(&Buf), Fd(fd), BufferSize(bufferSize), Fmt(format) {
+	// Leave some slack, so that we don't need to grow the buffer just before flushing
+	Buf.reserve(bufferSize + bufferSize / 8);
+}
+
+Writer::~Writer() {
+}
+
+size_t Writer::FormatUInt(uint64_t v, char* buf) {
+	return numeric::FormatUInt(v, buf);
+}
+
+size_t Writer::FormatInt(int64_t v, char* buf) {
+	return numeric::FormatInt(v, buf);
+}
+
+void Writer::Indent() {
+	Out->push_back('\n');
+	Out->append(Count.size(), '\t');
+}
+
+// Emit the separator that must precede the next value or key
+void Writer::Prefix() {
+	if (AfterKey) {
+		AfterKey = false;
+		return;
+	}
+	if (Count.size() == 0)
+		return;
+	if (Count.back()++ != 0)
+		Out->push_back(',');
+	if (Fmt == Format::Pretty)
+		Indent();
+}
+
+void Writer::End(char close) {
+	uint32_t n = Count.back();
+	Count.pop_back();
+	if (Fmt == Format::Pretty && n != 0)
+		Indent();
+	Out->push_back(close);
+	MaybeFlush();
+}
+
+void Writer::BeginObject() {
+	Prefix();
+	Out->push_back('{');
+	Count.push_back(0);
+}
+
+void Writer::EndObject() {
+	End('}');
+}
+
+void Writer::BeginArray() {
+	Prefix();
+	Out->push_back('[');
+	Count.push_back(0);
+}
+
+void Writer::EndArray() {
+	End(']');
+}
+
+void Writer::Key(const char* key, size_t len) {
+	Prefix();
+	EscapeString(key, len);
+	if (Fmt == Format::Pretty)
+		Out->append(": ", 2);
+	else
+		Out->push_back(':');
+	AfterKey = true;
+}
+
+void Writer::String(const char* s, size_t len) {
+	Prefix();
+	EscapeString(s, len);
+	MaybeFlush();
+}
+
+void Writer::EscapeString(const char* s, size_t len) {
+	Out->push_back('"');
+	const char* end = s + len;
+	while (s != end) {
+		// Find the next character that needs escaping, and copy everything before it in one go
+		const char* run = s;
+		s               = jsonscan::FindEscape(s, end);
+		Out->append(run, s - run);
+		if (s == end)
+			break;
+		char c = *s++;
+		switch (c) {
+		case '"': Out->append("\\\"", 2); break;
+		case '\\': Out->append("\\\\", 2); break;
+		case '\b': Out->append("\\b", 2); break;
+		case '\f': Out->append("\\f", 2); break;
+		case '\n': Out->append("\\n", 2); break;
+		case '\r': Out->append("\\r", 2); break;
+		case '\t': Out->append("\\t", 2); break;
+		default: {
+			char u[6] = {'\\', 'u', '0', '0', HexLower[(uint8_t) c >> 4], HexLower[c & 15]};
+			Out->append(u, 6);
+		}
+		}
+	}
+	Out->push_back('"');
+}
+
+void Writer::Int(int64_t v) {
+	Prefix();
+	char buf[20];
+	Out->append(buf, FormatInt(v, buf));
+	MaybeFlush();
+}
+
+void Writer::UInt(uint64_t v) {
+	Prefix();
+	char buf[20];
+	Out->append(buf, FormatUInt(v, buf));
+	MaybeFlush();
+}
+
+void Writer::Double(double v) {
+	Prefix();
+	if (!std::isfinite(v)) {
+		Out->append("null", 4);
+	} else {
+		char buf[numeric::MaxDoubleLen];
+		Out->append(buf, numeric::FormatDouble(v, buf));
+	}
+	MaybeFlush();
+}
+
+void Writer::Bool(bool v) {
+	Prefix();
+	if (v)
+		Out->append("true", 4);
+	else
+		Out->append("false", 5);
+	MaybeFlush();
+}
+
+void Writer::Null() {
+	Prefix();
+	Out->append("null", 4);
+	MaybeFlush();
+}
+
+void Writer::Raw(const char* json, size_t len) {
+	Prefix();
+	Out->append(json, len);
+	MaybeFlush();
+}
+
+void Writer::Write(const nlohmann::json& j) {
+	switch (j.type()) {
+	case nlohmann::json::value_t::object:
+		BeginObject();
+		for (auto it = j.begin(); it != j.end(); ++it) {
+			Key(it.key());
+			Write(it.value());
+		}
+		EndObject();
+		break;
+	case nlohmann::json::value_t::array:
+		BeginArray();
+		for (const auto& v : j)
+			Write(v);
+		EndArray();
+		break;
+	case nlohmann::json::value_t::string: String(j.get_ref<const nlohmann::json::string_t&>()); break;
+	case nlohmann::json::value_t::boolean: Bool(j.get<bool>()); break;
+	case nlohmann::json::value_t::number_integer: Int(j.get<int64_t>()); break;
+	case nlohmann::json::value_t::number_unsigned: UInt(j.get<uint64_t>()); break;
+	case nlohmann::json::value_t::number_float: Double(j.get<double>()); break;
+	case nlohmann::json::value_t::discarded: Raw("<discarded>", 11); break;
+	case nlohmann::json::value_t::null: Null(); break;
+	}
+}
+
+Error Writer::Flush() {
+	if (Fd == -1)
+		return Error();
+	if (Err.OK() && Buf.size() != 0)
+		Err = os::WriteAll(Fd, Buf.data(), Buf.size());
+	Buf.clear();
+	return Err;
+}
+
+BMHPAL_API Error WriteFile(const std::string& filename, Format format, std::function<void(Writer& w)> write) {
+	int  fd;
+	auto err = os::OpenForWrite(filename, fd);
+	if (!err.OK())
+		return err;
+	Writer w(fd, format);
+	write(w);
+	err = w.Flush();
+	if (close(fd) == -1 && err.OK())
+		err = os::ErrorFrom_errno(errno);
+	return err;
+}
+
+} // namespace jsonutil
+} // namespace bmhpal
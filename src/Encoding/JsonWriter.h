@@ -0,0 +1,88 @@
+#pragma once
+
+#include <functional>
+#include "../Error/Error.h"
+
+namespace bmhpal {
+namespace jsonutil {
+
+enum class Format {
+	Compact, // No whitespace. Same output as j.dump()
+	Pretty,  // One tab per level. Same output as j.dump(1, '\t')
+};
+
+/* Streaming JSON writer
+
+	Writer emits JSON text directly into a std::string, or into a buffer that is flushed to a file
+	descriptor whenever it fills up. You can drive it with individual tokens (BeginObject, Key, Int, ...),
+	or hand it an entire nlohmann::json with Write(). The output is byte for byte identical to
+	nlohmann::json::dump, except that strings are not validated as UTF-8.
+
+	Errors from the file descriptor are remembered, and returned by Flush(). Once an error has occurred,
+	all further output is discarded.
+
+	Example:
+
+		std::string s;
+		jsonutil::Writer w(s);
+		w.BeginObject();
+		w.Key("id");
+		w.Int(123);
+		w.EndObject();
+
+	*/
+class BMHPAL_API Writer {
+public:
+	Writer(std::string& out, Format format = Format::Compact);                       // Appends to out
+	Writer(int fd, Format format = Format::Compact, size_t bufferSize = 256 * 1024); // Does not take ownership of fd
+	~Writer();
+
+	void BeginObject();
+	void EndObject();
+	void BeginArray();
+	void EndArray();
+	void Key(const char* key, size_t len);
+	void Key(const char* key) { Key(key, strlen(key)); }
+	void Key(const std::string& key) { Key(key.data(), key.size()); }
+	void String(const char* s, size_t len);
+	void String(const char* s) { String(s, strlen(s)); }
+	void String(const std::string& s) { String(s.data(), s.size()); }
+	void Int(int64_t v);
+	void UInt(uint64_t v);
+	void Double(double v); // NaN and infinity are written as null, as nlohmann does
+	void Bool(bool v);
+	void Null();
+	void Raw(const char* json, size_t len); // Emit an already encoded value
+	void Write(const nlohmann::json& j);
+
+	Error Flush(); // Write any buffered output to the file descriptor
+
+	// Format v into buf, which must have space for at least 20 characters. Returns the number of characters written.
+	static size_t FormatUInt(uint64_t v, char* buf);
+	static size_t FormatInt(int64_t v, char* buf);
+
+private:
+	std::string*          Out;
+	std::string           Buf; // Used when writing to an fd
+	int                   Fd         = -1;
+	size_t                BufferSize = 0;
+	Format                Fmt;
+	std::vector<uint32_t> Count;            // Number of values written at each nesting level
+	bool                  AfterKey = false; // A key has been written, and we're waiting for its value
+	Error                 Err;
+
+	void Prefix();
+	void Indent();
+	void End(char close);
+	void EscapeString(const char* s, size_t len);
+	void MaybeFlush() {
+		if (Fd != -1 && Out->size() >= BufferSize)
+			Flush();
+	}
+};
+
+// Create the file, and stream its content through a Writer
+BMHPAL_API Error WriteFile(const std::string& filename, Format format, std::function<void(Writer& w)> write);
+
+} // namespace jsonutil
+} // namespace bmhpal
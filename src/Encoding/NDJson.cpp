@@ -0,0 +1,292 @@
+#include "pch.h"
+#include "NDJson.h"
+#include "Json.h"
+#include "../OS/OS.h"
+#include "../Text/ConvertUTF.h"
+#include "../Math_.h"
+
+#ifdef BMHPAL_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace ndjson {
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+static int  sys_read(int fd, void* buf, size_t len) { return _read(fd, buf, (unsigned) len); }
+static int  sys_open(const char* filename) { return _wopen(WideString(filename, strlen(filename)).c_str(), _O_RDONLY | _O_BINARY); }
+static void sys_close(int fd) { _close(fd); }
+#else
+static ssize_t sys_read(int fd, void* buf, size_t len) { return read(fd, buf, len); }
+static int     sys_open(const char* filename) { return open(filename, O_RDONLY); }
+static void    sys_close(int fd) { close(fd); }
+#endif
+
+BMHPAL_API void FindLineEnds(const char* buf, size_t len, std::vector<size_t>& lineEnds) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	// Produce a 64-bit mask of newlines at a time, and then walk the set bits. This is much faster than
+	// repeated calls to memchr, when lines are short.
+	const __m128i nl = _mm_set1_epi8('\n');
+	for (; i + 64 <= len; i += 64) {
+		uint64_t m0   = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (buf + i)), nl));
+		uint64_t m1   = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (buf + i + 16)), nl));
+		uint64_t m2   = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (buf + i + 32)), nl));
+		uint64_t m3   = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (buf + i + 48)), nl));
+		uint64_t bits = m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+		while (bits != 0) {
+			lineEnds.push_back(i + CountTrailingZeros64(bits));
+			bits &= bits - 1;
+		}
+	}
+#endif
+	for (; i < len; i++) {
+		if (buf[i] == '\n')
+			lineEnds.push_back(i);
+	}
+}
+
+static bool IsBlank(const char* s, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		if (s[i] != ' ' && s[i] != '\t' && s[i] != '\r')
+			return false;
+	}
+	return true;
+}
+
+Reader::Reader(RecordCallback onRecord, int nThreads) : OnRecord(onRecord), NThreads(nThreads) {
+	if (NThreads <= 0)
+		NThreads = std::max((int) std::thread::hardware_concurrency(), 1);
+	Queue.Initialize(true);
+}
+
+Reader::~Reader() {
+	Stop();
+}
+
+void Reader::Stop() {
+	for (size_t i = 0; i < Workers.size(); i++)
+		Queue.Push(nullptr);
+	for (auto& t : Workers)
+		t.join();
+	Workers.clear();
+	for (auto b : InFlight) {
+		b->Done.wait();
+		delete b;
+	}
+	InFlight.clear();
+}
+
+// If deliver is not null, then records are handed straight to it, instead of being stored in the batch
+void Reader::ParseBatch(Batch* b, const RecordCallback* deliver) {
+	vector<size_t> ends;
+	FindLineEnds(b->Data.data(), b->Data.size(), ends);
+	// The final line of the stream needn't be terminated
+	if (ends.size() == 0 || ends.back() != b->Data.size() - 1)
+		ends.push_back(b->Data.size());
+
+	if (!deliver)
+		b->Records.reserve(ends.size());
+	nlohmann::json rec;
+	const char*    s     = b->Data.data();
+	size_t         start = 0;
+	for (size_t i = 0; i < ends.size(); i++) {
+		size_t len = ends[i] - start;
+		if (!IsBlank(s + start, len)) {
+			auto err = jsonutil::Decode(s + start, len, rec);
+			if (!err.OK()) {
+				b->Err = Error::Fmt("%v (line %v)", err.Message(), b->FirstLine + i);
+				break;
+			}
+			if (deliver) {
+				b->Err = (*deliver)(rec);
+				if (!b->Err.OK())
+					break;
+			} else {
+				b->Records.push_back(std::move(rec));
+			}
+		}
+		start = ends[i] + 1;
+	}
+	// Release the memory now, instead of waiting for delivery
+	b->Data = string();
+}
+
+void Reader::WorkerThread(Reader* self) {
+	while (true) {
+		self->Queue.Semaphore.wait();
+		Batch* b = nullptr;
+		self->Queue.PopTail(b);
+		if (b == nullptr)
+			return;
+		ParseBatch(b, nullptr);
+		b->Done.signal();
+	}
+}
+
+// Hand off the first len bytes of Pending
+void Reader::Dispatch(size_t len) {
+	auto b       = new Batch();
+	b->FirstLine = NextLine;
+	if (len == Pending.size()) {
+		b->Data.swap(Pending);
+	} else {
+		b->Data.assign(Pending.data(), len);
+		Pending.erase(0, len);
+	}
+	NextLine += std::count(b->Data.begin(), b->Data.end(), '\n');
+	LineEnd = 0; // Whatever is left in Pending is part of a line
+
+	if (NThreads == 1) {
+		// Records have already been delivered, so a failure must stop us before the next batch
+		ParseBatch(b, &OnRecord);
+		Err = b->Err;
+		delete b;
+		return;
+	}
+
+	if (Workers.size() == 0) {
+		for (int i = 0; i < NThreads; i++)
+			Workers.push_back(std::thread(WorkerThread, this));
+	}
+	Queue.Push(b);
+	InFlight.push_back(b);
+
+	// Bound our memory usage, by not letting the workers get too far ahead of the consumer
+	while (InFlight.size() > (size_t) NThreads * 2 && Err.OK())
+		DeliverOldest();
+}
+
+void Reader::DeliverOldest() {
+	auto b = InFlight.front();
+	InFlight.pop_front();
+	b->Done.wait();
+	for (auto& r : b->Records) {
+		if (!Err.OK())
+			break;
+		Err = OnRecord(r);
+	}
+	if (Err.OK())
+		Err = b->Err;
+	delete b;
+}
+
+static const char* FindLastNewline(const char* s, size_t len) {
+#ifdef BMHPAL_PLATFORM_LINUX
+	return (const char*) memrchr(s, '\n', len);
+#else
+	for (size_t i = len; i != 0; i--) {
+		if (s[i - 1] == '\n')
+			return s + i - 1;
+	}
+	return nullptr;
+#endif
+}
+
+Error Reader::Write(const void* buf, size_t len) {
+	if (!Err.OK())
+		return Err;
+	Pending.append((const char*) buf, len);
+	// Only the new bytes need to be searched, so a line that is longer than BatchBytes is not rescanned on every Write
+	const char* nl = FindLastNewline((const char*) buf, len);
+	if (nl)
+		LineEnd = Pending.size() - len + (nl - (const char*) buf) + 1;
+	if (Pending.size() >= BatchBytes && LineEnd != 0)
+		Dispatch(LineEnd);
+	return Err;
+}
+
+Error Reader::Finish() {
+	if (Err.OK() && Pending.size() != 0)
+		Dispatch(Pending.size());
+	while (InFlight.size() != 0 && Err.OK())
+		DeliverOldest();
+	Stop();
+	return Err;
+}
+
+Error Reader::ReadFd(int fd) {
+	const size_t chunk = 256 * 1024;
+	vector<char> buf;
+	buf.resize(chunk);
+	while (true) {
+		auto n = sys_read(fd, &buf[0], chunk);
+		if (n == 0)
+			break;
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			auto err = os::ErrorFrom_errno(errno);
+			Stop();
+			return err;
+		}
+		auto err = Write(&buf[0], n);
+		if (!err.OK()) {
+			Stop();
+			return err;
+		}
+	}
+	return Finish();
+}
+
+Error Reader::ReadFile(const std::string& filename) {
+	int fd = sys_open(filename.c_str());
+	if (fd == -1)
+		return os::ErrorFrom_errno(errno);
+	auto err = ReadFd(fd);
+	sys_close(fd);
+	return err;
+}
+
+Writer::Writer(SinkCallback sink) : Sink(sink), J(Buf) {
+}
+
+Writer::Writer(int fd) : J(Buf) {
+	Sink = [fd](const char* buf, size_t len) -> Error {
+		return os::WriteAll(fd, buf, len);
+	};
+}
+
+Writer::~Writer() {
+}
+
+Error Writer::Write(const nlohmann::json& record) {
+	// Serialize straight onto the end of our buffer, instead of into a temporary string from dump()
+	J.Write(record);
+	Buf += '\n';
+	return MaybeFlush();
+}
+
+Error Writer::WriteRaw(const char* json, size_t len) {
+	Buf.append(json, len);
+	Buf += '\n';
+	return MaybeFlush();
+}
+
+Error Writer::MaybeFlush() {
+	if (Buf.size() < FlushBytes)
+		return Error();
+	return Flush();
+}
+
+Error Writer::Flush() {
+	if (Buf.size() == 0)
+		return Error();
+	auto err = Sink(Buf.data(), Buf.size());
+	// clear() retains capacity, so the buffer is reused for the next batch
+	Buf.clear();
+	return err;
+}
+
+} // namespace ndjson
+} // namespace bmhpal
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <thread>
+#include "../Error/Error.h"
+#include "../Containers/ObjQueue.h"
+#include "JsonWriter.h"
+
+namespace bmhpal {
+namespace ndjson {
+
+/*
+
+	Newline delimited JSON (JSON Lines)
+	===================================
+
+	Reader consumes a stream of bytes, which can arrive in chunks of any size (eg from a file descriptor,
+	or from http::Request::OnBody). Complete lines are gathered into batches of roughly BatchBytes, and
+	each batch is parsed by a pool of worker threads. Records are always delivered to your callback in
+	their original order, on the thread that called Write/Finish. Blank lines are ignored.
+
+	Writer appends serialized records into a single buffer, and only flushes to its sink once the buffer
+	exceeds FlushBytes, so writing a record does not allocate a std::string.
+
+	*/
+
+// Called once for every record, in order. Return an error to stop reading. That error is returned from Write/Finish.
+typedef std::function<Error(nlohmann::json& record)> RecordCallback;
+
+// Finds every '\n' in buf, and appends the offset of each one to lineEnds
+BMHPAL_API void FindLineEnds(const char* buf, size_t len, std::vector<size_t>& lineEnds);
+
+class BMHPAL_API Reader {
+public:
+	size_t BatchBytes = 1024 * 1024; // Approximate size of the unit of work handed to a worker thread
+
+	// If nThreads is 0, then we use one thread per core. If nThreads is 1, then all parsing happens on the calling thread.
+	Reader(RecordCallback onRecord, int nThreads = 0);
+	~Reader();
+
+	Error Write(const void* buf, size_t len); // Feed the next chunk of the stream. Records may be delivered before this returns.
+	Error Finish();                           // Parse the final line (which needn't end with a newline), and deliver all outstanding records
+
+	Error ReadFd(int fd);                       // Write() everything from fd until EOF, and then Finish()
+	Error ReadFile(const std::string& filename); // Open the file and call ReadFd
+
+private:
+	struct Batch {
+		std::string                 Data;
+		size_t                      FirstLine = 0;
+		std::vector<nlohmann::json> Records;
+		Error                       Err;
+		Semaphore                   Done;
+	};
+
+	RecordCallback           OnRecord;
+	int                      NThreads;
+	std::vector<std::thread> Workers;
+	ObjQueue<Batch*>         Queue;
+	std::deque<Batch*>       InFlight;     // Batches that have been dispatched, but not yet delivered
+	std::string              Pending;      // Bytes that have not been dispatched yet
+	size_t                   LineEnd  = 0; // End of the last complete line in Pending, or 0 if there isn't one
+	size_t                   NextLine = 1;
+	Error                    Err; // Once this is set, we ignore further input
+
+	void        Dispatch(size_t len);
+	void        DeliverOldest();
+	void        Stop();
+	static void ParseBatch(Batch* b, const RecordCallback* deliver);
+	static void WorkerThread(Reader* self);
+};
+
+// Writer sink. Must write all of the bytes, or return an error.
+typedef std::function<Error(const char* buf, size_t len)> SinkCallback;
+
+class BMHPAL_API Writer {
+public:
+	size_t FlushBytes = 1024 * 1024;
+
+	Writer(SinkCallback sink);
+	Writer(int fd); // Does not take ownership of fd
+	~Writer();      // Does not flush. You must call Flush() yourself, so that you can see the error.
+
+	Error Write(const nlohmann::json& record);
+	Error WriteRaw(const char* json, size_t len); // json must already be a single line of encoded json, without a trailing newline
+	Error Flush();
+
+private:
+	SinkCallback     Sink;
+	std::string      Buf;
+	jsonutil::Writer J; // Appends to Buf
+
+	Error MaybeFlush();
+};
+
+} // namespace ndjson
+} // namespace bmhpal
@@ -19,6 +19,7 @@ struct BMHPAL_API Sig16 {
 
 	bool        IsNull() const;
 	std::string Hex() const;
+	void        Hex(char* out) const; // Writes 32 characters to out, without a null terminator
 
 	bool operator==(const Sig16& b) const {
 		return ((QWords[0] ^ b.QWords[0]) |
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "Sig32.h"
+#include "../Encoding/Hex.h"
 
 namespace bmhpal {
 namespace hash {
@@ -13,7 +14,11 @@ bool Sig32::IsNull() const {
 }
 
 std::string Sig32::Hex() const {
-	return modp::b16_encode((const char*) Bytes, sizeof(Bytes));
+	return hex::Encode(Bytes, sizeof(Bytes), true);
+}
+
+void Sig32::Hex(char* out) const {
+	hex::Encode(Bytes, sizeof(Bytes), out, true);
 }
 
 Sig32 Sig32::Compute(const void* buf, size_t len) {
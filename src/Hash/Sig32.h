@@ -19,6 +19,7 @@ struct BMHPAL_API Sig32 {
 
 	bool        IsNull() const;
 	std::string Hex() const;
+	void        Hex(char* out) const; // Writes 64 characters to out, without a null terminator
 
 	static Sig32 Compute(const void* buf, size_t len);
 
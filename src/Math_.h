@@ -1,6 +1,10 @@
 #pragma once
 
 #include "math.h"
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace bmhpal {
 
@@ -10,6 +14,62 @@ T Clamp(T v, T vmin, T vmax) { return (v < vmin) ? vmin : (v > vmax) ? vmax : v;
 template <typename T>
 T RoundUp(T v, T mod) { return mod * ((v + mod - 1) / mod); }
 
+// Bit scanning, for GCC, clang and MSVC. For the Count functions, v must not be zero.
+inline unsigned CountLeadingZeros64(uint64_t v) {
+#if defined(_MSC_VER) && defined(_WIN64)
+	unsigned long i;
+	_BitScanReverse64(&i, v);
+	return 63 - (unsigned) i;
+#elif defined(_MSC_VER)
+	unsigned long i;
+	if (_BitScanReverse(&i, (unsigned long) (v >> 32)))
+		return 31 - (unsigned) i;
+	_BitScanReverse(&i, (unsigned long) v);
+	return 63 - (unsigned) i;
+#else
+	return (unsigned) __builtin_clzll(v);
+#endif
+}
+
+inline unsigned CountTrailingZeros(uint32_t v) {
+#if defined(_MSC_VER)
+	unsigned long i;
+	_BitScanForward(&i, v);
+	return (unsigned) i;
+#else
+	return (unsigned) __builtin_ctz(v);
+#endif
+}
+
+inline unsigned CountTrailingZeros64(uint64_t v) {
+#if defined(_MSC_VER) && defined(_WIN64)
+	unsigned long i;
+	_BitScanForward64(&i, v);
+	return (unsigned) i;
+#elif defined(_MSC_VER)
+	unsigned long i;
+	if (_BitScanForward(&i, (unsigned long) v))
+		return (unsigned) i;
+	_BitScanForward(&i, (unsigned long) (v >> 32));
+	return 32 + (unsigned) i;
+#else
+	return (unsigned) __builtin_ctzll(v);
+#endif
+}
+
+inline unsigned PopCount(uint32_t v) {
+#if defined(_MSC_VER) && defined(__AVX__)
+	return __popcnt(v);
+#elif defined(_MSC_VER)
+	// __popcnt emits the POPCNT instruction unconditionally, and that is not part of the x64 baseline
+	v = v - ((v >> 1) & 0x55555555);
+	v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+	return (((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24;
+#else
+	return (unsigned) __builtin_popcount(v);
+#endif
+}
+
 namespace math {
 struct MeanAndVariance {
 	double Mean = 0;
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "../OS/OS.h"
 #include "Http.h"
+#include "../Text/Numeric.h"
 #include "../Text/StringUtils.h"
 
 #ifdef _MSC_VER
@@ -201,6 +202,7 @@ void Client::PerformInternal(const Request& req, Response& resp) {
 	ReadPtrStart    = (char*) req.Body.c_str();
 	ReadPtr         = ReadPtrStart;
 	ReadPtrEnd      = ReadPtr + req.Body.size();
+	BodyReceived    = 0;
 	CurrentRequest  = &req;
 	CurrentResponse = &resp;
 
@@ -295,13 +297,22 @@ size_t Client::CurlWriteCallback(char* ptr, size_t size, size_t nmemb, void* use
 		self->CurrentResponse->Cancelled = true;
 		return 0;
 	}
-	self->CurrentResponse->Body.append(ptr, size * nmemb);
+	self->BodyReceived += size * nmemb;
+	if (self->CurrentRequest->OnBody) {
+		if (!self->CurrentRequest->OnBody(ptr, size * nmemb)) {
+			self->CurrentResponse->Cancelled = true;
+			self->IsCancelled                = true;
+			return 0;
+		}
+	} else {
+		self->CurrentResponse->Body.append(ptr, size * nmemb);
+	}
 	if (self->CurrentRequest->OnProgress) {
+		// If Content-Length is missing or invalid, then the total length is unknown, and len stays 0
 		auto    lenStr = self->CurrentResponse->Header("Content-Length");
 		int64_t len    = 0;
-		if (lenStr != "")
-			len = atoi64(lenStr.c_str());
-		bool keepGoing = self->CurrentRequest->OnProgress(ProgressPhase::Receive, self->CurrentResponse->Body.size(), len);
+		numeric::ParseInt(strings::TrimSpaceView(lenStr), len);
+		bool keepGoing = self->CurrentRequest->OnProgress(ProgressPhase::Receive, self->BodyReceived, len);
 		if (!keepGoing) {
 			self->CurrentResponse->Cancelled = true;
 			self->IsCancelled                = true;
@@ -345,7 +356,7 @@ size_t Client::CurlHeaderCallback(char* buffer, size_t size, size_t nitems, void
 	// HTTP/1.1 200 OK
 	// HTTP/1.0 411 Length Required
 	if (n >= 12 && (memcmp(buffer, "HTTP/1.0", 8) == 0 || memcmp(buffer, "HTTP/1.1", 8) == 0)) {
-		w->Status = atoi(buffer + 9);
+		numeric::ParseInt(buffer + 9, buffer + n, w->Status);
 		return n;
 	}
 	// final (blank) header line
@@ -14,6 +14,9 @@ enum class ProgressPhase {
 // Progress callback. If you return false, then the operation is cancelled
 typedef std::function<bool(ProgressPhase phase, size_t bytesDone, size_t bytesTotal)> ProgressCallback;
 
+// Body callback. Receives the response body in chunks, as it arrives. If you return false, then the operation is cancelled
+typedef std::function<bool(const void* buf, size_t len)> BodyCallback;
+
 // HTTP Request
 class BMHPAL_API Request {
 public:
@@ -24,6 +27,7 @@ public:
 	bool                                             AllowExpect100  = false;
 	bool                                             FollowRedirects = false;
 	ProgressCallback                                 OnProgress;
+	BodyCallback                                     OnBody; // If set, the response body is streamed here, instead of being stored in Response::Body
 
 	Request();
 	Request(const std::string& method, const std::string& uri, const std::string& body = "");
@@ -92,6 +96,7 @@ private:
 	const char*       ReadPtr         = nullptr;
 	const char*       ReadPtrStart    = nullptr;
 	const char*       ReadPtrEnd      = nullptr;
+	size_t            BodyReceived    = 0;
 	const Request*    CurrentRequest  = nullptr;
 	Response*         CurrentResponse = nullptr;
 
@@ -0,0 +1,539 @@
+#include "pch.h"
+#include "AsyncIO.h"
+#include "../Text/ConvertUTF.h"
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+#include <io.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(BMHPAL_PLATFORM_LINUX) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define BMHPAL_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace os {
+
+struct AsyncIO::Op {
+	Ops             Type;
+	int             Fd      = -1;
+	void*           Buf     = nullptr;
+	size_t          Len     = 0;
+	uint64_t        Offset  = 0;
+	int             Flags   = 0;
+	int             Mode    = 0;
+	std::string     Path;
+	FileAttributes* Attribs = nullptr;
+	StatMask        Mask    = StatMask::All;
+	AsyncCallback   Callback;
+	int64_t         Result = 0;
+	Error           Err;
+#ifdef BMHPAL_HAVE_IO_URING
+	struct statx Stx;
+#endif
+};
+
+struct AsyncIO::RingInfo {
+#ifdef BMHPAL_HAVE_IO_URING
+	unsigned*     SqHead  = nullptr;
+	unsigned*     SqTail  = nullptr;
+	unsigned*     SqArray = nullptr;
+	unsigned      SqMask  = 0;
+	io_uring_sqe* Sqes    = nullptr;
+	unsigned*     CqHead  = nullptr;
+	unsigned*     CqTail  = nullptr;
+	unsigned      CqMask  = 0;
+	io_uring_cqe* Cqes    = nullptr;
+	void*         SqMap   = nullptr;
+	size_t        SqLen   = 0;
+	void*         CqMap   = nullptr;
+	size_t        CqLen   = 0;
+	size_t        SqesLen = 0;
+#endif
+};
+
+#ifdef BMHPAL_HAVE_IO_URING
+static unsigned StatxMask(StatMask mask) {
+	unsigned m = 0;
+	m |= (mask & StatMask::Type) ? STATX_TYPE : 0;
+	m |= (mask & StatMask::Size) ? STATX_SIZE : 0;
+	m |= (mask & StatMask::TimeModify) ? STATX_MTIME : 0;
+	m |= (mask & StatMask::TimeCreate) ? STATX_CTIME : 0;
+	m |= (mask & StatMask::Inode) ? STATX_INO : 0;
+	m |= (mask & StatMask::NLink) ? STATX_NLINK : 0;
+	return m;
+}
+#endif
+
+AsyncIO::AsyncIO(unsigned queueDepth, int nThreads, bool forceThreadPool) : QueueDepth(std::max(queueDepth, 1u)) {
+	if (!forceThreadPool && SetupRing(QueueDepth))
+		return;
+	if (nThreads <= 0)
+		nThreads = std::max((int) std::thread::hardware_concurrency() * 2, 2);
+	Work.Initialize(true);
+	for (int i = 0; i < nThreads; i++)
+		Workers.push_back(std::thread(WorkerThread, this));
+}
+
+AsyncIO::~AsyncIO() {
+	Closing = true;
+	for (auto op : Queued)
+		delete op;
+	Queued.clear();
+	while (InFlight != 0)
+		Wait(1);
+	for (size_t i = 0; i < Workers.size(); i++)
+		Work.Push(nullptr);
+	for (auto& t : Workers)
+		t.join();
+	CloseRing();
+}
+
+bool AsyncIO::SetupRing(unsigned entries) {
+#ifdef BMHPAL_HAVE_IO_URING
+	io_uring_params p;
+	memset(&p, 0, sizeof(p));
+	int fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+	if (fd < 0)
+		return false;
+	// IORING_FEAT_RW_CUR_POS arrived in 5.6, along with IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, etc
+	if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+		close(fd);
+		return false;
+	}
+	Ring = fd;
+	RI   = new RingInfo();
+
+	RI->SqLen = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	RI->CqLen = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+	bool single = !!(p.features & IORING_FEAT_SINGLE_MMAP);
+	if (single)
+		RI->SqLen = RI->CqLen = std::max(RI->SqLen, RI->CqLen);
+	RI->SqMap = mmap(nullptr, RI->SqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+	if (RI->SqMap == MAP_FAILED) {
+		RI->SqMap = nullptr;
+		CloseRing();
+		return false;
+	}
+	if (single) {
+		RI->CqMap = RI->SqMap;
+	} else {
+		RI->CqMap = mmap(nullptr, RI->CqLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+		if (RI->CqMap == MAP_FAILED) {
+			RI->CqMap = nullptr;
+			CloseRing();
+			return false;
+		}
+	}
+	RI->SqesLen = p.sq_entries * sizeof(io_uring_sqe);
+	void* sqes  = mmap(nullptr, RI->SqesLen, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED) {
+		CloseRing();
+		return false;
+	}
+
+	char* sq    = (char*) RI->SqMap;
+	char* cq    = (char*) RI->CqMap;
+	RI->SqHead  = (unsigned*) (sq + p.sq_off.head);
+	RI->SqTail  = (unsigned*) (sq + p.sq_off.tail);
+	RI->SqArray = (unsigned*) (sq + p.sq_off.array);
+	RI->SqMask  = *(unsigned*) (sq + p.sq_off.ring_mask);
+	RI->Sqes    = (io_uring_sqe*) sqes;
+	RI->CqHead  = (unsigned*) (cq + p.cq_off.head);
+	RI->CqTail  = (unsigned*) (cq + p.cq_off.tail);
+	RI->CqMask  = *(unsigned*) (cq + p.cq_off.ring_mask);
+	RI->Cqes    = (io_uring_cqe*) (cq + p.cq_off.cqes);
+
+	// The kernel rounds the ring up to a power of 2, and we never have more than QueueDepth in flight, so the
+	// submission ring can't overflow, and the completion ring (which is twice as large) can't either.
+	QueueDepth = std::min(QueueDepth, p.sq_entries);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void AsyncIO::CloseRing() {
+#ifdef BMHPAL_HAVE_IO_URING
+	if (RI) {
+		if (RI->Sqes)
+			munmap(RI->Sqes, RI->SqesLen);
+		if (RI->CqMap && RI->CqMap != RI->SqMap)
+			munmap(RI->CqMap, RI->CqLen);
+		if (RI->SqMap)
+			munmap(RI->SqMap, RI->SqLen);
+		delete RI;
+		RI = nullptr;
+	}
+	if (Ring != -1)
+		close(Ring);
+	Ring = -1;
+#endif
+}
+
+void AsyncIO::Enqueue(Op* op) {
+	Queued.push_back(op);
+}
+
+void AsyncIO::Open(const std::string& filename, int flags, int mode, AsyncCallback done) {
+	auto op      = new Op();
+	op->Type     = Ops::Open;
+	op->Path     = filename;
+	op->Flags    = flags;
+	op->Mode     = mode;
+	op->Callback = done;
+	Enqueue(op);
+}
+
+void AsyncIO::Read(int fd, void* buf, size_t len, uint64_t offset, AsyncCallback done) {
+	auto op      = new Op();
+	op->Type     = Ops::Read;
+	op->Fd       = fd;
+	op->Buf      = buf;
+	op->Len      = std::min(len, (size_t) 1 << 30);
+	op->Offset   = offset;
+	op->Callback = done;
+	Enqueue(op);
+}
+
+void AsyncIO::Write(int fd, const void* buf, size_t len, uint64_t offset, AsyncCallback done) {
+	auto op      = new Op();
+	op->Type     = Ops::Write;
+	op->Fd       = fd;
+	op->Buf      = (void*) buf;
+	op->Len      = std::min(len, (size_t) 1 << 30);
+	op->Offset   = offset;
+	op->Callback = done;
+	Enqueue(op);
+}
+
+void AsyncIO::Stat(const std::string& path, FileAttributes* attribs, AsyncCallback done, StatMask mask) {
+	auto op      = new Op();
+	op->Type     = Ops::Stat;
+	op->Path     = path;
+	op->Attribs  = attribs;
+	op->Mask     = mask;
+	op->Callback = done;
+	Enqueue(op);
+}
+
+void AsyncIO::Close(int fd, AsyncCallback done) {
+	auto op      = new Op();
+	op->Type     = Ops::Close;
+	op->Fd       = fd;
+	op->Callback = done;
+	Enqueue(op);
+}
+
+void AsyncIO::PushSQE(Op* op) {
+#ifdef BMHPAL_HAVE_IO_URING
+	// We are the only writer of the submission tail
+	unsigned      tail = *RI->SqTail;
+	unsigned      idx  = tail & RI->SqMask;
+	io_uring_sqe* sqe  = &RI->Sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	switch (op->Type) {
+	case Ops::Open:
+		sqe->opcode     = IORING_OP_OPENAT;
+		sqe->fd         = AT_FDCWD;
+		sqe->addr       = (uint64_t) (uintptr_t) op->Path.c_str();
+		sqe->len        = (uint32_t) op->Mode;
+		sqe->open_flags = (uint32_t) op->Flags;
+		break;
+	case Ops::Read:
+	case Ops::Write:
+		sqe->opcode = op->Type == Ops::Read ? IORING_OP_READ : IORING_OP_WRITE;
+		sqe->fd     = op->Fd;
+		sqe->addr   = (uint64_t) (uintptr_t) op->Buf;
+		sqe->len    = (uint32_t) op->Len;
+		sqe->off    = op->Offset;
+		break;
+	case Ops::Stat:
+		sqe->opcode = IORING_OP_STATX;
+		sqe->fd     = AT_FDCWD;
+		sqe->addr   = (uint64_t) (uintptr_t) op->Path.c_str();
+		sqe->len    = StatxMask(op->Mask);
+		sqe->off    = (uint64_t) (uintptr_t) &op->Stx;
+		break;
+	case Ops::Close:
+		sqe->opcode = IORING_OP_CLOSE;
+		sqe->fd     = op->Fd;
+		break;
+	}
+	sqe->user_data   = (uint64_t) (uintptr_t) op;
+	RI->SqArray[idx] = idx;
+	__atomic_store_n(RI->SqTail, tail + 1, __ATOMIC_RELEASE);
+	RingPending++;
+#endif
+}
+
+void AsyncIO::Enter(unsigned minComplete) {
+#ifdef BMHPAL_HAVE_IO_URING
+	unsigned flags = minComplete != 0 ? IORING_ENTER_GETEVENTS : 0;
+	while (true) {
+		int r = (int) syscall(__NR_io_uring_enter, Ring, RingPending, minComplete, flags, nullptr, 0);
+		if (r >= 0) {
+			RingPending -= (unsigned) r;
+			return;
+		}
+		// On EAGAIN or EBUSY, the kernel wants us to reap completions first, which our caller will do
+		if (errno != EINTR)
+			return;
+	}
+#endif
+}
+
+size_t AsyncIO::ReapRing() {
+	size_t n = 0;
+#ifdef BMHPAL_HAVE_IO_URING
+	while (true) {
+		unsigned head = *RI->CqHead;
+		unsigned tail = __atomic_load_n(RI->CqTail, __ATOMIC_ACQUIRE);
+		if (head == tail)
+			break;
+		io_uring_cqe* cqe = &RI->Cqes[head & RI->CqMask];
+		Op*           op  = (Op*) (uintptr_t) cqe->user_data;
+		int           res = cqe->res;
+		// Release the slot before running the callback, which might submit more work
+		__atomic_store_n(RI->CqHead, head + 1, __ATOMIC_RELEASE);
+		if (res < 0) {
+			op->Err = ErrorFrom_errno(-res);
+		} else {
+			op->Result = res;
+			if (op->Type == Ops::Stat) {
+				const auto& s             = op->Stx;
+				op->Attribs->IsDir        = S_ISDIR(s.stx_mode);
+				op->Attribs->TimeCreate   = s.stx_ctime.tv_sec + s.stx_ctime.tv_nsec * (1.0 / 1000000000);
+				op->Attribs->TimeModify   = s.stx_mtime.tv_sec + s.stx_mtime.tv_nsec * (1.0 / 1000000000);
+				op->Attribs->TimeCreateNS = (int64_t) s.stx_ctime.tv_sec * 1000000000 + s.stx_ctime.tv_nsec;
+				op->Attribs->TimeModifyNS = (int64_t) s.stx_mtime.tv_sec * 1000000000 + s.stx_mtime.tv_nsec;
+				op->Attribs->Size         = s.stx_size;
+				op->Attribs->Inode        = s.stx_ino;
+				op->Attribs->NLink        = s.stx_nlink;
+			}
+		}
+		Finish(op);
+		n++;
+	}
+#endif
+	return n;
+}
+
+size_t AsyncIO::ReapThreads(size_t min) {
+	vector<Op*> done;
+	{
+		unique_lock<mutex> lock(CompletedLock);
+		if (min != 0)
+			CompletedCV.wait(lock, [&]() { return Completed.size() >= min; });
+		done.swap(Completed);
+	}
+	for (auto op : done)
+		Finish(op);
+	return done.size();
+}
+
+void AsyncIO::Finish(Op* op) {
+	InFlight--;
+	if (!Closing)
+		op->Callback(op->Err, op->Result);
+	delete op;
+}
+
+void AsyncIO::Execute(Op* op) {
+	int64_t r = 0;
+	switch (op->Type) {
+	case Ops::Open:
+#ifdef BMHPAL_PLATFORM_WINDOWS
+		r = _wopen(WideString(op->Path).c_str(), op->Flags | _O_BINARY, op->Mode);
+#else
+		r = open(op->Path.c_str(), op->Flags, op->Mode);
+#endif
+		break;
+	case Ops::Read:
+	case Ops::Write:
+#ifdef BMHPAL_PLATFORM_WINDOWS
+		op->Err = Error("AsyncIO: Read and Write are not implemented on Windows");
+		return;
+#else
+		do {
+			if (op->Type == Ops::Read)
+				r = pread(op->Fd, op->Buf, op->Len, (off_t) op->Offset);
+			else
+				r = pwrite(op->Fd, op->Buf, op->Len, (off_t) op->Offset);
+		} while (r == -1 && errno == EINTR);
+		break;
+#endif
+	case Ops::Stat:
+		op->Err = os::Stat(op->Path, *op->Attribs, op->Mask);
+		return;
+	case Ops::Close:
+#ifdef BMHPAL_PLATFORM_WINDOWS
+		r = _close(op->Fd);
+#else
+		r = close(op->Fd);
+#endif
+		break;
+	}
+	if (r == -1)
+		op->Err = ErrorFrom_errno(errno);
+	else
+		op->Result = r;
+}
+
+void AsyncIO::WorkerThread(AsyncIO* self) {
+	while (true) {
+		self->Work.Semaphore.wait();
+		Op* op = nullptr;
+		self->Work.PopTail(op);
+		if (op == nullptr)
+			return;
+		Execute(op);
+		{
+			lock_guard<mutex> lock(self->CompletedLock);
+			self->Completed.push_back(op);
+		}
+		self->CompletedCV.notify_one();
+	}
+}
+
+void AsyncIO::Submit() {
+	while (Queued.size() != 0 && InFlight < QueueDepth) {
+		Op* op = Queued.front();
+		Queued.pop_front();
+		InFlight++;
+		if (Ring != -1)
+			PushSQE(op);
+		else
+			Work.Push(op);
+	}
+	if (RingPending != 0)
+		Enter(0);
+}
+
+size_t AsyncIO::Poll() {
+	Submit();
+	return Ring != -1 ? ReapRing() : ReapThreads(0);
+}
+
+size_t AsyncIO::Wait(size_t n) {
+	size_t ran = 0;
+	while (ran < n && Outstanding() != 0) {
+		Submit();
+		if (Ring != -1) {
+			size_t got = ReapRing();
+			if (got == 0) {
+				Enter(1);
+				got = ReapRing();
+			}
+			ran += got;
+		} else {
+			ran += ReapThreads(InFlight != 0 ? 1 : 0);
+		}
+	}
+	return ran;
+}
+
+void AsyncIO::WaitAll() {
+	while (Outstanding() != 0)
+		Wait(Outstanding());
+}
+
+size_t AsyncIO::Outstanding() const {
+	return Queued.size() + InFlight;
+}
+
+Error AsyncIO::ReadFiles(const std::vector<std::string>& filenames, std::vector<std::string>& contents, std::vector<Error>* errors) {
+	contents.clear();
+	contents.resize(filenames.size());
+	vector<Error> errs(filenames.size());
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+	for (size_t i = 0; i < filenames.size(); i++)
+		errs[i] = os::ReadFile(filenames[i], contents[i]);
+#else
+	// Regular files only return a short read at EOF, so most small files take just three operations.
+	// Each file that is being read holds one of the scratch buffers, which limits the number of open files.
+	// The first read goes into the scratch buffer, so that small files don't each hold on to a large allocation.
+	const size_t                        firstRead = 16 * 1024;
+	size_t                              next      = 0;
+	vector<string>                      scratch(std::min((size_t) QueueDepth, filenames.size()));
+	vector<size_t>                      freeSlots;
+	function<void()>                    startNext;
+	function<void(size_t, size_t, int)> readMore;
+
+	auto finish = [&](size_t i, size_t slot, int fd, Error err) {
+		errs[i] = err;
+		if (fd != -1)
+			Close(fd, [](Error err, int64_t r) {});
+		freeSlots.push_back(slot);
+		startNext();
+	};
+
+	readMore = [&](size_t i, size_t slot, int fd) {
+		string& s   = contents[i];
+		size_t  pos = s.size();
+		s.resize(pos * 2);
+		Read(fd, &s[pos], s.size() - pos, pos, [&, i, slot, fd, pos](Error err, int64_t n) {
+			string& s = contents[i];
+			if (!err.OK() || (size_t) n < s.size() - pos) {
+				s.resize(err.OK() ? pos + (size_t) n : pos);
+				finish(i, slot, fd, err);
+				return;
+			}
+			readMore(i, slot, fd);
+		});
+	};
+
+	startNext = [&]() {
+		if (next == filenames.size() || freeSlots.size() == 0)
+			return;
+		size_t i    = next++;
+		size_t slot = freeSlots.back();
+		freeSlots.pop_back();
+		Open(filenames[i], O_RDONLY | O_CLOEXEC, 0, [&, i, slot](Error err, int64_t fd) {
+			if (!err.OK()) {
+				finish(i, slot, -1, err);
+				return;
+			}
+			string& buf = scratch[slot];
+			buf.resize(firstRead);
+			Read((int) fd, &buf[0], firstRead, 0, [&, i, slot, fd](Error err, int64_t n) {
+				if (err.OK())
+					contents[i].assign(scratch[slot].data(), (size_t) n);
+				if (!err.OK() || (size_t) n < firstRead)
+					finish(i, slot, (int) fd, err);
+				else
+					readMore(i, slot, (int) fd);
+			});
+		});
+	};
+
+	for (size_t slot = 0; slot < scratch.size(); slot++)
+		freeSlots.push_back(slot);
+	for (size_t slot = 0; slot < scratch.size(); slot++)
+		startNext();
+	WaitAll();
+#endif
+
+	if (errors) {
+		*errors = std::move(errs);
+		return Error();
+	}
+	for (size_t i = 0; i < filenames.size(); i++) {
+		if (!errs[i].OK())
+			return Error::Fmt("%v: %v", filenames[i], errs[i].Message());
+	}
+	return Error();
+}
+
+} // namespace os
+} // namespace bmhpal
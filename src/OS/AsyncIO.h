@@ -0,0 +1,105 @@
+#pragma once
+
+#include <fcntl.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include "../Error/Error.h"
+#include "../Containers/ObjQueue.h"
+#include "OS.h"
+
+namespace bmhpal {
+namespace os {
+
+/*
+
+	Asynchronous file I/O
+	=====================
+
+	AsyncIO lets you queue up many file operations (open, read, write, stat, close), and have them
+	executed concurrently. On Linux, if the kernel supports it (5.6 or later), operations are submitted
+	in batches to an io_uring, so a batch of hundreds of operations costs a single system call. Otherwise
+	we fall back to a pool of threads that execute the operations with ordinary blocking calls.
+
+	Operations are only queued by Open/Read/Write/Stat/Close. They are submitted by Submit, Poll or Wait.
+	Completion callbacks are always run on the thread that calls Poll or Wait, so an AsyncIO object needs
+	no locking on your side, as long as it is only used from one thread. Callbacks may queue further
+	operations, which is how you chain an open, a read and a close together.
+
+	Buffers and FileAttributes passed to Read/Write/Stat must remain valid until the callback is run.
+	Completion order is not defined.
+
+	On Windows only the thread pool is available, and Read and Write are not implemented yet.
+
+	*/
+
+// result is the fd for Open, the number of bytes transferred for Read and Write, and zero for Stat and Close
+typedef std::function<void(Error err, int64_t result)> AsyncCallback;
+
+class BMHPAL_API AsyncIO {
+public:
+	// queueDepth is the maximum number of operations in flight at once.
+	// nThreads is only used by the thread pool fallback. If zero, then we use two threads per core.
+	AsyncIO(unsigned queueDepth = 256, int nThreads = 0, bool forceThreadPool = false);
+	~AsyncIO(); // Waits for all outstanding operations, but does not run their callbacks
+
+	bool IsIOUring() const { return Ring != -1; }
+
+	void Open(const std::string& filename, int flags, int mode, AsyncCallback done); // flags and mode are the same as open()
+	void Read(int fd, void* buf, size_t len, uint64_t offset, AsyncCallback done);
+	void Write(int fd, const void* buf, size_t len, uint64_t offset, AsyncCallback done);
+	void Stat(const std::string& path, FileAttributes* attribs, AsyncCallback done, StatMask mask = StatMask::All);
+	void Close(int fd, AsyncCallback done);
+
+	void   Submit();            // Submit queued operations, as far as queueDepth allows
+	size_t Poll();              // Submit, and run the callbacks of completed operations, without blocking. Returns the number of callbacks run.
+	size_t Wait(size_t n = 1);  // Submit, and block until at least n operations have completed (or nothing is outstanding). Returns the number of callbacks run.
+	void   WaitAll();           // Block until everything, including operations queued by callbacks, has completed
+	size_t Outstanding() const; // Number of operations that are queued or in flight
+
+	// Read whole files, with many in flight at once. Reading of a file stops on its first error.
+	// If errors is not null, then it receives one error per file, and the function only fails if
+	// errors is null and at least one file failed.
+	Error ReadFiles(const std::vector<std::string>& filenames, std::vector<std::string>& contents, std::vector<Error>* errors = nullptr);
+
+private:
+	enum class Ops {
+		Open,
+		Read,
+		Write,
+		Stat,
+		Close,
+	};
+	struct Op;
+	struct RingInfo;
+
+	unsigned        QueueDepth;
+	std::deque<Op*> Queued;                // Not yet submitted
+	size_t          InFlight    = 0;       // Submitted, but callback not yet run
+	bool            Closing     = false;   // Set by the destructor, to suppress callbacks
+	int             Ring        = -1;      // io_uring fd
+	RingInfo*       RI          = nullptr; // io_uring memory mappings
+	unsigned        RingPending = 0;       // SQEs written, but not yet passed to io_uring_enter
+
+	// Thread pool fallback
+	std::vector<std::thread> Workers;
+	ObjQueue<Op*>            Work;
+	std::mutex               CompletedLock;
+	std::condition_variable  CompletedCV;
+	std::vector<Op*>         Completed; // Finished by workers, waiting for their callbacks to run
+
+	void        Enqueue(Op* op);
+	bool        SetupRing(unsigned entries);
+	void        CloseRing();
+	void        PushSQE(Op* op);
+	void        Enter(unsigned minComplete);
+	size_t      ReapRing();
+	size_t      ReapThreads(size_t min);
+	void        Finish(Op* op);
+	static void Execute(Op* op);
+	static void WorkerThread(AsyncIO* self);
+};
+
+} // namespace os
+} // namespace bmhpal
@@ -0,0 +1,58 @@
+#include "pch.h"
+#include "CPU.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bmhpal {
+namespace os {
+
+struct CPUFeatures {
+	bool SSSE3 = false;
+	bool SSE41 = false;
+	bool AVX2  = false;
+
+	CPUFeatures() {
+#if defined(BMHPAL_SSE2) && defined(__GNUC__)
+		__builtin_cpu_init();
+		SSSE3 = !!__builtin_cpu_supports("ssse3");
+		SSE41 = !!__builtin_cpu_supports("sse4.1");
+		AVX2  = !!__builtin_cpu_supports("avx2");
+#elif defined(BMHPAL_SSE2) && defined(_MSC_VER)
+		int r[4];
+		__cpuid(r, 0);
+		int maxLeaf = r[0];
+		__cpuid(r, 1);
+		SSSE3         = !!(r[2] & (1 << 9));
+		SSE41         = !!(r[2] & (1 << 19));
+		bool osxsave  = !!(r[2] & (1 << 27));
+		bool avx      = !!(r[2] & (1 << 28));
+		bool ymmSaved = osxsave && (_xgetbv(0) & 6) == 6;
+		if (maxLeaf >= 7 && avx && ymmSaved) {
+			__cpuidex(r, 7, 0);
+			AVX2 = !!(r[1] & (1 << 5));
+		}
+#endif
+	}
+};
+
+static const CPUFeatures& Features() {
+	static CPUFeatures f;
+	return f;
+}
+
+BMHPAL_API bool CPUHasSSSE3() {
+	return Features().SSSE3;
+}
+
+BMHPAL_API bool CPUHasSSE41() {
+	return Features().SSE41;
+}
+
+BMHPAL_API bool CPUHasAVX2() {
+	return Features().AVX2;
+}
+
+} // namespace os
+} // namespace bmhpal
@@ -0,0 +1,13 @@
+#pragma once
+
+namespace bmhpal {
+namespace os {
+
+// Runtime detection of x86 instruction set extensions. These always return false on other architectures.
+// The results are computed once, so these are cheap enough to call before every vectorized operation.
+BMHPAL_API bool CPUHasSSSE3();
+BMHPAL_API bool CPUHasSSE41();
+BMHPAL_API bool CPUHasAVX2();
+
+} // namespace os
+} // namespace bmhpal
@@ -0,0 +1,522 @@
+#include "pch.h"
+#include "DirWalker.h"
+
+#ifndef BMHPAL_PLATFORM_WINDOWS
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef BMHPAL_PLATFORM_LINUX
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace os {
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+
+Error WalkEntry::Stat(FileAttributes& attribs) const {
+	return os::Stat(Path, attribs);
+}
+
+static bool WalkRecursive(const std::string& dir, int depth, const WalkFunc& visit, const WalkErrorFunc& onError, Error& err) {
+	vector<FindFileItem> items;
+	auto                 e = FindFiles(dir, items);
+	if (!e.OK()) {
+		if (onError) {
+			onError(dir, e);
+			return true;
+		}
+		err = e;
+		return false;
+	}
+	WalkEntry entry;
+	entry.Depth = depth;
+	for (const auto& item : items) {
+		entry.Path  = item.FullPath;
+		entry.Name  = entry.Path.c_str() + entry.Path.size() - item.Name.size();
+		entry.IsDir = item.IsDir;
+		auto action = visit(entry);
+		if (action == WalkAction::Stop)
+			return false;
+		if (action == WalkAction::Continue && item.IsDir) {
+			if (!WalkRecursive(item.FullPath, depth + 1, visit, onError, err))
+				return false;
+		}
+	}
+	return true;
+}
+
+BMHPAL_API Error WalkDir(const std::string& root, const WalkFunc& visit, int nThreads, const WalkErrorFunc& onError) {
+	Error err;
+	WalkRecursive(root, 0, visit, onError, err);
+	return err;
+}
+
+static bool RemoveRecursive(const std::string& path, const WalkErrorFunc& onError, Error& firstErr) {
+	auto fail = [&](const std::string& p, Error err) {
+		if (onError)
+			onError(p, err);
+		if (firstErr.OK())
+			firstErr = Error::Fmt("%v: %v", p, err.Message());
+	};
+	vector<FindFileItem> items;
+	auto                 err = FindFiles(path, items);
+	if (!err.OK()) {
+		fail(path, err);
+		return false;
+	}
+	bool ok = true;
+	for (const auto& item : items) {
+		if (item.IsDir) {
+			ok = RemoveRecursive(item.FullPath, onError, firstErr) && ok;
+		} else {
+			err = Remove(item.FullPath);
+			if (!err.OK()) {
+				fail(item.FullPath, err);
+				ok = false;
+			}
+		}
+	}
+	if (!ok)
+		return false;
+	err = Remove(path);
+	if (!err.OK()) {
+		fail(path, err);
+		return false;
+	}
+	return true;
+}
+
+BMHPAL_API Error RemoveAll(const std::string& path, const WalkErrorFunc& onError, int nThreads) {
+	FileAttributes attribs;
+	auto           err = Stat(path, attribs);
+	if (!err.OK())
+		return IsNotExist(err) ? Error() : err;
+	if (!attribs.IsDir)
+		return Remove(path);
+	Error firstErr;
+	RemoveRecursive(path, onError, firstErr);
+	return firstErr;
+}
+
+#else
+
+Error WalkEntry::Stat(FileAttributes& attribs) const {
+	return StatAt(DirFd, Name, attribs, StatMask::All, false);
+}
+
+// An open directory. The fd stays open while the directory is being read, and until all of
+// its subdirectories have been opened, because they are opened relative to it.
+struct WalkDirNode {
+	int Fd;
+	WalkDirNode(int fd) : Fd(fd) {}
+	~WalkDirNode() { close(Fd); }
+};
+
+struct WalkJob {
+	shared_ptr<WalkDirNode> Parent;
+	std::string             Path;
+	size_t                  NameLen = 0;
+	int                     Depth   = 0; // Depth of the entries inside this directory
+};
+
+#ifdef BMHPAL_PLATFORM_LINUX
+struct linux_dirent64 {
+	uint64_t       d_ino;
+	int64_t        d_off;
+	unsigned short d_reclen;
+	unsigned char  d_type;
+	char           d_name[1];
+};
+#endif
+
+// Call f(name, d_type) for every entry in the directory, except "." and "..".
+// f returns false to stop reading.
+template <typename F>
+Error ForEachDirEntry(int fd, vector<char>& buf, F f) {
+#ifdef BMHPAL_PLATFORM_LINUX
+	while (true) {
+		long n = syscall(SYS_getdents64, fd, &buf[0], buf.size());
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return ErrorFrom_errno(errno);
+		}
+		if (n == 0)
+			return Error();
+		for (long pos = 0; pos < n;) {
+			auto d = (linux_dirent64*) &buf[pos];
+			pos += d->d_reclen;
+			const char* name = d->d_name;
+			if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+				continue;
+			if (!f(name, d->d_type))
+				return Error();
+		}
+	}
+#else
+	// fdopendir takes ownership of the fd, but the caller still needs it
+	int dfd = dup(fd);
+	if (dfd == -1)
+		return ErrorFrom_errno(errno);
+	DIR* d = fdopendir(dfd);
+	if (!d) {
+		auto e = errno;
+		close(dfd);
+		return ErrorFrom_errno(e);
+	}
+	Error err;
+	while (true) {
+		errno    = 0;
+		auto ent = readdir(d);
+		if (!ent) {
+			if (errno != 0)
+				err = ErrorFrom_errno(errno);
+			break;
+		}
+		const char* name = ent->d_name;
+		if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))
+			continue;
+		if (!f(name, ent->d_type))
+			break;
+	}
+	closedir(d);
+	return err;
+#endif
+}
+
+struct WalkWorker {
+	const WalkFunc&      Visit;
+	const WalkErrorFunc& OnError;
+	mutex                Lock;
+	condition_variable   CV;
+	vector<WalkJob>      Stack;      // Directories waiting to be read. Taking from the top keeps the walk roughly depth first, which limits the number of open fds.
+	size_t               Active = 0; // Number of directories being read
+	bool                 Stop   = false;
+	Error                FirstErr;
+
+	WalkWorker(const WalkFunc& visit, const WalkErrorFunc& onError) : Visit(visit), OnError(onError) {}
+
+	void Fail(const std::string& path, Error err) {
+		if (OnError) {
+			OnError(path, err);
+			return;
+		}
+		lock_guard<mutex> lock(Lock);
+		if (FirstErr.OK())
+			FirstErr = Error::Fmt("%v: %v", path, err.Message());
+		Stop = true;
+		CV.notify_all();
+	}
+
+	void Run() {
+		vector<char>       buf(64 * 1024);
+		vector<WalkJob>    children;
+		WalkEntry          entry;
+		unique_lock<mutex> lock(Lock);
+		while (true) {
+			while (Stack.empty() && Active != 0 && !Stop)
+				CV.wait(lock);
+			if (Stop || Stack.empty())
+				break;
+			WalkJob job = std::move(Stack.back());
+			Stack.pop_back();
+			Active++;
+			lock.unlock();
+
+			bool stop = ReadDir(job, buf, children, entry);
+
+			lock.lock();
+			Active--;
+			if (stop)
+				Stop = true;
+			for (auto& c : children)
+				Stack.push_back(std::move(c));
+			if (Stop || children.size() > 1 || (Stack.empty() && Active == 0))
+				CV.notify_all();
+			else if (children.size() == 1)
+				CV.notify_one();
+			children.clear();
+		}
+	}
+
+	// Returns true if the walk must stop
+	bool ReadDir(WalkJob& job, vector<char>& buf, vector<WalkJob>& children, WalkEntry& entry) {
+		int fd = openat(job.Parent->Fd, job.Path.c_str() + job.Path.size() - job.NameLen, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		if (fd == -1) {
+			Fail(job.Path, ErrorFrom_errno(errno));
+			return false;
+		}
+		job.Parent = nullptr;
+		return ReadDir(job, fd, buf, children, entry);
+	}
+
+	bool ReadDir(const WalkJob& job, int fd, vector<char>& buf, vector<WalkJob>& children, WalkEntry& entry) {
+		auto node = make_shared<WalkDirNode>(fd);
+
+		size_t prefixLen = job.Path.size();
+		entry.Path       = job.Path;
+		if (prefixLen == 0 || entry.Path[prefixLen - 1] != '/') {
+			entry.Path += '/';
+			prefixLen++;
+		}
+		entry.Depth = job.Depth;
+		entry.DirFd = fd;
+
+		bool stop = false;
+		auto err  = ForEachDirEntry(fd, buf, [&](const char* name, unsigned char type) -> bool {
+			size_t nameLen = strlen(name);
+			entry.Path.resize(prefixLen);
+			entry.Path.append(name, nameLen);
+			entry.Name = entry.Path.c_str() + prefixLen;
+			if (type == DT_UNKNOWN) {
+				// Some filesystems don't fill in d_type
+				struct stat s;
+				if (fstatat(fd, name, &s, AT_SYMLINK_NOFOLLOW) == 0)
+					type = S_ISDIR(s.st_mode) ? DT_DIR : S_ISLNK(s.st_mode) ? DT_LNK : DT_REG;
+			}
+			entry.IsDir     = type == DT_DIR;
+			entry.IsSymlink = type == DT_LNK;
+			auto action     = Visit(entry);
+			if (action == WalkAction::Stop) {
+				stop = true;
+				return false;
+			}
+			if (action == WalkAction::Continue && entry.IsDir) {
+				WalkJob child;
+				child.Parent  = node;
+				child.Path    = entry.Path;
+				child.NameLen = nameLen;
+				child.Depth   = job.Depth + 1;
+				children.push_back(std::move(child));
+			}
+			return true;
+		});
+		if (!err.OK())
+			Fail(job.Path, err);
+		return stop;
+	}
+};
+
+BMHPAL_API Error WalkDir(const std::string& root, const WalkFunc& visit, int nThreads, const WalkErrorFunc& onError) {
+	if (nThreads <= 0)
+		nThreads = std::max((int) std::thread::hardware_concurrency() * 2, 2);
+
+	WalkWorker w(visit, onError);
+
+	// Read the root on this thread, so that failure to open it is always returned, and so that
+	// we don't start threads for a directory that has no subdirectories.
+	int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (fd == -1)
+		return ErrorFrom_errno(errno);
+	{
+		vector<char> buf(64 * 1024);
+		WalkEntry    entry;
+		WalkJob      rootJob;
+		rootJob.Path = root;
+		w.Stop       = w.ReadDir(rootJob, fd, buf, w.Stack, entry);
+	}
+
+	vector<thread> threads;
+	if (w.Stack.size() != 0 && !w.Stop) {
+		for (int i = 1; i < nThreads; i++)
+			threads.push_back(thread([&w]() { w.Run(); }));
+	}
+	w.Run();
+	for (auto& t : threads)
+		t.join();
+	return w.FirstErr;
+}
+
+// A directory that is being emptied. It holds an fd so that its entries can be unlinked relative
+// to it, and it is removed from its parent once it has been read, and all of its subdirectories
+// have been removed.
+struct RemoveNode {
+	shared_ptr<RemoveNode> Parent; // Null for the root
+	int                    Fd = -1;
+	std::string            Path;
+	size_t                 NameLen = 0;
+	atomic<int>            Pending;       // One while the directory is being read, plus one for each subdirectory that is not yet removed
+	atomic<bool>           Failed;        // Something inside could not be removed, so neither can this directory
+	RemoveNode() : Pending(1), Failed(false) {}
+	~RemoveNode() {
+		if (Fd != -1)
+			close(Fd);
+	}
+	const char* Name() const { return Path.c_str() + Path.size() - NameLen; }
+};
+
+struct RemoveWorker {
+	const WalkErrorFunc&           OnError;
+	mutex                          Lock;
+	condition_variable             CV;
+	vector<shared_ptr<RemoveNode>> Stack;      // Directories waiting to be read
+	size_t                         Active = 0; // Number of directories being read
+	Error                          FirstErr;
+
+	RemoveWorker(const WalkErrorFunc& onError) : OnError(onError) {}
+
+	void Fail(const std::string& path, Error err) {
+		if (OnError)
+			OnError(path, err);
+		lock_guard<mutex> lock(Lock);
+		if (FirstErr.OK())
+			FirstErr = Error::Fmt("%v: %v", path, err.Message());
+	}
+
+	void Run() {
+		vector<char>                   buf(64 * 1024);
+		vector<shared_ptr<RemoveNode>> children;
+		unique_lock<mutex>             lock(Lock);
+		while (true) {
+			while (Stack.empty() && Active != 0)
+				CV.wait(lock);
+			if (Stack.empty())
+				break;
+			auto node = std::move(Stack.back());
+			Stack.pop_back();
+			Active++;
+			lock.unlock();
+
+			ReadDir(node, buf, children);
+			node = nullptr;
+
+			lock.lock();
+			Active--;
+			for (auto& c : children)
+				Stack.push_back(std::move(c));
+			if (children.size() > 1 || (Stack.empty() && Active == 0))
+				CV.notify_all();
+			else if (children.size() == 1)
+				CV.notify_one();
+			children.clear();
+		}
+	}
+
+	// Unlink every file in the directory, and queue up its subdirectories
+	void ReadDir(const shared_ptr<RemoveNode>& node, vector<char>& buf, vector<shared_ptr<RemoveNode>>& children) {
+		if (node->Fd == -1) {
+			node->Fd = openat(node->Parent->Fd, node->Name(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+			if (node->Fd == -1) {
+				Fail(node->Path, ErrorFrom_errno(errno));
+				node->Failed = true;
+				Release(node);
+				return;
+			}
+		}
+		int  fd  = node->Fd;
+		auto err = ForEachDirEntry(fd, buf, [&](const char* name, unsigned char type) -> bool {
+			if (type == DT_UNKNOWN) {
+				struct stat s;
+				if (fstatat(fd, name, &s, AT_SYMLINK_NOFOLLOW) == 0)
+					type = S_ISDIR(s.st_mode) ? DT_DIR : DT_REG;
+			}
+			if (type != DT_DIR) {
+				if (unlinkat(fd, name, 0) == 0)
+					return true;
+				if (errno == ENOENT)
+					return true;
+				if (errno != EISDIR) {
+					Fail(node->Path + "/" + name, ErrorFrom_errno(errno));
+					node->Failed = true;
+					return true;
+				}
+			}
+			auto child     = make_shared<RemoveNode>();
+			child->Parent  = node;
+			child->Path    = node->Path + "/" + name;
+			child->NameLen = strlen(name);
+			node->Pending++;
+			children.push_back(std::move(child));
+			return true;
+		});
+		if (!err.OK()) {
+			Fail(node->Path, err);
+			node->Failed = true;
+		}
+		Release(node);
+	}
+
+	// Called when the directory has been read, or one of its subdirectories is gone.
+	// Once everything inside it is gone, remove it from its parent, and then release the parent.
+	void Release(shared_ptr<RemoveNode> node) {
+		while (node && --node->Pending == 0) {
+			close(node->Fd);
+			node->Fd    = -1;
+			auto parent = node->Parent;
+			if (!node->Failed) {
+				int r = parent ? unlinkat(parent->Fd, node->Name(), AT_REMOVEDIR) : rmdir(node->Path.c_str());
+				if (r != 0 && errno != ENOENT) {
+					Fail(node->Path, ErrorFrom_errno(errno));
+					node->Failed = true;
+				}
+			}
+			if (node->Failed && parent)
+				parent->Failed = true;
+			node = parent;
+		}
+	}
+};
+
+BMHPAL_API Error RemoveAll(const std::string& path, const WalkErrorFunc& onError, int nThreads) {
+	// Unlinks within a directory are serialized by the kernel, so more threads than this don't help
+	if (nThreads <= 0)
+		nThreads = std::min(std::max((int) std::thread::hardware_concurrency() * 2, 2), 16);
+
+	int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd == -1) {
+		if (errno == ENOENT)
+			return Error();
+		Error err;
+		if (errno == ENOTDIR || errno == ELOOP) {
+			// path is a file, or a symbolic link
+			if (unlink(path.c_str()) == 0 || errno == ENOENT)
+				return Error();
+			err = ErrorFrom_errno(errno);
+		} else {
+			err = ErrorFrom_errno(errno);
+		}
+		if (onError)
+			onError(path, err);
+		return Error::Fmt("%v: %v", path, err.Message());
+	}
+
+	RemoveWorker w(onError);
+	auto         root = make_shared<RemoveNode>();
+	root->Fd          = fd;
+	root->Path        = path;
+	while (root->Path.size() > 1 && root->Path.back() == '/')
+		root->Path.pop_back();
+
+	// Read the root on this thread, so that we don't start threads for a directory that has no subdirectories
+	{
+		vector<char> buf(64 * 1024);
+		w.ReadDir(root, buf, w.Stack);
+		root = nullptr;
+	}
+
+	vector<thread> threads;
+	if (!w.Stack.empty()) {
+		for (int i = 1; i < nThreads; i++)
+			threads.push_back(thread([&w]() { w.Run(); }));
+	}
+	w.Run();
+	for (auto& t : threads)
+		t.join();
+	return w.FirstErr;
+}
+
+#endif
+
+} // namespace os
+} // namespace bmhpal
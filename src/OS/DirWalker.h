@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include "../Error/Error.h"
+#include "OS.h"
+
+namespace bmhpal {
+namespace os {
+
+/*
+
+	Recursive directory walker
+	==========================
+
+	WalkDir visits every entry below a directory, streaming each one to a callback as soon as it
+	is read, instead of collecting everything into a vector the way FindFiles does.
+
+	On Linux, directories are read with getdents64 into a large buffer, and subdirectories are opened
+	with openat relative to their parent's fd, so the kernel never has to resolve a full path. The type
+	of each entry comes from d_type, so no stat is needed unless you ask for one with WalkEntry::Stat,
+	which does an fstatat relative to the parent. Directories are fanned out over a pool of threads,
+	which keeps many directory reads in flight at once. That is what makes a walk of a cold tree fast.
+	On other platforms the walk is single threaded, and built on FindFiles.
+
+	The callback is run concurrently from all of the walker's threads, so it must be thread safe.
+	Entries within a directory are delivered in the order that the OS returns them, and the order
+	of directories is not defined. The callback's return value decides whether to descend into a
+	directory, and can stop the walk early.
+
+	Symbolic links are reported, but never followed.
+
+	RemoveAll uses the same machinery to delete a tree. A directory is removed by whichever thread
+	finishes the last of its subdirectories.
+
+	*/
+
+enum class WalkAction {
+	Continue, // Keep walking, and descend into this entry if it's a directory
+	Skip,     // Don't descend into this directory
+	Stop,     // Stop the walk as soon as possible
+};
+
+class BMHPAL_API WalkEntry {
+public:
+	std::string Path;             // Full path of the entry. This is reused between callbacks, so copy it if you need to keep it.
+	const char* Name      = "";   // The final component of Path
+	int         Depth     = 0;    // Zero for the entries directly inside the root
+	bool        IsDir     = false;
+	bool        IsSymlink = false;
+
+	Error Stat(FileAttributes& attribs) const; // Stat the entry, without following a symbolic link
+
+private:
+	friend struct WalkWorker;
+	int DirFd = -1;
+};
+
+typedef std::function<WalkAction(const WalkEntry& entry)>         WalkFunc;
+typedef std::function<void(const std::string& path, Error err)> WalkErrorFunc;
+
+// Visit everything below root (but not root itself).
+// nThreads is the number of threads to use. If zero, then we use two threads per core.
+// If onError is not null, then it receives every directory that could not be read, and the walk carries on.
+// If onError is null, then the walk stops at the first error, and returns it.
+BMHPAL_API Error WalkDir(const std::string& root, const WalkFunc& visit, int nThreads = 0, const WalkErrorFunc& onError = nullptr);
+
+// Delete path, and everything below it. Succeeds if path doesn't exist.
+// Subtrees are deleted in parallel, with unlinkat relative to each directory's fd.
+// Removal carries on past errors. If onError is not null, then it receives every path that
+// could not be removed (from any thread). The first error is returned.
+// nThreads is the maximum number of threads to use. If zero, then we use two threads per core, up to 16.
+// Threads are only started if path contains subdirectories.
+BMHPAL_API Error RemoveAll(const std::string& path, const WalkErrorFunc& onError, int nThreads = 0);
+
+} // namespace os
+} // namespace bmhpal
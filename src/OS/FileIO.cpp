@@ -0,0 +1,445 @@
+#include "pch.h"
+#include "FileIO.h"
+#include "OS.h"
+#include "../Text/ConvertUTF.h"
+#include "../Math_.h"
+
+#ifdef BMHPAL_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace bmhpal {
+namespace os {
+
+// Alignment of buffers, file offsets and transfer sizes for O_DIRECT. This is a multiple of every common logical block size.
+static const size_t Align = 4096;
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+static int   sys_read(int fd, void* buf, size_t len) { return _read(fd, buf, (unsigned) std::min(len, (size_t) 1 << 30)); }
+static int   sys_close(int fd) { return _close(fd); }
+static int   sys_fsync(int fd) { return _commit(fd); }
+static void* AlignedAlloc(size_t len) {
+	void* p = _aligned_malloc(len, Align);
+	if (!p)
+		BMHPAL_DIE_MSG("Out of memory");
+	return p;
+}
+static void AlignedFree(void* p) { _aligned_free(p); }
+#else
+static ssize_t sys_read(int fd, void* buf, size_t len) { return read(fd, buf, std::min(len, (size_t) 1 << 30)); }
+static int     sys_close(int fd) { return close(fd); }
+static int     sys_fsync(int fd) { return fsync(fd); }
+static void*   AlignedAlloc(size_t len) {
+	void* p = nullptr;
+	if (posix_memalign(&p, Align, len) != 0)
+		BMHPAL_DIE_MSG("Out of memory");
+	return p;
+}
+static void AlignedFree(void* p) { free(p); }
+#endif
+
+static size_t RoundUp(size_t v) {
+	return (v + Align - 1) & ~(Align - 1);
+}
+
+#ifdef BMHPAL_SSE2
+// Returns a bit for every '\n' in the 64 bytes at p
+static inline uint64_t NewlineMask(const char* p) {
+	const __m128i nl = _mm_set1_epi8('\n');
+	uint64_t      m0 = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) p), nl));
+	uint64_t      m1 = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (p + 16)), nl));
+	uint64_t      m2 = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (p + 32)), nl));
+	uint64_t      m3 = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (p + 48)), nl));
+	return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FileReader
+
+FileReader::FileReader(size_t bufferSize) {
+	BufSize = RoundUp(std::max(bufferSize, Align));
+}
+
+FileReader::~FileReader() {
+	Close();
+	AlignedFree(Buf);
+}
+
+Error FileReader::Open(const std::string& filename, FileFlags flags) {
+	Close();
+	bool direct = !!(flags & FileFlags::Direct);
+	int  fd     = -1;
+#ifdef BMHPAL_PLATFORM_WINDOWS
+	direct = false;
+	fd     = _wopen(WideString(filename).c_str(), _O_RDONLY | _O_BINARY);
+#else
+#ifdef O_DIRECT
+	if (direct) {
+		fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+		if (fd == -1 && errno != EINVAL)
+			return ErrorFrom_errno(errno);
+	}
+#endif
+	if (fd == -1) {
+		direct = false;
+		fd     = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	}
+#endif
+	if (fd == -1)
+		return ErrorFrom_errno(errno);
+#ifdef BMHPAL_PLATFORM_LINUX
+	// Double the kernel's readahead window
+	if (!direct)
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	Attach(fd, true);
+	Direct = direct;
+	return Error();
+}
+
+void FileReader::Attach(int fd, bool takeOwnership) {
+	Close();
+	Fd    = fd;
+	OwnFd = takeOwnership;
+}
+
+void FileReader::Close() {
+	if (Fd != -1 && OwnFd)
+		sys_close(Fd);
+	Fd       = -1;
+	OwnFd    = false;
+	Direct   = false;
+	AtEOF    = false;
+	Start    = 0;
+	End      = 0;
+	Consumed = 0;
+	HaveMask = false;
+}
+
+// Read more data into the buffer, keeping the unconsumed bytes. Returns ErrEOF if there is nothing more to read.
+Error FileReader::Fill() {
+	if (Fd == -1)
+		return Error("File is not open");
+	if (AtEOF)
+		return ErrEOF;
+	if (!Buf)
+		Buf = (char*) AlignedAlloc(BufSize);
+
+	// Move the unconsumed bytes to the front. With O_DIRECT, the read must land on an aligned address,
+	// so we place them just before the first aligned position.
+	size_t keep = End - Start;
+	size_t dst  = Direct ? RoundUp(keep) - keep : 0;
+	if (Start != dst) {
+		memmove(Buf + dst, Buf + Start, keep);
+		Start    = dst;
+		End      = dst + keep;
+		HaveMask = false;
+	}
+
+	// A single line is longer than the buffer
+	if (BufSize - End < Align) {
+		size_t newSize = BufSize * 2;
+		char*  newBuf  = (char*) AlignedAlloc(newSize);
+		memcpy(newBuf, Buf, End);
+		AlignedFree(Buf);
+		Buf     = newBuf;
+		BufSize = newSize;
+	}
+
+	size_t want = BufSize - End;
+	if (Direct)
+		want &= ~(Align - 1);
+	while (true) {
+		auto n = sys_read(Fd, Buf + End, want);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return ErrorFrom_errno(errno);
+		}
+		// With O_DIRECT, we can't issue another read after a short one, because the file offset is no longer aligned
+		if (n == 0 || (Direct && (size_t) n < want))
+			AtEOF = true;
+		End += n;
+		return n == 0 ? ErrEOF : Error();
+	}
+}
+
+size_t FileReader::FindNewline(size_t from) {
+	size_t i = from;
+#ifdef BMHPAL_SSE2
+	// Reuse the mask from the previous call, if it covers from
+	if (HaveMask && from >= MaskPos && from < MaskPos + 64) {
+		uint64_t m = Mask & (~(uint64_t) 0 << (from - MaskPos));
+		if (m != 0)
+			return MaskPos + CountTrailingZeros64(m);
+		i = MaskPos + 64;
+	}
+	HaveMask = false;
+	for (; i + 64 <= End; i += 64) {
+		uint64_t m = NewlineMask(Buf + i);
+		if (m != 0) {
+			MaskPos  = i;
+			Mask     = m;
+			HaveMask = true;
+			return i + CountTrailingZeros64(m);
+		}
+	}
+#endif
+	const char* p = (const char*) memchr(Buf + i, '\n', End - i);
+	return p ? (size_t) (p - Buf) : End;
+}
+
+Error FileReader::Read(void* buf, size_t len, size_t& n) {
+	n = 0;
+	while (n < len) {
+		if (Start == End) {
+			if (AtEOF)
+				break;
+			if (!Direct && len - n >= BufSize && Fd != -1) {
+				// Large reads go straight into the caller's buffer
+				auto r = sys_read(Fd, (char*) buf + n, len - n);
+				if (r == -1) {
+					if (errno == EINTR)
+						continue;
+					Consumed += n;
+					return ErrorFrom_errno(errno);
+				}
+				if (r == 0)
+					AtEOF = true;
+				n += r;
+				continue;
+			}
+			auto err = Fill();
+			if (err == ErrEOF)
+				break;
+			if (!err.OK()) {
+				Consumed += n;
+				return err;
+			}
+			continue;
+		}
+		size_t c = std::min(End - Start, len - n);
+		memcpy((char*) buf + n, Buf + Start, c);
+		Start += c;
+		n += c;
+	}
+	Consumed += n;
+	if (n == 0 && len != 0)
+		return ErrEOF;
+	return Error();
+}
+
+Error FileReader::ReadLine(strings::StringView& line) {
+	size_t from = Start;
+	while (true) {
+		size_t nl = from < End ? FindNewline(from) : End;
+		if (nl != End || (AtEOF && Start != End)) {
+			// The final line needn't end with a newline
+			size_t next = nl != End ? nl + 1 : End;
+			size_t len  = nl - Start;
+			if (len != 0 && Buf[Start + len - 1] == '\r')
+				len--;
+			line = strings::StringView(Buf + Start, len);
+			Consumed += next - Start;
+			Start = next;
+			return Error();
+		}
+		if (AtEOF)
+			return ErrEOF;
+		// Don't scan the same bytes again after refilling
+		size_t scanned = End - Start;
+		auto   err     = Fill();
+		if (!err.OK() && err != ErrEOF)
+			return err;
+		from = Start + scanned;
+	}
+}
+
+Error FileReader::ReadLine(std::string& line) {
+	strings::StringView v;
+	auto                err = ReadLine(v);
+	if (err.OK())
+		line.assign(v.data(), v.size());
+	return err;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// FileWriter
+
+FileWriter::FileWriter(size_t bufferSize) {
+	BufSize = RoundUp(std::max(bufferSize, Align));
+}
+
+FileWriter::~FileWriter() {
+	if (Fd != -1 && OwnFd)
+		sys_close(Fd);
+	AlignedFree(Buf);
+}
+
+Error FileWriter::Open(const std::string& filename, FileFlags flags) {
+	auto err = Close();
+	if (!err.OK())
+		return err;
+	bool append = !!(flags & FileFlags::Append);
+	bool direct = !!(flags & FileFlags::Direct) && !append;
+	int  fd     = -1;
+	if (!direct && !append) {
+		err = OpenForWrite(filename, fd);
+		if (!err.OK())
+			return err;
+	} else {
+#ifdef BMHPAL_PLATFORM_WINDOWS
+		direct = false;
+		fd     = _wopen(WideString(filename).c_str(), _O_CREAT | _O_WRONLY | _O_BINARY | (append ? _O_APPEND : _O_TRUNC), _S_IREAD | _S_IWRITE);
+#else
+		int oflags = O_CREAT | O_WRONLY | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+#ifdef O_DIRECT
+		if (direct) {
+			fd = open(filename.c_str(), oflags | O_DIRECT, 0644);
+			if (fd == -1 && errno != EINVAL)
+				return ErrorFrom_errno(errno);
+		}
+#endif
+		if (fd == -1) {
+			direct = false;
+			fd     = open(filename.c_str(), oflags, 0644);
+		}
+#endif
+		if (fd == -1)
+			return ErrorFrom_errno(errno);
+	}
+	Attach(fd, true);
+	Direct = direct;
+	return Error();
+}
+
+void FileWriter::Attach(int fd, bool takeOwnership) {
+	Close();
+	Fd    = fd;
+	OwnFd = takeOwnership;
+}
+
+Error FileWriter::Close() {
+	if (Fd == -1)
+		return Error();
+	auto err = Flush();
+#if defined(O_DIRECT) && !defined(BMHPAL_PLATFORM_WINDOWS)
+	if (err.OK() && Direct && Len != 0) {
+		// The final partial block can't be written with O_DIRECT
+		fcntl(Fd, F_SETFL, fcntl(Fd, F_GETFL) & ~O_DIRECT);
+		err = WriteBuffer(Len, nullptr, 0);
+	}
+#endif
+	if (OwnFd && sys_close(Fd) != 0 && err.OK())
+		err = ErrorFrom_errno(errno);
+	Fd      = -1;
+	OwnFd   = false;
+	Direct  = false;
+	Len     = 0;
+	Written = 0;
+	Err     = Error();
+	return err;
+}
+
+// Write the first len bytes of Buf, followed by extra
+Error FileWriter::WriteBuffer(size_t len, const void* extra, size_t extraLen) {
+#ifdef BMHPAL_PLATFORM_WINDOWS
+	auto err = WriteAll(Fd, Buf, len);
+	if (err.OK())
+		err = WriteAll(Fd, extra, extraLen);
+	if (!err.OK())
+		return err;
+#else
+	struct iovec iov[2];
+	iov[0].iov_base = Buf;
+	iov[0].iov_len  = len;
+	iov[1].iov_base = (void*) extra;
+	iov[1].iov_len  = extraLen;
+	int first       = len == 0 ? 1 : 0;
+	int count       = extraLen == 0 ? 1 : 2;
+	while (first < count) {
+		auto n = writev(Fd, iov + first, count - first);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return ErrorFrom_errno(errno);
+		}
+		// Skip over what was written, which may end partway through an iovec
+		for (; first < count && (size_t) n >= iov[first].iov_len; first++)
+			n -= iov[first].iov_len;
+		if (first < count) {
+			iov[first].iov_base = (char*) iov[first].iov_base + n;
+			iov[first].iov_len -= n;
+		}
+	}
+#endif
+	if (len != Len)
+		memmove(Buf, Buf + len, Len - len);
+	Len -= len;
+	Written += len + extraLen;
+	return Error();
+}
+
+Error FileWriter::Write(const void* buf, size_t len) {
+	if (!Err.OK())
+		return Err;
+	if (Fd == -1)
+		return Error("File is not open");
+	if (!Buf)
+		Buf = (char*) AlignedAlloc(BufSize);
+	if (Len + len <= BufSize) {
+		memcpy(Buf + Len, buf, len);
+		Len += len;
+		return Error();
+	}
+	if (!Direct) {
+		Err = WriteBuffer(Len, buf, len);
+		return Err;
+	}
+	// O_DIRECT needs aligned memory, so everything goes through our buffer
+	while (len != 0) {
+		size_t c = std::min(BufSize - Len, len);
+		memcpy(Buf + Len, buf, c);
+		Len += c;
+		(const char*&) buf += c;
+		len -= c;
+		if (Len == BufSize) {
+			Err = WriteBuffer(Len, nullptr, 0);
+			if (!Err.OK())
+				return Err;
+		}
+	}
+	return Error();
+}
+
+Error FileWriter::Flush() {
+	if (!Err.OK() || Fd == -1)
+		return Err;
+	size_t n = Direct ? Len & ~(Align - 1) : Len;
+	if (n != 0)
+		Err = WriteBuffer(n, nullptr, 0);
+	return Err;
+}
+
+Error FileWriter::Sync() {
+	auto err = Flush();
+	if (!err.OK())
+		return err;
+	if (Fd != -1 && sys_fsync(Fd) != 0)
+		return ErrorFrom_errno(errno);
+	return Error();
+}
+
+} // namespace os
+} // namespace bmhpal
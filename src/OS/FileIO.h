@@ -0,0 +1,115 @@
+#pragma once
+
+#include "../Error/Error.h"
+#include "../Error/CommonErrors.h"
+#include "../Text/StringView.h"
+
+namespace bmhpal {
+namespace os {
+
+/*
+
+	Buffered file streams
+	=====================
+
+	FileReader and FileWriter stream a file through a fixed size buffer, so that you can process files
+	that are larger than memory, or produce a file incrementally, without writing fd code yourself.
+
+	FileReader::ReadLine finds newlines 64 bytes at a time with SSE2, and remembers the mask of newlines
+	that it found, so reading many short lines costs roughly one vector compare per 64 bytes. A line may
+	be longer than the buffer, in which case the buffer grows to hold it. The view returned by ReadLine
+	is only valid until the next call on the reader.
+
+	FileWriter copies small writes into its buffer. When a write doesn't fit, the buffer and the new data
+	are sent to the OS together with writev, so large writes are never copied.
+
+	Direct opens the file with O_DIRECT, which bypasses the page cache. This is useful for streaming
+	datasets that are much larger than RAM, and which would otherwise evict everything else from the cache.
+	Buffers are always aligned for O_DIRECT. If the filesystem doesn't support O_DIRECT (eg tmpfs), then
+	we silently open the file normally. Direct is ignored on platforms other than Linux.
+
+	Both classes are closed by their destructors, but FileWriter's destructor does not flush, so you
+	must call Close() yourself, so that you can see the error.
+
+	*/
+
+enum class FileFlags {
+	None   = 0,
+	Direct = 1, // O_DIRECT
+	Append = 2, // FileWriter appends to an existing file, instead of truncating it. Direct is ignored when appending.
+};
+inline FileFlags operator|(FileFlags a, FileFlags b) {
+	return FileFlags((uint32_t) a | (uint32_t) b);
+}
+inline uint32_t operator&(FileFlags a, FileFlags b) {
+	return (uint32_t) a & (uint32_t) b;
+}
+
+class BMHPAL_API FileReader {
+public:
+	FileReader(size_t bufferSize = 1024 * 1024);
+	~FileReader();
+	FileReader(const FileReader&) = delete;
+	FileReader& operator=(const FileReader&) = delete;
+
+	Error Open(const std::string& filename, FileFlags flags = FileFlags::None);
+	void  Attach(int fd, bool takeOwnership); // Read from an existing fd, such as stdin
+	void  Close();
+
+	Error    Read(void* buf, size_t len, size_t& n); // Read up to len bytes. n is less than len only at EOF. Returns ErrEOF if n is zero.
+	Error    ReadLine(strings::StringView& line);    // Line excludes the trailing \n or \r\n. Returns ErrEOF when there are no more lines.
+	Error    ReadLine(std::string& line);            // Same as above, but copies the line
+	uint64_t Position() const { return Consumed; }   // Number of bytes that have been returned by Read and ReadLine
+
+private:
+	int      Fd       = -1;
+	bool     OwnFd    = false;
+	bool     Direct   = false;
+	bool     AtEOF    = false;
+	char*    Buf      = nullptr;
+	size_t   BufSize  = 0;
+	size_t   Start    = 0; // Unconsumed data is Buf[Start..End)
+	size_t   End      = 0;
+	uint64_t Consumed = 0;
+
+	// Newlines in the 64 bytes starting at Buf[MaskPos]. Bits for positions before Start have been cleared.
+	size_t   MaskPos  = 0;
+	uint64_t Mask     = 0;
+	bool     HaveMask = false;
+
+	Error  Fill();
+	size_t FindNewline(size_t from); // Returns the index in Buf of the next '\n' at or after from, or End if there is none
+};
+
+class BMHPAL_API FileWriter {
+public:
+	FileWriter(size_t bufferSize = 1024 * 1024);
+	~FileWriter(); // Closes the file, but does not flush
+	FileWriter(const FileWriter&) = delete;
+	FileWriter& operator=(const FileWriter&) = delete;
+
+	Error Open(const std::string& filename, FileFlags flags = FileFlags::None);
+	void  Attach(int fd, bool takeOwnership); // Write to an existing fd, such as stdout
+	Error Close();                            // Flush, and close the file
+
+	Error    Write(const void* buf, size_t len);
+	Error    Write(strings::StringView s) { return Write(s.data(), s.size()); }
+	Error    Flush();                                   // With Direct, only whole blocks are written, and the final partial block is written by Close
+	Error    Sync();                                    // Flush, and then fsync
+	uint64_t Position() const { return Written + Len; } // Number of bytes that have been passed to Write
+
+private:
+	int      Fd      = -1;
+	bool     OwnFd   = false;
+	bool     Direct  = false;
+	char*    Buf     = nullptr;
+	size_t   BufSize = 0;
+	size_t   Len     = 0; // Bytes in Buf
+	uint64_t Written = 0; // Bytes that have been written to the file
+	Error    Err;         // Once a write fails, every subsequent call fails with the same error
+
+	Error WriteBuffer(size_t len, const void* extra, size_t extraLen);
+};
+
+} // namespace os
+} // namespace bmhpal
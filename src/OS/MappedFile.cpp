@@ -0,0 +1,279 @@
+#include "pch.h"
+#include "MappedFile.h"
+#include "OS.h"
+
+#ifndef BMHPAL_PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bmhpal {
+namespace os {
+
+const size_t MappedFile::ToEnd;
+
+MappedFile::MappedFile() {
+}
+
+MappedFile::~MappedFile() {
+	Close();
+}
+
+MappedFile::MappedFile(MappedFile&& m) {
+	*this = std::move(m);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& m) {
+	if (this != &m) {
+		Close();
+		Len    = m.Len;
+		Off    = m.Off;
+		Map    = m.Map;
+		MapLen = m.MapLen;
+		Fd     = m.Fd;
+		Flags  = m.Flags;
+		Opened = m.Opened;
+		Buf    = std::move(m.Buf);
+		// Ptr points into Buf when we're not mapped, and moving a short string copies its bytes
+		if (Map)
+			Ptr = m.Ptr;
+		else
+			Ptr = Len != 0 ? &Buf[0] : (char*) "";
+		m.Map = nullptr;
+		m.Fd  = -1;
+		m.Reset();
+	}
+	return *this;
+}
+
+void MappedFile::Reset() {
+	Ptr    = (char*) "";
+	Len    = 0;
+	Off    = 0;
+	Map    = nullptr;
+	MapLen = 0;
+	Fd     = -1;
+	Flags  = MapFlags::None;
+	Opened = false;
+	Buf.clear();
+	Buf.shrink_to_fit();
+}
+
+Error MappedFile::Open(const std::string& filename, MapFlags flags, uint64_t offset, size_t len) {
+	auto err = Close();
+	if (!err.OK())
+		return err;
+	bool rw = !!(flags & MapFlags::ReadWrite);
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+	if (rw)
+		return Error("MappedFile: ReadWrite is not supported on Windows");
+	err = ReadFile(filename, Buf);
+	if (!err.OK())
+		return err;
+	if (offset >= Buf.size())
+		Buf.clear();
+	else
+		Buf.erase(0, (size_t) offset);
+	if (len < Buf.size())
+		Buf.resize(len);
+	Off    = offset;
+	Len    = Buf.size();
+	Ptr    = Len != 0 ? &Buf[0] : (char*) "";
+	Flags  = flags;
+	Opened = true;
+	return Error();
+#else
+	int fd = open(filename.c_str(), rw ? O_RDWR : O_RDONLY);
+	if (fd == -1)
+		return ErrorFrom_errno(errno);
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		auto e = errno;
+		close(fd);
+		return ErrorFrom_errno(e);
+	}
+	Off   = offset;
+	Flags = flags;
+
+	// Clip the range to the end of the file. Files in /proc claim to have zero size, so we treat them like pipes.
+	uint64_t fileSize  = (uint64_t) st.st_size;
+	bool     knownSize = S_ISREG(st.st_mode) && fileSize != 0;
+	if (knownSize)
+		len = offset >= fileSize ? 0 : (size_t) std::min((uint64_t) len, fileSize - offset);
+
+	if (knownSize && len != 0 && !(flags & MapFlags::NoMap)) {
+		// mmap needs a page aligned offset, so we map a little bit extra at the start
+		uint64_t page   = (uint64_t) sysconf(_SC_PAGESIZE);
+		uint64_t start  = offset & ~(page - 1);
+		size_t   mapLen = (size_t) (offset - start) + len;
+		int      mflags = rw ? MAP_SHARED : MAP_PRIVATE;
+#ifdef MAP_POPULATE
+		if (!!(flags & MapFlags::Populate))
+			mflags |= MAP_POPULATE;
+#endif
+		void* m = mmap(nullptr, mapLen, rw ? PROT_READ | PROT_WRITE : PROT_READ, mflags, fd, (off_t) start);
+		if (m != MAP_FAILED) {
+			Map    = m;
+			MapLen = mapLen;
+			Ptr    = (char*) m + (offset - start);
+			Len    = len;
+		}
+	}
+
+	if (!Map && len != 0) {
+		// Either we were asked not to map, or mmap isn't supported for this file
+		err = ReadRange(fd, knownSize, len);
+		if (!err.OK()) {
+			close(fd);
+			Reset();
+			return err;
+		}
+		if (rw) {
+			Fd = fd;
+			fd = -1;
+		}
+	}
+
+	if (fd != -1)
+		close(fd);
+	Opened = true;
+	return Error();
+#endif
+}
+
+Error MappedFile::ReadRange(int fd, bool knownSize, size_t len) {
+#ifdef BMHPAL_PLATFORM_WINDOWS
+	return Error();
+#else
+	if (knownSize) {
+		Buf.resize(len);
+		size_t pos = 0;
+		while (pos < len) {
+			auto n = pread(fd, &Buf[pos], std::min(len - pos, (size_t) 1 << 30), (off_t) (Off + pos));
+			if (n == -1) {
+				if (errno == EINTR)
+					continue;
+				return ErrorFrom_errno(errno);
+			}
+			if (n == 0)
+				break; // The file was truncated after we measured it
+			pos += n;
+		}
+		Buf.resize(pos);
+	} else {
+		// The size of a pipe or a /proc file is unknown, so we read until EOF, discarding everything before Off
+		char     tmp[4096];
+		uint64_t skip = Off;
+		while (Buf.size() < len) {
+			auto n = read(fd, tmp, sizeof(tmp));
+			if (n == -1) {
+				if (errno == EINTR)
+					continue;
+				return ErrorFrom_errno(errno);
+			}
+			if (n == 0)
+				break;
+			size_t start = (size_t) std::min(skip, (uint64_t) n);
+			skip -= start;
+			Buf.append(tmp + start, std::min((size_t) n - start, len - Buf.size()));
+		}
+	}
+	Len = Buf.size();
+	Ptr = Len != 0 ? &Buf[0] : (char*) "";
+	return Error();
+#endif
+}
+
+Error MappedFile::WriteBack() {
+#ifdef BMHPAL_PLATFORM_WINDOWS
+	return Error();
+#else
+	size_t pos = 0;
+	while (pos < Len) {
+		auto n = pwrite(Fd, Ptr + pos, std::min(Len - pos, (size_t) 1 << 30), (off_t) (Off + pos));
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			return ErrorFrom_errno(errno);
+		}
+		pos += n;
+	}
+	return Error();
+#endif
+}
+
+Error MappedFile::Close() {
+	Error err;
+#ifndef BMHPAL_PLATFORM_WINDOWS
+	if (Map) {
+		if (munmap(Map, MapLen) != 0)
+			err = ErrorFrom_errno(errno);
+	} else if (Fd != -1) {
+		err = WriteBack();
+		if (close(Fd) != 0 && err.OK())
+			err = ErrorFrom_errno(errno);
+	}
+#endif
+	Reset();
+	return err;
+}
+
+Error MappedFile::Advise(MapAdvice advice, size_t offset, size_t len) {
+#ifdef BMHPAL_PLATFORM_WINDOWS
+	return Error();
+#else
+	if (!Map || offset >= Len)
+		return Error();
+	len = std::min(len, Len - offset);
+
+	// madvise needs a page aligned address
+	uintptr_t page  = (uintptr_t) sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t) (Ptr + offset) & ~(page - 1);
+	uintptr_t end   = (uintptr_t) (Ptr + offset + len);
+
+	int adv = MADV_NORMAL;
+	switch (advice) {
+	case MapAdvice::Normal: adv = MADV_NORMAL; break;
+	case MapAdvice::Sequential: adv = MADV_SEQUENTIAL; break;
+	case MapAdvice::Random: adv = MADV_RANDOM; break;
+	case MapAdvice::WillNeed: adv = MADV_WILLNEED; break;
+	case MapAdvice::DontNeed: adv = MADV_DONTNEED; break;
+	case MapAdvice::HugePages:
+#ifdef MADV_HUGEPAGE
+		adv = MADV_HUGEPAGE;
+		break;
+#else
+		return Error("MappedFile: HugePages is not supported on this platform");
+#endif
+	}
+	if (madvise((void*) start, end - start, adv) != 0)
+		return ErrorFrom_errno(errno);
+	return Error();
+#endif
+}
+
+Error MappedFile::Sync(bool wait) {
+#ifdef BMHPAL_PLATFORM_WINDOWS
+	return Error();
+#else
+	if (Map) {
+		if (!(Flags & MapFlags::ReadWrite))
+			return Error();
+		if (msync(Map, MapLen, wait ? MS_SYNC : MS_ASYNC) != 0)
+			return ErrorFrom_errno(errno);
+	} else if (Fd != -1) {
+		auto err = WriteBack();
+		if (!err.OK())
+			return err;
+		if (wait && fsync(Fd) != 0)
+			return ErrorFrom_errno(errno);
+	}
+	return Error();
+#endif
+}
+
+} // namespace os
+} // namespace bmhpal
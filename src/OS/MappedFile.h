@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../Error/Error.h"
+
+namespace bmhpal {
+namespace os {
+
+/*
+
+	Memory mapped files
+	===================
+
+	MappedFile maps a file, or a range of a file, into memory. Unlike ReadFile, nothing is copied up front.
+	Pages are read in by the OS as they are touched, and they live in the page cache, so they don't count
+	against our private memory, and they can be shared between processes that map the same file.
+
+	If the file can't be mapped (for example /proc files, pipes, or filesystems that don't support mmap),
+	then Open falls back to reading the range into a private buffer. Data() works the same in both cases,
+	and IsMapped() tells you which one you got. In the fallback case, changes to a ReadWrite file are
+	written back by Sync() or Close().
+
+	On Windows we currently always use the fallback, and ReadWrite is not supported.
+
+	*/
+
+enum class MapFlags {
+	None      = 0,
+	ReadWrite = 1, // Map the file with PROT_WRITE and MAP_SHARED, so that changes are written back to the file
+	Populate  = 2, // Read the whole range in during Open (MAP_POPULATE), instead of faulting pages in on demand
+	NoMap     = 4, // Always read the range into a buffer. This is mostly useful for testing.
+};
+inline MapFlags operator|(MapFlags a, MapFlags b) {
+	return MapFlags((uint32_t) a | (uint32_t) b);
+}
+inline uint32_t operator&(MapFlags a, MapFlags b) {
+	return (uint32_t) a & (uint32_t) b;
+}
+
+// Hints for madvise. These are ignored when the file is not mapped.
+enum class MapAdvice {
+	Normal,
+	Sequential, // Aggressive readahead, and pages can be dropped soon after they are read
+	Random,     // No readahead
+	WillNeed,   // Start reading the range in now
+	DontNeed,   // We're finished with the range for now
+	HugePages,  // Back the range with transparent huge pages, where the kernel supports it for this kind of file
+};
+
+class BMHPAL_API MappedFile {
+public:
+	static const size_t ToEnd = (size_t) -1;
+
+	MappedFile();
+	~MappedFile();
+	MappedFile(MappedFile&& m);
+	MappedFile& operator=(MappedFile&& m);
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Map len bytes, starting at offset. The range is clipped to the end of the file.
+	// offset does not need to be page aligned.
+	Error Open(const std::string& filename, MapFlags flags = MapFlags::None, uint64_t offset = 0, size_t len = ToEnd);
+	Error Close();                                                          // Unmap, and write back changes if this is a ReadWrite fallback buffer
+	Error Advise(MapAdvice advice, size_t offset = 0, size_t len = ToEnd); // offset and len are relative to Data()
+	Error Sync(bool wait = true);                                           // Flush changes to disk. If wait is false, then just schedule the writes.
+
+	const char* Data() const { return Ptr; }                // Never null, even when Size() is zero
+	char*       MutableData() { return Ptr; }               // Only valid for ReadWrite
+	size_t      Size() const { return Len; }
+	uint64_t    Offset() const { return Off; }              // Offset of Data() within the file
+	bool        IsOpen() const { return Opened; }
+	bool        IsMapped() const { return Map != nullptr; } // False if we fell back to reading the file into a buffer
+
+private:
+	char*       Ptr    = (char*) "";
+	size_t      Len    = 0;
+	uint64_t    Off    = 0;
+	void*       Map    = nullptr; // Start of the page aligned mapping, which can be before Ptr
+	size_t      MapLen = 0;
+	std::string Buf;              // Fallback buffer
+	int         Fd     = -1;      // Kept open for writing back a ReadWrite fallback buffer
+	MapFlags    Flags  = MapFlags::None;
+	bool        Opened = false;
+
+	Error ReadRange(int fd, bool knownSize, size_t len);
+	Error WriteBack();
+	void  Reset();
+};
+
+} // namespace os
+} // namespace bmhpal
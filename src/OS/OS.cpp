@@ -1,22 +1,33 @@
 #include "pch.h"
 #include "OS.h"
+#include "AsyncIO.h"
+#include "DirWalker.h"
+#include "SyncGroup.h"
 #include "../Path.h"
 #include "../Text/ConvertUTF.h"
 #include "../Text/StringUtils.h"
+#include "../Text/Wildcard.h"
+#include <atomic>
 
 #ifdef _WIN32
 #include <intsafe.h>
 #include <io.h>
+#include <process.h>
 #else
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <spawn.h>
 #include <unistd.h>
+extern char** environ;
 #endif
 #include <fcntl.h>
 
 #if defined(BMHPAL_PLATFORM_LINUX)
 #include <sys/time.h>
 #include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
 #include <dirent.h>
 #endif
 
@@ -150,6 +161,12 @@ static double FileTimeToUnix(const FILETIME& ft) {
 	t -= SecondsFrom1601To1970 * (int64_t) 10000000;
 	return (double) t / 10000000.0;
 }
+
+static int64_t FileTimeToUnixNano(const FILETIME& ft) {
+	auto t = FileTimeTo100NanoSeconds(ft);
+	t -= SecondsFrom1601To1970 * (int64_t) 10000000;
+	return t * 100;
+}
 #endif
 
 BMHPAL_API void Sleep(time::Duration d) {
@@ -182,7 +199,7 @@ BMHPAL_API bool MkDir(const std::string& dir, MkDirFlags flags) {
 	bool existOK   = !!(flags & MkDirFlags::ExistOK);
 
 #if defined(BMHPAL_PLATFORM_WINDOWS)
-	auto err = _wmkdir(towide(dir).c_str());
+	auto err = _wmkdir(WideString(dir).c_str());
 	if (err == -1 && errno == EEXIST && existOK)
 		return true;
 	return err == 0;
@@ -219,10 +236,72 @@ BMHPAL_API std::string Cwd() {
 #endif
 }
 
-BMHPAL_API Error Stat(const std::string& path, FileAttributes& attribs) {
+#if defined(BMHPAL_PLATFORM_LINUX)
+static unsigned StatxMask(StatMask mask) {
+	unsigned m = 0;
+	m |= (mask & StatMask::Type) ? STATX_TYPE : 0;
+	m |= (mask & StatMask::Size) ? STATX_SIZE : 0;
+	m |= (mask & StatMask::TimeModify) ? STATX_MTIME : 0;
+	m |= (mask & StatMask::TimeCreate) ? STATX_CTIME : 0;
+	m |= (mask & StatMask::Inode) ? STATX_INO : 0;
+	m |= (mask & StatMask::NLink) ? STATX_NLINK : 0;
+	return m;
+}
+#endif
+
+#if !defined(BMHPAL_PLATFORM_WINDOWS)
+static void StatToAttributes(const struct stat& s, FileAttributes& attribs) {
+#if defined(BMHPAL_PLATFORM_APPLE)
+	const auto& ctime = s.st_ctimespec;
+	const auto& mtime = s.st_mtimespec;
+#else
+	const auto& ctime = s.st_ctim;
+	const auto& mtime = s.st_mtim;
+#endif
+	attribs.IsDir        = S_ISDIR(s.st_mode);
+	attribs.TimeCreate   = STAT_TIME(s, c);
+	attribs.TimeModify   = STAT_TIME(s, m);
+	attribs.TimeCreateNS = (int64_t) ctime.tv_sec * 1000000000 + ctime.tv_nsec;
+	attribs.TimeModifyNS = (int64_t) mtime.tv_sec * 1000000000 + mtime.tv_nsec;
+	attribs.Size         = s.st_size;
+	attribs.Inode        = s.st_ino;
+	attribs.NLink        = (uint32_t) s.st_nlink;
+}
+
+BMHPAL_API Error StatAt(int dirFd, const char* name, FileAttributes& attribs, StatMask mask, bool followSymlinks) {
+#if defined(BMHPAL_PLATFORM_LINUX)
+	// statx arrived in Linux 4.11
+	static std::atomic<bool> haveStatx(true);
+	if (haveStatx) {
+		struct statx s;
+		if (statx(dirFd, name, followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW, StatxMask(mask), &s) == 0) {
+			attribs.IsDir        = S_ISDIR(s.stx_mode);
+			attribs.TimeCreate   = s.stx_ctime.tv_sec + s.stx_ctime.tv_nsec * (1.0 / 1000000000);
+			attribs.TimeModify   = s.stx_mtime.tv_sec + s.stx_mtime.tv_nsec * (1.0 / 1000000000);
+			attribs.TimeCreateNS = (int64_t) s.stx_ctime.tv_sec * 1000000000 + s.stx_ctime.tv_nsec;
+			attribs.TimeModifyNS = (int64_t) s.stx_mtime.tv_sec * 1000000000 + s.stx_mtime.tv_nsec;
+			attribs.Size         = s.stx_size;
+			attribs.Inode        = s.stx_ino;
+			attribs.NLink        = s.stx_nlink;
+			return Error();
+		}
+		if (errno != ENOSYS)
+			return ErrorFrom_errno(errno);
+		haveStatx = false;
+	}
+#endif
+	struct stat s;
+	if (fstatat(dirFd, name, &s, followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+		return ErrorFrom_errno(errno);
+	StatToAttributes(s, attribs);
+	return Error();
+}
+#endif
+
+BMHPAL_API Error Stat(const std::string& path, FileAttributes& attribs, StatMask mask) {
 #ifdef _WIN32
 	// FILE_FLAG_BACKUP_SEMANTICS is necessary for opening a directory
-	HANDLE h = CreateFileW(towide(path).c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+	HANDLE h = CreateFileW(WideString(path).c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
 	if (h == INVALID_HANDLE_VALUE) {
 		return ErrorFrom_GetLastError(GetLastError());
 	}
@@ -231,24 +310,85 @@ BMHPAL_API Error Stat(const std::string& path, FileAttributes& attribs) {
 		CloseHandle(h);
 		return ErrorFrom_GetLastError(GetLastError());
 	}
-	attribs.IsDir      = !!(inf.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
-	attribs.TimeCreate = FileTimeToUnix(inf.ftCreationTime);
-	attribs.TimeModify = FileTimeToUnix(inf.ftLastWriteTime);
-	attribs.Size       = (uint64_t) inf.nFileSizeHigh << 32 | (uint64_t) inf.nFileSizeLow;
+	attribs.IsDir        = !!(inf.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
+	attribs.TimeCreate   = FileTimeToUnix(inf.ftCreationTime);
+	attribs.TimeModify   = FileTimeToUnix(inf.ftLastWriteTime);
+	attribs.TimeCreateNS = FileTimeToUnixNano(inf.ftCreationTime);
+	attribs.TimeModifyNS = FileTimeToUnixNano(inf.ftLastWriteTime);
+	attribs.Size         = (uint64_t) inf.nFileSizeHigh << 32 | (uint64_t) inf.nFileSizeLow;
+	attribs.Inode        = (uint64_t) inf.nFileIndexHigh << 32 | (uint64_t) inf.nFileIndexLow;
+	attribs.NLink        = inf.nNumberOfLinks;
 	CloseHandle(h);
 	return Error();
 #else
-	struct stat s;
-	if (stat(path.c_str(), &s) != 0)
-		return ErrorFrom_errno(errno);
-	attribs.IsDir      = S_ISDIR(s.st_mode);
-	attribs.TimeCreate = STAT_TIME(s, c); // st.st_mtim.tv_sec + st.st_mtim.tv_nsec * (1.0 / 1000000000);
-	attribs.TimeModify = STAT_TIME(s, m); // st.st_mtim.tv_sec + st.st_mtim.tv_nsec * (1.0 / 1000000000);
-	attribs.Size       = s.st_size;
-	return Error();
+	return StatAt(AT_FDCWD, path.c_str(), attribs, mask, true);
 #endif
 }
 
+BMHPAL_API Error StatMany(const std::vector<std::string>& paths, StatMask mask, std::vector<FileAttributes>& out, std::vector<Error>* errors, AsyncIO* aio) {
+	out.clear();
+	out.resize(paths.size());
+	vector<Error> errs(paths.size());
+
+	if (aio) {
+		for (size_t i = 0; i < paths.size(); i++) {
+			aio->Stat(paths[i], &out[i], [&errs, i](Error err, int64_t result) {
+				errs[i] = err;
+			}, mask);
+			// Don't let the queue grow without bound
+			if (aio->Outstanding() >= 4096)
+				aio->Wait(1024);
+		}
+		aio->WaitAll();
+	} else {
+#if defined(BMHPAL_PLATFORM_WINDOWS)
+		for (size_t i = 0; i < paths.size(); i++)
+			errs[i] = Stat(paths[i], out[i], mask);
+#else
+		int    dirFd  = -1;
+		size_t dirLen = 0; // Length of the directory prefix that dirFd refers to, including the trailing slash
+		size_t dirIdx = 0; // Index of a path that starts with that prefix
+		for (size_t i = 0; i < paths.size(); i++) {
+			const auto& p     = paths[i];
+			size_t      slash = p.rfind('/');
+			size_t      len   = slash + 1;
+			bool        inDir = slash != string::npos && slash != 0 && len < p.size(); // "a/" has no name to stat relative to "a"
+			if (inDir && !(dirFd != -1 && len == dirLen && p.compare(0, len, paths[dirIdx], 0, len) == 0)) {
+				if (dirFd != -1)
+					close(dirFd);
+				dirFd = -1;
+				// Opening the directory is only worthwhile if the next path is in it too
+				if (i + 1 < paths.size() && paths[i + 1].size() > len && paths[i + 1].compare(0, len, p, 0, len) == 0 && paths[i + 1].find('/', len) == string::npos) {
+#ifdef O_PATH
+					dirFd = open(p.substr(0, slash).c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+#else
+					dirFd = open(p.substr(0, slash).c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+					dirLen = len;
+					dirIdx = i;
+				}
+			}
+			if (inDir && dirFd != -1)
+				errs[i] = StatAt(dirFd, p.c_str() + len, out[i], mask, true);
+			else
+				errs[i] = StatAt(AT_FDCWD, p.c_str(), out[i], mask, true);
+		}
+		if (dirFd != -1)
+			close(dirFd);
+#endif
+	}
+
+	if (errors) {
+		*errors = std::move(errs);
+		return Error();
+	}
+	for (size_t i = 0; i < paths.size(); i++) {
+		if (!errs[i].OK())
+			return Error::Fmt("%v: %v", paths[i], errs[i].Message());
+	}
+	return Error();
+}
+
 BMHPAL_API Error FindFiles(std::string dir, std::vector<FindFileItem>& result, const std::string& wc) {
 #ifdef _WIN32
 	WIN32_FIND_DATAA fd;
@@ -274,7 +414,8 @@ BMHPAL_API Error FindFiles(std::string dir, std::vector<FindFileItem>& result, c
 	if (!d)
 		return ErrorFrom_errno(errno);
 
-	struct dirent* iter = nullptr;
+	strings::Wildcard match(wc);
+	struct dirent*    iter = nullptr;
 	while (true) {
 		FindFileItem item;
 		iter = readdir(d);
@@ -286,7 +427,7 @@ BMHPAL_API Error FindFiles(std::string dir, std::vector<FindFileItem>& result, c
 			continue;
 		if (strcmp(iter->d_name, "..") == 0)
 			continue;
-		if (!strings::MatchWildcard(iter->d_name, wc.c_str()))
+		if (!match.Match(iter->d_name))
 			continue;
 		item.IsDir    = iter->d_type == DT_DIR;
 		item.Name     = iter->d_name;
@@ -300,13 +441,13 @@ BMHPAL_API Error FindFiles(std::string dir, std::vector<FindFileItem>& result, c
 
 BMHPAL_API bool DirExists(const std::string& path) {
 	FileAttributes at;
-	auto           err = Stat(path, at);
+	auto           err = Stat(path, at, StatMask::Type);
 	return err.OK() && at.IsDir;
 }
 
 BMHPAL_API bool FileExists(const std::string& path) {
 	FileAttributes at;
-	auto           err = Stat(path, at);
+	auto           err = Stat(path, at, StatMask::Type);
 	return err.OK() && !at.IsDir;
 }
 
@@ -318,7 +459,7 @@ BMHPAL_API Error ReadFile(const std::string& filename, std::string& content, Rea
 		// Implement Stream read
 		BMHPAL_ASSERT(false);
 	}
-	HANDLE h = CreateFileW(towide(filename).c_str(), FILE_GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+	HANDLE h = CreateFileW(WideString(filename).c_str(), FILE_GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
 	if (h == INVALID_HANDLE_VALUE)
 		return ErrorFrom_GetLastError(GetLastError());
 
@@ -410,56 +551,291 @@ BMHPAL_API Error WriteFile(const std::string& filename, const std::string& buf)
 }
 
 BMHPAL_API Error WriteFile(const std::string& filename, const void* buf, size_t len) {
+	int  f;
+	auto err = OpenForWrite(filename, f);
+	if (!err.OK())
+		return err;
+	err = WriteAll(f, buf, len);
+	if (!err.OK()) {
+		close(f);
+		return err;
+	}
+	if (close(f) == -1)
+		return ErrorFrom_errno(errno);
+	return Error();
+}
+
+BMHPAL_API Error OpenForWrite(const std::string& filename, int& fd) {
 #ifdef BMHPAL_PLATFORM_WINDOWS
-	int f = _open(filename.c_str(), _O_CREAT | _O_TRUNC | _O_WRONLY | _O_BINARY, _S_IREAD | _S_IWRITE);
+	fd = _wopen(WideString(filename).c_str(), _O_CREAT | _O_TRUNC | _O_WRONLY | _O_BINARY, _S_IREAD | _S_IWRITE);
 #else
-	int f = open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+	fd = open(filename.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
 #endif
-	if (f == -1)
+	if (fd == -1)
 		return ErrorFrom_errno(errno);
-	size_t remain = len;
-	while (remain) {
-		size_t n = write(f, buf, (unsigned) remain);
+	return Error();
+}
+
+BMHPAL_API Error WriteAll(int fd, const void* buf, size_t len) {
+	while (len != 0) {
+		auto n = write(fd, buf, (unsigned) std::min(len, (size_t) 1 << 30));
 		if (n == -1) {
-			int e = errno;
-			close(f);
-			return ErrorFrom_errno(e);
+			if (errno == EINTR)
+				continue;
+			return ErrorFrom_errno(errno);
 		}
-		(char*&) buf += n;
-		remain -= n;
+		(const char*&) buf += n;
+		len -= n;
 	}
-	if (close(f) == -1)
+	return Error();
+}
+
+// Make the file's contents durable
+static Error SyncFile(int fd) {
+#if defined(BMHPAL_PLATFORM_WINDOWS)
+	if (_commit(fd) != 0)
+		return ErrorFrom_errno(errno);
+#elif defined(BMHPAL_PLATFORM_LINUX)
+	if (fdatasync(fd) != 0)
+		return ErrorFrom_errno(errno);
+#else
+	if (fsync(fd) != 0)
 		return ErrorFrom_errno(errno);
+#endif
 	return Error();
 }
 
-BMHPAL_API Error Rename(const std::string& src, const std::string& dst) {
-	if (rename(src.c_str(), dst.c_str()) == 0)
-		return Error();
-	else
+// Make the directory entries inside dir durable, such as a file that was just renamed into it
+static Error SyncDir(const std::string& dir, SyncGroup* group) {
+#if defined(BMHPAL_PLATFORM_WINDOWS)
+	// MoveFileEx with MOVEFILE_WRITE_THROUGH has already done this
+	return Error();
+#else
+	int fd = open(dir == "" ? "." : dir.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
 		return ErrorFrom_errno(errno);
+	Error err;
+	if (group)
+		err = group->Sync(fd);
+	else if (fsync(fd) != 0)
+		err = ErrorFrom_errno(errno);
+	close(fd);
+	return err;
+#endif
+}
+
+BMHPAL_API Error WriteFileAtomic(const std::string& filename, const std::string& buf, SyncGroup* group) {
+	return WriteFileAtomic(filename, buf.data(), buf.size(), group);
 }
 
-static Error RemoveFile(const std::string& path) {
+BMHPAL_API Error WriteFileAtomic(const std::string& filename, const void* buf, size_t len, SyncGroup* group) {
+	// The temporary file must be in the same directory, so that the rename doesn't cross filesystems
+	static std::atomic<uint32_t> counter(0);
 #if defined(BMHPAL_PLATFORM_WINDOWS)
-	return ::DeleteFileA(path.c_str()) ? Error() : os::ErrorFrom_GetLastError(GetLastError());
+	string tmp = tsf::fmt("%v.tmp.%v.%v", filename, _getpid(), counter++);
+	int    fd  = _wopen(WideString(tmp).c_str(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY, _S_IREAD | _S_IWRITE);
 #else
-	if (remove(path.c_str()) == 0)
-		return Error();
-	else
+	string tmp = tsf::fmt("%v.tmp.%v.%v", filename, getpid(), counter++);
+	int    fd  = open(tmp.c_str(), O_CREAT | O_EXCL | O_WRONLY | O_CLOEXEC, 0644);
+#endif
+	if (fd == -1)
 		return ErrorFrom_errno(errno);
+
+	Error err;
+#if !defined(BMHPAL_PLATFORM_WINDOWS)
+	// Keep the mode of the file that we're replacing. The mode passed to open is reduced by the umask, so set it explicitly.
+	struct stat st;
+	if (stat(filename.c_str(), &st) == 0 && fchmod(fd, st.st_mode & 07777) != 0)
+		err = ErrorFrom_errno(errno);
+#endif
+	if (err.OK())
+		err = WriteAll(fd, buf, len);
+	if (err.OK())
+		err = group ? group->Sync(fd) : SyncFile(fd);
+	if (close(fd) != 0 && err.OK())
+		err = ErrorFrom_errno(errno);
+	if (err.OK()) {
+#if defined(BMHPAL_PLATFORM_WINDOWS)
+		if (!MoveFileExW(WideString(tmp).c_str(), WideString(filename).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+			err = ErrorFrom_GetLastError(GetLastError());
+#else
+		err = Rename(tmp, filename);
+#endif
+	}
+	if (!err.OK()) {
+#if defined(BMHPAL_PLATFORM_WINDOWS)
+		_wremove(WideString(tmp).c_str());
+#else
+		remove(tmp.c_str());
 #endif
+		return err;
+	}
+	return SyncDir(path::Dir(filename), group);
 }
 
-static Error RemoveDir(const std::string& path) {
+BMHPAL_API Error Preallocate(int fd, uint64_t offset, uint64_t len) {
+#if defined(BMHPAL_PLATFORM_LINUX)
+	while (fallocate(fd, 0, (off_t) offset, (off_t) len) != 0) {
+		if (errno != EINTR)
+			return ErrorFrom_errno(errno);
+	}
+#endif
+	return Error();
+}
+
+#if !defined(BMHPAL_PLATFORM_WINDOWS)
+// Copy len bytes at offset, from src to the same offset in dst, without passing the data through userspace if possible
+static Error CopyRange(int src, int dst, uint64_t offset, uint64_t len) {
+	uint64_t end = offset + len;
+#if defined(BMHPAL_PLATFORM_LINUX)
+	// copy_file_range can share extents on filesystems like XFS and btrfs, and is done inside the kernel elsewhere.
+	// It fails with EXDEV across filesystems before Linux 5.3, and with ENOSYS or EINVAL on older kernels and some filesystems.
+	while (offset < end) {
+		loff_t  in  = (loff_t) offset;
+		loff_t  out = (loff_t) offset;
+		ssize_t n   = copy_file_range(src, &in, dst, &out, (size_t) std::min(end - offset, (uint64_t) 1 << 30), 0);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			break;
+		offset += n;
+	}
+	// sendfile writes at dst's file position
+	if (offset < end && lseek(dst, (off_t) offset, SEEK_SET) != -1) {
+		while (offset < end) {
+			off_t   in = (off_t) offset;
+			ssize_t n  = sendfile(dst, src, &in, (size_t) std::min(end - offset, (uint64_t) 1 << 30));
+			if (n == -1 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			offset += n;
+		}
+	}
+#endif
+	if (offset < end) {
+		vector<char> buf((size_t) std::min(end - offset, (uint64_t) 1024 * 1024));
+		while (offset < end) {
+			auto n = pread(src, &buf[0], (size_t) std::min(end - offset, (uint64_t) buf.size()), (off_t) offset);
+			if (n == -1) {
+				if (errno == EINTR)
+					continue;
+				return ErrorFrom_errno(errno);
+			}
+			if (n == 0)
+				return Error("File was truncated while it was being copied");
+			for (ssize_t done = 0; done < n;) {
+				auto w = pwrite(dst, &buf[done], n - done, (off_t) (offset + done));
+				if (w == -1) {
+					if (errno == EINTR)
+						continue;
+					return ErrorFrom_errno(errno);
+				}
+				done += w;
+			}
+			offset += n;
+		}
+	}
+	return Error();
+}
+
+static Error CopyFd(int src, int dst, uint64_t size) {
+#if defined(BMHPAL_PLATFORM_LINUX)
+	// A reflink shares all of the source's extents, so it's instant, and uses no extra space
+	if (ioctl(dst, FICLONE, src) == 0)
+		return Error();
+#endif
+
+	// Only copy the data segments, and leave holes where the source has them
+	uint64_t pos      = 0;
+	bool     anyHoles = false;
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+	while (pos < size) {
+		off_t data = lseek(src, (off_t) pos, SEEK_DATA);
+		if (data == -1) {
+			if (errno == ENXIO) {
+				// Nothing but a hole until EOF
+				anyHoles = true;
+				break;
+			}
+			// SEEK_DATA is not supported, so copy everything that remains
+			break;
+		}
+		off_t hole = lseek(src, data, SEEK_HOLE);
+		if (hole == -1)
+			hole = (off_t) size;
+		if ((uint64_t) data != pos)
+			anyHoles = true;
+		auto err = CopyRange(src, dst, (uint64_t) data, (uint64_t) hole - (uint64_t) data);
+		if (!err.OK())
+			return err;
+		pos = (uint64_t) hole;
+	}
+	if (anyHoles) {
+		// Extend the file over any trailing hole
+		if (ftruncate(dst, (off_t) size) != 0)
+			return ErrorFrom_errno(errno);
+		return Error();
+	}
+#endif
+	if (pos == 0)
+		Preallocate(dst, 0, size); // Reduce fragmentation. This is just a hint, so we ignore failure.
+	if (pos < size)
+		return CopyRange(src, dst, pos, size - pos);
+	return Error();
+}
+#endif
+
+BMHPAL_API Error CopyFile(const std::string& src, const std::string& dst) {
 #if defined(BMHPAL_PLATFORM_WINDOWS)
-	return ::RemoveDirectoryA(path.c_str()) ? Error() : os::ErrorFrom_GetLastError(GetLastError());
+	if (!::CopyFileW(WideString(src).c_str(), WideString(dst).c_str(), FALSE))
+		return ErrorFrom_GetLastError(GetLastError());
+	return Error();
 #else
-	if (remove(path.c_str()) == 0)
+	int sfd = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+	if (sfd == -1)
+		return ErrorFrom_errno(errno);
+	struct stat st;
+	if (fstat(sfd, &st) != 0) {
+		auto e = errno;
+		close(sfd);
+		return ErrorFrom_errno(e);
+	}
+	// Don't truncate until we know that dst is not src (or a hard link to it), otherwise we'd destroy the source
+	int dfd = open(dst.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, st.st_mode & 0777);
+	if (dfd == -1) {
+		auto e = errno;
+		close(sfd);
+		return ErrorFrom_errno(e);
+	}
+	struct stat dst_st;
+	Error       err;
+	if (fstat(dfd, &dst_st) != 0)
+		err = ErrorFrom_errno(errno);
+	else if (dst_st.st_dev == st.st_dev && dst_st.st_ino == st.st_ino)
+		err = Error::Fmt("Cannot copy %v to %v, because they are the same file", src, dst);
+	else if (ftruncate(dfd, 0) != 0)
+		err = ErrorFrom_errno(errno);
+	if (!err.OK()) {
+		close(sfd);
+		close(dfd);
+		return err;
+	}
+	err = CopyFd(sfd, dfd, (uint64_t) st.st_size);
+	close(sfd);
+	if (close(dfd) != 0 && err.OK())
+		err = ErrorFrom_errno(errno);
+	if (!err.OK())
+		remove(dst.c_str());
+	return err;
+#endif
+}
+
+BMHPAL_API Error Rename(const std::string& src, const std::string& dst) {
+	if (rename(src.c_str(), dst.c_str()) == 0)
 		return Error();
 	else
 		return ErrorFrom_errno(errno);
-#endif
 }
 
 BMHPAL_API Error Remove(const std::string& path) {
@@ -481,28 +857,7 @@ BMHPAL_API Error Remove(const std::string& path) {
 }
 
 BMHPAL_API Error RemoveAll(const std::string& path) {
-	vector<FindFileItem> items;
-	auto                 err = FindFiles(path, items);
-	if (!err.OK()) {
-		if (IsNotExist(err))
-			return Error();
-		return Error::Fmt("Error enumerating files in %v: %v", path, err.Message());
-	}
-	Error firstErr;
-	for (const auto& item : items) {
-		Error err;
-		if (item.IsDir)
-			err = RemoveAll(item.FullPath);
-		else
-			err = RemoveFile(item.FullPath);
-
-		if (!err.OK() && firstErr.OK())
-			firstErr = firstErr;
-	}
-	Error lastErr = RemoveDir(path);
-	if (firstErr.OK())
-		firstErr = lastErr;
-	return firstErr;
+	return RemoveAll(path, nullptr);
 }
 
 #if defined(BMHPAL_PLATFORM_WINDOWS)
@@ -624,23 +979,18 @@ BMHPAL_API Error Exec(const std::string& path, const std::vector<std::string>& a
 		argv.push_back(args[i].c_str());
 	argv.push_back(nullptr);
 
-	pid_t childid = vfork();
-	if (childid == -1)
-		return Error::Fmt("Unable to start child process: %d", errno);
-	if (childid != 0) {
-		// parent
-		handle.PID = childid;
-		return Error();
-	} else {
-		// child
-		if (!!(flags & ExecFlags::UseSearchPath))
-			execvp(path.c_str(), (char* const*) &argv[0]);
-		else
-			execv(path.c_str(), (char* const*) &argv[0]);
-		// Since we're using vfork, the only thing we're allowed to do now is call  __exit
-		_exit(1);
-		return Error("How can _exit(1) fail!!!"); // unreachable
-	}
+	// posix_spawn is a vfork-style clone on Linux, and unlike a raw vfork, it reports exec failures to us.
+	// See Process.h if you need control over the child's stdio or environment.
+	pid_t childid = 0;
+	int   r;
+	if (!!(flags & ExecFlags::UseSearchPath))
+		r = posix_spawnp(&childid, path.c_str(), nullptr, nullptr, (char* const*) &argv[0], environ);
+	else
+		r = posix_spawn(&childid, path.c_str(), nullptr, nullptr, (char* const*) &argv[0], environ);
+	if (r != 0)
+		return Error::Fmt("Unable to start child process: %v", ErrorFrom_errno(r).Message());
+	handle.PID = childid;
+	return Error();
 #endif
 }
 
@@ -4,9 +4,17 @@
 #include "../Error/Error.h"
 #include "../Error/CommonErrors.h"
 
+// windows.h defines CopyFile as a macro
+#ifdef CopyFile
+#undef CopyFile
+#endif
+
 namespace bmhpal {
 namespace os {
 
+class SyncGroup;
+class AsyncIO;
+
 enum class Platforms {
 	Linux,
 	Windows,
@@ -36,11 +44,34 @@ inline uint32_t operator&(MkDirFlags a, MkDirFlags b) {
 }
 
 struct FileAttributes {
-	double   TimeCreate = 0; // Creation time (unix seconds)
-	double   TimeModify = 0; // Last modification time (unix seconds)
-	uint64_t Size       = 0;
-	bool     IsDir      = false;
+	double   TimeCreate   = 0; // Creation time (unix seconds). On Linux, this is actually the inode change time (ctime).
+	double   TimeModify   = 0; // Last modification time (unix seconds)
+	int64_t  TimeCreateNS = 0; // TimeCreate in unix nanoseconds, which is exact, so it's the one to compare for change detection
+	int64_t  TimeModifyNS = 0; // TimeModify in unix nanoseconds
+	uint64_t Size         = 0;
+	uint64_t Inode        = 0; // Inode number (file index on Windows)
+	uint32_t NLink        = 0; // Number of hard links
+	bool     IsDir        = false;
+};
+
+// Selects the members of FileAttributes that a stat must fill in. Asking for less can make statx
+// cheaper, especially on network filesystems. Members that were not asked for might not be filled in.
+enum class StatMask {
+	None       = 0,
+	Type       = 1, // IsDir
+	Size       = 2,
+	TimeModify = 4, // TimeModify and TimeModifyNS
+	TimeCreate = 8, // TimeCreate and TimeCreateNS
+	Inode      = 16,
+	NLink      = 32,
+	All        = 63,
 };
+inline StatMask operator|(StatMask a, StatMask b) {
+	return StatMask((uint32_t) a | (uint32_t) b);
+}
+inline uint32_t operator&(StatMask a, StatMask b) {
+	return (uint32_t) a & (uint32_t) b;
+}
 
 struct FindFileItem {
 	std::string Name;
@@ -108,17 +139,23 @@ extern BMHPAL_API StaticError ErrENOENT;
 BMHPAL_API void Sleep(time::Duration d);
 BMHPAL_API bool MkDir(const std::string& dir, MkDirFlags flags = MkDirFlags::None);
 BMHPAL_API std::string Cwd(); // Get current working directory
-BMHPAL_API Error       Stat(const std::string& path, FileAttributes& attribs);
+BMHPAL_API Error       Stat(const std::string& path, FileAttributes& attribs, StatMask mask = StatMask::All);
 BMHPAL_API Error       FindFiles(std::string dir, std::vector<FindFileItem>& result, const std::string& wc = "*"); // Finds all entries in the given directory that match the wildcard
 BMHPAL_API bool        DirExists(const std::string& path);                                                         // Returns true if this is directory
 BMHPAL_API bool        FileExists(const std::string& path);                                                        // Returns true if this can be Stat() and is not a directory. It could be a socket, or anything weird like that though.
 BMHPAL_API Error       ReadFile(const std::string& filename, std::string& content, ReadFlags flags = ReadFlags::None);
 BMHPAL_API Error       WriteFile(const std::string& filename, const std::string& buf);
 BMHPAL_API Error       WriteFile(const std::string& filename, const void* buf, size_t len);
+BMHPAL_API Error       WriteFileAtomic(const std::string& filename, const std::string& buf, SyncGroup* group = nullptr); // Write to a temp file, fsync, rename over filename, and fsync the directory
+BMHPAL_API Error       WriteFileAtomic(const std::string& filename, const void* buf, size_t len, SyncGroup* group = nullptr);
+BMHPAL_API Error       OpenForWrite(const std::string& filename, int& fd);       // Create or truncate the file, and open it for writing
+BMHPAL_API Error       WriteAll(int fd, const void* buf, size_t len);            // Write all of buf, retrying after short writes
 BMHPAL_API Error       Rename(const std::string& src, const std::string& dst);
+BMHPAL_API Error       CopyFile(const std::string& src, const std::string& dst); // Create or overwrite dst. Uses a reflink or an in-kernel copy where possible, and preserves holes in sparse files.
+BMHPAL_API Error       Preallocate(int fd, uint64_t offset, uint64_t len);       // Allocate disk space for the range (fallocate). Does nothing on platforms other than Linux.
 BMHPAL_API Error       ErrorFrom_errno(int errno_);
 BMHPAL_API Error       Remove(const std::string& path);
-BMHPAL_API Error       RemoveAll(const std::string& path);
+BMHPAL_API Error       RemoveAll(const std::string& path); // Delete path and everything below it. Succeeds if path doesn't exist. See DirWalker.h for a version with an error callback.
 BMHPAL_API std::string UserHomeDir();        // On Windows, return C:\Users\<username>
 BMHPAL_API std::string UserLocalAppData();   // On Windows, return C:\Users\<username>\AppData\Local
 BMHPAL_API std::string UserRoamingAppData(); // On Windows, return C:\Users\<username>\AppData\Roaming
@@ -133,6 +170,20 @@ BMHPAL_API std::string ProcessPath();
 BMHPAL_API Error       CPUTime(double& self, double& children); // Return seconds of CPU time. Only implemented on Linux. Child processes must have exited and been waited on.
 BMHPAL_API bool        IsInsideLinuxContainer();                // Returns true if we believe we're running under docker or lxc
 
+// Stat many paths. out receives one FileAttributes per path.
+// If errors is not null, then it receives one error per path, and the function only fails if
+// errors is null and at least one stat failed.
+// On Linux, this uses statx, asking only for the fields in mask. When adjacent paths are in the
+// same directory, they are stat'ed relative to an fd for that directory, so the directory is looked
+// up once. If aio is not null, then the stats are submitted through it in batches instead, which
+// is much faster when the inodes are not cached.
+BMHPAL_API Error StatMany(const std::vector<std::string>& paths, StatMask mask, std::vector<FileAttributes>& out, std::vector<Error>* errors = nullptr, AsyncIO* aio = nullptr);
+
+#ifndef BMHPAL_PLATFORM_WINDOWS
+// Stat name relative to the directory dirFd, as fstatat does. dirFd may be AT_FDCWD.
+BMHPAL_API Error StatAt(int dirFd, const char* name, FileAttributes& attribs, StatMask mask = StatMask::All, bool followSymlinks = true);
+#endif
+
 inline Platforms Platform() {
 #ifdef _WIN32
 	return Platforms::Windows;
@@ -0,0 +1,406 @@
+#include "pch.h"
+#include "Process.h"
+
+#ifndef BMHPAL_PLATFORM_WINDOWS
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+#ifdef BMHPAL_PLATFORM_LINUX
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace os {
+
+BMHPAL_API StaticError ErrTimeout("Timeout");
+
+Process::Process() {
+}
+
+Process::~Process() {
+	// Closing our ends of the pipes lets a child that is reading its stdin see EOF
+	CloseFds();
+	if (Pid != 0 && !HasExit)
+		Wait();
+}
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+
+Error Process::Start(const std::string& path, const std::vector<std::string>& args, const SpawnOptions& options) {
+	return Error("os::Process is not implemented on Windows yet");
+}
+
+Error Process::Wait(int timeoutMS) {
+	return Error("os::Process is not implemented on Windows yet");
+}
+
+bool Process::Exited() {
+	return true;
+}
+
+Error Process::Kill() {
+	return Error("os::Process is not implemented on Windows yet");
+}
+
+Error Process::WaitAll(const std::vector<Process*>& procs, int timeoutMS) {
+	return Error("os::Process is not implemented on Windows yet");
+}
+
+bool Process::Reap() {
+	return true;
+}
+
+void Process::CloseFds() {
+}
+
+#else
+
+void Process::CloseFds() {
+	for (int* fd : {&InFd, &OutFd, &ErrFd, &StdinPipe, &StdoutPipe, &StderrPipe}) {
+		if (*fd != -1)
+			close(*fd);
+		*fd = -1;
+	}
+}
+
+// Create a pipe. Our end is non-blocking, and neither end is inherited by other children.
+static Error MakePipe(int fds[2], bool weRead) {
+#ifdef BMHPAL_PLATFORM_LINUX
+	if (pipe2(fds, O_CLOEXEC) != 0)
+		return ErrorFrom_errno(errno);
+#else
+	if (pipe(fds) != 0)
+		return ErrorFrom_errno(errno);
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+	int ours = weRead ? fds[0] : fds[1];
+	fcntl(ours, F_SETFL, fcntl(ours, F_GETFL) | O_NONBLOCK);
+	return Error();
+}
+
+// Build the environment for the child
+static void MakeEnv(const SpawnOptions& options, vector<string>& env, vector<char*>& envp) {
+	if (!options.ClearEnv) {
+		for (char** e = environ; *e; e++) {
+			const char* eq = strchr(*e, '=');
+			if (!eq)
+				continue;
+			size_t nameLen    = eq - *e + 1;
+			bool   overridden = false;
+			for (const auto& o : options.Env)
+				overridden = overridden || o.compare(0, nameLen, *e, nameLen) == 0;
+			if (!overridden)
+				env.push_back(*e);
+		}
+	}
+	for (const auto& o : options.Env)
+		env.push_back(o);
+	for (auto& e : env)
+		envp.push_back(&e[0]);
+	envp.push_back(nullptr);
+}
+
+Error Process::Start(const std::string& path, const std::vector<std::string>& args, const SpawnOptions& options) {
+	if (Pid != 0)
+		return Error("Process has already been started");
+
+	posix_spawn_file_actions_t actions;
+	posix_spawnattr_t          attr;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawnattr_init(&attr);
+
+	// Our end and the child's end of each pipe
+	int   ours[3]   = {-1, -1, -1};
+	int   theirs[3] = {-1, -1, -1};
+	auto  cleanup   = [&]() {
+		posix_spawn_file_actions_destroy(&actions);
+		posix_spawnattr_destroy(&attr);
+		for (int i = 0; i < 3; i++) {
+			if (theirs[i] != -1)
+				close(theirs[i]);
+		}
+	};
+	StdioMode modes[3] = {options.Stdin, options.Stdout, options.Stderr};
+	int       fds[3]   = {options.StdinFd, options.StdoutFd, options.StderrFd};
+	Error     err;
+	for (int i = 0; i < 3 && err.OK(); i++) {
+		switch (modes[i]) {
+		case StdioMode::Inherit:
+			break;
+		case StdioMode::Null:
+			posix_spawn_file_actions_addopen(&actions, i, "/dev/null", i == 0 ? O_RDONLY : O_WRONLY, 0);
+			break;
+		case StdioMode::Pipe:
+		case StdioMode::Buffer: {
+			int p[2];
+			err = MakePipe(p, i != 0);
+			if (!err.OK())
+				break;
+			ours[i]   = i == 0 ? p[1] : p[0];
+			theirs[i] = i == 0 ? p[0] : p[1];
+			posix_spawn_file_actions_adddup2(&actions, theirs[i], i);
+			break;
+		}
+		case StdioMode::Fd:
+			if (fds[i] == -1)
+				err = Error("SpawnOptions: StdioMode::Fd needs an fd");
+			else
+				posix_spawn_file_actions_adddup2(&actions, fds[i], i);
+			break;
+		case StdioMode::Stdout:
+			if (i != 2)
+				err = Error("SpawnOptions: StdioMode::Stdout is only valid for stderr");
+			else
+				posix_spawn_file_actions_adddup2(&actions, 1, 2);
+			break;
+		}
+	}
+	if (err.OK() && !options.Cwd.empty()) {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+		posix_spawn_file_actions_addchdir_np(&actions, options.Cwd.c_str());
+#else
+		err = Error("SpawnOptions: Cwd is not supported on this platform");
+#endif
+	}
+	if (!err.OK()) {
+		cleanup();
+		for (int i = 0; i < 3; i++) {
+			if (ours[i] != -1)
+				close(ours[i]);
+		}
+		return err;
+	}
+
+	// The child starts with no signals blocked, and with SIGPIPE at its default, whatever we have done with them
+	sigset_t mask, def;
+	sigemptyset(&mask);
+	sigemptyset(&def);
+	sigaddset(&def, SIGPIPE);
+	posix_spawnattr_setsigmask(&attr, &mask);
+	posix_spawnattr_setsigdefault(&attr, &def);
+	posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+	vector<const char*> argv;
+	argv.push_back(path.c_str());
+	for (const auto& a : args)
+		argv.push_back(a.c_str());
+	argv.push_back(nullptr);
+
+	vector<string> env;
+	vector<char*>  envp;
+	char**         envpp = environ;
+	if (options.ClearEnv || !options.Env.empty()) {
+		MakeEnv(options, env, envp);
+		envpp = &envp[0];
+	}
+
+	pid_t pid = 0;
+	int   r;
+	if (!!(options.Flags & ExecFlags::UseSearchPath))
+		r = posix_spawnp(&pid, path.c_str(), &actions, &attr, (char* const*) &argv[0], envpp);
+	else
+		r = posix_spawn(&pid, path.c_str(), &actions, &attr, (char* const*) &argv[0], envpp);
+	cleanup();
+	if (r != 0) {
+		for (int i = 0; i < 3; i++) {
+			if (ours[i] != -1)
+				close(ours[i]);
+		}
+		return ErrorFrom_errno(r);
+	}
+
+	Pid      = pid;
+	HasExit  = false;
+	ExitCode = 0;
+	Output.clear();
+	ErrorOutput.clear();
+#ifdef SYS_pidfd_open
+	// The pid can't be reused until we reap the child, so there is no race here
+	PidFd = (int) syscall(SYS_pidfd_open, pid, 0);
+	if (PidFd != -1)
+		fcntl(PidFd, F_SETFD, FD_CLOEXEC);
+#endif
+
+	int* buffered[3] = {&InFd, &OutFd, &ErrFd};
+	int* piped[3]    = {&StdinPipe, &StdoutPipe, &StderrPipe};
+	for (int i = 0; i < 3; i++) {
+		if (modes[i] == StdioMode::Buffer)
+			*buffered[i] = ours[i];
+		else if (modes[i] == StdioMode::Pipe)
+			*piped[i] = ours[i];
+	}
+	Input    = options.Input;
+	InputPos = 0;
+	if (InFd != -1 && Input.empty()) {
+		close(InFd);
+		InFd = -1;
+	}
+	return Error();
+}
+
+bool Process::Reap() {
+	if (HasExit)
+		return true;
+	int   status = 0;
+	pid_t r      = waitpid(Pid, &status, WNOHANG);
+	if (r == -1 && errno == EINTR)
+		return false;
+	if (r == 0)
+		return false;
+	if (r == -1) {
+		// Somebody else reaped the child
+		ExitCode = -1;
+	} else if (WIFEXITED(status)) {
+		ExitCode = WEXITSTATUS(status);
+	} else if (WIFSIGNALED(status)) {
+		ExitCode = 128 + WTERMSIG(status);
+	}
+	HasExit = true;
+	if (PidFd != -1)
+		close(PidFd);
+	PidFd = -1;
+	// If the child is gone, then nobody is going to read the rest of its input
+	if (InFd != -1)
+		close(InFd);
+	InFd = -1;
+	return true;
+}
+
+bool Process::Exited() {
+	return Pid != 0 && Reap();
+}
+
+Error Process::Kill() {
+	if (Pid == 0 || HasExit)
+		return Error();
+#ifdef SYS_pidfd_send_signal
+	if (PidFd != -1) {
+		if (syscall(SYS_pidfd_send_signal, PidFd, SIGKILL, nullptr, 0) == 0)
+			return Error();
+		return ErrorFrom_errno(errno);
+	}
+#endif
+	if (kill(Pid, SIGKILL) != 0)
+		return ErrorFrom_errno(errno);
+	return Error();
+}
+
+Error Process::Wait(int timeoutMS) {
+	return WaitAll({this}, timeoutMS);
+}
+
+// Write to a pipe whose reader might be gone, without being killed by SIGPIPE
+static ssize_t WriteNoSigPipe(int fd, const void* buf, size_t len) {
+	sigset_t pipeSet, old;
+	sigemptyset(&pipeSet);
+	sigaddset(&pipeSet, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &pipeSet, &old);
+	sigset_t pending;
+	sigpending(&pending);
+	bool wasPending = sigismember(&pending, SIGPIPE);
+
+	ssize_t n = write(fd, buf, len);
+	int     e = errno;
+	if (n == -1 && e == EPIPE && !wasPending) {
+		// Consume the SIGPIPE that we just caused
+		timespec zero = {0, 0};
+		sigtimedwait(&pipeSet, nullptr, &zero);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, nullptr);
+	errno = e;
+	return n;
+}
+
+Error Process::WaitAll(const std::vector<Process*>& procs, int timeoutMS) {
+	auto start = chrono::steady_clock::now();
+
+	vector<pollfd>   fds;
+	vector<Process*> owners;
+	vector<char>     buf(64 * 1024);
+	while (true) {
+		fds.clear();
+		owners.clear();
+		bool needTimer = false; // True if some process has no pidfd, so we must poll waitpid
+		for (auto p : procs) {
+			if (p->Pid == 0 || p->Done())
+				continue;
+			if (!p->HasExit && p->Reap() && p->Done())
+				continue;
+			auto add = [&](int fd, short events) {
+				pollfd pfd;
+				pfd.fd      = fd;
+				pfd.events  = events;
+				pfd.revents = 0;
+				fds.push_back(pfd);
+				owners.push_back(p);
+			};
+			if (p->InFd != -1)
+				add(p->InFd, POLLOUT);
+			if (p->OutFd != -1)
+				add(p->OutFd, POLLIN);
+			if (p->ErrFd != -1)
+				add(p->ErrFd, POLLIN);
+			if (!p->HasExit) {
+				if (p->PidFd != -1)
+					add(p->PidFd, POLLIN);
+				else
+					needTimer = true;
+			}
+		}
+		if (fds.empty() && !needTimer)
+			return Error();
+
+		int timeout = -1;
+		if (timeoutMS >= 0) {
+			auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+			if (elapsed >= timeoutMS)
+				return ErrTimeout;
+			timeout = timeoutMS - (int) elapsed;
+		}
+		if (needTimer && (timeout == -1 || timeout > 10))
+			timeout = 10;
+		int r = poll(fds.empty() ? nullptr : &fds[0], fds.size(), timeout);
+		if (r == -1 && errno != EINTR)
+			return ErrorFrom_errno(errno);
+
+		for (size_t i = 0; i < fds.size(); i++) {
+			if (fds[i].revents == 0)
+				continue;
+			auto p  = owners[i];
+			int  fd = fds[i].fd;
+			if (fd == p->InFd) {
+				ssize_t n = WriteNoSigPipe(fd, &p->Input[p->InputPos], p->Input.size() - p->InputPos);
+				if (n > 0)
+					p->InputPos += n;
+				if (p->InputPos == p->Input.size() || (n == -1 && errno != EAGAIN && errno != EINTR)) {
+					close(p->InFd);
+					p->InFd = -1;
+				}
+			} else if (fd == p->OutFd || fd == p->ErrFd) {
+				ssize_t n = read(fd, &buf[0], buf.size());
+				if (n > 0) {
+					(fd == p->OutFd ? p->Output : p->ErrorOutput).append(&buf[0], n);
+				} else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+					close(fd);
+					(fd == p->OutFd ? p->OutFd : p->ErrFd) = -1;
+				}
+			} else if (fd == p->PidFd) {
+				p->Reap();
+			}
+		}
+	}
+}
+
+#endif
+
+} // namespace os
+} // namespace bmhpal
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "../Error/Error.h"
+#include "OS.h"
+
+namespace bmhpal {
+namespace os {
+
+/*
+
+	Child processes
+	===============
+
+	Process launches a child with posix_spawn, which on Linux is a vfork-style clone, so the cost of
+	launching doesn't grow with the size of our address space the way fork does. You control the
+	child's stdin, stdout and stderr, its environment, and its working directory.
+
+	Each stream can be inherited, sent to /dev/null, redirected to an fd of yours, or connected to a
+	pipe. With Pipe, you get our end of the pipe (non-blocking), and you do the reading and writing.
+	With Buffer, Wait does it for you: stdin is fed from SpawnOptions::Input, and stdout and stderr
+	are collected into Output and ErrorOutput. Wait runs a poll loop over all of the pipes, so a child
+	that writes a lot to both stdout and stderr can't deadlock against us.
+
+	On Linux 5.3 and later, we hold a pidfd for the child, so waiting is a poll on that fd, instead
+	of polling waitpid. WaitAll drives many processes from a single loop, which is how you run
+	hundreds of short-lived helpers at once, and collect their output.
+
+	You must Wait for every process that you Start. If a Process is destroyed while its child is
+	still running, then the destructor closes our ends of the pipes, and waits for the child to exit.
+
+	Process is not implemented on Windows yet. Use Exec there.
+
+	*/
+
+extern BMHPAL_API StaticError ErrTimeout;
+
+enum class StdioMode {
+	Inherit, // Share our stream
+	Null,    // /dev/null
+	Pipe,    // A pipe, which you read or write yourself through Process::StdinPipe, StdoutPipe or StderrPipe
+	Buffer,  // Stdin is fed from SpawnOptions::Input. Stdout and stderr are collected into Process::Output and Process::ErrorOutput.
+	Fd,      // Redirect to SpawnOptions::StdinFd, StdoutFd or StderrFd
+	Stdout,  // Only valid for stderr. Send stderr wherever stdout is going.
+};
+
+struct SpawnOptions {
+	ExecFlags                Flags = ExecFlags::None;
+	std::string              Cwd;              // If not empty, the child starts in this directory
+	std::vector<std::string> Env;              // NAME=value pairs, which are added to our own environment, replacing any variables of the same name
+	bool                     ClearEnv = false; // If true, then the child's environment is only Env
+	StdioMode                Stdin    = StdioMode::Inherit;
+	StdioMode                Stdout   = StdioMode::Inherit;
+	StdioMode                Stderr   = StdioMode::Inherit;
+	int                      StdinFd  = -1;
+	int                      StdoutFd = -1;
+	int                      StderrFd = -1;
+	std::string              Input; // Written to the child's stdin, when Stdin is Buffer
+};
+
+class BMHPAL_API Process {
+public:
+	std::string Output;          // Collected stdout, when Stdout is Buffer
+	std::string ErrorOutput;     // Collected stderr, when Stderr is Buffer
+	int         ExitCode   = 0;  // Valid once the process has exited. If it was killed by a signal, then this is 128 + the signal number, the way a shell reports it.
+	int         StdinPipe  = -1; // Our end of the child's stdin, when Stdin is Pipe. Close it to send EOF.
+	int         StdoutPipe = -1; // Our end of the child's stdout, when Stdout is Pipe
+	int         StderrPipe = -1; // Our end of the child's stderr, when Stderr is Pipe
+
+	Process();
+	~Process();
+	Process(const Process&) = delete;
+	Process& operator=(const Process&) = delete;
+
+	Error Start(const std::string& path, const std::vector<std::string>& args, const SpawnOptions& options = SpawnOptions());
+	Error Wait(int timeoutMS = -1); // Wait for the process to exit, and for Buffer streams to reach EOF. Returns ErrTimeout if that doesn't happen within timeoutMS.
+	bool  Exited();                 // Returns true if the process has exited. Does not block.
+	Error Kill();                   // Send SIGKILL. You must still Wait.
+	int   PID() const { return Pid; }
+
+	// Wait for all of the processes, with a single event loop
+	static Error WaitAll(const std::vector<Process*>& procs, int timeoutMS = -1);
+
+private:
+	int         Pid      = 0;
+	int         PidFd    = -1;
+	bool        HasExit  = false;
+	int         InFd     = -1; // Our ends of the Buffer pipes
+	int         OutFd    = -1;
+	int         ErrFd    = -1;
+	size_t      InputPos = 0;
+	std::string Input;
+
+	bool Reap(); // Returns true if the process has exited
+	bool Done() const { return HasExit && OutFd == -1 && ErrFd == -1; }
+	void CloseFds(); // Close our ends of all pipes
+};
+
+} // namespace os
+} // namespace bmhpal
@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "SyncGroup.h"
+#include "OS.h"
+
+#ifdef BMHPAL_PLATFORM_WINDOWS
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace os {
+
+SyncGroup::SyncGroup() {
+}
+
+SyncGroup::~SyncGroup() {
+}
+
+static Error SyncFd(int fd) {
+#if defined(BMHPAL_PLATFORM_WINDOWS)
+	if (_commit(fd) != 0)
+		return ErrorFrom_errno(errno);
+#elif defined(BMHPAL_PLATFORM_LINUX)
+	if (syncfs(fd) != 0)
+		return ErrorFrom_errno(errno);
+#else
+	if (fsync(fd) != 0)
+		return ErrorFrom_errno(errno);
+#endif
+	return Error();
+}
+
+Error SyncGroup::Sync(int fd) {
+#ifndef BMHPAL_PLATFORM_LINUX
+	{
+		lock_guard<mutex> lock(Lock);
+		NBatches++;
+	}
+	return SyncFd(fd);
+#else
+	unique_lock<mutex> lock(Lock);
+	if (!Next)
+		Next = make_shared<Batch>();
+	// Our writes happened before we joined b, and b only starts after we've joined, so b covers us
+	auto b   = Next;
+	bool led = false;
+	while (!b->Done) {
+		if (!Syncing && Next == b) {
+			// Lead this batch. Anybody who arrives from now on joins the one after it.
+			Syncing = true;
+			led     = true;
+			Next    = make_shared<Batch>();
+			NBatches++;
+			lock.unlock();
+			auto err = SyncFd(fd);
+			lock.lock();
+			b->Err  = err;
+			b->Done = true;
+			Syncing = false;
+			CV.notify_all();
+		} else {
+			CV.wait(lock);
+		}
+	}
+	// The batch's error came from the leader's filesystem, which needn't be ours, so only the leader reports it.
+	Error err = led ? b->Err : Error();
+	lock.unlock();
+	// syncfs doesn't report writeback errors before Linux 5.8, and after that, only reports them once, to the leader.
+	// fdatasync reports any error for our own file. The batch has already written the pages, so this is cheap.
+	if (fdatasync(fd) != 0 && err.OK())
+		err = ErrorFrom_errno(errno);
+	return err;
+#endif
+}
+
+uint64_t SyncGroup::Batches() const {
+	lock_guard<mutex> lock(Lock);
+	return NBatches;
+}
+
+} // namespace os
+} // namespace bmhpal
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include "../Error/Error.h"
+
+namespace bmhpal {
+namespace os {
+
+/*
+
+	Group commit
+	============
+
+	When many threads each write a file and then fsync it, the fsyncs are serialized on disk latency.
+	SyncGroup batches them. A thread that calls Sync either starts a new sync, or waits for the next
+	one to start, so that one sync covers every writer that joined while the previous sync was running.
+
+	On Linux, a batch is a single syncfs(), which flushes the whole filesystem that fd lives on.
+	All files that share a SyncGroup must therefore be on the same filesystem. Note that syncfs also
+	flushes unrelated dirty data on that filesystem, so it's best suited to a dedicated data volume.
+	syncfs can't tell us which file a writeback error belongs to, so once the batch is done, each
+	caller also does an fdatasync of its own fd, which finds nothing left to write, and reports
+	any error for that file. A syncfs error is only returned to the caller whose fd it ran on.
+	On other platforms, Sync just calls fsync on fd, without batching.
+
+	Pass a SyncGroup to WriteFileAtomic, to make many concurrent durable writes cheap.
+
+	*/
+class BMHPAL_API SyncGroup {
+public:
+	SyncGroup();
+	~SyncGroup();
+
+	// Make everything written to fd's filesystem before this call durable
+	Error Sync(int fd);
+
+	uint64_t Batches() const; // Number of syncs that have been issued. Useful for measuring how well writes are being grouped.
+
+private:
+	struct Batch {
+		Error Err;
+		bool  Done = false;
+	};
+
+	mutable std::mutex      Lock;
+	std::condition_variable CV;
+	std::shared_ptr<Batch>  Next; // The batch that new callers join. It starts when the current batch finishes.
+	bool                    Syncing  = false;
+	uint64_t                NBatches = 0;
+};
+
+} // namespace os
+} // namespace bmhpal
@@ -0,0 +1,316 @@
+#include "pch.h"
+#include "Watcher.h"
+#include "DirWalker.h"
+
+#ifdef BMHPAL_PLATFORM_LINUX
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace os {
+
+Watcher::Watcher() : Stopping(false) {
+	Events.Initialize(true);
+}
+
+Watcher::~Watcher() {
+	Stop();
+}
+
+#ifdef BMHPAL_PLATFORM_LINUX
+
+static const uint32_t WatchMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_FROM | IN_MOVED_TO | IN_EXCL_UNLINK | IN_ONLYDIR;
+
+static int64_t SteadyNow() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Error Watcher::Init() {
+	if (Fd != -1)
+		return Error();
+	Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (Fd == -1)
+		return ErrorFrom_errno(errno);
+	return Error();
+}
+
+Error Watcher::Start(time::Duration debounce) {
+	lock_guard<mutex> lock(Lock);
+	if (Thread.joinable())
+		return Error("Watcher is already started");
+	auto err = Init();
+	if (!err.OK())
+		return err;
+	WakeFd = eventfd(0, EFD_CLOEXEC);
+	if (WakeFd == -1)
+		return ErrorFrom_errno(errno);
+	Debounce = debounce.Nanoseconds();
+	Stopping = false;
+	Thread   = std::thread([this]() { Run(); });
+	return Error();
+}
+
+void Watcher::Stop() {
+	if (Thread.joinable()) {
+		Stopping = true;
+		Wake();
+		Thread.join();
+	}
+	lock_guard<mutex> lock(Lock);
+	Flush(true);
+	if (Fd != -1)
+		close(Fd);
+	if (WakeFd != -1)
+		close(WakeFd);
+	Fd     = -1;
+	WakeFd = -1;
+	Watches.clear();
+	PathToWatch.clear();
+	Roots.clear();
+}
+
+Error Watcher::Add(const std::string& dir, bool recursive) {
+	lock_guard<mutex> lock(Lock);
+	auto              err = Init();
+	if (!err.OK())
+		return err;
+	err = AddWatch(dir, recursive, false);
+	if (!err.OK())
+		return err;
+	Watch root;
+	root.Path      = dir;
+	root.Recursive = recursive;
+	Roots.push_back(root);
+	return Error();
+}
+
+size_t Watcher::NumWatches() {
+	lock_guard<mutex> lock(Lock);
+	return Watches.size();
+}
+
+void Watcher::Wake() {
+	uint64_t one = 1;
+	auto     r   = write(WakeFd, &one, sizeof(one));
+	(void) r;
+}
+
+void Watcher::SimulateOverflow() {
+	inotify_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.wd   = -1;
+	ev.mask = IN_Q_OVERFLOW;
+	lock_guard<mutex> lock(Lock);
+	HandleEvents((const char*) &ev, sizeof(ev));
+	// The thread must recompute its timeout, so that the new event gets delivered
+	if (WakeFd != -1)
+		Wake();
+}
+
+// If reportContents is true, then we report a Create for everything inside dir
+Error Watcher::AddWatch(const std::string& dir, bool recursive, bool reportContents) {
+	int wd = inotify_add_watch(Fd, dir.c_str(), WatchMask);
+	if (wd == -1)
+		return ErrorFrom_errno(errno);
+	Watches[wd].Path      = dir;
+	Watches[wd].Recursive = recursive;
+	PathToWatch[dir]      = wd;
+	if (!recursive && !reportContents)
+		return Error();
+
+	// We hold Lock, so the walk must not be spread over other threads
+	Error   firstErr;
+	int64_t now   = SteadyNow();
+	auto    visit = [&](const WalkEntry& e) {
+		if (reportContents)
+			Record(e.Path, WatchEvents::Create, e.IsDir, now);
+		if (!e.IsDir || !recursive)
+			return WalkAction::Skip;
+		int sub = inotify_add_watch(Fd, e.Path.c_str(), WatchMask);
+		if (sub == -1) {
+			// ENOENT means that the directory has already been deleted again
+			if (errno != ENOENT && firstErr.OK())
+				firstErr = Error::Fmt("%v: %v", e.Path, ErrorFrom_errno(errno).Message());
+			return WalkAction::Skip;
+		}
+		Watches[sub].Path      = e.Path;
+		Watches[sub].Recursive = true;
+		PathToWatch[e.Path]    = sub;
+		return WalkAction::Continue;
+	};
+	auto err = WalkDir(dir, visit, 1, [](const std::string& path, Error err) {});
+	if (!err.OK() && !IsNotExist(err))
+		return err;
+	return firstErr;
+}
+
+// Stop watching dir and everything below it, because it has been moved away
+void Watcher::RemoveWatches(const std::string& dir) {
+	for (auto it = Watches.begin(); it != Watches.end();) {
+		const auto& p = it->second.Path;
+		if (p.compare(0, dir.size(), dir) == 0 && (p.size() == dir.size() || p[dir.size()] == '/')) {
+			inotify_rm_watch(Fd, it->first);
+			PathToWatch.erase(p);
+			it = Watches.erase(it);
+		} else {
+			it++;
+		}
+	}
+}
+
+void Watcher::Record(const std::string& path, WatchEvents ev, bool isDir, int64_t now) {
+	auto& p = PendingEvents[path];
+	if (ev == WatchEvents::Delete && (p.Events & WatchEvents::Create) && !(p.Events & WatchEvents::Delete)) {
+		// Created and deleted again before anybody saw it
+		PendingEvents.erase(path);
+		return;
+	}
+	if (p.Events == WatchEvents::None)
+		p.First = now;
+	p.Events = p.Events | ev;
+	p.IsDir  = p.IsDir || isDir;
+	p.Last   = now;
+}
+
+void Watcher::HandleEvents(const char* buf, size_t len) {
+	int64_t now = SteadyNow();
+	for (size_t pos = 0; pos < len;) {
+		auto ev = (const inotify_event*) (buf + pos);
+		pos += sizeof(inotify_event) + ev->len;
+
+		if (ev->mask & IN_Q_OVERFLOW) {
+			for (const auto& root : Roots) {
+				Record(root.Path, WatchEvents::Rescan, true, now);
+				// Directories might have been created without us seeing them
+				AddWatch(root.Path, root.Recursive, false);
+			}
+			continue;
+		}
+
+		auto it = Watches.find(ev->wd);
+		if (it == Watches.end())
+			continue;
+		if (ev->mask & IN_IGNORED) {
+			// The directory was deleted or unmounted
+			auto p = PathToWatch.find(it->second.Path);
+			if (p != PathToWatch.end() && p->second == ev->wd)
+				PathToWatch.erase(p);
+			Watches.erase(it);
+			continue;
+		}
+
+		// Copy these out, because adding and removing watches invalidates 'it'
+		bool   recursive = it->second.Recursive;
+		string path      = ev->len != 0 ? it->second.Path + "/" + ev->name : it->second.Path;
+		bool   isDir     = !!(ev->mask & IN_ISDIR);
+
+		if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+			Record(path, WatchEvents::Create, isDir, now);
+			if (isDir && recursive)
+				AddWatch(path, true, true);
+		}
+		if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+			Record(path, WatchEvents::Delete, isDir, now);
+			if (isDir && (ev->mask & IN_MOVED_FROM))
+				RemoveWatches(path);
+		}
+		if (ev->mask & IN_MODIFY)
+			Record(path, WatchEvents::Modify, isDir, now);
+	}
+}
+
+int64_t Watcher::Flush(bool all) {
+	int64_t now  = SteadyNow();
+	int64_t next = -1;
+	vector<pair<int64_t, WatchEvent>> ready;
+	for (auto it = PendingEvents.begin(); it != PendingEvents.end();) {
+		const auto& p   = it->second;
+		int64_t     due = std::min(p.Last + Debounce, p.First + Debounce * 20);
+		if (all || now >= due) {
+			WatchEvent ev;
+			ev.Path   = it->first;
+			ev.Events = p.Events;
+			ev.IsDir  = p.IsDir;
+			ready.push_back({p.First, std::move(ev)});
+			it = PendingEvents.erase(it);
+		} else {
+			if (next == -1 || due - now < next)
+				next = due - now;
+			it++;
+		}
+	}
+	// Deliver in the order that things first happened, so that a directory comes before its contents
+	sort(ready.begin(), ready.end(), [](const pair<int64_t, WatchEvent>& a, const pair<int64_t, WatchEvent>& b) {
+		return a.first != b.first ? a.first < b.first : a.second.Path < b.second.Path;
+	});
+	for (const auto& r : ready)
+		Events.Push(r.second);
+	return next;
+}
+
+void Watcher::Run() {
+	// inotify_event must be aligned
+	vector<uint64_t> buf(64 * 1024 / sizeof(uint64_t));
+	while (true) {
+		int64_t wait;
+		{
+			lock_guard<mutex> lock(Lock);
+			wait = Flush(false);
+		}
+		pollfd fds[2];
+		fds[0].fd      = Fd;
+		fds[0].events  = POLLIN;
+		fds[0].revents = 0;
+		fds[1].fd      = WakeFd;
+		fds[1].events  = POLLIN;
+		fds[1].revents = 0;
+		int timeout    = wait < 0 ? -1 : (int) ((wait + 999999) / 1000000);
+		int r          = poll(fds, 2, timeout);
+		if (r == -1)
+			continue;
+		if (fds[1].revents != 0) {
+			uint64_t n;
+			auto     r = read(WakeFd, &n, sizeof(n));
+			(void) r;
+			if (Stopping)
+				return;
+		}
+		if (fds[0].revents & POLLIN) {
+			auto n = read(Fd, &buf[0], buf.size() * sizeof(uint64_t));
+			if (n > 0) {
+				lock_guard<mutex> lock(Lock);
+				HandleEvents((const char*) &buf[0], (size_t) n);
+			}
+		}
+	}
+}
+
+#else
+
+Error Watcher::Start(time::Duration debounce) {
+	return Error("os::Watcher is only implemented on Linux");
+}
+
+void Watcher::Stop() {
+}
+
+Error Watcher::Add(const std::string& dir, bool recursive) {
+	return Error("os::Watcher is only implemented on Linux");
+}
+
+size_t Watcher::NumWatches() {
+	return 0;
+}
+
+void Watcher::SimulateOverflow() {
+}
+
+#endif
+
+} // namespace os
+} // namespace bmhpal
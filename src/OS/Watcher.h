@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "../Error/Error.h"
+#include "../Containers/ObjQueue.h"
+#include "../Time/Time_.h"
+
+namespace bmhpal {
+namespace os {
+
+/*
+
+	Filesystem watcher
+	==================
+
+	Watcher tells you which paths have changed below a set of directories, so that you can react to
+	changes without rescanning everything on a timer. It is built on inotify.
+
+	Events are delivered on the Events queue, from a background thread. Wait on Events.Semaphore,
+	and then pop one event (see the CAVEAT in ObjQueue.h).
+
+	Events for the same path are coalesced. A path is only delivered once no new events have
+	arrived for it for 'debounce', so a file that is being written produces one Modify event, not one
+	per write. A path that keeps changing is still delivered at least every 20 x debounce.
+	A file that is created and deleted within the debounce period produces no event at all.
+
+	Renames are reported as a Delete of the old path, and a Create of the new path.
+
+	With a recursive watch, new subdirectories are watched as soon as they appear. Files can be
+	created inside a new directory before we manage to watch it, so we list the new directory, and
+	report a Create for everything that is already inside it.
+
+	If the kernel's event queue overflows, then events have been lost, and we can't know which.
+	We deliver a Rescan event for each directory that was passed to Add, so that you only need to
+	rescan the trees that you asked to watch. We also re-add watches to any directories that
+	were missed.
+
+	Each watched directory consumes an inotify watch. The limit is /proc/sys/fs/inotify/max_user_watches.
+
+	Watcher is only implemented on Linux.
+
+	*/
+
+enum class WatchEvents {
+	None   = 0,
+	Create = 1,
+	Delete = 2,
+	Modify = 4,
+	Rescan = 8, // Events were lost. Path is a directory that was passed to Add, and everything below it must be rescanned.
+};
+inline WatchEvents operator|(WatchEvents a, WatchEvents b) {
+	return WatchEvents((uint32_t) a | (uint32_t) b);
+}
+inline uint32_t operator&(WatchEvents a, WatchEvents b) {
+	return (uint32_t) a & (uint32_t) b;
+}
+
+struct WatchEvent {
+	std::string Path;
+	WatchEvents Events = WatchEvents::None; // Everything that happened to Path during the debounce period
+	bool        IsDir  = false;
+};
+
+class BMHPAL_API Watcher {
+public:
+	ObjQueue<WatchEvent> Events;
+
+	Watcher();
+	~Watcher(); // Calls Stop
+
+	Error Start(time::Duration debounce = time::Millisecond * 50);
+	void  Stop();
+
+	// Start watching dir. If recursive is true, then all subdirectories are watched too.
+	// May be called before or after Start.
+	Error Add(const std::string& dir, bool recursive = true);
+
+	size_t NumWatches(); // Number of inotify watches in use
+
+private:
+	friend struct WatcherTester; // tests/TestOS.cpp
+
+	struct Watch {
+		std::string Path;
+		bool        Recursive = false;
+	};
+	struct Pending {
+		WatchEvents Events = WatchEvents::None;
+		bool        IsDir  = false;
+		int64_t     First  = 0; // Time of the first and last event, in steady clock nanoseconds
+		int64_t     Last   = 0;
+	};
+
+	std::mutex                               Lock;
+	int                                      Fd       = -1; // inotify
+	int                                      WakeFd   = -1; // eventfd, to wake up the thread
+	int64_t                                  Debounce = 0;  // nanoseconds
+	std::atomic<bool>                        Stopping;
+	std::thread                              Thread;
+	std::unordered_map<int, Watch>           Watches; // Key is the inotify watch descriptor
+	std::unordered_map<std::string, int>     PathToWatch;
+	std::vector<Watch>                       Roots;
+	std::unordered_map<std::string, Pending> PendingEvents;
+
+	Error   Init();
+	Error   AddWatch(const std::string& dir, bool recursive, bool reportContents);
+	void    RemoveWatches(const std::string& dir);
+	void    Record(const std::string& path, WatchEvents ev, bool isDir, int64_t now);
+	void    HandleEvents(const char* buf, size_t len);
+	int64_t Flush(bool all); // Deliver events that have settled. Returns the time until the next pending event is due, or -1 if nothing is pending.
+	void    Run();
+	void    Wake();
+	void    SimulateOverflow(); // Behave as though the kernel's event queue had overflowed
+};
+
+} // namespace os
+} // namespace bmhpal
@@ -40,4 +40,16 @@
 #define BMHPAL_NORETURN __attribute__((noreturn)) __attribute__((analyzer_noreturn))
 #define BMHPAL_DEBUG_BREAK() __builtin_trap()
 
-#endif
\ No newline at end of file
+#endif
+// SSE2 is part of the x64 baseline, so code guarded by this needs no runtime CPU check
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BMHPAL_SSE2
+#endif
+
+// Kernels for newer instruction sets (SSSE3, AVX2) are compiled per-function with BMHPAL_TARGET,
+// and must only be called after checking the corresponding os::CPUHas... function.
+#if defined(__GNUC__)
+#define BMHPAL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BMHPAL_TARGET(isa)
+#endif
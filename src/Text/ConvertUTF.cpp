@@ -37,6 +37,12 @@
 
 #include <string>
 #include "ConvertUTF.h"
+#include "../OS/CPU.h"
+#include "../Math_.h"
+
+#ifdef BMHPAL_SSE2
+#include <immintrin.h>
+#endif
 
 #ifdef CVTUTF_DEBUG
 #include <stdio.h>
@@ -60,6 +66,100 @@ static const UTF32 halfMask = 0x3FFUL;
 
 /* --------------------------------------------------------------------- */
 
+/* ---------------------------------------------------------------------
+
+	Vectorized paths.
+
+	Everything below produces exactly the same output, return value, and final source/target positions
+	as the original byte-at-a-time code, which is kept alongside as the ...Scalar functions.
+
+	UTF-8 input is decoded in chunks. Each chunk is first validated with SIMD (SSSE3 or AVX2, chosen at
+	runtime), and if it is valid, then it is decoded without any of the per-sequence legality checks. If
+	a chunk is invalid, we hand over to the scalar code at the start of that chunk, so that it can report
+	the precise location of the error. Note that the strict/lenient flag has no effect when the source is
+	UTF-8, because IsLegalUTF8 already rejects surrogates and values above 0x10FFFF.
+
+	Runs of ASCII are widened or narrowed 16 at a time with SSE2.
+
+------------------------------------------------------------------------ */
+
+// Copy a run of ASCII characters from UTF-16 to UTF-8, 8 at a time. Returns the number of characters copied,
+// which is zero if there are fewer than 8 characters of ASCII, or fewer than 8 bytes of space in the target.
+static inline size_t NarrowASCII(const UTF16* src, size_t srcLen, UTF8* dst, size_t dstLen) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	const __m128i hiBits = _mm_set1_epi16((short) 0xFF80);
+	const __m128i zero   = _mm_setzero_si128();
+	size_t        n      = std::min(srcLen, dstLen);
+	for (; i + 8 <= n; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, hiBits), zero)) != 0xFFFF)
+			break;
+		_mm_storel_epi64((__m128i*) (dst + i), _mm_packus_epi16(v, v));
+	}
+#endif
+	return i;
+}
+
+// Copy a run of ASCII characters from UTF-32 to UTF-8, 8 at a time.
+static inline size_t NarrowASCII(const UTF32* src, size_t srcLen, UTF8* dst, size_t dstLen) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	const __m128i hiBits = _mm_set1_epi32((int) 0xFFFFFF80);
+	const __m128i zero   = _mm_setzero_si128();
+	size_t        n      = std::min(srcLen, dstLen);
+	for (; i + 8 <= n; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i b = _mm_loadu_si128((const __m128i*) (src + i + 4));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(a, b), hiBits), zero)) != 0xFFFF)
+			break;
+		__m128i w = _mm_packs_epi32(a, b);
+		_mm_storel_epi64((__m128i*) (dst + i), _mm_packus_epi16(w, w));
+	}
+#endif
+	return i;
+}
+
+// Widen a run of ASCII characters from UTF-8 to UTF-16, 16 at a time.
+static inline size_t WidenASCII(const UTF8* src, size_t srcLen, UTF16* dst, size_t dstLen) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	size_t        n    = std::min(srcLen, dstLen);
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_unpacklo_epi8(v, zero));
+		_mm_storeu_si128((__m128i*) (dst + i + 8), _mm_unpackhi_epi8(v, zero));
+	}
+#endif
+	return i;
+}
+
+// Widen a run of ASCII characters from UTF-8 to UTF-32, 16 at a time.
+static inline size_t WidenASCII(const UTF8* src, size_t srcLen, UTF32* dst, size_t dstLen) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	size_t        n    = std::min(srcLen, dstLen);
+	for (; i + 16 <= n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+		__m128i lo = _mm_unpacklo_epi8(v, zero);
+		__m128i hi = _mm_unpackhi_epi8(v, zero);
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*) (dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*) (dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128((__m128i*) (dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+	}
+#endif
+	return i;
+}
+
+/* --------------------------------------------------------------------- */
+
 ConversionResult ConvertUTF32toUTF16(
     const UTF32** sourceStart, const UTF32* sourceEnd,
     UTF16** targetStart, UTF16* targetEnd, ConversionFlags flags) {
@@ -221,6 +321,13 @@ ConversionResult ConvertUTF16toUTF8(
 	const UTF16*     source = *sourceStart;
 	UTF8*            target = *targetStart;
 	while (source < sourceEnd) {
+		if (*source < 0x80) {
+			size_t n = NarrowASCII(source, sourceEnd - source, target, targetEnd - target);
+			source += n;
+			target += n;
+			if (n != 0)
+				continue;
+		}
 		UTF32          ch;
 		unsigned short bytesToWrite = 0;
 		const UTF32    byteMask     = 0xBF;
@@ -315,7 +422,7 @@ static bool IsLegalUTF8(const UTF8* source, int length) {
 		if ((a = (*--srcptr)) < 0x80 || a > 0xBF)
 			return false;
 	case 2:
-		if ((a = (*--srcptr)) > 0xBF)
+		if ((a = (*--srcptr)) < 0x80 || a > 0xBF)
 			return false;
 
 		switch (*source) {
@@ -366,7 +473,7 @@ bool IsLegalUTF8Sequence(const UTF8* source, const UTF8* sourceEnd) {
 
 /* --------------------------------------------------------------------- */
 
-ConversionResult ConvertUTF8toUTF16(
+ConversionResult ConvertUTF8toUTF16Scalar(
     const UTF8** sourceStart, const UTF8* sourceEnd,
     UTF16** targetStart, UTF16* targetEnd, ConversionFlags flags) {
 	ConversionResult result = ConversionOk;
@@ -453,6 +560,13 @@ ConversionResult ConvertUTF32toUTF8(
 	const UTF32*     source = *sourceStart;
 	UTF8*            target = *targetStart;
 	while (source < sourceEnd) {
+		if (*source < 0x80) {
+			size_t n = NarrowASCII(source, sourceEnd - source, target, targetEnd - target);
+			source += n;
+			target += n;
+			if (n != 0)
+				continue;
+		}
 		UTF32          ch;
 		unsigned short bytesToWrite = 0;
 		const UTF32    byteMask     = 0xBF;
@@ -506,7 +620,7 @@ ConversionResult ConvertUTF32toUTF8(
 
 /* --------------------------------------------------------------------- */
 
-ConversionResult ConvertUTF8toUTF32(
+ConversionResult ConvertUTF8toUTF32Scalar(
     const UTF8** sourceStart, const UTF8* sourceEnd,
     UTF32** targetStart, UTF32* targetEnd, ConversionFlags flags) {
 	ConversionResult result = ConversionOk;
@@ -568,6 +682,269 @@ ConversionResult ConvertUTF8toUTF32(
 	return result;
 }
 
+/* --------------------------------------------------------------------- */
+
+// Scalar validation, sequence by sequence
+static bool IsLegalUTF8StringScalar(const UTF8* source, const UTF8* sourceEnd) {
+	while (source < sourceEnd) {
+		if (*source < 0x80) {
+			source++;
+			continue;
+		}
+		int length = trailingBytesForUTF8[*source] + 1;
+		if (length > sourceEnd - source || !IsLegalUTF8(source, length))
+			return false;
+		source += length;
+	}
+	return true;
+}
+
+#ifdef BMHPAL_SSE2
+/*
+		 * SIMD validation, from John Keiser and Daniel Lemire's "Validating UTF-8 In Less Than One Instruction
+		 * Per Byte" (https://arxiv.org/abs/2010.03090), which is also what simdjson uses.
+		 * Three table lookups on the high and low nibbles of each byte and the high nibble of the byte before it
+		 * classify every pair of adjacent bytes. A pair is bad if all three lookups share a bit. Three and four
+		 * byte sequences additionally need the 2nd or 3rd byte after the lead to be a continuation byte.
+		 * The kernels return the number of bytes checked (a multiple of the block size), and set 'ok' to false
+		 * if an error was found. Sequences that cross the end of the checked region are not validated, so
+		 * the caller must check the tail, starting from the last lead byte.
+		 */
+enum : uint8_t {
+	TooShort     = 1 << 0, // 11______ 0_______, or 11______ 11______
+	TooLong      = 1 << 1, // 0_______ 10______
+	Overlong3    = 1 << 2, // 11100000 100_____
+	TooLarge     = 1 << 3, // 11110100 1001____, etc
+	Surrogate    = 1 << 4, // 11101101 101_____
+	Overlong2    = 1 << 5, // 1100000_ 10______
+	TooLarge1000 = 1 << 6, // 11110101 1000____, etc
+	Overlong4    = 1 << 6, // 11110000 1000____
+	TwoConts     = 1 << 7, // 10______ 10______
+	Carry        = TooShort | TooLong | TwoConts,
+};
+
+#define UTF8_BYTE1_HIGH                                                                       \
+	TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong, TooLong,                   \
+	    TwoConts, TwoConts, TwoConts, TwoConts,                                               \
+	    TooShort | Overlong2,                                                                 \
+	    TooShort,                                                                             \
+	    TooShort | Overlong3 | Surrogate,                                                     \
+	    TooShort | TooLarge | TooLarge1000 | Overlong4
+
+#define UTF8_BYTE1_LOW                                                                                \
+	Carry | Overlong3 | Overlong2 | Overlong4,                                                        \
+	    Carry | Overlong2,                                                                            \
+	    Carry,                                                                                        \
+	    Carry,                                                                                        \
+	    Carry | TooLarge,                                                                             \
+	    Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, \
+	    Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000, \
+	    Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000,                                 \
+	    Carry | TooLarge | TooLarge1000 | Surrogate,                                                      \
+	    Carry | TooLarge | TooLarge1000, Carry | TooLarge | TooLarge1000
+
+#define UTF8_BYTE2_HIGH                                                                    \
+	TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort, TooShort,        \
+	    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge1000 | Overlong4,             \
+	    TooLong | Overlong2 | TwoConts | Overlong3 | TooLarge,                             \
+	    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,                             \
+	    TooLong | Overlong2 | TwoConts | Surrogate | TooLarge,                             \
+	    TooShort, TooShort, TooShort, TooShort
+
+BMHPAL_TARGET("ssse3")
+static size_t ValidateUTF8SSSE3(const UTF8* src, size_t len, bool& ok) {
+	const __m128i byte1High = _mm_setr_epi8(UTF8_BYTE1_HIGH);
+	const __m128i byte1Low  = _mm_setr_epi8(UTF8_BYTE1_LOW);
+	const __m128i byte2High = _mm_setr_epi8(UTF8_BYTE2_HIGH);
+	const __m128i nibble    = _mm_set1_epi8(0x0F);
+	// The largest byte values that can end a block without leaving a sequence incomplete
+	const __m128i maxTail = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char) 0xEF, (char) 0xDF, (char) 0xBF);
+	__m128i       prev    = _mm_setzero_si128();
+	__m128i       err     = _mm_setzero_si128();
+	__m128i       prevInc = _mm_setzero_si128(); // Nonzero if the previous block ended in the middle of a sequence
+	size_t        i       = 0;
+	for (; i + 16 <= len; i += 16) {
+		__m128i in = _mm_loadu_si128((const __m128i*) (src + i));
+		if (_mm_movemask_epi8(in) == 0) {
+			err     = _mm_or_si128(err, prevInc);
+			prevInc = _mm_setzero_si128();
+		} else {
+			__m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+			__m128i sc    = _mm_and_si128(_mm_and_si128(_mm_shuffle_epi8(byte1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                                                         _mm_shuffle_epi8(byte1Low, _mm_and_si128(prev1, nibble))),
+                                           _mm_shuffle_epi8(byte2High, _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+			__m128i prev2  = _mm_alignr_epi8(in, prev, 14);
+			__m128i prev3  = _mm_alignr_epi8(in, prev, 13);
+			__m128i must23 = _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8((char) (0xE0 - 0x80))), _mm_subs_epu8(prev3, _mm_set1_epi8((char) (0xF0 - 0x80))));
+			err            = _mm_or_si128(err, _mm_xor_si128(_mm_and_si128(must23, _mm_set1_epi8((char) 0x80)), sc));
+			prevInc        = _mm_subs_epu8(in, maxTail);
+		}
+		prev = in;
+	}
+	ok = _mm_movemask_epi8(_mm_cmpeq_epi8(err, _mm_setzero_si128())) == 0xFFFF;
+	return i;
+}
+
+BMHPAL_TARGET("avx2")
+static size_t ValidateUTF8AVX2(const UTF8* src, size_t len, bool& ok) {
+	const __m256i byte1High = _mm256_setr_epi8(UTF8_BYTE1_HIGH, UTF8_BYTE1_HIGH);
+	const __m256i byte1Low  = _mm256_setr_epi8(UTF8_BYTE1_LOW, UTF8_BYTE1_LOW);
+	const __m256i byte2High = _mm256_setr_epi8(UTF8_BYTE2_HIGH, UTF8_BYTE2_HIGH);
+	const __m256i nibble    = _mm256_set1_epi8(0x0F);
+	const __m256i maxTail   = _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                             -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char) 0xEF, (char) 0xDF, (char) 0xBF);
+	__m256i prev    = _mm256_setzero_si256();
+	__m256i err     = _mm256_setzero_si256();
+	__m256i prevInc = _mm256_setzero_si256();
+	size_t  i       = 0;
+	for (; i + 32 <= len; i += 32) {
+		__m256i in = _mm256_loadu_si256((const __m256i*) (src + i));
+		if (_mm256_movemask_epi8(in) == 0) {
+			err     = _mm256_or_si256(err, prevInc);
+			prevInc = _mm256_setzero_si256();
+		} else {
+			// alignr works within 128 bit lanes, so first build a register of [prev.hi, in.lo]
+			__m256i straddle = _mm256_permute2x128_si256(prev, in, 0x21);
+			__m256i prev1    = _mm256_alignr_epi8(in, straddle, 15);
+			__m256i sc       = _mm256_and_si256(_mm256_and_si256(_mm256_shuffle_epi8(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                                                              _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, nibble))),
+                                             _mm256_shuffle_epi8(byte2High, _mm256_and_si256(_mm256_srli_epi16(in, 4), nibble)));
+			__m256i prev2  = _mm256_alignr_epi8(in, straddle, 14);
+			__m256i prev3  = _mm256_alignr_epi8(in, straddle, 13);
+			__m256i must23 = _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8((char) (0xE0 - 0x80))), _mm256_subs_epu8(prev3, _mm256_set1_epi8((char) (0xF0 - 0x80))));
+			err            = _mm256_or_si256(err, _mm256_xor_si256(_mm256_and_si256(must23, _mm256_set1_epi8((char) 0x80)), sc));
+			prevInc        = _mm256_subs_epu8(in, maxTail);
+		}
+		prev = in;
+	}
+	ok = _mm256_testz_si256(err, err) != 0;
+	return i;
+}
+
+#undef UTF8_BYTE1_HIGH
+#undef UTF8_BYTE1_LOW
+#undef UTF8_BYTE2_HIGH
+#endif
+
+bool IsLegalUTF8String(const UTF8* source, const UTF8* sourceEnd) {
+	size_t len = sourceEnd - source;
+	size_t i   = 0;
+	bool   ok  = true;
+#ifdef BMHPAL_SSE2
+	if (len >= 64 && os::CPUHasAVX2())
+		i = ValidateUTF8AVX2(source, len, ok);
+	else if (len >= 32 && os::CPUHasSSSE3())
+		i = ValidateUTF8SSSE3(source, len, ok);
+	if (!ok)
+		return false;
+	// The vector kernels don't check sequences that straddle the end of the region that they covered, so
+	// continue from the last lead byte, if it's close enough to the end to be the start of such a sequence.
+	for (size_t k = 1; k <= 3 && k <= i; k++) {
+		if (source[i - k] >= 0xC0) {
+			i -= k;
+			break;
+		}
+	}
+#endif
+	return IsLegalUTF8StringScalar(source + i, sourceEnd);
+}
+
+/* --------------------------------------------------------------------- */
+
+static const size_t UTF8ChunkSize = 16 * 1024;
+
+// Store a character in UTF-16, or return false if there's no space for it
+static inline bool PutChar(UTF32 ch, UTF16*& target, UTF16* targetEnd) {
+	if (ch <= UNI_MAX_BMP) {
+		if (target >= targetEnd)
+			return false;
+		*target++ = (UTF16) ch;
+	} else {
+		if (target + 1 >= targetEnd)
+			return false;
+		ch -= halfBase;
+		*target++ = (UTF16) ((ch >> halfShift) + UNI_SUR_HIGH_START);
+		*target++ = (UTF16) ((ch & halfMask) + UNI_SUR_LOW_START);
+	}
+	return true;
+}
+
+static inline bool PutChar(UTF32 ch, UTF32*& target, UTF32* targetEnd) {
+	if (target >= targetEnd)
+		return false;
+	*target++ = ch;
+	return true;
+}
+
+/*
+		 * Decode UTF-8, one validated chunk at a time. Returns when the source is finished, the target is full,
+		 * or a chunk is found to be invalid, in which case source is left at the start of that chunk, and the
+		 * caller must continue with the scalar code.
+		 */
+template <typename T>
+static ConversionResult ConvertValidUTF8(const UTF8*& source, const UTF8* sourceEnd, T*& target, T* targetEnd) {
+	while (source < sourceEnd) {
+		// Don't split a sequence between chunks. If there are more than 3 continuation bytes, then the chunk is invalid anyway.
+		const UTF8* chunkEnd = sourceEnd - source > (ptrdiff_t) UTF8ChunkSize ? source + UTF8ChunkSize : sourceEnd;
+		for (int k = 0; k < 3 && chunkEnd != sourceEnd && (*chunkEnd & 0xC0) == 0x80; k++)
+			chunkEnd--;
+		if (!IsLegalUTF8String(source, chunkEnd))
+			return ConversionOk;
+
+		while (source < chunkEnd) {
+			UTF32 ch = *source;
+			if (ch < 0x80) {
+				size_t n = WidenASCII(source, chunkEnd - source, target, targetEnd - target);
+				if (n != 0) {
+					source += n;
+					target += n;
+					continue;
+				}
+				if (target >= targetEnd)
+					return ConversionResultTargetExhausted;
+				*target++ = (T) ch;
+				source++;
+				continue;
+			}
+			int len;
+			if (ch < 0xE0) {
+				ch  = ((ch & 0x1F) << 6) | (source[1] & 0x3F);
+				len = 2;
+			} else if (ch < 0xF0) {
+				ch  = ((ch & 0x0F) << 12) | ((source[1] & 0x3F) << 6) | (source[2] & 0x3F);
+				len = 3;
+			} else {
+				ch  = ((ch & 0x07) << 18) | ((source[1] & 0x3F) << 12) | ((source[2] & 0x3F) << 6) | (source[3] & 0x3F);
+				len = 4;
+			}
+			if (!PutChar(ch, target, targetEnd))
+				return ConversionResultTargetExhausted;
+			source += len;
+		}
+	}
+	return ConversionOk;
+}
+
+ConversionResult ConvertUTF8toUTF16(const UTF8** sourceStart, const UTF8* sourceEnd,
+                                    UTF16** targetStart, UTF16* targetEnd, ConversionFlags flags) {
+	if (sourceEnd - *sourceStart >= 32) {
+		ConversionResult result = ConvertValidUTF8(*sourceStart, sourceEnd, *targetStart, targetEnd);
+		if (result != ConversionOk || *sourceStart == sourceEnd)
+			return result;
+	}
+	return ConvertUTF8toUTF16Scalar(sourceStart, sourceEnd, targetStart, targetEnd, flags);
+}
+
+ConversionResult ConvertUTF8toUTF32(const UTF8** sourceStart, const UTF8* sourceEnd,
+                                    UTF32** targetStart, UTF32* targetEnd, ConversionFlags flags) {
+	if (sourceEnd - *sourceStart >= 32) {
+		ConversionResult result = ConvertValidUTF8(*sourceStart, sourceEnd, *targetStart, targetEnd);
+		if (result != ConversionOk || *sourceStart == sourceEnd)
+			return result;
+	}
+	return ConvertUTF8toUTF32Scalar(sourceStart, sourceEnd, targetStart, targetEnd, flags);
+}
+
 /* ---------------------------------------------------------------------
 
 			Note A.
@@ -594,31 +971,165 @@ using namespace bmhpal::Unicode;
 
 namespace bmhpal {
 
+// Number of bytes at s that are replaced by a single U+FFFD, when s is not the start of a legal sequence.
+// This is the "maximal subpart" from the Unicode standard: the lead byte, and as many of the bytes after it as
+// could still have been part of a legal sequence.
+static size_t IllegalUTF8Length(const UTF8* s, const UTF8* end) {
+	UTF8 lead = *s;
+	if (lead < 0xC2 || lead > 0xF4)
+		return 1;
+	UTF8 lo = lead == 0xE0 ? 0xA0 : lead == 0xF0 ? 0x90 : 0x80;
+	UTF8 hi = lead == 0xED ? 0x9F : lead == 0xF4 ? 0x8F : 0xBF;
+	int  n  = 1;
+	for (; n <= trailingBytesForUTF8[lead] && s + n < end && s[n] >= lo && s[n] <= hi; n++) {
+		lo = 0x80;
+		hi = 0xBF;
+	}
+	return n;
+}
+
+// Convert without writing a null terminator, replacing illegal sequences with U+FFFD. Returns the number of
+// characters written. Conversion only stops early if dst is full, in which case *srcUsed is less than srcLen.
+static size_t ToWide(const char* src, size_t srcLen, wchar_t* dst, size_t dstLen, size_t* srcUsed = nullptr) {
+	const UTF8* srcPos = (const UTF8*) src;
+	const UTF8* srcEnd = srcPos + srcLen;
+	wchar_t*    dstPos = dst;
+	wchar_t*    dstEnd = dst + dstLen;
+	while (true) {
+		ConversionResult r;
+		if (WideIs16)
+			r = ConvertUTF8toUTF16(&srcPos, srcEnd, (UTF16**) &dstPos, (UTF16*) dstEnd, ConversionStrict);
+		else
+			r = ConvertUTF8toUTF32(&srcPos, srcEnd, (UTF32**) &dstPos, (UTF32*) dstEnd, ConversionStrict);
+		if (r == ConversionOk || r == ConversionResultTargetExhausted || srcPos == srcEnd || dstPos == dstEnd)
+			break;
+		*dstPos++ = (wchar_t) UNI_REPLACEMENT_CHAR;
+		srcPos += IllegalUTF8Length(srcPos, srcEnd);
+	}
+	if (srcUsed)
+		*srcUsed = srcPos - (const UTF8*) src;
+	return dstPos - dst;
+}
+
+// The opposite of ToWide. Unpaired surrogates are replaced with U+FFFD.
+static size_t ToUTF8(const wchar_t* src, size_t srcLen, char* dst, size_t dstLen) {
+	const wchar_t* srcPos = src;
+	const wchar_t* srcEnd = src + srcLen;
+	UTF8*          dstPos = (UTF8*) dst;
+	UTF8*          dstEnd = (UTF8*) (dst + dstLen);
+	while (true) {
+		ConversionResult r;
+		if (WideIs16)
+			r = ConvertUTF16toUTF8((const UTF16**) &srcPos, (const UTF16*) srcEnd, &dstPos, dstEnd, ConversionStrict);
+		else
+			r = ConvertUTF32toUTF8((const UTF32**) &srcPos, (const UTF32*) srcEnd, &dstPos, dstEnd, ConversionStrict);
+		if (r == ConversionOk || r == ConversionResultTargetExhausted || srcPos == srcEnd || dstEnd - dstPos < 3)
+			break;
+		*dstPos++ = 0xEF;
+		*dstPos++ = 0xBF;
+		*dstPos++ = 0xBD;
+		srcPos++;
+	}
+	return (char*) dstPos - dst;
+}
+
+size_t WideLengthFromUTF8(const char* src, size_t srcLen) {
+	// Every byte that is not a continuation byte starts a character. With UTF-16, 4 byte sequences need a surrogate pair.
+	size_t n = 0;
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	const __m128i contEnd = _mm_set1_epi8((char) 0xC0);
+	const __m128i lead4   = _mm_set1_epi8((char) 0xF0);
+	for (; i + 16 <= srcLen; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		// Continuation bytes are 0x80..0xBF, which are the only bytes less than 0xC0 when viewed as signed
+		n += 16 - PopCount((uint32_t) _mm_movemask_epi8(_mm_cmplt_epi8(v, contEnd)));
+		if (WideIs16)
+			n += PopCount((uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, lead4), v)));
+	}
+#endif
+	for (; i < srcLen; i++) {
+		uint8_t c = (uint8_t) src[i];
+		n += (c & 0xC0) != 0x80;
+		n += WideIs16 && c >= 0xF0;
+	}
+	return n;
+}
+
+size_t UTF8LengthFromWide(const wchar_t* src, size_t srcLen) {
+	size_t n = 0;
+	for (size_t i = 0; i < srcLen; i++) {
+		UTF32 c = (UTF32) src[i];
+		if (c < 0x80)
+			n += 1;
+		else if (c < 0x800)
+			n += 2;
+		else if (WideIs16 && c >= UNI_SUR_HIGH_START && c <= UNI_SUR_HIGH_END && i + 1 < srcLen && (UTF32) src[i + 1] >= UNI_SUR_LOW_START && (UTF32) src[i + 1] <= UNI_SUR_LOW_END) {
+			n += 4;
+			i++;
+		} else if (c < 0x10000 || c > UNI_MAX_LEGAL_UTF32)
+			n += 3; // Values above 0x10FFFF become the replacement character
+		else
+			n += 4;
+	}
+	return n;
+}
+
+size_t BMHPAL_API towide(const char* src, size_t srcLen, wchar_t* dst, size_t dstLen) {
+	if (dstLen == 0)
+		return 0;
+	size_t n = ToWide(src, srcLen, dst, dstLen - 1);
+	dst[n]   = 0;
+	return n;
+}
+
+size_t BMHPAL_API toutf8(const wchar_t* src, size_t srcLen, char* dst, size_t dstLen) {
+	if (dstLen == 0)
+		return 0;
+	size_t n = ToUTF8(src, srcLen, dst, dstLen - 1);
+	dst[n]   = 0;
+	return n;
+}
+
 std::wstring BMHPAL_API towide(const std::string& src) {
-	std::wstring w;
-	for (auto cp : src)
-		w += (wchar_t) cp;
-	return w;
+	// Size the output exactly up front, so that there is only one allocation, and no copy
+	std::wstring dst;
+	size_t       used = 0;
+	dst.resize(WideLengthFromUTF8(src.data(), src.size()));
+	if (dst.size() != 0)
+		dst.resize(ToWide(src.data(), src.size(), &dst[0], dst.size(), &used));
+	if (used != src.size()) {
+		// Illegal text can need more than WideLengthFromUTF8, but never more than one character per byte
+		dst.resize(src.size());
+		dst.resize(ToWide(src.data(), src.size(), &dst[0], dst.size()));
+	}
+	return dst;
 }
 
 std::string BMHPAL_API toutf8(const std::wstring& src) {
 	std::string dst;
-	size_t      srcLen = src.length();
-	if (srcLen != 0) {
-		dst.resize(MaximumUtf8FromWide(srcLen));
-		const wchar_t*   srcPos  = src.c_str();
-		const wchar_t*   srcEnd  = srcPos + srcLen;
-		UTF8*            tempDst = (UTF8*) const_cast<char*>(dst.c_str()); // this violates the std::string spec, but I cannot see how any implementation would not be OK with it.
-		UTF8*            dstPos  = tempDst;
-		UTF8*            dstEnd  = tempDst + dst.length();
-		ConversionResult res     = WideIs16 ? ConvertUTF16toUTF8((const UTF16**) &srcPos, (const UTF16*) srcEnd, &dstPos, dstEnd, ConversionStrict) : ConvertUTF32toUTF8((const UTF32**) &srcPos, (const UTF32*) srcEnd, &dstPos, dstEnd, ConversionStrict);
-		for (size_t spare = dst.size() - (dstPos - tempDst); spare != 0; spare--)
-			dst.pop_back();
-		dst.shrink_to_fit();
-	}
+	dst.resize(UTF8LengthFromWide(src.data(), src.size()));
+	if (dst.size() != 0)
+		dst.resize(ToUTF8(src.data(), src.size(), &dst[0], dst.size()));
 	return dst;
 }
 
+WideString::WideString(const char* utf8, size_t len) {
+	// len is an upper bound on the output, so only do the exact pre-pass if we might need the heap
+	size_t n    = len + 1 <= 260 ? len : WideLengthFromUTF8(utf8, len);
+	size_t used = 0;
+	Len         = ToWide(utf8, len, Reserve(n), n, &used);
+	if (used != len)
+		Len = ToWide(utf8, len, Reserve(len), len); // Illegal text that needs more than WideLengthFromUTF8
+	Buf[Len] = 0;
+}
+
+UTF8String::UTF8String(const wchar_t* wide, size_t len) {
+	size_t n = MaximumUtf8FromWide(len) + 1 <= 260 ? MaximumUtf8FromWide(len) : UTF8LengthFromWide(wide, len);
+	Len      = ToUTF8(wide, len, Reserve(n), n);
+	Buf[Len] = 0;
+}
+
 bool ConvertWideToUTF8(const wchar_t* src, size_t srcLen, char* dst, size_t& dstLen, bool relaxNullTerminator) {
 	if (dst)
 		*dst = 0;
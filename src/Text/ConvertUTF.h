@@ -87,9 +87,75 @@
 
 namespace bmhpal {
 
+// Illegal sequences (or unpaired surrogates) are replaced with U+FFFD
 std::wstring BMHPAL_API towide(const std::string& src);
 std::string BMHPAL_API  toutf8(const std::wstring& src);
 
+/** Convert into a caller-provided buffer, without allocating.
+    Illegal sequences are replaced with U+FFFD, so conversion only stops when dst is full. The output is always null
+    terminated, unless dstLen is zero. Returns the number of characters written, excluding the null terminator.
+    To convert everything, dst needs space for WideLengthFromUTF8(src, srcLen) + 1 characters (or UTF8LengthFromWide + 1 bytes).
+    If src is not legal UTF-8, then srcLen + 1 characters is always enough.
+    **/
+size_t BMHPAL_API towide(const char* src, size_t srcLen, wchar_t* dst, size_t dstLen);
+size_t BMHPAL_API toutf8(const wchar_t* src, size_t srcLen, char* dst, size_t dstLen);
+
+/// Exact number of wchar_t needed to represent legal UTF-8 text. Illegal text can need more, up to srcLen.
+size_t BMHPAL_API WideLengthFromUTF8(const char* src, size_t srcLen);
+
+/// Exact number of bytes needed to represent legal UTF-16/UTF-32 text as UTF-8. For illegal text, this is an upper bound.
+size_t BMHPAL_API UTF8LengthFromWide(const wchar_t* src, size_t srcLen);
+
+/** A null terminated string that lives inside the object if it fits into N characters (including the terminator),
+    and on the heap otherwise. This is the result type of WideString and UTF8String.
+    **/
+template <typename CH, size_t N>
+class SmallString {
+public:
+	SmallString() { Static[0] = 0; }
+	~SmallString() { delete[] Heap; }
+	SmallString(const SmallString&) = delete;
+	SmallString& operator=(const SmallString&) = delete;
+
+	const CH* c_str() const { return Buf; }
+	const CH* data() const { return Buf; }
+	size_t    size() const { return Len; }
+	bool      empty() const { return Len == 0; }
+	bool      IsOnHeap() const { return Heap != nullptr; }
+
+protected:
+	CH     Static[N];
+	CH*    Heap = nullptr;
+	CH*    Buf  = Static;
+	size_t Len  = 0;
+
+	// Make space for n characters plus a null terminator. Existing content is discarded.
+	CH* Reserve(size_t n) {
+		if (n + 1 > N) {
+			delete[] Heap;
+			Heap = new CH[n + 1];
+			Buf  = Heap;
+		}
+		return Buf;
+	}
+};
+
+/** Convert UTF-8 to wchar_t, for passing to an OS function, without touching the heap unless the result is
+    longer than MAX_PATH. Use it for temporaries like this: CreateFileW(WideString(path).c_str(), ...)
+    **/
+class BMHPAL_API WideString : public SmallString<wchar_t, 260> {
+public:
+	WideString(const char* utf8, size_t len);
+	WideString(const std::string& utf8) : WideString(utf8.data(), utf8.size()) {}
+};
+
+/// The opposite of WideString
+class BMHPAL_API UTF8String : public SmallString<char, 260> {
+public:
+	UTF8String(const wchar_t* wide, size_t len);
+	UTF8String(const std::wstring& wide) : UTF8String(wide.data(), wide.size()) {}
+};
+
 /** Convert wchar_t (UTF16 or UTF32) to UTF8.
     @param src Source buffer. May be NULL, which is equivalent to making srcLen = 0.
     @param srcLen Length in characters of source. If -1, then we determine the length by looking for a null terminator.
@@ -200,6 +266,18 @@ ConversionResult BMHPAL_API ConvertUTF32toUTF16(const UTF32** sourceStart, const
 
 bool BMHPAL_API IsLegalUTF8Sequence(const UTF8* source, const UTF8* sourceEnd);
 
+/* Returns true if the entire buffer is legal UTF-8, ie if ConvertUTF8toUTF32 would succeed on it.
+   This is vectorized with SSSE3 or AVX2, if the CPU supports it. */
+bool BMHPAL_API IsLegalUTF8String(const UTF8* source, const UTF8* sourceEnd);
+
+/* The original byte-at-a-time implementations of ConvertUTF8toUTF16 and ConvertUTF8toUTF32. The
+   vectorized versions produce identical results, and these are exposed so that this can be tested. */
+ConversionResult BMHPAL_API ConvertUTF8toUTF16Scalar(const UTF8** sourceStart, const UTF8* sourceEnd,
+                                                     UTF16** targetStart, UTF16* targetEnd, ConversionFlags flags);
+
+ConversionResult BMHPAL_API ConvertUTF8toUTF32Scalar(const UTF8** sourceStart, const UTF8* sourceEnd,
+                                                     UTF32** targetStart, UTF32* targetEnd, ConversionFlags flags);
+
 } // namespace Unicode
 } // namespace bmhpal
 
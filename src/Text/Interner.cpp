@@ -0,0 +1,177 @@
+#include "pch.h"
+#include "Interner.h"
+#include "../Alloc.h"
+
+namespace bmhpal {
+namespace strings {
+
+const Interner::ID Interner::NotFound;
+
+Interner::Interner(size_t chunkSize) : ChunkSize(chunkSize) {
+}
+
+Interner::~Interner() {
+	for (auto& sh : Shards) {
+		for (char* c : sh.Chunks)
+			free(c);
+	}
+}
+
+uint64_t Interner::Hash(StringView s) {
+	return XXH64(s.data(), s.size(), 0);
+}
+
+static inline uint32_t StoredLen(const char* p) {
+	uint32_t len;
+	memcpy(&len, p - 4, 4);
+	return len;
+}
+
+// Returns the position of the slot that holds s, or the empty slot where s should go
+uint32_t Interner::FindSlot(const Shard& sh, StringView s, uint32_t hash) const {
+	uint32_t mask = (uint32_t) sh.Table.size() - 1;
+	for (uint32_t pos = hash & mask;; pos = (pos + 1) & mask) {
+		const Slot& slot = sh.Table[pos];
+		if (slot.Index == 0)
+			return pos;
+		if (slot.Hash == hash) {
+			uint32_t    i = slot.Index - 1;
+			const char* p = sh.Pages[i >> PageBits][i & (PageSize - 1)].load(std::memory_order_relaxed);
+			if (StoredLen(p) == s.size() && memcmp(p, s.data(), s.size()) == 0)
+				return pos;
+		}
+	}
+}
+
+// Copy s into the arena, preceded by its length, and followed by a null terminator
+const char* Interner::Store(Shard& sh, StringView s) {
+	size_t need = 4 + s.size() + 1;
+	// Keep the length prefix 4 byte aligned
+	sh.ChunkPos = (char*) (((uintptr_t) sh.ChunkPos + 3) & ~(uintptr_t) 3);
+	char* dst;
+	if (sh.ChunkPos + need <= sh.ChunkEnd) {
+		dst = sh.ChunkPos;
+		sh.ChunkPos += need;
+	} else if (need > ChunkSize / 4) {
+		// Give large strings their own block, so that we don't waste the rest of the current chunk
+		dst = (char*) malloc_or_die(need);
+		sh.Chunks.push_back(dst);
+		sh.ChunkBytes += need;
+	} else {
+		char* chunk = (char*) malloc_or_die(ChunkSize);
+		sh.Chunks.push_back(chunk);
+		sh.ChunkBytes += ChunkSize;
+		sh.ChunkPos = chunk + need;
+		sh.ChunkEnd = chunk + ChunkSize;
+		dst         = chunk;
+	}
+	uint32_t len = (uint32_t) s.size();
+	memcpy(dst, &len, 4);
+	memcpy(dst + 4, s.data(), s.size());
+	dst[4 + s.size()] = 0;
+	return dst + 4;
+}
+
+void Interner::Grow(Shard& sh) {
+	std::vector<Slot> old;
+	old.swap(sh.Table);
+	sh.Table.resize(old.empty() ? 64 : old.size() * 2, Slot{0, 0});
+	uint32_t mask = (uint32_t) sh.Table.size() - 1;
+	for (const auto& slot : old) {
+		if (slot.Index == 0)
+			continue;
+		uint32_t pos = slot.Hash & mask;
+		while (sh.Table[pos].Index != 0)
+			pos = (pos + 1) & mask;
+		sh.Table[pos] = slot;
+	}
+}
+
+void Interner::AddPage(Shard& sh) {
+	size_t n = sh.Pages.size();
+	if (n == sh.DirCapacity) {
+		// Readers may still be using the old directory, so we keep it alive
+		uint32_t  cap = std::max(sh.DirCapacity * 2, (uint32_t) 16);
+		DirEntry* dir = new DirEntry[cap];
+		for (size_t i = 0; i < n; i++)
+			dir[i].store(sh.Pages[i].get(), std::memory_order_relaxed);
+		sh.Dirs.emplace_back(dir);
+		sh.DirCapacity = cap;
+		sh.Dir.store(dir, std::memory_order_release);
+	}
+	sh.Pages.emplace_back(new PageEntry[PageSize]);
+	sh.Dirs.back()[n].store(sh.Pages.back().get(), std::memory_order_release);
+}
+
+Interner::ID Interner::Intern(StringView s) {
+	uint64_t h     = Hash(s);
+	uint32_t shard = (uint32_t) (h >> (64 - ShardBits));
+	uint32_t h32   = (uint32_t) h;
+	Shard&   sh    = Shards[shard];
+
+	std::lock_guard<std::mutex> lock(sh.Lock);
+	if (sh.Table.empty())
+		Grow(sh);
+	uint32_t pos = FindSlot(sh, s, h32);
+	if (sh.Table[pos].Index != 0)
+		return ((sh.Table[pos].Index - 1) << ShardBits) | shard;
+
+	// The top index of the last shard would collide with NotFound
+	BMHPAL_ASSERT(sh.Count < (1u << (32 - ShardBits)) - 1);
+	if ((sh.Count + 1) * 4 > sh.Table.size() * 3) {
+		Grow(sh);
+		pos = FindSlot(sh, s, h32);
+	}
+	uint32_t idx = sh.Count++;
+	if (idx % PageSize == 0)
+		AddPage(sh);
+	sh.Pages.back()[idx % PageSize].store(Store(sh, s), std::memory_order_release);
+	sh.Table[pos] = Slot{h32, idx + 1};
+	return (idx << ShardBits) | shard;
+}
+
+Interner::ID Interner::Find(StringView s) const {
+	uint64_t     h     = Hash(s);
+	uint32_t     shard = (uint32_t) (h >> (64 - ShardBits));
+	const Shard& sh    = Shards[shard];
+
+	std::lock_guard<std::mutex> lock(sh.Lock);
+	if (sh.Table.empty())
+		return NotFound;
+	uint32_t pos = FindSlot(sh, s, (uint32_t) h);
+	if (sh.Table[pos].Index == 0)
+		return NotFound;
+	return ((sh.Table[pos].Index - 1) << ShardBits) | shard;
+}
+
+StringView Interner::Get(ID id) const {
+	const Shard& sh   = Shards[id & (NShards - 1)];
+	uint32_t     idx  = id >> ShardBits;
+	DirEntry*    dir  = sh.Dir.load(std::memory_order_acquire);
+	PageEntry*   page = dir[idx >> PageBits].load(std::memory_order_acquire);
+	const char*  p    = page[idx & (PageSize - 1)].load(std::memory_order_acquire);
+	return StringView(p, StoredLen(p));
+}
+
+size_t Interner::Size() const {
+	size_t n = 0;
+	for (const auto& sh : Shards) {
+		std::lock_guard<std::mutex> lock(sh.Lock);
+		n += sh.Count;
+	}
+	return n;
+}
+
+size_t Interner::BytesAllocated() const {
+	size_t n = 0;
+	for (const auto& sh : Shards) {
+		std::lock_guard<std::mutex> lock(sh.Lock);
+		n += sh.ChunkBytes + sh.Table.size() * sizeof(Slot) + sh.Pages.size() * PageSize * sizeof(PageEntry);
+		for (uint32_t cap = sh.DirCapacity; cap >= 16; cap /= 2)
+			n += cap * sizeof(DirEntry);
+	}
+	return n;
+}
+
+} // namespace strings
+} // namespace bmhpal
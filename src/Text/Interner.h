@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "StringView.h"
+
+namespace bmhpal {
+namespace strings {
+
+/*
+
+	String interning
+	================
+
+	Interner stores one copy of each distinct string, and identifies it by a 32-bit ID. Two strings
+	that were interned into the same Interner are equal if and only if their IDs are equal, so
+	comparisons are O(1), and the ID can be used as a cheap hash key in place of the string.
+
+	Strings are copied into large arena chunks, so there is no per-string heap allocation, and the
+	bytes never move. The views returned by Get, and the pointers returned by CStr, are valid for
+	the lifetime of the Interner.
+
+	The Interner is thread safe. It is split into shards by the xxHash of the string, each with its own
+	lock, arena and hash table. Get and CStr don't take any lock.
+
+	*/
+class BMHPAL_API Interner {
+public:
+	typedef uint32_t ID;
+	static const ID  NotFound = 0xffffffff;
+
+	Interner(size_t chunkSize = 64 * 1024);
+	~Interner();
+
+	ID          Intern(StringView s);     // Returns the ID of s, adding it if necessary
+	ID          Find(StringView s) const; // Returns the ID of s, or NotFound if s has not been interned
+	StringView  Get(ID id) const;         // Returns the string, which is also null terminated
+	const char* CStr(ID id) const { return Get(id).data(); }
+	size_t      Size() const;             // Number of distinct strings
+	size_t      BytesAllocated() const;   // Total memory used by arenas, hash tables and ID lookup pages
+
+private:
+	static const int      ShardBits = 4;
+	static const uint32_t NShards   = 1 << ShardBits;
+	static const int      PageBits  = 10;
+	static const uint32_t PageSize  = 1 << PageBits;
+
+	typedef std::atomic<const char*> PageEntry; // Pointer to the string's bytes, which are preceded by a uint32 length
+	typedef std::atomic<PageEntry*>  DirEntry;
+
+	struct Slot {
+		uint32_t Hash;
+		uint32_t Index; // 1 + the index of the string within its shard, or 0 if the slot is empty
+	};
+
+	struct Shard {
+		mutable std::mutex                        Lock;
+		std::vector<Slot>                         Table;
+		uint32_t                                  Count       = 0;
+		std::vector<char*>                        Chunks;
+		char*                                     ChunkPos    = nullptr;
+		char*                                     ChunkEnd    = nullptr;
+		size_t                                    ChunkBytes  = 0;
+		std::atomic<DirEntry*>                    Dir{nullptr};
+		uint32_t                                  DirCapacity = 0;
+		std::vector<std::unique_ptr<DirEntry[]>>  Dirs; // Old directories are kept alive for lock-free readers
+		std::vector<std::unique_ptr<PageEntry[]>> Pages;
+	};
+
+	size_t ChunkSize;
+	Shard  Shards[NShards];
+
+	static uint64_t Hash(StringView s);
+	uint32_t        FindSlot(const Shard& sh, StringView s, uint32_t hash) const;
+	const char*     Store(Shard& sh, StringView s);
+	void            Grow(Shard& sh);
+	void            AddPage(Shard& sh);
+};
+
+} // namespace strings
+} // namespace bmhpal
@@ -0,0 +1,257 @@
+#include "pch.h"
+#include "MultiMatcher.h"
+#include "Splitter.h"
+
+using namespace std;
+
+namespace bmhpal {
+namespace strings {
+
+const uint32_t MultiMatcher::NoMatch;
+
+MultiMatcher::MultiMatcher(const std::vector<std::string>& patterns, bool caseInsensitive) {
+	Compile(patterns, caseInsensitive);
+}
+
+void MultiMatcher::Compile(const std::vector<std::string>& patterns, bool caseInsensitive) {
+	Next.clear();
+	Out.clear();
+	Depth.clear();
+	PatternLen.clear();
+	StartBytes.clear();
+	MaxLen = 0;
+
+	// Assign a class to every byte that appears in a pattern. Class 0 is for all other bytes.
+	bool used[256] = {false};
+	for (const auto& p : patterns) {
+		for (char ch : p) {
+			uint8_t c = (uint8_t) ch;
+			if (caseInsensitive && c >= 'A' && c <= 'Z')
+				c += 'a' - 'A';
+			used[c] = true;
+		}
+	}
+	memset(ByteClass, 0, sizeof(ByteClass));
+	NClasses = 1;
+	for (int c = 0; c < 256; c++) {
+		if (used[c])
+			ByteClass[c] = (uint8_t) NClasses++;
+	}
+	if (NClasses > 256) {
+		// Every byte value is used, so classes are just byte values
+		for (int c = 0; c < 256; c++)
+			ByteClass[c] = (uint8_t) c;
+		NClasses = 256;
+	}
+	if (caseInsensitive) {
+		for (int c = 'A'; c <= 'Z'; c++)
+			ByteClass[c] = ByteClass[c + 'a' - 'A'];
+	}
+
+	// Build the trie. 0 is the root, and no trie edge leads back to the root, so a 0 in Next means "no child".
+	Next.resize(NClasses, 0);
+	Out.push_back(NoMatch);
+	Depth.push_back(0);
+	for (size_t i = 0; i < patterns.size(); i++) {
+		const auto& p = patterns[i];
+		PatternLen.push_back((uint32_t) p.size());
+		if (p.empty())
+			continue;
+		MaxLen         = std::max(MaxLen, p.size());
+		uint32_t state = 0;
+		for (char ch : p) {
+			size_t   slot = state * NClasses + ByteClass[(uint8_t) ch];
+			uint32_t next = Next[slot];
+			if (next == 0) {
+				next       = (uint32_t) Out.size();
+				Next[slot] = next;
+				Next.resize(Next.size() + NClasses, 0);
+				Out.push_back(NoMatch);
+				Depth.push_back(Depth[state] + 1);
+			}
+			state = next;
+		}
+		if (Out[state] == NoMatch)
+			Out[state] = (uint32_t) i;
+	}
+
+	// Breadth first, fill in the failure transitions, so that Next becomes a DFA
+	vector<uint32_t> fail(Out.size(), 0);
+	vector<uint32_t> queue;
+	queue.push_back(0);
+	for (size_t q = 0; q < queue.size(); q++) {
+		uint32_t  u   = queue[q];
+		uint32_t* row = &Next[u * NClasses];
+		for (uint32_t c = 0; c < NClasses; c++) {
+			uint32_t v = row[c];
+			if (v != 0) {
+				fail[v] = u == 0 ? 0 : Next[fail[u] * NClasses + c];
+				if (Out[v] == NoMatch)
+					Out[v] = Out[fail[v]];
+				queue.push_back(v);
+			} else if (u != 0) {
+				row[c] = Next[fail[u] * NClasses + c];
+			}
+		}
+	}
+
+	for (int b = 0; b < 256; b++) {
+		if (Next[ByteClass[b]] != 0)
+			StartBytes += (char) b;
+	}
+}
+
+template <typename EMIT>
+size_t MultiMatcher::ScanT(const char* s, size_t len, bool final, EMIT emit) const {
+	const uint32_t* next     = Next.data();
+	const uint32_t  nc       = NClasses;
+	const size_t    none     = (size_t) -1;
+	bool            skip     = !StartBytes.empty() && StartBytes.size() <= 8;
+	uint32_t        state    = 0;
+	size_t          i        = 0;
+	size_t          candPos  = none;
+	size_t          candLen  = 0;
+	size_t          candPatt = 0;
+	if (MaxLen == 0)
+		return len;
+
+	while (true) {
+		while (i < len) {
+			if (state == 0 && skip) {
+				// There can be no pending candidate in the root state, so jump to the next byte that could start a match
+				const char* p = FindAnyOf(s + i, len - i, StartBytes.data(), StartBytes.size());
+				if (!p) {
+					i = len;
+					break;
+				}
+				i = p - s;
+			}
+			state = next[state * nc + ByteClass[(uint8_t) s[i]]];
+			i++;
+			uint32_t o = Out[state];
+			if (o != NoMatch) {
+				size_t plen  = PatternLen[o];
+				size_t start = i - plen;
+				if (candPos == none || start < candPos || (start == candPos && plen > candLen)) {
+					candPos  = start;
+					candLen  = plen;
+					candPatt = o;
+				}
+			}
+			if (candPos != none && i - Depth[state] > candPos) {
+				// No future match can start at or before candPos, so the candidate is final
+				if (!emit(Match{candPos, candLen, candPatt}))
+					return i;
+				i       = candPos + candLen;
+				state   = 0;
+				candPos = none;
+			}
+		}
+		if (candPos == none)
+			break;
+		if (!final) {
+			// A partial match that starts before the candidate could still beat it
+			return std::min(candPos, len - Depth[state]);
+		}
+		if (!emit(Match{candPos, candLen, candPatt}))
+			return len;
+		i       = candPos + candLen;
+		state   = 0;
+		candPos = none;
+	}
+	return final ? len : len - Depth[state];
+}
+
+size_t MultiMatcher::Scan(const char* s, size_t len, bool final, const std::function<void(const Match& m)>& emit) const {
+	return ScanT(s, len, final, [&](const Match& m) {
+		emit(m);
+		return true;
+	});
+}
+
+bool MultiMatcher::Find(StringView s, Match& m) const {
+	bool found = false;
+	ScanT(s.data(), s.size(), true, [&](const Match& match) {
+		m     = match;
+		found = true;
+		return false;
+	});
+	return found;
+}
+
+void MultiMatcher::FindAll(StringView s, std::vector<Match>& matches) const {
+	ScanT(s.data(), s.size(), true, [&](const Match& m) {
+		matches.push_back(m);
+		return true;
+	});
+}
+
+std::string MultiMatcher::ReplaceAll(StringView s, const std::vector<std::string>& replacements) const {
+	string out;
+	ReplaceAll(s, replacements, out);
+	return out;
+}
+
+void MultiMatcher::ReplaceAll(StringView s, const std::vector<std::string>& replacements, std::string& out) const {
+	size_t last = 0;
+	ScanT(s.data(), s.size(), true, [&](const Match& m) {
+		out.append(s.data() + last, m.Pos - last);
+		out += replacements[m.Pattern];
+		last = m.Pos + m.Len;
+		return true;
+	});
+	out.append(s.data() + last, s.size() - last);
+}
+
+MultiMatchStream::MultiMatchStream(const MultiMatcher& matcher, MatchCallback onMatch) : Matcher(matcher), OnMatch(onMatch) {
+}
+
+MultiMatchStream::MultiMatchStream(const MultiMatcher& matcher, const std::vector<std::string>& replacements, OutputCallback onOutput) : Matcher(matcher), Replacements(&replacements), OnOutput(onOutput) {
+}
+
+void MultiMatchStream::Write(const void* buf, size_t len) {
+	if (Pending.empty()) {
+		// Scan the caller's buffer directly, and only keep the undecided tail
+		size_t decided = Process((const char*) buf, len, false);
+		Pending.assign((const char*) buf + decided, len - decided);
+	} else {
+		Pending.append((const char*) buf, len);
+		size_t decided = Process(Pending.data(), Pending.size(), false);
+		Pending.erase(0, decided);
+	}
+}
+
+void MultiMatchStream::Finish() {
+	Process(Pending.data(), Pending.size(), true);
+	Pending.clear();
+	PendingPos = 0;
+}
+
+// s is the stream starting at PendingPos. Returns the number of bytes consumed.
+size_t MultiMatchStream::Process(const char* s, size_t len, bool final) {
+	size_t decided;
+	if (Replacements) {
+		Out.clear();
+		size_t last    = 0;
+		auto   replace = [&](const MultiMatcher::Match& m) {
+			Out.append(s + last, m.Pos - last);
+			Out += (*Replacements)[m.Pattern];
+			last = m.Pos + m.Len;
+		};
+		decided = Matcher.Scan(s, len, final, replace);
+		Out.append(s + last, decided - last);
+		if (Out.size() != 0)
+			OnOutput(Out.data(), Out.size());
+	} else {
+		size_t base  = PendingPos;
+		auto   match = [&](const MultiMatcher::Match& m) {
+			OnMatch(MultiMatcher::Match{base + m.Pos, m.Len, m.Pattern});
+		};
+		decided = Matcher.Scan(s, len, final, match);
+	}
+	PendingPos += decided;
+	return decided;
+}
+
+} // namespace strings
+} // namespace bmhpal
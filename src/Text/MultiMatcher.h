@@ -0,0 +1,104 @@
+#pragma once
+
+#include <functional>
+#include "StringView.h"
+
+namespace bmhpal {
+namespace strings {
+
+/*
+
+	Multi-pattern search
+	====================
+
+	MultiMatcher compiles a set of patterns into an Aho-Corasick automaton, so that a buffer can be
+	searched for all of the patterns in a single pass, regardless of how many patterns there are.
+
+	Matches are leftmost-longest and non-overlapping: at every position, the earliest starting match
+	wins, and of the patterns that start there, the longest wins. This is the same result that you'd
+	get from a regex alternation with POSIX semantics, and it's what you want for search and replace.
+
+	The input alphabet is compressed into byte classes (bytes that appear in no pattern share a single
+	class), which keeps the transition table small enough to stay in cache with hundreds of patterns.
+	While the automaton is in its root state, we skip ahead to the next byte that can begin a pattern,
+	using a vectorized scan when there are few such bytes.
+
+	Empty patterns are ignored.
+
+	*/
+
+class BMHPAL_API MultiMatcher {
+public:
+	struct Match {
+		size_t Pos;     // Byte offset of the match
+		size_t Len;     // Length of the match
+		size_t Pattern; // Index of the pattern that matched
+
+		bool operator==(const Match& b) const { return Pos == b.Pos && Len == b.Len && Pattern == b.Pattern; }
+	};
+
+	MultiMatcher() {}
+	MultiMatcher(const std::vector<std::string>& patterns, bool caseInsensitive = false);
+
+	// Replace any existing patterns. If caseInsensitive, then ASCII letters match either case.
+	void Compile(const std::vector<std::string>& patterns, bool caseInsensitive = false);
+
+	size_t NumPatterns() const { return PatternLen.size(); }
+	size_t MaxPatternLen() const { return MaxLen; }
+
+	bool        Find(StringView s, Match& m) const;                      // Find the first match
+	void        FindAll(StringView s, std::vector<Match>& matches) const; // Append all matches
+	std::string ReplaceAll(StringView s, const std::vector<std::string>& replacements) const;
+	void        ReplaceAll(StringView s, const std::vector<std::string>& replacements, std::string& out) const; // Append to out
+
+	// Scan s, calling emit for every match. If final is false, then s is a prefix of a longer input, and we stop at the
+	// point where the next match could depend on bytes that we haven't seen yet. Returns the number of bytes that
+	// are fully decided. Matches are never emitted past this point. This is the building block of MultiMatchStream.
+	size_t Scan(const char* s, size_t len, bool final, const std::function<void(const Match& m)>& emit) const;
+
+private:
+	static const uint32_t NoMatch = 0xffffffff;
+
+	std::vector<uint32_t> Next;       // Transition table, indexed by state * NClasses + class
+	std::vector<uint32_t> Out;        // Longest pattern that ends at each state, or NoMatch
+	std::vector<uint32_t> Depth;      // Length of the prefix that each state represents
+	std::vector<uint32_t> PatternLen; // Length of each pattern
+	uint8_t               ByteClass[256];
+	uint32_t              NClasses = 1;
+	size_t                MaxLen   = 0;
+	std::string           StartBytes; // Bytes that leave the root state
+
+	template <typename EMIT>
+	size_t ScanT(const char* s, size_t len, bool final, EMIT emit) const;
+};
+
+// Streaming search or replace, for input that arrives in chunks of any size.
+// Only the bytes that could still be part of a match are retained between chunks.
+class BMHPAL_API MultiMatchStream {
+public:
+	typedef std::function<void(const MultiMatcher::Match& m)> MatchCallback;  // Match::Pos is relative to the start of the stream
+	typedef std::function<void(const char* buf, size_t len)>  OutputCallback; // Receives the output of search and replace
+
+	// Search. The matcher must outlive the stream.
+	MultiMatchStream(const MultiMatcher& matcher, MatchCallback onMatch);
+
+	// Search and replace. The matcher and replacements must outlive the stream.
+	MultiMatchStream(const MultiMatcher& matcher, const std::vector<std::string>& replacements, OutputCallback onOutput);
+
+	void Write(const void* buf, size_t len);
+	void Finish(); // Flush the remaining input. The stream can be reused after this.
+
+private:
+	const MultiMatcher&             Matcher;
+	const std::vector<std::string>* Replacements = nullptr;
+	MatchCallback                   OnMatch;
+	OutputCallback                  OnOutput;
+	std::string                     Pending;        // Undecided bytes
+	size_t                          PendingPos = 0; // Stream offset of Pending[0]
+	std::string                     Out;
+
+	size_t Process(const char* s, size_t len, bool final);
+};
+
+} // namespace strings
+} // namespace bmhpal
@@ -0,0 +1,293 @@
+#include "pch.h"
+#include "Numeric.h"
+#include "../Math_.h"
+
+using namespace std;
+
+namespace bmhpal {
+namespace numeric {
+
+BMHPAL_API StaticError ErrInvalidNumber("Invalid number");
+BMHPAL_API StaticError ErrNumberOutOfRange("Number out of range");
+
+// Python: "".join("%02d" % i for i in range(100))
+static const char DigitPairs[201] = "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+                                    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+                                    "8081828384858687888990919293949596979899";
+
+static const uint64_t PowersOf10[20] = {1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull};
+
+// Exact powers of 10 that can be represented by a double
+static const double ExactPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static inline bool IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+static inline unsigned CountDigits(uint64_t v) {
+	// 1233/4096 is a little more than log10(2), so t is either the number of digits, or one too many.
+	// Zero has one digit, like 1.
+	v             = v | 1;
+	unsigned bits = 64 - CountLeadingZeros64(v);
+	unsigned t    = (bits * 1233) >> 12;
+	return t + 1 - (v < PowersOf10[t]);
+}
+
+BMHPAL_API size_t FormatUInt(uint64_t v, char* buf) {
+	// Knowing the length up front lets us write the digits directly into place, two at a time
+	size_t len = CountDigits(v);
+	char*  p   = buf + len;
+	while (v >= 100) {
+		unsigned d = (unsigned) (v % 100) * 2;
+		v /= 100;
+		p -= 2;
+		p[0] = DigitPairs[d];
+		p[1] = DigitPairs[d + 1];
+	}
+	if (v >= 10) {
+		p[-2] = DigitPairs[v * 2];
+		p[-1] = DigitPairs[v * 2 + 1];
+	} else {
+		p[-1] = '0' + (char) v;
+	}
+	return len;
+}
+
+BMHPAL_API size_t FormatInt(int64_t v, char* buf) {
+	if (v >= 0)
+		return FormatUInt((uint64_t) v, buf);
+	buf[0] = '-';
+	return 1 + FormatUInt(0 - (uint64_t) v, buf + 1);
+}
+
+BMHPAL_API size_t FormatDouble(double v, char* buf) {
+	if (std::isnan(v)) {
+		memcpy(buf, "nan", 3);
+		return 3;
+	} else if (std::isinf(v)) {
+		if (v < 0) {
+			memcpy(buf, "-inf", 4);
+			return 4;
+		}
+		memcpy(buf, "inf", 3);
+		return 3;
+	}
+	return nlohmann::detail::to_chars(buf, buf + MaxDoubleLen, v) - buf;
+}
+
+BMHPAL_API std::string IntToString(int64_t v) {
+	char buf[MaxIntLen];
+	return string(buf, FormatInt(v, buf));
+}
+
+BMHPAL_API std::string UIntToString(uint64_t v) {
+	char buf[MaxIntLen];
+	return string(buf, FormatUInt(v, buf));
+}
+
+BMHPAL_API std::string DoubleToString(double v) {
+	char buf[MaxDoubleLen];
+	return string(buf, FormatDouble(v, buf));
+}
+
+// Parse digits into v. Returns the position after the digits, or s if there are none.
+static const char* ParseDigits(const char* s, const char* end, uint64_t& v, bool& overflow) {
+	const char* p = s;
+	uint64_t    x = 0;
+	overflow      = false;
+	for (; p != end && IsDigit(*p); p++) {
+		unsigned d = *p - '0';
+		if (x > (UINT64_MAX - d) / 10)
+			overflow = true;
+		x = x * 10 + d;
+	}
+	v = x;
+	return p;
+}
+
+BMHPAL_API ParseResult ParseUInt(const char* s, const char* end, uint64_t& v) {
+	uint64_t    x;
+	bool        overflow;
+	const char* p = ParseDigits(s, end, x, overflow);
+	if (p == s)
+		return ParseResult{s, ErrInvalidNumber};
+	if (overflow)
+		return ParseResult{p, ErrNumberOutOfRange};
+	v = x;
+	return ParseResult{p, Error()};
+}
+
+BMHPAL_API ParseResult ParseInt(const char* s, const char* end, int64_t& v) {
+	bool        neg   = s != end && *s == '-';
+	const char* start = neg ? s + 1 : s;
+	uint64_t    x;
+	bool        overflow;
+	const char* p = ParseDigits(start, end, x, overflow);
+	if (p == start)
+		return ParseResult{s, ErrInvalidNumber};
+	if (overflow || x > (uint64_t) INT64_MAX + (neg ? 1 : 0))
+		return ParseResult{p, ErrNumberOutOfRange};
+	v = neg ? (int64_t) (0 - x) : (int64_t) x;
+	return ParseResult{p, Error()};
+}
+
+BMHPAL_API ParseResult ParseInt(const char* s, const char* end, int32_t& v) {
+	int64_t x;
+	auto    r = ParseInt(s, end, x);
+	if (r.Err.OK()) {
+		if (x < INT32_MIN || x > INT32_MAX)
+			r.Err = ErrNumberOutOfRange;
+		else
+			v = (int32_t) x;
+	}
+	return r;
+}
+
+// Returns true if s starts with word (which is lowercase), compared case insensitively
+static bool MatchWordNoCase(const char* s, const char* end, const char* word) {
+	size_t n = strlen(word);
+	if ((size_t) (end - s) < n)
+		return false;
+	for (size_t i = 0; i < n; i++) {
+		char c = s[i];
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		if (c != word[i])
+			return false;
+	}
+	return true;
+}
+
+BMHPAL_API ParseResult ParseDouble(const char* s, const char* end, double& v) {
+	const char* p   = s;
+	bool        neg = false;
+	if (p != end && *p == '-') {
+		neg = true;
+		p++;
+	}
+
+	if (p != end && (*p == 'i' || *p == 'I' || *p == 'n' || *p == 'N')) {
+		double special;
+		if (MatchWordNoCase(p, end, "infinity")) {
+			p += 8;
+			special = std::numeric_limits<double>::infinity();
+		} else if (MatchWordNoCase(p, end, "inf")) {
+			p += 3;
+			special = std::numeric_limits<double>::infinity();
+		} else if (MatchWordNoCase(p, end, "nan")) {
+			p += 3;
+			special = std::numeric_limits<double>::quiet_NaN();
+		} else {
+			return ParseResult{s, ErrInvalidNumber};
+		}
+		v = neg ? -special : special;
+		return ParseResult{p, Error()};
+	}
+
+	// Accumulate up to 19 significant digits, which always fit into a uint64
+	uint64_t mantissa  = 0;
+	int      nDigits   = 0;
+	int      exp10     = 0;
+	bool     anyDigits = false;
+	bool     truncated = false;
+	for (; p != end && IsDigit(*p); p++) {
+		anyDigits = true;
+		if (nDigits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			nDigits += mantissa != 0;
+		} else {
+			exp10++;
+			truncated |= *p != '0';
+		}
+	}
+	if (p != end && *p == '.') {
+		const char* frac = ++p;
+		for (; p != end && IsDigit(*p); p++) {
+			if (nDigits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				nDigits += mantissa != 0;
+				exp10--;
+			} else {
+				truncated |= *p != '0';
+			}
+		}
+		anyDigits |= p != frac;
+	}
+	if (!anyDigits)
+		return ParseResult{s, ErrInvalidNumber};
+
+	// The exponent is only consumed if it has at least one digit
+	if (p != end && (*p == 'e' || *p == 'E')) {
+		const char* q      = p + 1;
+		bool        expNeg = false;
+		if (q != end && (*q == '+' || *q == '-')) {
+			expNeg = *q == '-';
+			q++;
+		}
+		if (q != end && IsDigit(*q)) {
+			int e = 0;
+			for (; q != end && IsDigit(*q); q++) {
+				if (e < 100000)
+					e = e * 10 + (*q - '0');
+			}
+			exp10 += expNeg ? -e : e;
+			p = q;
+		}
+	}
+
+	double d;
+	if (mantissa == 0) {
+		d = 0;
+	} else if (!truncated && mantissa <= ((uint64_t) 1 << 53) && exp10 >= -22 && exp10 <= 22) {
+		// Clinger's fast path. Both operands are exact, so the result is correctly rounded.
+		d = (double) mantissa;
+		d = exp10 < 0 ? d / ExactPow10[-exp10] : d * ExactPow10[exp10];
+	} else {
+		// strtod needs a null terminated string, and our source buffer may end right after the number
+		const char* start = neg ? s + 1 : s;
+		char        buf[64];
+		size_t      len = p - start;
+		if (len < sizeof(buf)) {
+			memcpy(buf, start, len);
+			buf[len] = 0;
+			d        = strtod(buf, nullptr);
+		} else {
+			d = strtod(string(start, len).c_str(), nullptr);
+		}
+	}
+	if (std::isinf(d))
+		return ParseResult{p, ErrNumberOutOfRange};
+	v = neg ? -d : d;
+	return ParseResult{p, Error()};
+}
+
+template <typename T, typename PARSE>
+Error ParseAll(strings::StringView s, T& v, PARSE parse) {
+	T    x;
+	auto r = parse(s.data(), s.data() + s.size(), x);
+	if (!r.Err.OK())
+		return r.Err;
+	if (r.Ptr != s.data() + s.size())
+		return ErrInvalidNumber;
+	v = x;
+	return Error();
+}
+
+BMHPAL_API Error ParseInt(strings::StringView s, int64_t& v) {
+	return ParseAll(s, v, [](const char* a, const char* b, int64_t& x) { return ParseInt(a, b, x); });
+}
+
+BMHPAL_API Error ParseInt(strings::StringView s, int32_t& v) {
+	return ParseAll(s, v, [](const char* a, const char* b, int32_t& x) { return ParseInt(a, b, x); });
+}
+
+BMHPAL_API Error ParseUInt(strings::StringView s, uint64_t& v) {
+	return ParseAll(s, v, [](const char* a, const char* b, uint64_t& x) { return ParseUInt(a, b, x); });
+}
+
+BMHPAL_API Error ParseDouble(strings::StringView s, double& v) {
+	return ParseAll(s, v, [](const char* a, const char* b, double& x) { return ParseDouble(a, b, x); });
+}
+
+} // namespace numeric
+} // namespace bmhpal
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../Error/Error.h"
+#include "StringView.h"
+
+namespace bmhpal {
+namespace numeric {
+
+/*
+
+	Number formatting and parsing
+	=============================
+
+	The Format functions write into a caller-supplied buffer, do not add a null terminator, and return
+	the number of characters written. Integers are formatted two digits at a time from a lookup table,
+	after computing the number of digits up front, so they're written in place without a reversal pass.
+	Doubles are formatted with Grisu2, which produces the shortest representation that round trips.
+
+	The Parse functions behave like C++17's std::from_chars. They don't skip whitespace, and don't
+	accept a leading '+'. They return the position after the number, and an error, which is one of:
+
+		ErrInvalidNumber     No number was found. Ptr is s.
+		ErrNumberOutOfRange  The number doesn't fit into the result type. Ptr is after the number.
+
+	On error, the output value is not modified.
+
+	*/
+
+extern BMHPAL_API StaticError ErrInvalidNumber;
+extern BMHPAL_API StaticError ErrNumberOutOfRange;
+
+const size_t MaxIntLen    = 20; // Longest output of FormatInt and FormatUInt
+const size_t MaxDoubleLen = 32; // Size of the buffer that FormatDouble needs
+
+BMHPAL_API size_t FormatUInt(uint64_t v, char* buf);
+BMHPAL_API size_t FormatInt(int64_t v, char* buf);
+BMHPAL_API size_t FormatDouble(double v, char* buf); // NaN and infinity are written as "nan", "inf" and "-inf"
+
+BMHPAL_API std::string IntToString(int64_t v);
+BMHPAL_API std::string UIntToString(uint64_t v);
+BMHPAL_API std::string DoubleToString(double v);
+
+struct ParseResult {
+	const char* Ptr; // First character that was not consumed
+	Error       Err;
+};
+
+BMHPAL_API ParseResult ParseInt(const char* s, const char* end, int64_t& v);
+BMHPAL_API ParseResult ParseInt(const char* s, const char* end, int32_t& v);
+BMHPAL_API ParseResult ParseUInt(const char* s, const char* end, uint64_t& v);
+BMHPAL_API ParseResult ParseDouble(const char* s, const char* end, double& v); // Also accepts "inf", "infinity" and "nan", in any case
+
+// Parse the whole of s, which must contain only the number
+BMHPAL_API Error ParseInt(strings::StringView s, int64_t& v);
+BMHPAL_API Error ParseInt(strings::StringView s, int32_t& v);
+BMHPAL_API Error ParseUInt(strings::StringView s, uint64_t& v);
+BMHPAL_API Error ParseDouble(strings::StringView s, double& v);
+
+} // namespace numeric
+} // namespace bmhpal
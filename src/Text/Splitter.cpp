@@ -0,0 +1,127 @@
+#include "pch.h"
+#include "Splitter.h"
+#include "../Math_.h"
+
+#ifdef BMHPAL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace bmhpal {
+namespace strings {
+
+static void BuildSet(const char* set, size_t setLen, uint32_t* bitmap) {
+	memset(bitmap, 0, 32);
+	for (size_t i = 0; i < setLen; i++) {
+		uint8_t c = (uint8_t) set[i];
+		bitmap[c >> 5] |= 1u << (c & 31);
+	}
+}
+
+static inline bool InSet(const uint32_t* bitmap, char c) {
+	uint8_t u = (uint8_t) c;
+	return (bitmap[u >> 5] & (1u << (u & 31))) != 0;
+}
+
+static const char* FindAnyOfT(const char* s, size_t len, const char* set, size_t setLen, const uint32_t* bitmap) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	// One compare per set member, so this only pays off for small sets
+	if (setLen <= 8) {
+		__m128i sets[8];
+		for (size_t j = 0; j < setLen; j++)
+			sets[j] = _mm_set1_epi8(set[j]);
+		for (; i + 16 <= len; i += 16) {
+			__m128i c   = _mm_loadu_si128((const __m128i*) (s + i));
+			__m128i hit = _mm_setzero_si128();
+			for (size_t j = 0; j < setLen; j++)
+				hit = _mm_or_si128(hit, _mm_cmpeq_epi8(c, sets[j]));
+			int m = _mm_movemask_epi8(hit);
+			if (m != 0)
+				return s + i + CountTrailingZeros((uint32_t) m);
+		}
+	}
+#endif
+	for (; i < len; i++) {
+		if (InSet(bitmap, s[i]))
+			return s + i;
+	}
+	return nullptr;
+}
+
+BMHPAL_API const char* FindAnyOf(const char* s, size_t len, const char* set, size_t setLen) {
+	if (setLen == 1)
+		return (const char*) memchr(s, set[0], len);
+	uint32_t bitmap[8];
+	BuildSet(set, setLen, bitmap);
+	return FindAnyOfT(s, len, set, setLen, bitmap);
+}
+
+Splitter::Splitter(StringView s, char delim) {
+	P        = s.data();
+	End      = s.data() + s.size();
+	Finished = s.empty();
+	Mode     = SplitModes::Char;
+	Delim    = delim;
+}
+
+Splitter::Splitter(StringView s, StringView delim, SplitModes mode, bool skipEmpty) {
+	P         = s.data();
+	End       = s.data() + s.size();
+	Finished  = s.empty();
+	SkipEmpty = skipEmpty;
+	Mode      = mode;
+	Delims    = delim;
+	if (Mode != SplitModes::Char && Delims.size() == 1) {
+		// A single character is the same in all three modes, and memchr is the fastest way to find it
+		Mode  = SplitModes::Char;
+		Delim = Delims[0];
+	} else if (Mode == SplitModes::Char) {
+		Delim = Delims.empty() ? 0 : Delims[0];
+	} else if (Mode == SplitModes::AnyOf) {
+		BuildSet(Delims.data(), Delims.size(), Set);
+	}
+}
+
+const char* Splitter::FindDelim(const char* s, const char* end) const {
+	switch (Mode) {
+	case SplitModes::Char:
+		return (const char*) memchr(s, Delim, end - s);
+	case SplitModes::AnyOf:
+		return FindAnyOfT(s, end - s, Delims.data(), Delims.size(), Set);
+	case SplitModes::String: {
+		size_t dlen = Delims.size();
+		if (dlen == 0)
+			return nullptr;
+		while ((size_t) (end - s) >= dlen) {
+			s = (const char*) memchr(s, Delims[0], end - s - dlen + 1);
+			if (!s)
+				return nullptr;
+			if (memcmp(s + 1, Delims.data() + 1, dlen - 1) == 0)
+				return s;
+			s++;
+		}
+		return nullptr;
+	}
+	}
+	return nullptr;
+}
+
+bool Splitter::Next(StringView& field) {
+	while (!Finished) {
+		const char* hit = FindDelim(P, End);
+		if (hit) {
+			field = StringView(P, hit - P);
+			P     = hit + (Mode == SplitModes::String ? Delims.size() : 1);
+		} else {
+			field    = StringView(P, End - P);
+			P        = End;
+			Finished = true;
+		}
+		if (!SkipEmpty || !field.empty())
+			return true;
+	}
+	return false;
+}
+
+} // namespace strings
+} // namespace bmhpal
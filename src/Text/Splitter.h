@@ -0,0 +1,115 @@
+#pragma once
+
+#include "StringView.h"
+
+namespace bmhpal {
+namespace strings {
+
+/*
+
+	Lazy string splitting
+	=====================
+
+	Splitter yields each field as a StringView into the source string, so splitting does not allocate.
+	The source string must outlive the Splitter and the views that it produces.
+
+		for (auto field : strings::SplitView(line, ','))
+			...
+
+		strings::Splitter tok = strings::Tokenize(text, " \t\r\n");
+		strings::StringView word;
+		while (tok.Next(word))
+			...
+
+	A string containing N delimiters produces N+1 fields, except for an empty string, which produces
+	no fields. Tokenize is the exception: it never produces empty fields, so consecutive delimiters
+	are treated as one.
+
+	*/
+
+enum class SplitModes {
+	Char,   // Delimiter is a single character
+	String, // Delimiter is a multi-character string
+	AnyOf,  // Any one of the characters in the delimiter string is a delimiter
+};
+
+class SplitIterator;
+
+class BMHPAL_API Splitter {
+public:
+	Splitter() {}
+	Splitter(StringView s, char delim);
+	Splitter(StringView s, StringView delim, SplitModes mode, bool skipEmpty = false);
+
+	bool          Next(StringView& field); // Returns false when there are no more fields
+	SplitIterator begin() const;
+	SplitIterator end() const;
+
+	// Returns the unconsumed part of the string
+	StringView Remaining() const { return Finished ? StringView() : StringView(P, End - P); }
+
+private:
+	const char* P         = nullptr;
+	const char* End       = nullptr;
+	bool        Finished  = true;
+	bool        SkipEmpty = false;
+	SplitModes  Mode      = SplitModes::Char;
+	char        Delim     = 0;
+	StringView  Delims;
+	uint32_t    Set[8]    = {0}; // Bitmap of the bytes in Delims, for AnyOf
+
+	const char* FindDelim(const char* s, const char* end) const;
+};
+
+class SplitIterator {
+public:
+	SplitIterator() {}
+	SplitIterator(const Splitter& s) : S(s) { Done = !S.Next(Field); }
+
+	StringView        operator*() const { return Field; }
+	const StringView* operator->() const { return &Field; }
+	SplitIterator&    operator++() {
+		Done = !S.Next(Field);
+		return *this;
+	}
+	bool operator!=(const SplitIterator& b) const { return Done != b.Done; }
+	bool operator==(const SplitIterator& b) const { return Done == b.Done; }
+
+private:
+	Splitter   S;
+	StringView Field;
+	bool       Done = true;
+};
+
+inline SplitIterator Splitter::begin() const {
+	return SplitIterator(*this);
+}
+
+inline SplitIterator Splitter::end() const {
+	return SplitIterator();
+}
+
+inline Splitter SplitView(StringView s, char delim) {
+	return Splitter(s, delim);
+}
+
+// Split on a multi-character delimiter, such as "\r\n" or ", "
+inline Splitter SplitView(StringView s, StringView delim) {
+	return Splitter(s, delim, SplitModes::String);
+}
+
+// Split on any of the characters in delims
+inline Splitter SplitAnyOf(StringView s, StringView delims) {
+	return Splitter(s, delims, SplitModes::AnyOf);
+}
+
+// Split on any of the characters in delims, and skip empty fields (like strtok)
+inline Splitter Tokenize(StringView s, StringView delims = " \t\r\n") {
+	return Splitter(s, delims, SplitModes::AnyOf, true);
+}
+
+// Returns a pointer to the first occurrence of any of the characters in set, or nullptr. Vectorized for sets of up to 8 characters.
+BMHPAL_API const char* FindAnyOf(const char* s, size_t len, const char* set, size_t setLen);
+
+} // namespace strings
+} // namespace bmhpal
@@ -1,4 +1,10 @@
 #include "pch.h"
+#include "StringUtils.h"
+#include "Numeric.h"
+
+#ifdef BMHPAL_SSE2
+#include <emmintrin.h>
+#endif
 
 namespace bmhpal {
 
@@ -33,10 +39,15 @@ size_t ItoAT(TINT value, TCH* result, int base) {
 }
 
 BMHPAL_API size_t ItoA(int value, char* result, int base) {
-	return ItoAT(value, result, base);
+	return I64toA(value, result, base);
 }
 
 BMHPAL_API size_t I64toA(int64_t value, char* result, int base) {
+	if (base == 10) {
+		size_t len  = numeric::FormatInt(value, result);
+		result[len] = 0;
+		return len;
+	}
 	return ItoAT(value, result, base);
 }
 
@@ -64,6 +75,62 @@ inline char ToLowerChar(char c) {
 		return c;
 }
 
+#ifdef BMHPAL_SSE2
+// Returns 0xff in every byte of c that is between lo and hi inclusive, for ASCII lo and hi
+static inline __m128i InRange(__m128i c, char lo, char hi) {
+	// Bytes >= 0x80 are negative, so they're never in range
+	return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8(hi + 1)));
+}
+
+static inline __m128i ToLower16(__m128i c) {
+	return _mm_or_si128(c, _mm_and_si128(InRange(c, 'A', 'Z'), _mm_set1_epi8(0x20)));
+}
+#endif
+
+BMHPAL_API void ToUpperInPlace(char* s, size_t len) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	for (; i + 16 <= len; i += 16) {
+		__m128i c = _mm_loadu_si128((const __m128i*) (s + i));
+		c         = _mm_xor_si128(c, _mm_and_si128(InRange(c, 'a', 'z'), _mm_set1_epi8(0x20)));
+		_mm_storeu_si128((__m128i*) (s + i), c);
+	}
+#endif
+	for (; i < len; i++) {
+		if (s[i] >= 'a' && s[i] <= 'z')
+			s[i] -= 'a' - 'A';
+	}
+}
+
+BMHPAL_API void ToLowerInPlace(char* s, size_t len) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	for (; i + 16 <= len; i += 16)
+		_mm_storeu_si128((__m128i*) (s + i), ToLower16(_mm_loadu_si128((const __m128i*) (s + i))));
+#endif
+	for (; i < len; i++)
+		s[i] = ToLowerChar(s[i]);
+}
+
+BMHPAL_API bool EqualsNoCase(const char* a, size_t aLen, const char* b, size_t bLen) {
+	if (aLen != bLen)
+		return false;
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	for (; i + 16 <= aLen; i += 16) {
+		__m128i la = ToLower16(_mm_loadu_si128((const __m128i*) (a + i)));
+		__m128i lb = ToLower16(_mm_loadu_si128((const __m128i*) (b + i)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(la, lb)) != 0xFFFF)
+			return false;
+	}
+#endif
+	for (; i < aLen; i++) {
+		if (ToLowerChar(a[i]) != ToLowerChar(b[i]))
+			return false;
+	}
+	return true;
+}
+
 BMHPAL_API bool EqualsNoCase(const char* a, const char* b) {
 	size_t i = 0;
 	for (; a[i] && b[i]; i++) {
@@ -84,34 +151,43 @@ BMHPAL_API std::string Join(const std::vector<std::string>& parts, const char* j
 	return r;
 }
 
+// Returns the number of bytes in the UTF-8 sequence that starts with c. Stray continuation bytes count as 1.
+static inline int UTF8SeqLen(char c) {
+	uint8_t u = (uint8_t) c;
+	return u < 0xC0 ? 1 : u < 0xE0 ? 2 : u < 0xF0 ? 3 : 4;
+}
+
+// This is not recursive, so it runs in O(len(s) * len(p)) time, even for patterns such as *a*a*a*b.
+// When a literal fails after a '*', we only need to retry from the most recent '*', because the
+// earlier stars can already absorb anything that the most recent one could.
+// A '?' matches one UTF-8 code point.
 template <bool CaseSensitive>
 bool MatchWildcardT(const char* s, const char* p) {
-	if (*p == '*') {
-		while (*p == '*')
-			++p;
-		if (*p == 0)
-			return true;
-		while (*s != 0 && !MatchWildcardT<CaseSensitive>(s, p)) {
-			int cp;
-			if (!utfz::next(s, cp))
-				break;
-		}
-		return *s != 0;
-	} else if (*p == 0 || *s == 0) {
-		return *p == *s;
-	} else {
-		int px = utfz::decode(p);
-		int sx = utfz::decode(s);
-
-		if ((CaseSensitive ? (px == sx) : ::tolower(px) == ::tolower(sx)) || *p == '?') {
-			int cp;
-			utfz::next(s, cp);
-			utfz::next(p, cp);
-			return MatchWildcardT<CaseSensitive>(s, p);
+	const char* star   = nullptr; // Pattern position after the most recent '*'
+	const char* resume = nullptr; // Position in s where that '*' stopped absorbing characters
+	while (*s != 0) {
+		if (*p == '*') {
+			star   = ++p;
+			resume = s;
+		} else if (*p == '?') {
+			for (int n = UTF8SeqLen(*s); n != 0 && *s != 0; n--)
+				s++;
+			p++;
+		} else if (*p != 0 && (CaseSensitive ? *p == *s : ToLowerChar(*p) == ToLowerChar(*s))) {
+			s++;
+			p++;
+		} else if (star) {
+			p = star;
+			for (int n = UTF8SeqLen(*resume); n != 0 && *resume != 0; n--)
+				resume++;
+			s = resume;
 		} else {
 			return false;
 		}
 	}
+	while (*p == '*')
+		p++;
+	return *p == 0;
 }
 
 BMHPAL_API bool MatchWildcard(const std::string& s, const std::string& p) {
@@ -133,7 +209,7 @@ BMHPAL_API std::string FormatBytes(int64_t bytes) {
 	const int64_t TB = 1024 * 1024 * 1024 * (int64_t) 1024;
 	const int64_t PB = 1024 * 1024 * 1024 * (int64_t) 1024 * (int64_t) 1024;
 	if (bytes < 1024)
-		return tsf::fmt("%v bytes", bytes);
+		return numeric::IntToString(bytes) + " bytes";
 	else if (bytes < 1024 * 1024)
 		return tsf::fmt("%.0f KB", bytes / (double) 1024);
 	else if (bytes < GB)
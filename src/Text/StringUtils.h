@@ -1,5 +1,7 @@
 #pragma once
 
+#include "StringView.h"
+
 namespace bmhpal {
 
 inline int64_t atoi64(const char* s) {
@@ -50,31 +52,47 @@ std::basic_string<T> Replace(const std::basic_string<T>& s, const std::basic_str
 	return snew;
 }
 
+// ASCII case conversion, in place. The char versions are vectorized.
+BMHPAL_API void ToUpperInPlace(char* s, size_t len);
+BMHPAL_API void ToLowerInPlace(char* s, size_t len);
+
 template <typename T>
-std::basic_string<T> toupper(const std::basic_string<T>& s) {
-	auto                 len = s.size();
-	std::basic_string<T> r;
-	r.reserve(len);
+void ToUpperInPlace(T* s, size_t len) {
 	for (size_t i = 0; i < len; i++) {
 		if (s[i] >= 'a' && s[i] <= 'z')
-			r += s[i] - ('a' - 'A');
-		else
-			r += s[i];
+			s[i] -= 'a' - 'A';
 	}
-	return r;
 }
 
 template <typename T>
-std::basic_string<T> tolower(const std::basic_string<T>& s) {
-	auto                 len = s.size();
-	std::basic_string<T> r;
-	r.reserve(len);
+void ToLowerInPlace(T* s, size_t len) {
 	for (size_t i = 0; i < len; i++) {
 		if (s[i] >= 'A' && s[i] <= 'Z')
-			r += s[i] + ('a' - 'A');
-		else
-			r += s[i];
+			s[i] += 'a' - 'A';
 	}
+}
+
+template <typename T>
+void ToUpperInPlace(std::basic_string<T>& s) {
+	ToUpperInPlace(&s[0], s.size());
+}
+
+template <typename T>
+void ToLowerInPlace(std::basic_string<T>& s) {
+	ToLowerInPlace(&s[0], s.size());
+}
+
+template <typename T>
+std::basic_string<T> toupper(const std::basic_string<T>& s) {
+	std::basic_string<T> r = s;
+	ToUpperInPlace(r);
+	return r;
+}
+
+template <typename T>
+std::basic_string<T> tolower(const std::basic_string<T>& s) {
+	std::basic_string<T> r = s;
+	ToLowerInPlace(r);
 	return r;
 }
 
@@ -82,39 +100,48 @@ inline bool IsWhite(char c) {
 	return c == '\t' || c == ' ' || c == '\r' || c == '\n';
 }
 
+// Returns the part of s that remains after trimming tab,space,newline,CR from the left and right sides
+template <typename T>
+BasicStringView<T> TrimSpaceView(BasicStringView<T> s) {
+	size_t start = 0;
+	size_t end   = s.size();
+	while (start != end && IsWhite(s[start]))
+		start++;
+	while (end != start && IsWhite(s[end - 1]))
+		end--;
+	return s.substr(start, end - start);
+}
+
+template <typename T>
+BasicStringView<T> TrimSpaceView(const std::basic_string<T>& s) {
+	return TrimSpaceView(BasicStringView<T>(s));
+}
+
 // Trims tab,space,newline,CR from left and right sides of string
 template <typename T>
 std::basic_string<T> TrimSpace(const std::basic_string<T>& s) {
-	std::basic_string<T> r;
-	auto                 len     = s.size();
-	bool                 atStart = true;
-	for (size_t i = 0; i < len; i++) {
-		char c = s[i];
-		if (atStart) {
-			if (!IsWhite(c)) {
-				atStart = false;
-				r += c;
-			}
-		} else {
-			r += c;
-		}
-	}
-	size_t j = r.size() - 1;
-	for (; j != -1; j--) {
-		if (!IsWhite(r[j]))
-			break;
-	}
-	if (j != r.size() - 1)
-		r.erase(r.begin() + j + 1, r.end());
-	return r;
+	auto v = TrimSpaceView(s);
+	return std::basic_string<T>(v.data(), v.size());
 }
 
+// Trims tab,space,newline,CR from left and right sides of string, without allocating
 template <typename T>
-bool EqualsNoCase(const std::basic_string<T>& a, const std::basic_string<T>& b) {
-	if (a.size() != b.size())
+void TrimSpaceInPlace(std::basic_string<T>& s) {
+	auto v = TrimSpaceView(s);
+	if (v.size() == s.size())
+		return;
+	s.erase(v.data() - s.data() + v.size());
+	s.erase(0, v.data() - s.data());
+}
+
+// ASCII case insensitive comparison. The char version is vectorized.
+BMHPAL_API bool EqualsNoCase(const char* a, size_t aLen, const char* b, size_t bLen);
+
+template <typename T>
+bool EqualsNoCase(const T* a, size_t aLen, const T* b, size_t bLen) {
+	if (aLen != bLen)
 		return false;
-	size_t len = a.size();
-	for (size_t i = 0; i < len; i++) {
+	for (size_t i = 0; i < aLen; i++) {
 		int _a = a[i];
 		int _b = b[i];
 		_a     = (_a >= 'A' && _a <= 'Z') ? _a + 'a' - 'A' : _a;
@@ -125,6 +152,16 @@ bool EqualsNoCase(const std::basic_string<T>& a, const std::basic_string<T>& b)
 	return true;
 }
 
+template <typename T>
+bool EqualsNoCase(const std::basic_string<T>& a, const std::basic_string<T>& b) {
+	return EqualsNoCase(a.data(), a.size(), b.data(), b.size());
+}
+
+template <typename T>
+bool EqualsNoCase(BasicStringView<T> a, BasicStringView<T> b) {
+	return EqualsNoCase(a.data(), a.size(), b.data(), b.size());
+}
+
 BMHPAL_API bool EqualsNoCase(const char* a, const char* b);
 
 template <typename T>
@@ -0,0 +1,43 @@
+#pragma once
+
+namespace bmhpal {
+namespace strings {
+
+// A non-owning reference to a range of characters, like C++17's std::basic_string_view.
+// The referenced string must outlive the view.
+template <typename T>
+class BasicStringView {
+public:
+	static const size_t npos = (size_t) -1;
+
+	BasicStringView() {}
+	BasicStringView(const T* s, size_t len) : P(s), N(len) {}
+	BasicStringView(const T* s) : P(s), N(std::char_traits<T>::length(s)) {}
+	BasicStringView(const std::basic_string<T>& s) : P(s.data()), N(s.size()) {}
+
+	const T*             data() const { return P; }
+	size_t               size() const { return N; }
+	bool                 empty() const { return N == 0; }
+	const T*             begin() const { return P; }
+	const T*             end() const { return P + N; }
+	const T&             operator[](size_t i) const { return P[i]; }
+	std::basic_string<T> str() const { return std::basic_string<T>(P, N); }
+
+	BasicStringView substr(size_t pos, size_t len = npos) const {
+		pos = std::min(pos, N);
+		return BasicStringView(P + pos, std::min(len, N - pos));
+	}
+
+	bool operator==(BasicStringView b) const { return N == b.N && std::char_traits<T>::compare(P, b.P, N) == 0; }
+	bool operator!=(BasicStringView b) const { return !(*this == b); }
+
+private:
+	const T* P = nullptr;
+	size_t   N = 0;
+};
+
+typedef BasicStringView<char>    StringView;
+typedef BasicStringView<wchar_t> WStringView;
+
+} // namespace strings
+} // namespace bmhpal
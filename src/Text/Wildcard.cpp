@@ -0,0 +1,220 @@
+#include "pch.h"
+#include "Wildcard.h"
+
+#ifdef BMHPAL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace bmhpal {
+namespace strings {
+
+static inline char FoldCase(char c) {
+	return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline const char* NextCodePoint(const char* s, const char* end) {
+	uint8_t u = (uint8_t) *s;
+	size_t  n = u < 0xC0 ? 1 : u < 0xE0 ? 2 : u < 0xF0 ? 3 : 4;
+	return s + std::min(n, (size_t) (end - s));
+}
+
+static inline const char* PrevCodePoint(const char* start, const char* s) {
+	s--;
+	while (s != start && ((uint8_t) *s & 0xC0) == 0x80)
+		s--;
+	return s;
+}
+
+static bool IsASCII(const char* s, size_t len) {
+	size_t i = 0;
+#ifdef BMHPAL_SSE2
+	__m128i any = _mm_setzero_si128();
+	for (; i + 16 <= len; i += 16)
+		any = _mm_or_si128(any, _mm_loadu_si128((const __m128i*) (s + i)));
+	if (_mm_movemask_epi8(any) != 0)
+		return false;
+#endif
+	for (; i < len; i++) {
+		if ((uint8_t) s[i] >= 0x80)
+			return false;
+	}
+	return true;
+}
+
+Wildcard::Wildcard(StringView pattern, bool caseSensitive) {
+	Compile(pattern, caseSensitive);
+}
+
+void Wildcard::Compile(StringView pattern, bool caseSensitive) {
+	Pat      = pattern.str();
+	Case     = caseSensitive;
+	HasStar  = false;
+	HasQuery = false;
+	MinLen   = 0;
+	Middle.clear();
+	if (!Case) {
+		for (auto& c : Pat)
+			c = FoldCase(c);
+	}
+
+	std::vector<Piece> pieces;
+	Piece              piece;
+	for (size_t i = 0; i <= Pat.size(); i++) {
+		if (i == Pat.size() || Pat[i] == '*') {
+			piece.Len = (uint32_t) i - piece.Start;
+			pieces.push_back(piece);
+			piece       = Piece();
+			piece.Start = (uint32_t) i + 1;
+		} else {
+			MinLen++;
+			if (Pat[i] == '?') {
+				piece.Query = true;
+				HasQuery    = true;
+			}
+		}
+	}
+	HasStar = pieces.size() > 1;
+	Prefix  = pieces.front();
+	Suffix  = HasStar ? pieces.back() : Piece();
+	for (size_t i = 1; i + 1 < pieces.size(); i++) {
+		if (pieces[i].Len != 0)
+			Middle.push_back(pieces[i]);
+	}
+}
+
+// Returns the end of the match of piece at s, or null
+const char* Wildcard::MatchAt(const Piece& piece, const char* s, const char* end, bool utf8) const {
+	const char* p    = Pat.data() + piece.Start;
+	const char* pEnd = p + piece.Len;
+	if (!piece.Query && Case) {
+		if ((size_t) (end - s) < piece.Len || memcmp(s, p, piece.Len) != 0)
+			return nullptr;
+		return s + piece.Len;
+	}
+	for (; p != pEnd; p++) {
+		if (s == end)
+			return nullptr;
+		if (*p == '?') {
+			s = utf8 ? NextCodePoint(s, end) : s + 1;
+		} else {
+			if ((Case ? *s : FoldCase(*s)) != *p)
+				return nullptr;
+			s++;
+		}
+	}
+	return s;
+}
+
+// Matches piece so that it ends at s, without going below start. Returns the start of the match, or null.
+const char* Wildcard::MatchAtEnd(const Piece& piece, const char* start, const char* s, bool utf8) const {
+	const char* pStart = Pat.data() + piece.Start;
+	for (const char* p = pStart + piece.Len; p != pStart;) {
+		p--;
+		if (s == start)
+			return nullptr;
+		if (*p == '?') {
+			s = utf8 ? PrevCodePoint(start, s) : s - 1;
+		} else {
+			s--;
+			if ((Case ? *s : FoldCase(*s)) != *p)
+				return nullptr;
+		}
+	}
+	return s;
+}
+
+// Finds the leftmost match of piece in [s, end)
+const char* Wildcard::Find(const Piece& piece, const char* s, const char* end, bool utf8, const char*& matchEnd) const {
+	char first = Pat[piece.Start];
+	if (first != '?' && Case) {
+		// Jump between occurrences of the first byte
+		while (s != end) {
+			s = (const char*) memchr(s, first, end - s);
+			if (!s)
+				return nullptr;
+			if ((matchEnd = MatchAt(piece, s, end, utf8)) != nullptr)
+				return s;
+			s++;
+		}
+		return nullptr;
+	}
+	for (; s != end; s = utf8 ? NextCodePoint(s, end) : s + 1) {
+		if ((matchEnd = MatchAt(piece, s, end, utf8)) != nullptr)
+			return s;
+	}
+	return nullptr;
+}
+
+bool Wildcard::Match(StringView str) const {
+	if (str.size() < MinLen)
+		return false;
+	const char* s    = str.data();
+	const char* end  = s + str.size();
+	bool        utf8 = HasQuery && !IsASCII(s, str.size());
+
+	if (!HasStar)
+		return MatchAt(Prefix, s, end, utf8) == end;
+
+	s = MatchAt(Prefix, s, end, utf8);
+	if (!s)
+		return false;
+	end = MatchAtEnd(Suffix, s, end, utf8);
+	if (!end)
+		return false;
+	for (const auto& piece : Middle) {
+		const char* matchEnd = nullptr;
+		if (!Find(piece, s, end, utf8, matchEnd))
+			return false;
+		s = matchEnd;
+	}
+	return true;
+}
+
+void WildcardSet::Add(StringView pattern, bool caseSensitive) {
+	int idx = (int) Patterns.size();
+	Patterns.push_back(Wildcard(pattern, caseSensitive));
+	const auto& p = Patterns.back().Pattern();
+	if (p.empty()) {
+		// Only matches an empty string
+		auto& bucket = caseSensitive ? ByLast : ByLastNoCase;
+		bucket.resize(257);
+		bucket[256].push_back(idx);
+	} else if (p.back() == '*' || p.back() == '?') {
+		// The last byte of a matching string is unknown
+		Any.push_back(idx);
+	} else {
+		auto& bucket = caseSensitive ? ByLast : ByLastNoCase;
+		bucket.resize(257);
+		bucket[(uint8_t) p.back()].push_back(idx);
+	}
+}
+
+int WildcardSet::MatchFirst(StringView s) const {
+	// Each candidate list is sorted, so we can stop each one as soon as it reaches our best match so far
+	int  best    = -1;
+	auto tryList = [&](const std::vector<int>& list) {
+		for (int i : list) {
+			if (best != -1 && i >= best)
+				return;
+			if (Patterns[i].Match(s)) {
+				best = i;
+				return;
+			}
+		}
+	};
+	if (ByLast.size() != 0)
+		tryList(ByLast[s.empty() ? 256 : (uint8_t) s[s.size() - 1]]);
+	if (ByLastNoCase.size() != 0)
+		tryList(ByLastNoCase[s.empty() ? 256 : (uint8_t) FoldCase(s[s.size() - 1])]);
+	tryList(Any);
+	return best;
+}
+
+void WildcardSet::MatchMany(const std::vector<std::string>& s, std::vector<int>& result) const {
+	result.resize(s.size());
+	for (size_t i = 0; i < s.size(); i++)
+		result[i] = MatchFirst(s[i]);
+}
+
+} // namespace strings
+} // namespace bmhpal
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "StringView.h"
+
+namespace bmhpal {
+namespace strings {
+
+/*
+
+	Compiled wildcard patterns
+	==========================
+
+	Wildcard is the compiled form of a pattern for MatchWildcard, where '*' matches any run of characters,
+	and '?' matches a single UTF-8 code point. Use it when the same pattern is matched against many strings.
+
+	The pattern is split on '*' into a prefix, a suffix, and the pieces in between. The prefix and suffix
+	are anchored, so they're checked first (which is all that "*.txt" needs), and then each middle piece
+	is found with a forward search, taking the leftmost occurrence. Taking the leftmost occurrence is
+	always correct for '*', so there is no backtracking, and adversarial patterns like *a*a*a*b run in
+	linear time.
+
+	If the pattern has no '?', or the string is pure ASCII, then we match bytes instead of code points.
+	Case insensitive matching only folds ASCII letters.
+
+	*/
+class BMHPAL_API Wildcard {
+public:
+	Wildcard() {}
+	Wildcard(StringView pattern, bool caseSensitive = true);
+
+	void Compile(StringView pattern, bool caseSensitive = true);
+	bool Match(StringView s) const;
+
+	const std::string& Pattern() const { return Pat; } // Lowercased, if case insensitive
+	bool               CaseSensitive() const { return Case; }
+
+private:
+	struct Piece {
+		uint32_t Start = 0;     // Offset into Pat
+		uint32_t Len   = 0;     // Number of bytes in Pat
+		bool     Query = false; // Contains a '?'
+	};
+	std::string        Pat;
+	Piece              Prefix;
+	Piece              Suffix;
+	std::vector<Piece> Middle;
+	bool               HasStar  = false;
+	bool               HasQuery = false;
+	bool               Case     = true;
+	size_t             MinLen   = 0; // Minimum length, in bytes, of a string that can match
+
+	const char* MatchAt(const Piece& piece, const char* s, const char* end, bool utf8) const;
+	const char* MatchAtEnd(const Piece& piece, const char* start, const char* s, bool utf8) const;
+	const char* Find(const Piece& piece, const char* s, const char* end, bool utf8, const char*& matchEnd) const;
+};
+
+// WildcardSet matches strings against many patterns at once, for example a list of file exclusion rules.
+// Patterns that end in a literal are bucketed by their final byte, so for each string we only try the
+// patterns that could possibly match it.
+class BMHPAL_API WildcardSet {
+public:
+	void   Add(StringView pattern, bool caseSensitive = true);
+	size_t Size() const { return Patterns.size(); }
+
+	int  MatchFirst(StringView s) const;                                               // Returns the index of the first pattern that matches s, or -1
+	bool MatchAny(StringView s) const { return MatchFirst(s) != -1; }                  // Returns true if any pattern matches s
+	void MatchMany(const std::vector<std::string>& s, std::vector<int>& result) const; // result[i] = MatchFirst(s[i])
+
+private:
+	std::vector<Wildcard>         Patterns;
+	std::vector<int>              Any;          // Patterns that end with '*' or '?'
+	std::vector<std::vector<int>> ByLast;       // Case sensitive patterns, bucketed by their last byte
+	std::vector<std::vector<int>> ByLastNoCase; // Case insensitive patterns, bucketed by their lowercase last byte
+};
+
+} // namespace strings
+} // namespace bmhpal
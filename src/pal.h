@@ -18,8 +18,15 @@
 #include "Containers/ObjQueue.h"
 #include "Crypto/Rand.h"
 #include "Diff/Diff.h"
+#include "Encoding/Base64.h"
+#include "Encoding/Cbor.h"
 #include "Encoding/Hex.h"
 #include "Encoding/Json.h"
+#include "Encoding/JsonBind.h"
+#include "Encoding/JsonReader.h"
+#include "Encoding/JsonTape.h"
+#include "Encoding/JsonWriter.h"
+#include "Encoding/NDJson.h"
 #include "Error/Asserts.h"
 #include "Error/Error.h"
 #include "Error/CommonErrors.h"
@@ -27,13 +34,27 @@
 #include "Hash/crc32.h"
 #include "Hash/Sig16.h"
 #include "Hash/Sig32.h"
+#include "OS/AsyncIO.h"
+#include "OS/CPU.h"
+#include "OS/DirWalker.h"
+#include "OS/FileIO.h"
+#include "OS/MappedFile.h"
 #include "OS/OS.h"
+#include "OS/Process.h"
+#include "OS/SyncGroup.h"
 #include "OS/Terminal.h"
+#include "OS/Watcher.h"
 #include "Path.h"
 #include "Math_.h"
 #include "Net/Http.h"
 #include "Net/Url.h"
 #include "Time/Time_.h"
 #include "Text/ConvertUTF.h"
+#include "Text/Interner.h"
+#include "Text/MultiMatcher.h"
+#include "Text/Numeric.h"
+#include "Text/Splitter.h"
 #include "Text/StringUtils.h"
+#include "Text/StringView.h"
+#include "Text/Wildcard.h"
 #include "Viz/Viz.h"
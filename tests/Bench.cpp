@@ -0,0 +1,43 @@
+#include "pch.h"
+
+#ifdef BMHPAL_PLATFORM_LINUX
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+namespace bench {
+
+bool Enabled() {
+	return os::GetEnv("PAL_BENCH") != "";
+}
+
+bool CanDropCaches() {
+#ifdef BMHPAL_PLATFORM_LINUX
+	return os::GetEnv("PAL_BENCH_COLD") != "" && access("/proc/sys/vm/drop_caches", W_OK) == 0;
+#else
+	return false;
+#endif
+}
+
+void DropCaches() {
+	if (CanDropCaches())
+		os::WriteFile("/proc/sys/vm/drop_caches", "3");
+}
+
+void Compare(const std::string& title, const std::vector<Case>& cases) {
+	string line = title + ".";
+	for (size_t i = 0; i < cases.size(); i++) {
+		if (cases[i].Prepare)
+			cases[i].Prepare();
+		time::Benchmark b;
+		cases[i].Run();
+		double t = b.Seconds();
+		line += tsf::fmt("%v %v: %.1f ms", i == 0 ? "" : ",", cases[i].Name, t * 1000);
+	}
+	tsf::print("%v\n", line);
+}
+
+} // namespace bench
+} // namespace bmhpal
@@ -0,0 +1,33 @@
+#pragma once
+
+// Benchmarks write large files and trees, so they are registered as large tests that run on their own,
+// and they do nothing unless PAL_BENCH is set in the environment.
+#define BENCHFUNC(name)                                           \
+	static void Bench_##name();                                   \
+	TT_TEST_FUNC(NULL, NULL, TTSizeLarge, name, TTParallelSolo) { \
+		if (bmhpal::bench::Enabled())                             \
+			Bench_##name();                                       \
+	}                                                             \
+	static void Bench_##name()
+
+namespace bmhpal {
+namespace bench {
+
+struct Case {
+	std::string           Name;
+	std::function<void()> Run;
+	std::function<void()> Prepare; // Optional. Called before Run, and not timed.
+};
+
+bool Enabled(); // True if PAL_BENCH is set
+
+// Dropping the page cache affects the whole machine, so cold cache runs only happen if PAL_BENCH_COLD is set,
+// and we are allowed to write to /proc/sys/vm/drop_caches.
+bool CanDropCaches();
+void DropCaches();
+
+// Time each case, in order, and print "<title>. <name>: <ms> ms, <name>: <ms> ms, ..."
+void Compare(const std::string& title, const std::vector<Case>& cases);
+
+} // namespace bench
+} // namespace bmhpal
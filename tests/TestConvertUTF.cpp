@@ -0,0 +1,297 @@
+#include "pch.h"
+
+using namespace std;
+using namespace bmhpal::Unicode;
+
+namespace bmhpal {
+
+// Random UTF-8 text, where 'ascii' is the percentage of characters that are ASCII
+static string RandomUTF8(size_t nchars, int ascii, uint32_t seed) {
+	string   s;
+	uint32_t r = seed;
+	for (size_t i = 0; i < nchars; i++) {
+		r          = r * 1103515245 + 12345;
+		uint32_t v = r >> 8;
+		UTF32    cp;
+		if ((int) (v % 100) < ascii)
+			cp = 0x20 + (v >> 7) % 0x5f;
+		else if (v & 1)
+			cp = 0x80 + (v >> 7) % (0x10000 - 0x80);
+		else
+			cp = 0x10000 + (v >> 7) % (0x110000 - 0x10000);
+		if (cp >= 0xD800 && cp <= 0xDFFF)
+			cp = 0xE000;
+		UTF8         buf[4];
+		const UTF32* src = &cp;
+		UTF8*        dst = buf;
+		ConvertUTF32toUTF8(&src, src + 1, &dst, buf + 4, ConversionStrict);
+		s.append((const char*) buf, dst - buf);
+	}
+	return s;
+}
+
+// Run the vectorized and scalar decoders on the same input, and make sure they agree on everything
+template <typename T, typename Fast, typename Slow>
+static void CompareDecode(const string& s, size_t targetLen, Fast fast, Slow slow) {
+	vector<T>   t1(targetLen + 1), t2(targetLen + 1);
+	const UTF8* src1 = (const UTF8*) s.data();
+	const UTF8* src2 = src1;
+	T*          dst1 = t1.data();
+	T*          dst2 = t2.data();
+	auto        r1   = fast(&src1, src1 + s.size(), &dst1, dst1 + targetLen, ConversionStrict);
+	auto        r2   = slow(&src2, src2 + s.size(), &dst2, dst2 + targetLen, ConversionStrict);
+	TTASSEQ(r1, r2);
+	TTASSERT(src1 == src2);
+	TTASSEQ(dst1 - t1.data(), dst2 - t2.data());
+	TTASSERT(memcmp(t1.data(), t2.data(), (dst1 - t1.data()) * sizeof(T)) == 0);
+}
+
+static void CompareAll(const string& s, bool checkValid) {
+	bool expectValid = true;
+	for (const UTF8* p = (const UTF8*) s.data(); p < (const UTF8*) s.data() + s.size();) {
+		if (!IsLegalUTF8Sequence(p, (const UTF8*) s.data() + s.size())) {
+			expectValid = false;
+			break;
+		}
+		p += *p < 0x80 ? 1 : *p < 0xE0 ? 2 : *p < 0xF0 ? 3 : 4;
+	}
+	if (checkValid)
+		TTASSEQ(IsLegalUTF8String((const UTF8*) s.data(), (const UTF8*) s.data() + s.size()), expectValid);
+	for (size_t targetLen : {s.size() * 2, s.size() / 2, s.size() / 3})
+		CompareDecode<UTF16>(s, targetLen, ConvertUTF8toUTF16, ConvertUTF8toUTF16Scalar);
+	for (size_t targetLen : {s.size(), s.size() / 2})
+		CompareDecode<UTF32>(s, targetLen, ConvertUTF8toUTF32, ConvertUTF8toUTF32Scalar);
+}
+
+TESTFUNC(ConvertUTF) {
+	const char* bad[] = {
+	    "\xC0\x80",         // overlong
+	    "\xE0\x80\x80",     // overlong
+	    "\xF0\x80\x80\x80", // overlong
+	    "\xED\xA0\x80",     // surrogate
+	    "\xF4\x90\x80\x80", // above 0x10FFFF
+	    "\xF8\x88\x80\x80\x80",
+	    "\xFF",
+	    "\x80",      // lone continuation
+	    "\xE2\x82",  // truncated
+	    "\xC2\x41",  // missing continuation
+	    "\xE2\x82\xAC\xAC",
+	    "\xE0\x61\x80",     // ASCII after a lead byte with a restricted 2nd byte
+	    "\xED\x61\x80",
+	    "\xF0\x61\x80\x80",
+	    "\xF4\x61\x80\x80",
+	};
+	const char* good[] = {"\xC2\x80", "\xE0\xA0\x80", "\xEF\xBF\xBF", "\xF0\x90\x80\x80", "\xF4\x8F\xBF\xBF", "\xED\x9F\xBF"};
+
+	// Splice each sequence into every position of text that is long enough to exercise every vector kernel
+	for (int ascii : {100, 90, 0}) {
+		for (size_t n : {40, 100}) {
+			string base = RandomUTF8(n, ascii, ascii + 1);
+			for (size_t pos = 0; pos < base.size(); pos++) {
+				if ((base[pos] & 0xC0) == 0x80)
+					continue;
+				for (auto b : bad)
+					CompareAll(base.substr(0, pos) + b + base.substr(pos), true);
+				for (auto g : good)
+					CompareAll(base.substr(0, pos) + g + base.substr(pos), true);
+			}
+		}
+	}
+
+	// Errors on either side of the chunk boundaries, and at the very end
+	string big = RandomUTF8(50000, 50, 7);
+	CompareAll(big, true);
+	for (size_t pos = 1; pos < big.size(); pos = pos * 3 / 2 + 1) {
+		string s = big;
+		s[pos]   = (char) 0xFF;
+		CompareAll(s, true);
+		CompareAll(s.substr(0, pos + 1), true);
+	}
+	for (size_t pos = 16 * 1024 - 8; pos < 16 * 1024 + 8; pos++) {
+		string s = big;
+		s[pos]   = (char) 0x80;
+		CompareAll(s, false);
+	}
+	CompareAll(big.substr(0, big.size() - 1), true);
+
+	// A lead byte followed by ASCII, at every offset around the chunk boundary, and in the tail that the vector kernels leave to the scalar code
+	const char* leadThenASCII[] = {"\xC2\x61", "\xE0\x61\x80", "\xED\x61\x80", "\xF0\x61\x80\x80", "\xF4\x61\x80\x80"};
+	string      ascii(16 * 1024 + 100, 'a');
+	for (auto b : leadThenASCII) {
+		for (size_t pos = 16 * 1024 - 40; pos < 16 * 1024 + 40; pos++)
+			CompareAll(ascii.substr(0, pos) + b + ascii.substr(pos), true);
+		for (size_t n = 0; n < 100; n++)
+			CompareAll(ascii.substr(0, n) + b, true);
+	}
+
+	// The other direction, including the ASCII fast paths
+	for (int ascii : {100, 50}) {
+		string        s = RandomUTF8(1000, ascii, 3);
+		vector<UTF32> u32(s.size());
+		vector<UTF16> u16(s.size() * 2);
+		const UTF8*   src = (const UTF8*) s.data();
+		UTF32*        d32 = u32.data();
+		TTASSEQ(ConvertUTF8toUTF32(&src, src + s.size(), &d32, d32 + u32.size(), ConversionStrict), ConversionOk);
+		src        = (const UTF8*) s.data();
+		UTF16* d16 = u16.data();
+		TTASSEQ(ConvertUTF8toUTF16(&src, src + s.size(), &d16, d16 + u16.size(), ConversionStrict), ConversionOk);
+		string       back(s.size(), 0);
+		const UTF32* s32 = u32.data();
+		UTF8*        out = (UTF8*) &back[0];
+		TTASSEQ(ConvertUTF32toUTF8(&s32, (const UTF32*) d32, &out, out + back.size(), ConversionStrict), ConversionOk);
+		TTASSERT(back == s);
+		const UTF16* s16 = u16.data();
+		out              = (UTF8*) &back[0];
+		TTASSEQ(ConvertUTF16toUTF8(&s16, (const UTF16*) d16, &out, out + back.size(), ConversionStrict), ConversionOk);
+		TTASSERT(back == s);
+		// Too little space
+		s16 = u16.data();
+		out = (UTF8*) &back[0];
+		TTASSEQ(ConvertUTF16toUTF8(&s16, (const UTF16*) d16, &out, out + back.size() - 1, ConversionStrict), ConversionResultTargetExhausted);
+		TTASSERT(out < (UTF8*) &back[0] + back.size());
+	}
+}
+
+BENCHFUNC(ConvertUTFBench) {
+	for (int ascii : {100, 95, 0}) {
+		string        s    = RandomUTF8(4 * 1024 * 1024, ascii, 9);
+		const int     reps = 5;
+		vector<UTF16> u16(s.size() * 2);
+		vector<UTF32> u32(s.size());
+		const UTF8*   end = (const UTF8*) s.data() + s.size();
+
+		time::Benchmark b;
+		bool            ok = true;
+		for (int i = 0; i < reps; i++) {
+			for (const UTF8* p = (const UTF8*) s.data(); p < end && ok; p += *p < 0x80 ? 1 : *p < 0xE0 ? 2 : *p < 0xF0 ? 3 : 4)
+				ok = IsLegalUTF8Sequence(p, end);
+		}
+		double validSlow = b.Seconds();
+		b.Start();
+		for (int i = 0; i < reps; i++)
+			ok &= IsLegalUTF8String((const UTF8*) s.data(), end);
+		double validFast = b.Seconds();
+
+		double t[4];
+		for (int k = 0; k < 4; k++) {
+			b.Start();
+			for (int i = 0; i < reps; i++) {
+				const UTF8* src = (const UTF8*) s.data();
+				UTF16*      d16 = u16.data();
+				UTF32*      d32 = u32.data();
+				switch (k) {
+				case 0: ConvertUTF8toUTF16Scalar(&src, end, &d16, d16 + u16.size(), ConversionStrict); break;
+				case 1: ConvertUTF8toUTF16(&src, end, &d16, d16 + u16.size(), ConversionStrict); break;
+				case 2: ConvertUTF8toUTF32Scalar(&src, end, &d32, d32 + u32.size(), ConversionStrict); break;
+				case 3: ConvertUTF8toUTF32(&src, end, &d32, d32 + u32.size(), ConversionStrict); break;
+				}
+			}
+			t[k] = b.Seconds();
+		}
+
+		double mb = (double) (s.size() * reps) / (1024 * 1024);
+		tsf::print("UTF-8 %3d%% ASCII (MB/s, scalar / vector): validate %5.0f / %5.0f, to UTF-16 %5.0f / %5.0f, to UTF-32 %5.0f / %5.0f (%v)\n",
+		           ascii, mb / validSlow, mb / validFast, mb / t[0], mb / t[1], mb / t[2], mb / t[3], ok);
+	}
+}
+
+TESTFUNC(ConvertUTFWide) {
+	// "a", e-acute, euro, musical G clef (which needs a surrogate pair in UTF-16)
+	const string utf8  = "a\xC3\xA9\xE2\x82\xAC\xF0\x9D\x84\x9E";
+	const size_t nwide = sizeof(wchar_t) == 2 ? 5 : 4;
+	TTASSEQ(WideLengthFromUTF8(utf8.data(), utf8.size()), nwide);
+	auto w = towide(utf8);
+	TTASSEQ(w.size(), nwide);
+	TTASSERT(w[0] == L'a' && w[1] == 0xE9 && w[2] == 0x20AC);
+	TTASSEQ(UTF8LengthFromWide(w.data(), w.size()), utf8.size());
+	TTASSERT(toutf8(w) == utf8);
+	TTASSERT(towide("") == L"");
+	TTASSERT(toutf8(L"") == "");
+
+	// Long enough for the vectorized length count
+	string long8;
+	for (int i = 0; i < 20; i++)
+		long8 += utf8;
+	TTASSEQ(WideLengthFromUTF8(long8.data(), long8.size()), nwide * 20);
+	TTASSERT(toutf8(towide(long8)) == long8);
+
+	// Caller buffers are always terminated, and conversion stops when they're full
+	wchar_t wbuf[4];
+	TTASSEQ(towide(utf8.data(), utf8.size(), wbuf, 4), 3u);
+	TTASSERT(wbuf[2] == 0x20AC && wbuf[3] == 0);
+	TTASSEQ(towide(utf8.data(), utf8.size(), wbuf, 0), 0u);
+	char buf[5];
+	TTASSEQ(toutf8(w.data(), w.size(), buf, sizeof(buf)), 3u);
+	TTASSERT(strcmp(buf, "a\xC3\xA9") == 0);
+
+	// Illegal sequences become U+FFFD, instead of ending the string
+	const wchar_t rep = 0xFFFD;
+	TTASSERT(towide("ab\xFF" "cd") == wstring(L"ab") + rep + L"cd");
+	TTASSERT(towide("/tmp/dir/\xFF" "child") == wstring(L"/tmp/dir/") + rep + L"child");
+	TTASSERT(towide("\xE2\x82" "x") == wstring(1, rep) + L"x");     // Truncated sequence
+	TTASSERT(towide("a\xF0\x9D\x84") == wstring(L"a") + rep);        // Truncated at the end
+	TTASSERT(towide("\xED\xA0\x80") == wstring(3, rep));             // Surrogate
+	TTASSERT(towide("\x80\x80\x80") == wstring(3, rep));             // More than WideLengthFromUTF8
+	TTASSERT(towide("\xE2\x82\xAC\xAC") == wstring(1, 0x20AC) + rep); // Stray continuation byte
+	TTASSERT(towide(string(100, 'a') + "\xFF" + string(100, 'b')) == wstring(100, L'a') + rep + wstring(100, L'b')); // Through the vectorized decoder
+	TTASSEQ(towide("ab\xFF" "cd", 5, wbuf, 4), 3u);
+	TTASSERT(wbuf[2] == rep && wbuf[3] == 0);
+	TTASSERT(WideString("a\x80\x80", 3).c_str() == wstring(L"a") + rep + rep);
+	WideString wbad(string(300, '\x80'));
+	TTASSERT(wbad.c_str() == wstring(300, rep));
+	TTASSERT(toutf8(wstring(L"a") + (wchar_t) 0xD800 + L"b") == "a\xEF\xBF\xBD" "b");
+
+	// Small strings stay inside the object
+	WideString ws(utf8);
+	TTASSERT(!ws.IsOnHeap());
+	TTASSERT(ws.c_str() == w);
+	UTF8String us(w);
+	TTASSERT(!us.IsOnHeap());
+	TTASSEQ(string(us.c_str()), utf8);
+	string     longPath(300, 'x');
+	WideString wl(longPath);
+	TTASSERT(wl.IsOnHeap());
+	TTASSEQ(wl.size(), 300u);
+	TTASSERT(wl.c_str()[300] == 0);
+}
+
+BENCHFUNC(ConvertUTFWideBench) {
+	// Typical path lengths, some with non-ASCII characters
+	vector<string> paths;
+	for (int i = 0; i < 1000; i++)
+		paths.push_back(tsf::fmt("/home/user/projects/%v/src/some_module/file_%v%v.cpp", i, i * 7, i % 5 == 0 ? "\xC3\xA9t\xC3\xA9" : ""));
+	const int reps = 300;
+	size_t    sum  = 0;
+
+	time::Benchmark b;
+	for (int r = 0; r < reps; r++) {
+		for (const auto& p : paths)
+			sum += towide(p).size();
+	}
+	double str = b.Seconds();
+
+	b.Start();
+	size_t onHeap = 0;
+	for (int r = 0; r < reps; r++) {
+		for (const auto& p : paths) {
+			WideString w(p);
+			sum += w.size();
+			onHeap += w.IsOnHeap();
+		}
+	}
+	double small = b.Seconds();
+
+	b.Start();
+	wchar_t buf[260];
+	for (int r = 0; r < reps; r++) {
+		for (const auto& p : paths)
+			sum += towide(p.data(), p.size(), buf, 260);
+	}
+	double caller = b.Seconds();
+
+	double n = (double) (paths.size() * reps);
+	tsf::print("towide on paths (ns/call): std::wstring %.0f (1 allocation per call), WideString %.0f (%v allocations), caller buffer %.0f (%v)\n",
+	           str * 1e9 / n, small * 1e9 / n, onHeap, caller * 1e9 / n, sum & 1);
+}
+
+} // namespace bmhpal
@@ -0,0 +1,212 @@
+#include "pch.h"
+
+using namespace std;
+
+namespace bmhpal {
+
+static string RandomBytes(size_t n, uint32_t seed = 1) {
+	string s;
+	s.resize(n);
+	for (size_t i = 0; i < n; i++) {
+		seed = seed * 1103515245 + 12345;
+		s[i] = (char) (seed >> 16);
+	}
+	return s;
+}
+
+TESTFUNC(Hex) {
+	for (size_t len = 0; len < 100; len++) {
+		string raw = RandomBytes(len, (uint32_t) len);
+		string enc = hex::Encode(raw.data(), raw.size());
+		string upper = hex::Encode(raw.data(), raw.size(), true);
+		TTASSEQ(upper, modp::b16_encode(raw.data(), raw.size()));
+		TTASSEQ(enc, strings::tolower(upper));
+		for (const auto& e : {enc, upper}) {
+			string dec;
+			dec.resize(len);
+			auto err = hex::Decode(e.c_str(), &dec[0], dec.size());
+			TTASSERT(err.OK());
+			TTASSERT(dec == raw);
+		}
+		if (len != 0) {
+			// corrupt every position in turn, to make sure the vectorized path validates every lane
+			for (size_t i = 0; i < enc.size(); i++) {
+				string bad = enc;
+				bad[i]     = i % 3 == 0 ? 'g' : i % 3 == 1 ? '\x80' : '/';
+				string dec;
+				dec.resize(len);
+				TTASSERT(!hex::Decode(bad.c_str(), bad.size(), &dec[0], dec.size()).OK());
+			}
+		}
+	}
+
+	char buf[4];
+	TTASSERT(!hex::Decode("abc", buf, sizeof(buf)).OK());
+	TTASSERT(!hex::Decode("0102030405", buf, sizeof(buf)).OK());
+	TTASSERT(hex::Decode("01020304", buf, sizeof(buf)).OK());
+	TTASSEQ(hex::DecodeChar('F'), 15u);
+	TTASSEQ(hex::DecodeChar('z'), (unsigned) -1);
+
+	string s = "sig:";
+	hex::EncodeAppend("\x01\xfe", 2, s);
+	TTASSEQ(s, "sig:01fe");
+
+	auto sig = hash::Sig16::Compute("abc", 3);
+	char sigHex[32];
+	sig.Hex(sigHex);
+	TTASSEQ(string(sigHex, 32), sig.Hex());
+	TTASSEQ(sig.Hex(), modp::b16_encode((const char*) sig.Bytes, sizeof(sig.Bytes)));
+}
+
+BENCHFUNC(HexBench) {
+	const size_t n    = 1024 * 1024;
+	const int    reps = 20;
+	string       raw  = RandomBytes(n);
+	string       enc;
+	string       dec;
+	dec.resize(n);
+
+	time::Benchmark b;
+	for (int i = 0; i < reps; i++)
+		enc = modp::b16_encode(raw.data(), raw.size());
+	double modpEnc = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		enc.clear();
+		hex::EncodeAppend(raw.data(), raw.size(), enc);
+	}
+	double palEnc = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++)
+		dec = modp::b16_decode(enc.data(), enc.size());
+	double modpDec = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++)
+		hex::Decode(enc.data(), enc.size(), &dec[0], dec.size());
+	double palDec = b.Seconds();
+	TTASSERT(dec == raw);
+
+	double mb = (double) (n * reps) / (1024 * 1024);
+	tsf::print("hex encode: modp %6.0f MB/s, pal %6.0f MB/s\n", mb / modpEnc, mb / palEnc);
+	tsf::print("hex decode: modp %6.0f MB/s, pal %6.0f MB/s\n", mb / modpDec, mb / palDec);
+
+	// Sig16::Hex into a stack buffer vs a fresh std::string per call
+	auto   sig     = hash::Sig16::Compute(raw.data(), raw.size());
+	char   buf[32] = {0};
+	size_t sum     = 0;
+	b.Start();
+	for (int i = 0; i < 1000000; i++)
+		sum += sig.Hex().size();
+	double sigStr = b.Seconds();
+	b.Start();
+	for (int i = 0; i < 1000000; i++) {
+		sig.Hex(buf);
+		sum += buf[i & 31];
+	}
+	double sigBuf = b.Seconds();
+	tsf::print("Sig16::Hex x 1M: string %.1f ms, buffer %.1f ms (%v)\n", sigStr * 1000, sigBuf * 1000, sum & 1);
+}
+
+TESTFUNC(Base64) {
+	for (size_t len = 0; len < 200; len++) {
+		string raw = RandomBytes(len, (uint32_t) len + 1000);
+		string enc = base64::Encode(raw);
+		TTASSEQ(enc, modp::b64_encode(raw.data(), raw.size()));
+		TTASSEQ(enc.size(), base64::EncodedLen(len));
+		string dec;
+		TTASSERT(base64::Decode(enc, dec).OK());
+		TTASSERT(dec == raw);
+
+		// URL alphabet, without padding
+		auto   urlFlags = base64::Flags::URL | base64::Flags::NoPad;
+		string url      = base64::Encode(raw, urlFlags);
+		string expect   = enc;
+		while (expect.size() != 0 && expect.back() == '=')
+			expect.pop_back();
+		for (auto& c : expect)
+			c = c == '+' ? '-' : c == '/' ? '_' : c;
+		TTASSEQ(url, expect);
+		TTASSERT(base64::Decode(url, dec, base64::Flags::URL).OK());
+		TTASSERT(dec == raw);
+
+		// Every invalid character must be detected, regardless of which lane it lands in
+		if (url.size() != 0) {
+			for (size_t i = 0; i < url.size(); i += 7) {
+				string bad = url;
+				bad[i]     = i % 2 == 0 ? '+' : '\xff';
+				TTASSERT(!base64::Decode(bad, dec, base64::Flags::URL).OK());
+				bad    = enc;
+				bad[i] = i % 2 == 0 ? '-' : '.';
+				TTASSERT(!base64::Decode(bad, dec).OK());
+			}
+		}
+
+		// Stream through the chunked encoder and decoder, with awkward chunk sizes
+		for (size_t chunk : {1, 2, 5, 64}) {
+			base64::Encoder e;
+			string          streamEnc;
+			for (size_t i = 0; i < len; i += chunk)
+				e.Write(raw.data() + i, min(chunk, len - i), streamEnc);
+			e.Finish(streamEnc);
+			TTASSEQ(streamEnc, enc);
+
+			base64::Decoder d;
+			string          streamDec;
+			for (size_t i = 0; i < enc.size(); i += chunk)
+				TTASSERT(d.Write(enc.data() + i, min(chunk, enc.size() - i), streamDec).OK());
+			TTASSERT(d.Finish(streamDec).OK());
+			TTASSERT(streamDec == raw);
+		}
+	}
+	string dec;
+	TTASSERT(!base64::Decode("A", dec).OK());
+	TTASSERT(!base64::Decode("AB=", dec).OK());
+	TTASSERT(!base64::Decode("AB=C", dec).OK());
+	TTASSERT(base64::Decode("YWI", dec).OK());
+	TTASSEQ(dec, "ab");
+	base64::Decoder d;
+	TTASSERT(d.Write("YQ==", 4, dec).OK());
+	TTASSERT(!d.Write("YQ==", 4, dec).OK());
+}
+
+BENCHFUNC(Base64Bench) {
+	const size_t n    = 4 * 1024 * 1024;
+	const int    reps = 10;
+	string       raw  = RandomBytes(n);
+	string       enc;
+	string       dec;
+
+	time::Benchmark b;
+	for (int i = 0; i < reps; i++)
+		enc = modp::b64_encode(raw.data(), raw.size());
+	double modpEnc = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		enc.clear();
+		base64::EncodeAppend(raw.data(), raw.size(), enc);
+	}
+	double palEnc = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++)
+		dec = modp::b64_decode(enc.data(), enc.size());
+	double modpDec = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		dec.clear();
+		base64::DecodeAppend(enc.data(), enc.size(), dec);
+	}
+	double palDec = b.Seconds();
+	TTASSERT(dec == raw);
+
+	double mb = (double) (n * reps) / (1024 * 1024);
+	tsf::print("base64 encode: modp %6.0f MB/s, pal %6.0f MB/s (SSSE3: %v)\n", mb / modpEnc, mb / palEnc, os::CPUHasSSSE3());
+	tsf::print("base64 decode: modp %6.0f MB/s, pal %6.0f MB/s\n", mb / modpDec, mb / palDec);
+}
+
+} // namespace bmhpal
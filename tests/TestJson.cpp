@@ -0,0 +1,889 @@
+#include "pch.h"
+#include <cfloat>
+
+#ifndef BMHPAL_PLATFORM_WINDOWS
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace bmhpal {
+
+// Parse with both the tape parser and nlohmann, and make sure they agree
+static void CheckSame(const string& src) {
+	jsontape::Doc doc;
+	auto          err = doc.Parse(src.data(), src.size());
+	TTASSERT(err.OK());
+	nlohmann::json fromTape;
+	doc.Root().ToJson(fromTape);
+	auto expect = nlohmann::json::parse(src);
+	TTASSEQ(fromTape.dump(), expect.dump());
+}
+
+static string MakeBigJson(size_t approxBytes) {
+	string s = "{\"name\": \"test\", \"items\": [";
+	for (int i = 0; s.size() < approxBytes; i++) {
+		if (i != 0)
+			s += ",\n";
+		s += tsf::fmt("{\"id\": %v, \"name\": \"item number %v\", \"price\": %v.%v, \"active\": %v, \"tags\": [\"a\", \"b\\n\", \"c\"], \"owner\": null}",
+		              i, i, i % 1000, i % 97, i % 3 == 0 ? "true" : "false");
+	}
+	s += "], \"count\": 123}";
+	return s;
+}
+
+TESTFUNC(JsonTape) {
+	CheckSame("{}");
+	CheckSame("[]");
+	CheckSame(" 5 ");
+	CheckSame("\"hello\"");
+	CheckSame("[1, -1, 0, -0, 1.5, -2.25e3, 1e-7, 123456789012345678, 9223372036854775807, -9223372036854775808, 18446744073709551615, 1e300, 0.1, 3.141592653589793238462643383]");
+	CheckSame("[true, false, null, [], {}, [[[]]], {\"a\": {\"b\": {\"c\": [1, 2, {}]}}}]");
+	CheckSame("{\"a\": 1, \"b\": \"x\", \"c\": [1, 2, 3], \"d\": {\"e\": null}}");
+	CheckSame("[\"esc \\\" \\\\ \\/ \\b \\f \\n \\r \\t\", \"\\u0041\\u00e9\\u20ac\\ud83d\\ude00\", \"a long string without any escapes at all, to exercise the SIMD scanner\"]");
+	CheckSame(MakeBigJson(10000));
+
+	const char* bad[] = {
+	    "",
+	    "[",
+	    "[1,]",
+	    "{\"a\" 1}",
+	    "{1: 2}",
+	    "[1 2]",
+	    "01",
+	    "1.",
+	    "-",
+	    "1e",
+	    "tru",
+	    "\"abc",
+	    "\"a\tb\"",
+	    "\"\\x\"",
+	    "\"\\u12\"",
+	    "\"\\ud83d\"",
+	    "\"\\ude00\"",
+	    "{} {}",
+	};
+	for (auto b : bad) {
+		jsontape::Doc doc;
+		TTASSERT(!doc.Parse(b, strlen(b)).OK());
+		TTASSERT(doc.Root().IsMissing());
+	}
+
+	string deep;
+	for (int i = 0; i < 2000; i++)
+		deep += "[";
+	jsontape::Doc doc;
+	TTASSERT(!doc.Parse(deep.data(), deep.size()).OK());
+
+	string src = "{\"name\": \"Bob\", \"age\": 42, \"big\": 9000000000, \"ok\": true, \"time\": 1500000000.5, \"esc\": \"a\\nb\", \"list\": [10, 20, 30]}";
+	TTASSERT(doc.Parse(src.data(), src.size()).OK());
+	auto root = doc.Root();
+	TTASSERT(root.IsObject());
+	TTASSEQ(root.Size(), 7u);
+	TTASSEQ(jsonser::GetStr(root, "name"), "Bob");
+	TTASSEQ(jsonser::GetStr(root, "esc"), "a\nb");
+	TTASSEQ(jsonser::GetStr(root, "missing", "x"), "x");
+	TTASSEQ(jsonser::GetInt32(root, "age"), 42);
+	TTASSEQ(jsonser::GetInt64(root, "big"), 9000000000ll);
+	TTASSEQ(jsonser::GetInt64(root, "name", -1), -1);
+	TTASSERT(jsonser::GetBool(root, "ok"));
+	TTASSERT(jsonser::Has(root, "list"));
+	TTASSERT(!jsonser::Has(root, "nope"));
+	TTASSEQ(jsonser::GetUnixTime(root, "time").ToUnix(), 1500000000.5);
+	auto list = root.Find("list");
+	TTASSEQ(list.Size(), 3u);
+	TTASSEQ(list.At(2).Int64(), 30);
+	TTASSERT(list.At(3).IsMissing());
+	TTASSERT(root.Find("name").Find("x").IsMissing());
+
+	// Doubles that don't fit are clamped, instead of being cast
+	{
+		const char*   nums = "[1e300, -1e300, 2.5, -2.5, 1e19]";
+		jsontape::Doc ndoc;
+		TTASSERT(ndoc.Parse(nums, strlen(nums)).OK());
+		auto a = ndoc.Root();
+		TTASSERT(a.At(0).Int64() == INT64_MAX && a.At(0).UInt64() == UINT64_MAX);
+		TTASSERT(a.At(1).Int64() == INT64_MIN && a.At(1).UInt64() == 0);
+		TTASSERT(a.At(2).Int64() == 2 && a.At(2).UInt64() == 2);
+		TTASSERT(a.At(3).Int64() == -2 && a.At(3).UInt64() == 0);
+		TTASSERT(a.At(4).Int64() == INT64_MAX && a.At(4).UInt64() == 10000000000000000000ull);
+	}
+
+	// LoadFile
+	const string filename = "jsontape.test";
+	TTASSERT(os::WriteFile(filename, src).OK());
+	jsontape::Doc fromFile;
+	TTASSERT(fromFile.LoadFile(filename).OK());
+	TTASSEQ(jsonser::GetStr(fromFile.Root(), "name"), "Bob");
+	TTASSEQ(jsonser::GetStr(fromFile.Root(), "esc"), "a\nb");
+	TTASSERT(os::WriteFile(filename, "").OK());
+	TTASSERT(!fromFile.LoadFile(filename).OK());
+	TTASSERT(os::Remove(filename).OK());
+	TTASSERT(!fromFile.LoadFile(filename).OK());
+}
+
+BENCHFUNC(JsonTapeBench) {
+	string    src  = MakeBigJson(10 * 1024 * 1024);
+	const int reps = 3;
+
+	time::Benchmark b;
+	int64_t         sum = 0;
+	for (int i = 0; i < reps; i++) {
+		auto j = nlohmann::json::parse(src);
+		for (const auto& item : j["items"])
+			sum += jsonser::GetInt64(item, "id");
+	}
+	double nlo = b.Seconds();
+
+	b.Start();
+	jsontape::Doc doc;
+	for (int i = 0; i < reps; i++) {
+		doc.Parse(src.data(), src.size());
+		doc.Root().Find("items").ForEachElement([&](const jsontape::Value& item) {
+			sum += jsonser::GetInt64(item, "id");
+		});
+	}
+	double tape = b.Seconds();
+
+	double mb = (double) (src.size() * reps) / (1024 * 1024);
+	tsf::print("json parse + lookup: nlohmann %6.0f MB/s, tape %6.0f MB/s (%v)\n", mb / nlo, mb / tape, sum & 1);
+	tsf::print("json tape size: %v for %v of source\n", strings::FormatBytes(doc.Tape.size() * 8 + doc.Strings.size()), strings::FormatBytes(src.size()));
+}
+
+static string MakeJsonLines(int n) {
+	string s;
+	for (int i = 0; i < n; i++)
+		s += tsf::fmt("{\"id\": %v, \"msg\": \"log message %v\", \"level\": \"info\", \"tags\": [1, 2, 3]}\n", i, i);
+	return s;
+}
+
+TESTFUNC(NDJson) {
+	string         lines = "a\nbb\n\n" + string(100, 'x') + "\n" + string(63, 'y') + "\n\n\n";
+	vector<size_t> ends;
+	ndjson::FindLineEnds(lines.data(), lines.size(), ends);
+	vector<size_t> expect;
+	for (size_t i = 0; i < lines.size(); i++) {
+		if (lines[i] == '\n')
+			expect.push_back(i);
+	}
+	TTASSERT(ends == expect);
+
+	string src = MakeJsonLines(1000);
+	for (int nThreads : {1, 3}) {
+		for (size_t chunk : {1, 7, 4096, 1000000}) {
+			int            next = 0;
+			ndjson::Reader r([&](nlohmann::json& rec) -> Error {
+				if (rec["id"].get<int>() != next)
+					return Error("out of order");
+				next++;
+				return Error();
+			},
+			                 nThreads);
+			r.BatchBytes = 500;
+			for (size_t i = 0; i < src.size(); i += chunk)
+				TTASSERT(r.Write(src.data() + i, min(chunk, src.size() - i)).OK());
+			TTASSERT(r.Finish().OK());
+			TTASSEQ(next, 1000);
+		}
+	}
+
+	// A line that is much longer than BatchBytes, arriving in small pieces
+	{
+		vector<size_t> got;
+		ndjson::Reader r([&](nlohmann::json& rec) -> Error {
+			got.push_back(rec.get<string>().size());
+			return Error();
+		},
+		                 1);
+		r.BatchBytes = 1000;
+		string s     = "\"a\"\n\"" + string(200000, 'x') + "\"\n\"bb\"\n";
+		for (size_t i = 0; i < s.size(); i += 100)
+			TTASSERT(r.Write(s.data() + i, min<size_t>(100, s.size() - i)).OK());
+		TTASSERT(r.Finish().OK());
+		TTASSERT(got == vector<size_t>({1, 200000, 2}));
+	}
+
+	// Blank lines, CRLF, and no terminating newline
+	{
+		vector<int>    got;
+		ndjson::Reader r([&](nlohmann::json& rec) -> Error {
+			got.push_back(rec.get<int>());
+			return Error();
+		});
+		string s = "\n1\r\n  \n2\n3";
+		TTASSERT(r.Write(s.data(), s.size()).OK());
+		TTASSERT(r.Finish().OK());
+		TTASSERT(got == vector<int>({1, 2, 3}));
+	}
+
+	// Parse errors report the line number, and stop delivery
+	for (int nThreads : {1, 2}) {
+		int            n = 0;
+		ndjson::Reader r([&](nlohmann::json& rec) -> Error {
+			n++;
+			return Error();
+		},
+		                 nThreads);
+		r.BatchBytes = 10;
+		string s     = "1\n2\n3\n4\n{bad\n6\n7\n";
+		r.Write(s.data(), s.size());
+		auto err = r.Finish();
+		TTASSERT(!err.OK());
+		TTASSERT(strings::EndsWith(err.Message(), "(line 5)"));
+		TTASSEQ(n, 4);
+	}
+
+	// A callback error stops delivery immediately, even though later batches arrive in separate writes
+	for (int nThreads : {1, 4}) {
+		int            n = 0;
+		ndjson::Reader r([&](nlohmann::json& rec) -> Error {
+			n++;
+			return n == 3 ? Error("stop") : Error();
+		},
+		                 nThreads);
+		r.BatchBytes = 4;
+		for (int i = 0; i < 20; i++) {
+			string line = tsf::fmt("%v\n%v\n", i * 2, i * 2 + 1);
+			r.Write(line.data(), line.size());
+		}
+		TTASSEQ(string(r.Finish().Message()), "stop");
+		TTASSEQ(n, 3);
+	}
+
+	// Writer into a sink, and into a file, and back again
+	{
+		string         out;
+		ndjson::Writer w([&](const char* buf, size_t len) -> Error {
+			out.append(buf, len);
+			return Error();
+		});
+		w.FlushBytes = 100;
+		for (int i = 0; i < 100; i++)
+			TTASSERT(w.Write(nlohmann::json{{"id", i}, {"s", "x\ny"}}).OK());
+		TTASSERT(w.WriteRaw("[1]", 3).OK());
+		TTASSERT(w.Flush().OK());
+		TTASSEQ(out.substr(0, 21), "{\"id\":0,\"s\":\"x\\ny\"}\n{");
+		TTASSEQ(out.substr(out.size() - 4), "[1]\n");
+
+		TTASSERT(os::WriteFile("ndjson.test", out).OK());
+		int            n = 0;
+		ndjson::Reader r([&](nlohmann::json& rec) -> Error {
+			n++;
+			return Error();
+		});
+		TTASSERT(r.ReadFile("ndjson.test").OK());
+		TTASSEQ(n, 101);
+		TTASSERT(os::Remove("ndjson.test").OK());
+	}
+}
+
+BENCHFUNC(NDJsonBench) {
+	string src = MakeJsonLines(200000);
+
+	time::Benchmark b;
+	int64_t         sum   = 0;
+	size_t          start = 0;
+	while (start < src.size()) {
+		size_t         end = src.find('\n', start);
+		nlohmann::json j;
+		jsonutil::Decode(src.substr(start, end - start), j);
+		sum += jsonser::GetInt64(j, "id");
+		start = end + 1;
+	}
+	double naive = b.Seconds();
+
+	double threaded[2];
+	int    nThreads[2] = {1, 0};
+	for (int i = 0; i < 2; i++) {
+		b.Start();
+		ndjson::Reader r([&](nlohmann::json& rec) -> Error {
+			sum += jsonser::GetInt64(rec, "id");
+			return Error();
+		},
+		                 nThreads[i]);
+		r.Write(src.data(), src.size());
+		r.Finish();
+		threaded[i] = b.Seconds();
+	}
+
+	double mb = (double) src.size() / (1024 * 1024);
+	tsf::print("ndjson read: per-line Decode %4.0f MB/s, Reader 1 thread %4.0f MB/s, Reader %v threads %4.0f MB/s (%v)\n",
+	           mb / naive, mb / threaded[0], std::thread::hardware_concurrency(), mb / threaded[1], sum & 1);
+
+	nlohmann::json rec = nlohmann::json::parse(src.substr(0, src.find('\n')));
+	string         out;
+	b.Start();
+	for (int i = 0; i < 200000; i++)
+		out += rec.dump() + "\n";
+	double dump = b.Seconds();
+
+	size_t         written = 0;
+	ndjson::Writer w([&](const char* buf, size_t len) -> Error {
+		written += len;
+		return Error();
+	});
+	b.Start();
+	for (int i = 0; i < 200000; i++)
+		w.Write(rec);
+	w.Flush();
+	double batched = b.Seconds();
+	TTASSEQ(written, out.size());
+	tsf::print("ndjson write: dump() per record %4.0f MB/s, Writer %4.0f MB/s\n", mb / dump, mb / batched);
+}
+
+TESTFUNC(JsonWriter) {
+	vector<nlohmann::json> docs = {
+	    nlohmann::json::parse("{}"),
+	    nlohmann::json::parse("[]"),
+	    nlohmann::json::parse("[{}, [], [[]], {\"a\": {}}, {\"b\": []}]"),
+	    nlohmann::json::parse(MakeBigJson(3000)),
+	    nlohmann::json::parse("[0, -1, 9, 10, 99, 100, 12345678901234567, 9223372036854775807, -9223372036854775808, 18446744073709551615]"),
+	    nlohmann::json::parse("[0.0, -0.0, 1.5, 0.1, 1e300, 1e-300, 123456.789, 5e-324, 1.7976931348623157e308, 100.0]"),
+	    nlohmann::json::parse("{\"z\": true, \"a\": false, \"m\": null, \"s\": \"\\\" \\\\ / \\b \\f \\n \\r \\t \\u0001 \\u001f \\u007f \\u00e9\"}"),
+	    "a long string with an escape at the end, so that the vectorized scan has to step over several blocks\n",
+	};
+	uint64_t seed = 1;
+	for (int i = 0; i < 1000; i++) {
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		double d;
+		memcpy(&d, &seed, 8);
+		if (std::isfinite(d))
+			docs.push_back(d);
+		docs.push_back(ldexp((double) (seed >> 11), -(i % 40)));
+	}
+	for (const auto& j : docs) {
+		string compact;
+		jsonutil::Encode(j, compact);
+		TTASSEQ(compact, j.dump());
+		string pretty;
+		jsonutil::Encode(j, pretty, jsonutil::Format::Pretty);
+		TTASSEQ(pretty, j.dump(1, '\t'));
+	}
+
+	// NaN and infinity become null, as they do with nlohmann
+	string s;
+	jsonutil::Encode(nlohmann::json{1.0 / 0.0, std::nan("")}, s);
+	TTASSEQ(s, "[null,null]");
+
+	// Token API
+	s = "";
+	jsonutil::Writer w(s, jsonutil::Format::Pretty);
+	w.BeginObject();
+	w.Key("id");
+	w.Int(-5);
+	w.Key("list");
+	w.BeginArray();
+	w.UInt(1);
+	w.Double(2.5);
+	w.String("x\ty");
+	w.Raw("{\"pre\":1}", 9);
+	w.Null();
+	w.Bool(true);
+	w.EndArray();
+	w.Key("empty");
+	w.BeginObject();
+	w.EndObject();
+	w.EndObject();
+	TTASSEQ(s, "{\n\t\"id\": -5,\n\t\"list\": [\n\t\t1,\n\t\t2.5,\n\t\t\"x\\ty\",\n\t\t{\"pre\":1},\n\t\tnull,\n\t\ttrue\n\t],\n\t\"empty\": {}\n}");
+
+	char buf[21];
+	TTASSEQ(string(buf, jsonutil::Writer::FormatInt(INT64_MIN, buf)), "-9223372036854775808");
+	TTASSEQ(string(buf, jsonutil::Writer::FormatUInt(UINT64_MAX, buf)), "18446744073709551615");
+
+	// SaveFile produces exactly what it used to, and the compact form round trips too
+	const string filename = "jsonwriter.test";
+	auto         big      = nlohmann::json::parse(MakeBigJson(1024 * 1024));
+	TTASSERT(jsonutil::SaveFile(filename, big).OK());
+	string raw;
+	TTASSERT(os::ReadFile(filename, raw).OK());
+	TTASSERT(raw == big.dump(1, '\t'));
+	TTASSERT(jsonutil::SaveFile(filename, big, jsonutil::Format::Compact).OK());
+	nlohmann::json back;
+	TTASSERT(jsonutil::LoadFile(filename, back).OK());
+	TTASSERT(back == big);
+	TTASSERT(os::Remove(filename).OK());
+	TTASSERT(!jsonutil::SaveFile("/a_bogus_path/that_should_not.exist", big).OK());
+
+#ifndef BMHPAL_PLATFORM_WINDOWS
+	// A long run of nulls and bools is flushed as it goes, instead of piling up in the buffer
+	{
+		int fd = -1;
+		TTASSERT(os::OpenForWrite(filename, fd).OK());
+		jsonutil::Writer fw(fd, jsonutil::Format::Compact, 100);
+		fw.BeginArray();
+		for (int i = 0; i < 100; i++) {
+			fw.Null();
+			fw.Bool(i % 2 == 0);
+		}
+		TTASSERT(os::ReadFile(filename, raw).OK());
+		TTASSERT(raw.size() >= 800);
+		fw.EndArray();
+		TTASSERT(fw.Flush().OK());
+		close(fd);
+		TTASSERT(os::Remove(filename).OK());
+	}
+#endif
+}
+
+BENCHFUNC(JsonWriterBench) {
+	auto      j    = nlohmann::json::parse(MakeBigJson(10 * 1024 * 1024));
+	const int reps = 3;
+
+	time::Benchmark b;
+	size_t          len = 0;
+	for (int i = 0; i < reps; i++)
+		len += j.dump(1, '\t').size();
+	double dump = b.Seconds();
+
+	string out;
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		out.clear();
+		jsonutil::Encode(j, out, jsonutil::Format::Pretty);
+	}
+	double writer = b.Seconds();
+	TTASSEQ(len, out.size() * reps);
+
+	const string filename = "jsonwriter.bench";
+	b.Start();
+	os::WriteFile(filename, j.dump(1, '\t'));
+	double saveOld = b.Seconds();
+	b.Start();
+	jsonutil::SaveFile(filename, j);
+	double saveNew = b.Seconds();
+	os::Remove(filename);
+
+	double mb = (double) len / (1024 * 1024);
+	tsf::print("json encode: dump() %4.0f MB/s, Writer %4.0f MB/s\n", mb / dump, mb / writer);
+	tsf::print("json SaveFile: dump + WriteFile %.0f ms (%v buffer), streaming %.0f ms (256 KB buffer)\n", saveOld * 1000, strings::FormatBytes(out.size()), saveNew * 1000);
+}
+
+struct BindItem {
+	int64_t        ID = 0;
+	string         Name;
+	double         Price  = 0;
+	bool           Active = false;
+	vector<string> Tags;
+
+	template <typename F>
+	void JsonFields(F& f) {
+		f("id", ID);
+		f("name", Name);
+		f("price", Price);
+		f("active", Active);
+		f("tags", Tags);
+	}
+};
+
+struct BindDoc {
+	string           Name;
+	vector<BindItem> Items;
+	int32_t          Count = 0;
+	uint16_t         Small = 7;
+	float            Ratio = 0;
+	time::Time       When;
+	nlohmann::json   Extra;
+
+	template <typename F>
+	void JsonFields(F& f) {
+		f("name", Name);
+		f("items", Items);
+		f("count", Count);
+		f("small", Small);
+		f("ratio", Ratio);
+		f("when", When);
+		f("extra", Extra);
+	}
+};
+
+TESTFUNC(JsonReader) {
+	string         src = "{\"a\": [1, -2, 3.5, \"x\\ny\", true, null, {\"b\": {}}], \"c\": 18446744073709551615}";
+	jsonutil::Reader r(src.data(), src.size());
+	const char*      key;
+	size_t           keyLen;
+	TTASSERT(r.Peek() == jsonutil::Reader::Token::Object);
+	TTASSERT(r.BeginObject());
+	TTASSERT(r.NextMember(key, keyLen));
+	TTASSEQ(string(key, keyLen), "a");
+	TTASSERT(r.BeginArray());
+	int64_t i = 0;
+	double  d = 0;
+	string  s;
+	bool    b = false;
+	TTASSERT(r.NextElement() && r.Int64(i) && i == 1);
+	TTASSERT(r.NextElement() && r.Int64(i) && i == -2);
+	TTASSERT(r.NextElement() && r.Double(d) && d == 3.5);
+	TTASSERT(r.NextElement() && r.String(s) && s == "x\ny");
+	TTASSERT(r.NextElement() && r.Bool(b) && b);
+	TTASSERT(r.NextElement() && r.Null());
+	TTASSERT(r.NextElement() && r.Skip());
+	TTASSERT(!r.NextElement());
+	TTASSERT(r.NextMember(key, keyLen));
+	const char* raw;
+	size_t      rawLen;
+	TTASSERT(r.Raw(raw, rawLen));
+	TTASSEQ(string(raw, rawLen), "18446744073709551615");
+	TTASSERT(!r.NextMember(key, keyLen));
+	TTASSERT(r.Finish());
+	TTASSERT(r.OK());
+
+	// Type mismatch
+	jsonutil::Reader r2("[\"x\"]", 5);
+	TTASSERT(r2.BeginArray() && r2.NextElement());
+	TTASSERT(!r2.Int64(i));
+	TTASSERT(!r2.OK());
+	TTASSERT(!r2.NextElement());
+
+	// Numbers that don't fit
+	const char* tooBig[] = {"1e300", "-1e300", "1e999", "9223372036854775808", "9.3e18", "-9.3e18"};
+	for (auto t : tooBig) {
+		jsonutil::Reader r4(t, strlen(t));
+		TTASSERT(!r4.Int64(i));
+	}
+	uint64_t u = 0;
+	for (auto t : {"1e300", "1e999", "1.9e19"}) {
+		jsonutil::Reader r4(t, strlen(t));
+		TTASSERT(!r4.UInt64(u));
+	}
+	jsonutil::Reader r5("-9223372036854775808", 20);
+	TTASSERT(r5.Int64(i) && i == INT64_MIN);
+
+	// Skip must validate everything it passes over
+	const char* bad[] = {"[1,]", "{\"a\" 1}", "[1 2]", "[tru]", "{\"a\": [}", "[", "\"\\q\""};
+	for (auto b : bad) {
+		jsonutil::Reader r3(b, strlen(b));
+		TTASSERT(!r3.Skip() || !r3.Finish());
+	}
+}
+
+TESTFUNC(JsonBind) {
+	string  src = MakeBigJson(10000);
+	BindDoc doc;
+	TTASSERT(jsonbind::Decode(src, doc).OK());
+	auto j = nlohmann::json::parse(src);
+	TTASSEQ(doc.Name, "test");
+	TTASSEQ(doc.Count, 123);
+	TTASSEQ(doc.Small, 7); // absent fields keep their values
+	TTASSEQ(doc.Items.size(), j["items"].size());
+	for (size_t i = 0; i < doc.Items.size(); i++) {
+		const auto& item = j["items"][i];
+		TTASSEQ(doc.Items[i].ID, jsonser::GetInt64(item, "id"));
+		TTASSEQ(doc.Items[i].Name, jsonser::GetStr(item, "name"));
+		TTASSEQ(doc.Items[i].Active, jsonser::GetBool(item, "active"));
+		TTASSEQ(doc.Items[i].Price, item["price"].get<double>());
+		TTASSEQ(doc.Items[i].Tags.size(), 3);
+		TTASSEQ(doc.Items[i].Tags[1], "b\n");
+	}
+
+	// Round trip through Encode, with every field type populated
+	doc.Small = 65535;
+	doc.Ratio = 0.5f;
+	doc.When  = time::Time::FromUnix(1500000000.25);
+	doc.Extra = nlohmann::json{{"k", {1, 2}}};
+	string enc;
+	jsonbind::Encode(doc, enc);
+	BindDoc back;
+	TTASSERT(jsonbind::Decode(enc, back).OK());
+	string enc2;
+	jsonbind::Encode(back, enc2);
+	TTASSEQ(enc, enc2);
+	TTASSERT(fabs(back.When.ToUnix() - 1500000000.25) < 0.001);
+	TTASSEQ(back.Extra.dump(), "{\"k\":[1,2]}");
+
+	// The encoded form is what nlohmann would produce for the equivalent DOM
+	BindItem item;
+	item.ID     = 5;
+	item.Name   = "five";
+	item.Price  = 1.25;
+	item.Active = true;
+	item.Tags   = {"x"};
+	enc.clear();
+	jsonbind::Encode(item, enc, jsonutil::Format::Pretty);
+	nlohmann::json expect = {{"id", 5}, {"name", "five"}, {"price", 1.25}, {"active", true}, {"tags", {"x"}}};
+	TTASSEQ(nlohmann::json::parse(enc), expect);
+
+	// Null leaves the field alone, unknown keys are skipped, and wrong types are errors
+	item = BindItem();
+	TTASSERT(jsonbind::Decode("{\"name\": null, \"zzz\": {\"a\": [1, 2]}, \"id\": 9}", item).OK());
+	TTASSEQ(item.ID, 9);
+	TTASSERT(!jsonbind::Decode("{\"name\": 5}", item).OK());
+	TTASSERT(!jsonbind::Decode("{\"tags\": [1]}", item).OK());
+	TTASSERT(!jsonbind::Decode("{\"id\": 5} x", item).OK());
+	TTASSERT(!jsonbind::Decode("[]", item).OK());
+
+	// Numbers that don't fit in the field
+	BindDoc small;
+	TTASSERT(!jsonbind::Decode("{\"count\": 5000000000}", small).OK());
+	TTASSERT(!jsonbind::Decode("{\"count\": 1e300}", small).OK());
+	TTASSERT(!jsonbind::Decode("{\"small\": 65536}", small).OK());
+	TTASSERT(!jsonbind::Decode("{\"small\": -1}", small).OK());
+	TTASSERT(jsonbind::Decode("{\"count\": -2147483648, \"small\": 65535}", small).OK());
+	TTASSEQ(small.Count, INT32_MIN);
+	TTASSEQ(small.Small, 65535);
+
+	// Files
+	const string filename = "jsonbind.test";
+	TTASSERT(jsonbind::SaveFile(filename, doc).OK());
+	BindDoc fromFile;
+	TTASSERT(jsonbind::LoadFile(filename, fromFile).OK());
+	TTASSEQ(fromFile.Items.size(), doc.Items.size());
+	TTASSERT(os::Remove(filename).OK());
+}
+
+BENCHFUNC(JsonBindBench) {
+	string    src  = MakeBigJson(10 * 1024 * 1024);
+	const int reps = 3;
+
+	time::Benchmark b;
+	int64_t         sum = 0;
+	for (int i = 0; i < reps; i++) {
+		nlohmann::json j;
+		jsonutil::Decode(src, j);
+		vector<BindItem> items;
+		for (const auto& ji : j["items"]) {
+			BindItem item;
+			item.ID     = jsonser::GetInt64(ji, "id");
+			item.Name   = jsonser::GetStr(ji, "name");
+			item.Active = jsonser::GetBool(ji, "active");
+			items.push_back(item);
+			sum += item.ID;
+		}
+	}
+	double dom = b.Seconds();
+
+	BindDoc doc;
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		jsonbind::Decode(src, doc);
+		sum += doc.Items.size();
+	}
+	double bind = b.Seconds();
+
+	string out;
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		nlohmann::json j;
+		j["name"] = doc.Name;
+		auto& items = j["items"];
+		for (const auto& item : doc.Items)
+			items.push_back({{"id", item.ID}, {"name", item.Name}, {"price", item.Price}, {"active", item.Active}, {"tags", item.Tags}});
+		out = j.dump();
+	}
+	double domEnc = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		out.clear();
+		jsonbind::Encode(doc, out);
+	}
+	double bindEnc = b.Seconds();
+
+	double mb = (double) (src.size() * reps) / (1024 * 1024);
+	tsf::print("json decode to struct: DOM + jsonser %4.0f MB/s, jsonbind %4.0f MB/s (%v)\n", mb / dom, mb / bind, sum & 1);
+	tsf::print("json encode from struct: DOM + dump %4.0f MB/s, jsonbind %4.0f MB/s\n", mb / domEnc, mb / bindEnc);
+}
+
+TESTFUNC(Cbor) {
+	// Same bytes as nlohmann, for everything except floats, which we shrink when possible
+	auto j = nlohmann::json::parse(R"({"a": [0, 23, 24, 255, 256, 65535, 65536, 4294967296, -1, -24, -25, -257, -9223372036854775808, 18446744073709551615],
+		"s": "hello", "long": "0123456789012345678901234567890123456789", "t": true, "f": false, "n": null, "o": {}, "e": []})");
+	string out;
+	cbor::Encode(j, out);
+	auto expect = nlohmann::json::to_cbor(j);
+	TTASSERT(out == string(expect.begin(), expect.end()));
+	nlohmann::json back;
+	TTASSERT(cbor::Decode(out, back).OK());
+	TTASSERT(back == j);
+	TTASSERT(back["a"][13].is_number_unsigned());
+	TTASSERT(back["a"][12].is_number_integer());
+
+	// Floats are stored in 4 bytes if that loses nothing, otherwise 8. nlohmann reads both.
+	// Doubles beyond the range of float must be caught without converting them to float.
+	const pair<double, size_t> floats[] = {{0.5, 5}, {-1.25, 5}, {1e30, 9}, {0.1, 9}, {3.141592653589793, 9}, {-1e300, 9}, {FLT_MAX, 5}, {-1e39, 9}, {INFINITY, 5}};
+	for (auto f : floats) {
+		double d = f.first;
+		out.clear();
+		cbor::Encode(d, out);
+		TTASSEQ(out.size(), f.second);
+		TTASSERT(cbor::Decode(out, back).OK());
+		TTASSERT(back.get<double>() == d);
+		TTASSERT(nlohmann::json::from_cbor(out).get<double>() == d);
+	}
+
+	// Round trip a large document, in both directions with nlohmann
+	auto big = nlohmann::json::parse(MakeBigJson(1024 * 1024));
+	out.clear();
+	cbor::Encode(big, out);
+	TTASSERT(cbor::Decode(out, back).OK());
+	TTASSERT(back == big);
+	TTASSERT(nlohmann::json::from_cbor(out) == big);
+	auto theirs = nlohmann::json::to_cbor(big);
+	TTASSERT(cbor::Decode(theirs.data(), theirs.size(), back).OK());
+	TTASSERT(back == big);
+
+	// Indefinite length containers, via the token API
+	out.clear();
+	{
+		cbor::Writer w(out);
+		w.BeginObject();
+		w.Key("list");
+		w.BeginArray();
+		w.Int(-5);
+		w.String("x");
+		w.EndArray();
+		w.Key("fixed");
+		w.BeginArray(1);
+		w.Double(2.5);
+		w.EndArray();
+		w.EndObject();
+	}
+	TTASSERT(cbor::Decode(out, back).OK());
+	TTASSEQ(back.dump(), R"({"fixed":[2.5],"list":[-5,"x"]})");
+	TTASSERT(nlohmann::json::from_cbor(out) == back);
+
+	// Things that nlohmann doesn't emit: half floats, tags, undefined, indefinite length strings
+	const uint8_t exotic[] = {0x84, 0xF9, 0x3E, 0x00, 0xC1, 0x1A, 0x51, 0x4B, 0x67, 0xB0, 0xF7, 0x7F, 0x62, 'a', 'b', 0x61, 'c', 0xFF};
+	TTASSERT(cbor::Decode(exotic, sizeof(exotic), back).OK());
+	TTASSEQ(back.dump(), R"([1.5,1363896240,null,"abc"])");
+
+	// Pull parser
+	cbor::Reader r(exotic, sizeof(exotic));
+	double       d;
+	int64_t      i;
+	string       str;
+	TTASSERT(r.BeginArray());
+	TTASSERT(r.NextElement() && r.Double(d) && d == 1.5);
+	TTASSERT(r.NextElement() && r.Int64(i) && i == 1363896240);
+	TTASSERT(r.NextElement() && r.Peek() == cbor::Reader::Token::Null);
+	TTASSERT(r.Null());
+	TTASSERT(r.NextElement() && r.String(str) && str == "abc");
+	TTASSERT(!r.NextElement());
+	TTASSERT(r.Finish());
+
+	// Errors
+	TTASSERT(!cbor::Decode(exotic, sizeof(exotic) - 1, back).OK());
+	TTASSERT(!cbor::Decode("\x82\x01\x02\x03", 4, back).OK());
+	TTASSERT(!cbor::Decode("\x5F\xFF", 2, back).OK()); // byte string
+	TTASSERT(!cbor::Decode("\x9B\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF", 9, back).OK());
+	TTASSERT(!cbor::Decode("", 0, back).OK());
+
+	// Numbers that don't fit
+	const uint8_t halfNaN[] = {0xF9, 0x7E, 0x00};
+	cbor::Reader  r2(halfNaN, sizeof(halfNaN));
+	TTASSERT(!r2.Int64(i));
+	out.clear();
+	cbor::Encode(nlohmann::json(UINT64_MAX), out);
+	cbor::Reader r3(out.data(), out.size());
+	TTASSERT(!r3.Int64(i));
+	out.clear();
+	cbor::Encode(nlohmann::json(1e300), out);
+	cbor::Reader r4(out.data(), out.size());
+	uint64_t     u;
+	TTASSERT(!r4.UInt64(u));
+
+	// Streaming, one byte at a time
+	string seq;
+	for (int k = 0; k < 100; k++)
+		cbor::Encode({{"id", k}, {"name", "x"}}, seq);
+	int           n = 0;
+	cbor::Decoder dec([&](nlohmann::json& item) -> Error {
+		if (item["id"].get<int>() != n++)
+			return Error("out of order");
+		return Error();
+	});
+	for (char c : seq)
+		TTASSERT(dec.Write(&c, 1).OK());
+	TTASSERT(dec.Finish().OK());
+	TTASSEQ(n, 100);
+	TTASSERT(dec.Write("\x82\x01", 2).OK());
+	TTASSERT(!dec.Finish().OK());
+
+	// Large items in socket-sized pieces, with the exotic encodings in between, one byte at a time
+	string bigBin;
+	cbor::Encode(big, bigBin);
+	seq = bigBin + string((const char*) exotic, sizeof(exotic)) + bigBin;
+	vector<nlohmann::json> items;
+	cbor::Decoder          dec2([&](nlohmann::json& item) -> Error {
+		items.push_back(std::move(item));
+		return Error();
+	});
+	for (size_t pos = 0; pos < seq.size();) {
+		size_t chunk = pos >= bigBin.size() && pos < bigBin.size() + sizeof(exotic) ? 1 : std::min<size_t>(1500, seq.size() - pos);
+		TTASSERT(dec2.Write(seq.data() + pos, chunk).OK());
+		pos += chunk;
+	}
+	TTASSERT(dec2.Finish().OK());
+	TTASSEQ(items.size(), 3);
+	TTASSERT(items.size() == 3 && items[0] == big && items[1].dump() == R"([1.5,1363896240,null,"abc"])" && items[2] == big);
+
+	// Errors are reported from a streamed item too
+	cbor::Decoder dec3([&](nlohmann::json& item) -> Error { return Error(); });
+	TTASSERT(dec3.Write("\x83\x01", 2).OK());
+	TTASSERT(!dec3.Write("\x1C", 1).OK());
+
+	// Files
+	const string filename = "cbor.test";
+	TTASSERT(cbor::SaveFile(filename, big).OK());
+	TTASSERT(cbor::LoadFile(filename, back).OK());
+	TTASSERT(back == big);
+	TTASSERT(os::Remove(filename).OK());
+	TTASSERT(!cbor::LoadFile(filename, back).OK());
+}
+
+BENCHFUNC(CborBench) {
+	string    src  = MakeBigJson(10 * 1024 * 1024);
+	const int reps = 3;
+	auto      j    = nlohmann::json::parse(src);
+	string    bin;
+	cbor::Encode(j, bin);
+
+	time::Benchmark b;
+	int64_t         sum = 0;
+	for (int i = 0; i < reps; i++) {
+		auto parsed = nlohmann::json::parse(src);
+		sum += parsed["items"].size();
+	}
+	double text = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		auto parsed = nlohmann::json::from_cbor(bin);
+		sum += parsed["items"].size();
+	}
+	double theirs = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		nlohmann::json parsed;
+		cbor::Decode(bin, parsed);
+		sum += parsed["items"].size();
+	}
+	double ours = b.Seconds();
+
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		cbor::Reader r(bin.data(), bin.size());
+		r.Skip();
+		sum += r.Position();
+	}
+	double scan = b.Seconds();
+
+	// As if it arrived from a socket
+	b.Start();
+	for (int i = 0; i < reps; i++) {
+		cbor::Decoder dec([&](nlohmann::json& item) -> Error {
+			sum += item["items"].size();
+			return Error();
+		});
+		for (size_t pos = 0; pos < bin.size(); pos += 16384)
+			dec.Write(bin.data() + pos, std::min<size_t>(16384, bin.size() - pos));
+	}
+	double stream = b.Seconds();
+
+	double mb = (double) (src.size() * reps) / (1024 * 1024);
+	tsf::print("cbor size: %v, vs %v of json\n", strings::FormatBytes(bin.size()), strings::FormatBytes(src.size()));
+	tsf::print("parse to DOM (MB/s of equivalent json): json %4.0f, nlohmann::from_cbor %4.0f, cbor::Decode %4.0f, cbor::Decoder in 16 KB pieces %4.0f. cbor::Reader scan %5.0f (%v)\n",
+	           mb / text, mb / theirs, mb / ours, mb / stream, mb / scan, sum & 1);
+}
+
+} // namespace bmhpal
@@ -0,0 +1,250 @@
+#include "pch.h"
+
+using namespace std;
+
+namespace bmhpal {
+
+// The digit-by-digit divide and reverse that ItoA used to do
+static size_t DivideAndReverse(int64_t value, char* result) {
+	char *  ptr = result, *ptr1 = result, tmp_char;
+	int64_t tmp_value;
+	do {
+		tmp_value = value;
+		value /= 10;
+		*ptr++ = "9876543210123456789"[9 + (tmp_value - value * 10)];
+	} while (value);
+	if (tmp_value < 0)
+		*ptr++ = '-';
+	size_t written = (size_t) (ptr - result);
+	*ptr--         = '\0';
+	while (ptr1 < ptr) {
+		tmp_char = *ptr;
+		*ptr--   = *ptr1;
+		*ptr1++  = tmp_char;
+	}
+	return written;
+}
+
+TESTFUNC(NumericFormat) {
+	char buf[numeric::MaxDoubleLen];
+
+	// Every digit count, and the values either side of each power of 10
+	uint64_t p = 1;
+	for (int digits = 1; digits <= 20; digits++) {
+		for (uint64_t v : {p - 1, p, p + 1, p * 9}) {
+			if (digits == 20 && v == p * 9)
+				continue; // overflow
+			TTASSEQ(string(buf, numeric::FormatUInt(v, buf)), to_string(v));
+		}
+		if (digits < 20)
+			p *= 10;
+	}
+	for (int64_t v : {(int64_t) 0, (int64_t) -1, (int64_t) 9, (int64_t) -10, INT64_MAX, INT64_MIN})
+		TTASSEQ(numeric::IntToString(v), to_string(v));
+	TTASSEQ(numeric::UIntToString(UINT64_MAX), "18446744073709551615");
+
+	TTASSEQ(numeric::DoubleToString(0.1), "0.1");
+	TTASSEQ(numeric::DoubleToString(-2.5e-300), "-2.5e-300");
+	TTASSEQ(numeric::DoubleToString(1.0 / 3), "0.3333333333333333");
+	TTASSEQ(numeric::DoubleToString(numeric_limits<double>::infinity()), "inf");
+	TTASSEQ(numeric::DoubleToString(-numeric_limits<double>::infinity()), "-inf");
+	TTASSEQ(numeric::DoubleToString(numeric_limits<double>::quiet_NaN()), "nan");
+
+	// Shortest round trip
+	uint32_t seed = 5;
+	for (int i = 0; i < 10000; i++) {
+		seed       = seed * 1103515245 + 12345;
+		uint64_t u = ((uint64_t) seed << 32) ^ ((uint64_t) (seed * 2654435761u) << 7) ^ i;
+		double   d;
+		memcpy(&d, &u, 8);
+		if (!std::isfinite(d))
+			continue;
+		size_t len = numeric::FormatDouble(d, buf);
+		double back;
+		TTASSERT(numeric::ParseDouble(strings::StringView(buf, len), back).OK());
+		TTASSERT(back == d);
+	}
+
+	char itoa[66];
+	TTASSEQ(ItoA(-123, itoa), 4);
+	TTASSEQ(string(itoa), "-123");
+	TTASSEQ(I64toA(255, 16), "ff");
+}
+
+TESTFUNC(BitScan) {
+	for (unsigned i = 0; i < 64; i++) {
+		uint64_t v = (uint64_t) 1 << i;
+		TTASSEQ(CountLeadingZeros64(v), 63 - i);
+		TTASSEQ(CountLeadingZeros64(v | 1), 63 - i);
+		TTASSEQ(CountTrailingZeros64(v), i);
+		TTASSEQ(CountTrailingZeros64(v | ((uint64_t) 1 << 63)), i);
+		if (i < 32) {
+			TTASSEQ(CountTrailingZeros((uint32_t) v), i);
+			TTASSEQ(CountTrailingZeros((uint32_t) v | 0x80000000u), i);
+			TTASSEQ(PopCount((uint32_t) v - 1), i);
+		}
+	}
+	TTASSEQ(PopCount(0xffffffffu), 32u);
+	TTASSEQ(PopCount(0x80000001u), 2u);
+}
+
+TESTFUNC(NumericParse) {
+	auto parseInt = [](const char* s, int64_t& v) {
+		return numeric::ParseInt(s, s + strlen(s), v);
+	};
+	int64_t v = 7;
+	auto    r = parseInt("123abc", v);
+	TTASSERT(r.Err.OK() && v == 123 && *r.Ptr == 'a');
+	r = parseInt("-9223372036854775808", v);
+	TTASSERT(r.Err.OK() && v == INT64_MIN);
+	v = 7;
+	r = parseInt("9223372036854775808", v);
+	TTASSERT(r.Err == numeric::ErrNumberOutOfRange && v == 7 && *r.Ptr == 0);
+	r = parseInt("-", v);
+	TTASSERT(r.Err == numeric::ErrInvalidNumber && v == 7);
+	r = parseInt("+1", v);
+	TTASSERT(r.Err == numeric::ErrInvalidNumber);
+	r = parseInt(" 1", v);
+	TTASSERT(r.Err == numeric::ErrInvalidNumber);
+
+	uint64_t u;
+	TTASSERT(numeric::ParseUInt("18446744073709551615", u).OK() && u == UINT64_MAX);
+	TTASSERT(numeric::ParseUInt("18446744073709551616", u) == numeric::ErrNumberOutOfRange);
+	TTASSERT(numeric::ParseUInt("-1", u) == numeric::ErrInvalidNumber);
+
+	int32_t i32;
+	TTASSERT(numeric::ParseInt("-2147483648", i32).OK() && i32 == INT32_MIN);
+	TTASSERT(numeric::ParseInt("2147483648", i32) == numeric::ErrNumberOutOfRange);
+	TTASSERT(numeric::ParseInt("12 ", i32) == numeric::ErrInvalidNumber);
+
+	auto parseDouble = [](const char* s, double& d) -> bool {
+		return numeric::ParseDouble(s, d).OK();
+	};
+	double d;
+	TTASSERT(parseDouble("0", d) && d == 0);
+	TTASSERT(parseDouble("-0", d) && d == 0 && std::signbit(d));
+	TTASSERT(parseDouble("1.5", d) && d == 1.5);
+	TTASSERT(parseDouble(".5", d) && d == 0.5);
+	TTASSERT(parseDouble("5.", d) && d == 5);
+	TTASSERT(parseDouble("1e10", d) && d == 1e10);
+	TTASSERT(parseDouble("1E-10", d) && d == 1e-10);
+	TTASSERT(parseDouble("2.2250738585072014e-308", d) && d == 2.2250738585072014e-308);
+	TTASSERT(parseDouble("0.000000000000000000000000000001", d) && d == 1e-30);
+	TTASSERT(parseDouble("123456789012345678901234567890", d) && d == 123456789012345678901234567890.0);
+	TTASSERT(parseDouble("9007199254740993", d) && d == 9007199254740992.0);
+	TTASSERT(parseDouble("-Infinity", d) && d == -numeric_limits<double>::infinity());
+	TTASSERT(parseDouble("nan", d) && std::isnan(d));
+	TTASSERT(!parseDouble("1e", d));
+	TTASSERT(!parseDouble(".", d));
+	TTASSERT(!parseDouble("in", d));
+	TTASSERT(numeric::ParseDouble("1e999", d) == numeric::ErrNumberOutOfRange);
+
+	// A dangling exponent is not consumed
+	const char* s  = "1e+x";
+	auto        rd = numeric::ParseDouble(s, s + 4, d);
+	TTASSERT(rd.Err.OK() && d == 1 && rd.Ptr == s + 1);
+
+	// Match strtod on random decimal strings, including ones too long for the fast path
+	uint32_t seed = 9;
+	auto     rnd  = [&]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 8;
+	};
+	for (int i = 0; i < 20000; i++) {
+		string str = rnd() % 2 ? "-" : "";
+		int    n   = 1 + rnd() % 25;
+		for (int j = 0; j < n; j++)
+			str += '0' + rnd() % 10;
+		if (rnd() % 2) {
+			str += '.';
+			n = rnd() % 25;
+			for (int j = 0; j < n; j++)
+				str += '0' + rnd() % 10;
+		}
+		if (rnd() % 2)
+			str += tsf::fmt("e%v", (int) (rnd() % 600) - 300);
+		double expect = strtod(str.c_str(), nullptr);
+		auto   err    = numeric::ParseDouble(str, d);
+		if (std::isinf(expect)) {
+			TTASSERT(err == numeric::ErrNumberOutOfRange);
+		} else {
+			TTASSERT(err.OK());
+			TTASSERT(d == expect);
+		}
+	}
+}
+
+BENCHFUNC(NumericBench) {
+	vector<int64_t> ints;
+	uint32_t        seed = 1;
+	for (int i = 0; i < 1000000; i++) {
+		seed = seed * 1103515245 + 12345;
+		// A mix of small and large magnitudes
+		ints.push_back(((int64_t) seed << (seed % 32)) * (i % 2 ? 1 : -1));
+	}
+	char   buf[66];
+	size_t sum = 0;
+
+	time::Benchmark b;
+	for (auto v : ints)
+		sum += DivideAndReverse(v, buf);
+	double itoaOld = b.Seconds();
+
+	b.Start();
+	for (auto v : ints)
+		sum += numeric::FormatInt(v, buf);
+	double itoaNew = b.Seconds();
+
+	vector<string> strs;
+	for (auto v : ints)
+		strs.push_back(numeric::IntToString(v));
+
+	b.Start();
+	for (const auto& s : strs)
+		sum += atoi64(s.c_str());
+	double atoiOld = b.Seconds();
+
+	b.Start();
+	for (const auto& s : strs) {
+		int64_t v = 0;
+		numeric::ParseInt(s.data(), s.data() + s.size(), v);
+		sum += v;
+	}
+	double atoiNew = b.Seconds();
+
+	vector<double> doubles;
+	for (size_t i = 0; i < 200000; i++)
+		doubles.push_back((double) ints[i] / (double) (i + 7));
+	b.Start();
+	for (auto d : doubles)
+		sum += tsf::fmt("%v", d).size();
+	double dtoaOld = b.Seconds();
+
+	b.Start();
+	for (auto d : doubles)
+		sum += numeric::FormatDouble(d, buf);
+	double dtoaNew = b.Seconds();
+
+	vector<string> dstrs;
+	for (auto d : doubles)
+		dstrs.push_back(numeric::DoubleToString(d));
+	b.Start();
+	for (const auto& s : dstrs)
+		sum += (size_t) strtod(s.c_str(), nullptr);
+	double strtodOld = b.Seconds();
+
+	b.Start();
+	for (const auto& s : dstrs) {
+		double d = 0;
+		numeric::ParseDouble(s.data(), s.data() + s.size(), d);
+		sum += (size_t) d;
+	}
+	double strtodNew = b.Seconds();
+
+	double ni = 1e9 / ints.size();
+	double nd = 1e9 / doubles.size();
+	tsf::print("ns per number (old / new): int format %.1f / %.1f, int parse %.1f / %.1f\n", itoaOld * ni, itoaNew * ni, atoiOld * ni, atoiNew * ni);
+	tsf::print("ns per number (old / new): double format (tsf) %.1f / %.1f, double parse (strtod) %.1f / %.1f (%v)\n", dtoaOld * nd, dtoaNew * nd, strtodOld * nd, strtodNew * nd, sum);
+}
+
+} // namespace bmhpal
@@ -52,4 +52,1073 @@ TESTFUNC(OS) {
 // If both self time and child find time is included, expect to see about 5ms and 500ms for self, children, respectively.
 #endif
 }
+
+TESTFUNC(MappedFile) {
+	const string filename = "junk-mapped.test";
+	string       content;
+	for (int i = 0; i < 10000; i++)
+		content += tsf::fmt("%v,", i);
+	TTASSERT(os::WriteFile(filename, content).OK());
+
+	for (auto flags : {os::MapFlags::None, os::MapFlags::NoMap}) {
+		os::MappedFile f;
+		TTASSERT(f.Open(filename, flags).OK());
+		TTASSERT(f.IsMapped() == (flags == os::MapFlags::None));
+		TTASSERT(string(f.Data(), f.Size()) == content);
+		TTASSERT(f.Advise(os::MapAdvice::Random).OK());
+
+		// Ranges don't need to be page aligned, and are clipped to the end of the file
+		TTASSERT(f.Open(filename, flags, 5000, 100).OK());
+		TTASSERT(f.Offset() == 5000);
+		TTASSERT(string(f.Data(), f.Size()) == content.substr(5000, 100));
+		TTASSERT(f.Open(filename, flags, content.size() - 10, 100).OK());
+		TTASSERT(string(f.Data(), f.Size()) == content.substr(content.size() - 10));
+		TTASSERT(f.Open(filename, flags, content.size() + 10).OK());
+		TTASSERT(f.IsOpen() && f.Size() == 0 && f.Data() != nullptr);
+
+		// Writes go back to the file
+		TTASSERT(f.Open(filename, flags | os::MapFlags::ReadWrite, 4097, 3).OK());
+		memcpy(f.MutableData(), "abc", 3);
+		os::MappedFile moved = std::move(f);
+		TTASSERT(!f.IsOpen());
+		TTASSERT(moved.Sync().OK());
+		TTASSERT(moved.Close().OK());
+		string after;
+		TTASSERT(os::ReadFile(filename, after).OK());
+		TTASSERT(after.substr(4097, 3) == "abc");
+		TTASSERT(after.substr(0, 4097) == content.substr(0, 4097));
+		TTASSERT(os::WriteFile(filename, content).OK());
+	}
+
+	os::MappedFile f;
+	TTASSERT(os::IsNotExist(f.Open("/a_bogus_path/that_should_not.exist")));
+	TTASSERT(!f.IsOpen());
+
+#ifdef BMHPAL_PLATFORM_LINUX
+	// /proc files can't be mapped, and have no size
+	TTASSERT(f.Open("/proc/self/status", os::MapFlags::None, 2).OK());
+	TTASSERT(!f.IsMapped() && f.Size() > 10);
+	TTASSERT(string(f.Data(), 4) == "me:\t");
+#endif
+
+	TTASSERT(os::Remove(filename).OK());
+}
+
+#ifdef BMHPAL_PLATFORM_LINUX
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+static size_t ResidentBytes() {
+	string statm;
+	os::ReadFile("/proc/self/statm", statm, os::ReadFlags::Stream);
+	size_t size = 0, resident = 0;
+	sscanf(statm.c_str(), "%zu %zu", &size, &resident);
+	return resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+BENCHFUNC(MappedFileBench) {
+	const string filename = "junk-mapped-bench.test";
+	const size_t size     = 256 * 1024 * 1024;
+	{
+		string content(size, 'x');
+		TTASSERT(os::WriteFile(filename, content).OK());
+	}
+
+	// Time to first byte, and RSS after touching the first byte, and then after touching every page
+	size_t          sum  = 0;
+	size_t          rss0 = ResidentBytes();
+	time::Benchmark b;
+	string          buf;
+	TTASSERT(os::ReadFile(filename, buf).OK());
+	sum += buf[0];
+	double readFirst = b.Seconds();
+	size_t readRss   = ResidentBytes() - rss0;
+	buf              = string();
+
+	rss0 = ResidentBytes();
+	b.Start();
+	os::MappedFile f;
+	TTASSERT(f.Open(filename).OK());
+	f.Advise(os::MapAdvice::Sequential);
+	sum += f.Data()[0];
+	double mapFirst    = b.Seconds();
+	size_t mapFirstRss = ResidentBytes() - rss0;
+	for (size_t i = 0; i < f.Size(); i += 4096)
+		sum += f.Data()[i];
+	double mapAll    = b.Seconds();
+	size_t mapAllRss = ResidentBytes() - rss0;
+	f.Close();
+
+	tsf::print("256 MB file (page cache warm). ReadFile: first byte %.1f ms, RSS %v\n", readFirst * 1000, strings::FormatBytes(readRss));
+	tsf::print("MappedFile: first byte %.3f ms, RSS %v. All pages %.1f ms, RSS %v (shared, reclaimable) (%v)\n", mapFirst * 1000, strings::FormatBytes(mapFirstRss), mapAll * 1000, strings::FormatBytes(mapAllRss), sum);
+	TTASSERT(os::Remove(filename).OK());
+}
+#endif
+
+TESTFUNC(AsyncIO) {
+	const string dir = "junk-asyncio";
+	os::RemoveAll(dir);
+	TTASSERT(os::MkDir(dir));
+	vector<string> files, expect;
+	for (int i = 0; i < 300; i++) {
+		// Include files that are larger than the first read, and empty files
+		files.push_back(dir + tsf::fmt("/%v", i));
+		expect.push_back(string((i * 997) % 40000, 'a' + i % 26));
+		TTASSERT(os::WriteFile(files.back(), expect.back()).OK());
+	}
+
+	for (bool threads : {false, true}) {
+		os::AsyncIO    aio(32, 4, threads);
+		vector<string> contents;
+		TTASSERT(aio.ReadFiles(files, contents).OK());
+		TTASSERT(contents == expect);
+
+		vector<string> withMissing = {files[1], dir + "/missing", files[2]};
+		vector<Error>  errs;
+		TTASSERT(aio.ReadFiles(withMissing, contents, &errs).OK());
+		TTASSERT(errs[0].OK() && os::IsNotExist(errs[1]) && errs[2].OK());
+		TTASSERT(contents[0] == expect[1] && contents[1] == "" && contents[2] == expect[2]);
+		TTASSERT(!aio.ReadFiles(withMissing, contents).OK());
+
+		// Chain open, write, stat and close through callbacks
+		os::FileAttributes attribs;
+		string             data = "hello async";
+		int                done = 0;
+		aio.Open(dir + "/w", O_CREAT | O_TRUNC | O_WRONLY, 0644, [&](Error err, int64_t fd) {
+			TTASSERT(err.OK());
+			aio.Write((int) fd, data.data(), data.size(), 0, [&, fd](Error err, int64_t n) {
+				TTASSERT(err.OK() && n == (int64_t) data.size());
+				aio.Close((int) fd, [&](Error err, int64_t r) {
+					TTASSERT(err.OK());
+					aio.Stat(dir + "/w", &attribs, [&](Error err, int64_t r) {
+						TTASSERT(err.OK());
+						done++;
+					});
+				});
+			});
+		});
+		aio.Stat(dir, &attribs, [&](Error err, int64_t r) { TTASSERT(err.OK()); });
+		TTASSERT(aio.Outstanding() == 2);
+		aio.WaitAll();
+		TTASSERT(aio.Outstanding() == 0);
+		TTASSERT(done == 1);
+		TTASSERT(attribs.Size == data.size() && !attribs.IsDir);
+	}
+	TTASSERT(os::RemoveAll(dir).OK());
+}
+
+BENCHFUNC(AsyncIOBench) {
+	const string dir = "junk-asyncio-bench";
+	os::RemoveAll(dir);
+	TTASSERT(os::MkDir(dir));
+	vector<string> files;
+	size_t         total = 0;
+	uint32_t       seed  = 1;
+	for (int i = 0; i < 20000; i++) {
+		seed = seed * 1103515245 + 12345;
+		files.push_back(dir + tsf::fmt("/%v", i));
+		string data(100 + (seed >> 8) % 8000, 'x');
+		TTASSERT(os::WriteFile(files.back(), data).OK());
+		total += data.size();
+	}
+
+	os::AsyncIO    ring;
+	os::AsyncIO    pool(256, 0, true);
+	vector<string> contents;
+	bench::Compare(tsf::fmt("Read %v small files (%v, page cache warm)", files.size(), strings::FormatBytes(total)),
+	               {
+	                   {"ReadFile loop", [&]() {
+		                    string s;
+		                    for (const auto& f : files)
+			                    TTASSERT(os::ReadFile(f, s).OK());
+	                    }},
+	                   {tsf::fmt("AsyncIO (%v)", ring.IsIOUring() ? "io_uring" : "thread pool"), [&]() { TTASSERT(ring.ReadFiles(files, contents).OK()); }},
+	                   {"AsyncIO (thread pool)", [&]() { TTASSERT(pool.ReadFiles(files, contents).OK()); }},
+	               });
+	TTASSERT(os::RemoveAll(dir).OK());
+}
+
+TESTFUNC(FileIO) {
+	const string filename = "junk-fileio.test";
+
+	// Lines of every length around the 64 byte scan width, and some longer than the buffer
+	vector<string> lines;
+	uint32_t       seed = 7;
+	for (int i = 0; i < 3000; i++) {
+		seed = seed * 1103515245 + 12345;
+		size_t len = i % 500 == 0 ? 10000 + (seed >> 8) % 10000 : (seed >> 8) % 150;
+		string line;
+		for (size_t j = 0; j < len; j++)
+			line += 'a' + (j + i) % 26;
+		lines.push_back(line);
+	}
+
+	for (auto flags : {os::FileFlags::None, os::FileFlags::Direct}) {
+		for (bool crlf : {false, true}) {
+			os::FileWriter w(4096);
+			TTASSERT(w.Open(filename, flags).OK());
+			string expect;
+			for (size_t i = 0; i < lines.size(); i++) {
+				// The last line has no terminator
+				string line = lines[i] + (i == lines.size() - 1 ? "" : crlf ? "\r\n" : "\n");
+				TTASSERT(w.Write(line).OK());
+				expect += line;
+			}
+			TTASSERT(w.Position() == expect.size());
+			TTASSERT(w.Close().OK());
+			string all;
+			TTASSERT(os::ReadFile(filename, all).OK());
+			TTASSERT(all == expect);
+
+			os::FileReader      r(4096);
+			strings::StringView line;
+			TTASSERT(r.Open(filename, flags).OK());
+			for (size_t i = 0; i < lines.size(); i++) {
+				TTASSERT(r.ReadLine(line).OK());
+				TTASSERT(line == lines[i]);
+			}
+			TTASSERT(r.ReadLine(line) == ErrEOF);
+			TTASSERT(r.Position() == expect.size());
+
+			// Read in odd sized pieces, including pieces larger than the buffer
+			TTASSERT(r.Open(filename, flags).OK());
+			string got;
+			char   buf[20000];
+			for (size_t i = 0;; i++) {
+				size_t n   = 0;
+				auto   err = r.Read(buf, 1 + i * 997 % sizeof(buf), n);
+				if (err == ErrEOF)
+					break;
+				TTASSERT(err.OK());
+				got.append(buf, n);
+			}
+			TTASSERT(got == expect);
+		}
+	}
+
+	// Append, an empty final line, and an empty file
+	os::FileWriter w;
+	TTASSERT(w.Open(filename).OK());
+	TTASSERT(w.Write("a\n").OK());
+	TTASSERT(w.Close().OK());
+	TTASSERT(w.Open(filename, os::FileFlags::Append).OK());
+	TTASSERT(w.Write("\nb\n").OK());
+	TTASSERT(w.Sync().OK());
+	TTASSERT(w.Close().OK());
+	os::FileReader r;
+	string         line;
+	TTASSERT(r.Open(filename).OK());
+	TTASSERT(r.ReadLine(line).OK() && line == "a");
+	TTASSERT(r.ReadLine(line).OK() && line == "");
+	TTASSERT(r.ReadLine(line).OK() && line == "b");
+	TTASSERT(r.ReadLine(line) == ErrEOF);
+	TTASSERT(w.Open(filename).OK());
+	TTASSERT(w.Close().OK());
+	TTASSERT(r.Open(filename).OK());
+	TTASSERT(r.ReadLine(line) == ErrEOF);
+	r.Close();
+
+	TTASSERT(os::IsNotExist(r.Open("/a_bogus_path/that_should_not.exist")));
+	TTASSERT(os::Remove(filename).OK());
+}
+
+BENCHFUNC(FileIOBench) {
+	const string filename = "junk-fileio-bench.test";
+	size_t       nlines   = 0;
+	{
+		os::FileWriter w;
+		TTASSERT(w.Open(filename).OK());
+		uint32_t seed = 3;
+		for (int i = 0; i < 2000000; i++) {
+			seed = seed * 1103515245 + 12345;
+			TTASSERT(w.Write(tsf::fmt("%v,%v,line %v\n", seed, seed >> 8, i)).OK());
+			nlines++;
+		}
+		TTASSERT(w.Close().OK());
+	}
+
+	size_t sum1 = 0, sum2 = 0;
+	bench::Compare(tsf::fmt("Read %v lines", nlines),
+	               {
+	                   {"fgets", [&]() {
+		                    FILE* f = fopen(filename.c_str(), "rb");
+		                    char  buf[4096];
+		                    while (fgets(buf, sizeof(buf), f))
+			                    sum1 += strlen(buf);
+		                    fclose(f);
+	                    }},
+	                   {"FileReader::ReadLine", [&]() {
+		                    os::FileReader      r;
+		                    strings::StringView line;
+		                    TTASSERT(r.Open(filename).OK());
+		                    while (r.ReadLine(line).OK())
+			                    sum2 += line.size() + 1;
+	                    }},
+	               });
+	TTASSERT(sum1 == sum2);
+	TTASSERT(os::Remove(filename).OK());
+}
+
+TESTFUNC(WriteFileAtomic) {
+	const string dir = "junk-atomic";
+	os::RemoveAll(dir);
+	TTASSERT(os::MkDir(dir));
+	const string filename = dir + "/a";
+	TTASSERT(os::WriteFileAtomic(filename, "first").OK());
+	TTASSERT(os::WriteFileAtomic(filename, "second").OK());
+	string content;
+	TTASSERT(os::ReadFile(filename, content).OK());
+	TTASSERT(content == "second");
+	TTASSERT(os::IsNotExist(os::WriteFileAtomic(dir + "/missing/a", "x")));
+
+#ifndef BMHPAL_PLATFORM_WINDOWS
+	// The replacement keeps the original's mode, even bits that the umask would remove
+	struct stat st;
+	TTASSERT(chmod(filename.c_str(), 0707) == 0);
+	TTASSERT(os::WriteFileAtomic(filename, "third").OK());
+	TTASSERT(stat(filename.c_str(), &st) == 0 && (st.st_mode & 07777) == 0707);
+#endif
+
+	// Concurrent writers sharing a SyncGroup
+	os::SyncGroup  group;
+	vector<thread> threads;
+	vector<Error>  errs(8);
+	for (int t = 0; t < 8; t++) {
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < 20 && errs[t].OK(); i++)
+				errs[t] = os::WriteFileAtomic(dir + tsf::fmt("/%v-%v", t, i), tsf::fmt("%v %v", t, i), &group);
+		});
+	}
+	for (auto& th : threads)
+		th.join();
+	for (const auto& err : errs)
+		TTASSERT(err.OK());
+	vector<os::FindFileItem> items;
+	TTASSERT(os::FindFiles(dir, items).OK());
+	TTASSERT(items.size() == 8 * 20 + 1); // No temporary files are left behind
+	TTASSERT(os::ReadFile(dir + "/3-7", content).OK());
+	TTASSERT(content == "3 7");
+	TTASSERT(group.Batches() <= 8 * 20 * 2);
+	TTASSERT(os::RemoveAll(dir).OK());
+}
+
+BENCHFUNC(WriteFileAtomicBench) {
+	const string dir = "junk-atomic-bench";
+	os::RemoveAll(dir);
+	TTASSERT(os::MkDir(dir));
+	const int nthreads = 16;
+	const int nfiles   = 25;
+
+	auto run = [&](os::SyncGroup* group) {
+		vector<thread> threads;
+		for (int t = 0; t < nthreads; t++) {
+			threads.emplace_back([&, t]() {
+				for (int i = 0; i < nfiles; i++)
+					os::WriteFileAtomic(dir + tsf::fmt("/%v-%v", t, i), string(4096, 'x'), group);
+			});
+		}
+		for (auto& th : threads)
+			th.join();
+	};
+
+	os::SyncGroup group;
+	bench::Compare(tsf::fmt("%v durable writes from %v threads", nthreads * nfiles, nthreads),
+	               {
+	                   {"fsync per file", [&]() { run(nullptr); }},
+	                   {"SyncGroup", [&]() { run(&group); }},
+	               });
+	tsf::print("SyncGroup issued %v syncs\n", group.Batches());
+	TTASSERT(os::RemoveAll(dir).OK());
+}
+
+TESTFUNC(CopyFile) {
+	const string dir = "junk-copyfile";
+	os::RemoveAll(dir);
+	TTASSERT(os::MkDir(dir));
+
+	// Ordinary file, overwriting an existing destination
+	string   data(3 * 1024 * 1024 + 17, 0);
+	uint32_t seed = 1;
+	for (auto& c : data) {
+		seed = seed * 1103515245 + 12345;
+		c    = (char) (seed >> 16);
+	}
+	TTASSERT(os::WriteFile(dir + "/a", data).OK());
+	TTASSERT(os::WriteFile(dir + "/b", string(10 * 1024 * 1024, 'x')).OK());
+	TTASSERT(os::CopyFile(dir + "/a", dir + "/b").OK());
+	string content;
+	TTASSERT(os::ReadFile(dir + "/b", content).OK());
+	TTASSERT(content == data);
+
+	// Empty file
+	TTASSERT(os::WriteFile(dir + "/empty", "").OK());
+	TTASSERT(os::CopyFile(dir + "/empty", dir + "/empty2").OK());
+	TTASSERT(os::ReadFile(dir + "/empty2", content).OK());
+	TTASSERT(content == "");
+
+	TTASSERT(os::IsNotExist(os::CopyFile(dir + "/missing", dir + "/c")));
+	TTASSERT(!os::FileExists(dir + "/c"));
+
+	// Copying a file onto itself must fail, and leave the file alone
+	TTASSERT(os::WriteFile(dir + "/self", "hello world").OK());
+	TTASSERT(!os::CopyFile(dir + "/self", dir + "/self").OK());
+	TTASSERT(os::ReadFile(dir + "/self", content).OK());
+	TTASSERT(content == "hello world");
+
+#ifdef BMHPAL_PLATFORM_LINUX
+	// Sparse file: 64 MB, with data at the start, in the middle, and a hole at the end
+	int fd = -1;
+	TTASSERT(os::OpenForWrite(dir + "/sparse", fd).OK());
+	TTASSERT(pwrite(fd, "head", 4, 0) == 4);
+	TTASSERT(pwrite(fd, "middle", 6, 32 * 1024 * 1024) == 6);
+	TTASSERT(ftruncate(fd, 64 * 1024 * 1024) == 0);
+	close(fd);
+	TTASSERT(os::CopyFile(dir + "/sparse", dir + "/sparse2").OK());
+	TTASSERT(os::ReadFile(dir + "/sparse2", content).OK());
+	TTASSERT(content.size() == 64 * 1024 * 1024);
+	TTASSERT(content.compare(0, 4, "head") == 0);
+	TTASSERT(content.compare(32 * 1024 * 1024, 6, "middle") == 0);
+	TTASSERT(content.find_first_not_of('\0', 32 * 1024 * 1024 + 6) == string::npos);
+	struct stat st;
+	TTASSERT(stat((dir + "/sparse2").c_str(), &st) == 0);
+	TTASSERT(st.st_blocks * 512 < 1024 * 1024); // The holes were preserved
+
+	// Same for a hard link
+	TTASSERT(link((dir + "/self").c_str(), (dir + "/self-link").c_str()) == 0);
+	TTASSERT(!os::CopyFile(dir + "/self", dir + "/self-link").OK());
+	TTASSERT(os::ReadFile(dir + "/self-link", content).OK());
+	TTASSERT(content == "hello world");
+
+	// Preallocate reserves space without changing the file's contents
+	TTASSERT(os::OpenForWrite(dir + "/prealloc", fd).OK());
+	Error err = os::Preallocate(fd, 0, 8 * 1024 * 1024);
+	if (err.OK()) {
+		TTASSERT(fstat(fd, &st) == 0);
+		TTASSERT(st.st_size == 8 * 1024 * 1024);
+		TTASSERT(st.st_blocks * 512 >= 8 * 1024 * 1024);
+	}
+	close(fd);
+#endif
+
+	TTASSERT(os::RemoveAll(dir).OK());
+}
+
+BENCHFUNC(CopyFileBench) {
+	const string dir = "junk-copyfile-bench";
+	os::RemoveAll(dir);
+	TTASSERT(os::MkDir(dir));
+	string data(256 * 1024 * 1024, 'x');
+	TTASSERT(os::WriteFile(dir + "/src", data).OK());
+	data = string();
+
+	bench::Compare("Copy 256 MB",
+	               {
+	                   {"ReadFile + WriteFile", [&]() {
+		                    string content;
+		                    TTASSERT(os::ReadFile(dir + "/src", content).OK());
+		                    TTASSERT(os::WriteFile(dir + "/dst1", content).OK());
+	                    }},
+	                   {"CopyFile", [&]() { TTASSERT(os::CopyFile(dir + "/src", dir + "/dst2").OK()); }},
+	               });
+	TTASSERT(os::RemoveAll(dir).OK());
+}
+
+static void FindFilesRecursive(const string& dir, size_t& n) {
+	vector<os::FindFileItem> items;
+	os::FindFiles(dir, items);
+	n += items.size();
+	for (const auto& item : items) {
+		if (item.IsDir)
+			FindFilesRecursive(item.FullPath, n);
+	}
+}
+
+static void MakeTree(const string& root, int ndirs, int nfiles) {
+	os::MkDir(root);
+	for (int d = 0; d < ndirs; d++) {
+		// Two levels, so that there is some depth to walk
+		string sub = root + tsf::fmt("/%v", d % 10);
+		string dir = sub + tsf::fmt("/%v", d);
+		os::MkDir(sub);
+		os::MkDir(dir);
+		for (int f = 0; f < nfiles; f++)
+			os::WriteFile(dir + tsf::fmt("/file-%v", f), "");
+	}
+}
+
+TESTFUNC(WalkDir) {
+	const string root = "junk-walk";
+	os::RemoveAll(root);
+	MakeTree(root, 40, 25);
+	TTASSERT(os::WriteFile(root + "/3/3/big", string(1000, 'x')).OK());
+
+	size_t expect = 0;
+	FindFilesRecursive(root, expect);
+	TTASSERT(expect == 10 + 40 + 40 * 25 + 1);
+
+	for (int nthreads : {1, 4}) {
+		mutex          lock;
+		vector<string> paths;
+		int            maxDepth = 0;
+		auto           visit    = [&](const os::WalkEntry& e) {
+			lock_guard<mutex> g(lock);
+			paths.push_back(e.Path);
+			maxDepth = max(maxDepth, e.Depth);
+			TTASSERT(e.Path.substr(e.Path.rfind('/') + 1) == e.Name);
+			TTASSERT(e.IsDir == (strncmp(e.Name, "file-", 5) != 0 && strcmp(e.Name, "big") != 0));
+			if (strcmp(e.Name, "big") == 0) {
+				os::FileAttributes attribs;
+				TTASSERT(e.Stat(attribs).OK());
+				TTASSERT(attribs.Size == 1000);
+			}
+			return os::WalkAction::Continue;
+		};
+		auto err = os::WalkDir(root, visit, nthreads);
+		TTASSERT(err.OK());
+		TTASSERT(paths.size() == expect);
+		TTASSERT(maxDepth == 2);
+		sort(paths.begin(), paths.end());
+		TTASSERT(unique(paths.begin(), paths.end()) == paths.end());
+		TTASSERT(binary_search(paths.begin(), paths.end(), root + "/7/17/file-24"));
+	}
+
+	// Skip the subdirectories of "3"
+	atomic<int> n(0);
+	auto skip = [&](const os::WalkEntry& e) {
+		n++;
+		return e.Depth == 1 && e.Path.find("/3/") != string::npos ? os::WalkAction::Skip : os::WalkAction::Continue;
+	};
+	TTASSERT(os::WalkDir(root, skip).OK());
+	TTASSERT(n == (int) expect - 4 * 25 - 1);
+
+	// Stop
+	n = 0;
+	auto stop = [&](const os::WalkEntry& e) {
+		n++;
+		return os::WalkAction::Stop;
+	};
+	TTASSERT(os::WalkDir(root, stop).OK());
+	TTASSERT(n >= 1 && n <= 8);
+
+	TTASSERT(os::IsNotExist(os::WalkDir(root + "/missing", [](const os::WalkEntry& e) { return os::WalkAction::Continue; })));
+	TTASSERT(os::RemoveAll(root).OK());
+}
+
+BENCHFUNC(WalkDirBench) {
+	const string root = "junk-walk-bench";
+	os::RemoveAll(root);
+	MakeTree(root, 2000, 50);
+
+	bool canDropCaches = bench::CanDropCaches();
+	for (int cold = 0; cold < 2; cold++) {
+		if (cold && !canDropCaches)
+			break;
+		size_t         n1 = 0;
+		atomic<size_t> n2(0);
+		auto           prepare = [&]() {
+			if (cold)
+				bench::DropCaches();
+		};
+		bench::Compare(tsf::fmt("Walk %v files, %v cache", 2000 * 50, cold ? "cold" : "warm"),
+		               {
+		                   {"FindFiles recursion", [&]() { FindFilesRecursive(root, n1); }, prepare},
+		                   {"WalkDir", [&]() {
+			                    os::WalkDir(root, [&](const os::WalkEntry& e) {
+				                    n2++;
+				                    return os::WalkAction::Continue;
+			                    });
+		                    },
+		                    prepare},
+		               });
+		TTASSERT(n1 == n2);
+	}
+	TTASSERT(os::RemoveAll(root).OK());
+}
+
+TESTFUNC(RemoveAll) {
+	const string root = "junk-removeall";
+	os::RemoveAll(root);
+	MakeTree(root, 30, 20);
+	string deep = root;
+	for (int i = 0; i < 10; i++) {
+		deep += "/deep";
+		TTASSERT(os::MkDir(deep));
+	}
+	TTASSERT(os::WriteFile(deep + "/x", "x").OK());
+	TTASSERT(os::RemoveAll(root).OK());
+	TTASSERT(!os::DirExists(root));
+
+	// Nonexistent path, and a plain file
+	TTASSERT(os::RemoveAll(root).OK());
+	TTASSERT(os::WriteFile(root, "x").OK());
+	TTASSERT(os::RemoveAll(root).OK());
+	TTASSERT(!os::FileExists(root));
+
+#ifdef BMHPAL_PLATFORM_LINUX
+	// A symbolic link to a directory is removed, but its target is not touched
+	MakeTree(root, 2, 2);
+	TTASSERT(os::MkDir(root + "/link"));
+	TTASSERT(symlink("../1", (root + "/link/to1").c_str()) == 0);
+	TTASSERT(os::RemoveAll(root + "/link").OK());
+	TTASSERT(os::FileExists(root + "/1/1/file-0"));
+
+	// Errors are reported for each entry that can't be removed, and removal carries on.
+	// A read-only directory only stops a non-root user.
+	if (geteuid() != 0) {
+		TTASSERT(chmod((root + "/0/0").c_str(), 0555) == 0);
+		mutex          lock;
+		vector<string> failed;
+		auto           err = os::RemoveAll(root, [&](const string& path, Error err) {
+			lock_guard<mutex> g(lock);
+			failed.push_back(path);
+		});
+		TTASSERT(!err.OK());
+		TTASSERT(failed.size() == 2);
+		TTASSERT(!os::DirExists(root + "/1"));
+		TTASSERT(os::FileExists(root + "/0/0/file-1"));
+		TTASSERT(chmod((root + "/0/0").c_str(), 0755) == 0);
+	}
+#endif
+	TTASSERT(os::RemoveAll(root).OK());
+	TTASSERT(!os::DirExists(root));
+}
+
+// This is how RemoveAll used to work
+static Error RemoveAllSerial(const string& path) {
+	vector<os::FindFileItem> items;
+	auto                     err = os::FindFiles(path, items);
+	if (!err.OK())
+		return err;
+	for (const auto& item : items) {
+		if (item.IsDir)
+			err = RemoveAllSerial(item.FullPath);
+		else
+			err = os::Remove(item.FullPath);
+		if (!err.OK())
+			return err;
+	}
+	return os::Remove(path);
+}
+
+BENCHFUNC(RemoveAllBench) {
+	const string root = "junk-removeall-bench";
+	os::RemoveAll(root);
+
+	auto makeTree = [&]() { MakeTree(root, 1000, 50); };
+	bench::Compare(tsf::fmt("Delete %v files", 1000 * 50),
+	               {
+	                   {"FindFiles recursion", [&]() { TTASSERT(RemoveAllSerial(root).OK()); }, makeTree},
+	                   {"RemoveAll", [&]() { TTASSERT(os::RemoveAll(root).OK()); }, makeTree},
+	               });
+}
+
+TESTFUNC(StatMany) {
+	const string dir = "junk-statmany";
+	os::RemoveAll(dir);
+	TTASSERT(os::MkDir(dir));
+	TTASSERT(os::MkDir(dir + "/sub"));
+	vector<string> paths;
+	for (int i = 0; i < 10; i++) {
+		paths.push_back(dir + tsf::fmt("/%v", i));
+		TTASSERT(os::WriteFile(paths.back(), string(i, 'x')).OK());
+	}
+	paths.push_back(dir + "/sub");
+	paths.push_back(dir + "/missing");
+	paths.push_back(dir + "/5");
+
+	for (int useAIO = 0; useAIO < 2; useAIO++) {
+		os::AsyncIO                aio;
+		vector<os::FileAttributes> attribs;
+		vector<Error>              errs;
+		TTASSERT(!os::StatMany(paths, os::StatMask::All, attribs).OK());
+		TTASSERT(os::StatMany(paths, os::StatMask::All, attribs, &errs, useAIO ? &aio : nullptr).OK());
+		TTASSERT(attribs.size() == paths.size() && errs.size() == paths.size());
+		for (int i = 0; i < 10; i++) {
+			TTASSERT(errs[i].OK());
+			TTASSERT(attribs[i].Size == i);
+			TTASSERT(!attribs[i].IsDir);
+			TTASSERT(attribs[i].NLink == 1);
+			TTASSERT(attribs[i].TimeModifyNS != 0);
+			TTASSERT(fabs(attribs[i].TimeModifyNS / 1e9 - attribs[i].TimeModify) < 1e-5);
+			if (i != 0)
+				TTASSERT(attribs[i].Inode != attribs[i - 1].Inode);
+		}
+		TTASSERT(attribs[10].IsDir);
+		TTASSERT(os::IsNotExist(errs[11]));
+		TTASSERT(attribs[12].Inode == attribs[5].Inode);
+	}
+
+	// A trailing slash, followed by a path in that directory
+	{
+		TTASSERT(os::WriteFile(dir + "/sub/a", "a").OK());
+		vector<string>             slashed = {dir + "/sub/", dir + "/sub/a", dir + "/", dir + "/0"};
+		vector<os::FileAttributes> attribs;
+		TTASSERT(os::StatMany(slashed, os::StatMask::All, attribs).OK());
+		TTASSERT(attribs[0].IsDir && attribs[1].Size == 1 && attribs[2].IsDir && attribs[3].Size == 0);
+	}
+
+	// Change detection with the exact timestamp
+	os::FileAttributes a1, a2;
+	TTASSERT(os::Stat(paths[3], a1).OK());
+	os::Sleep(time::Millisecond * 5);
+	TTASSERT(os::WriteFile(paths[3], "yyy").OK());
+	TTASSERT(os::Stat(paths[3], a2, os::StatMask::TimeModify | os::StatMask::Inode).OK());
+	TTASSERT(a2.TimeModifyNS > a1.TimeModifyNS);
+	TTASSERT(a2.Inode == a1.Inode);
+
+	TTASSERT(os::RemoveAll(dir).OK());
+}
+
+BENCHFUNC(StatManyBench) {
+	const string root = "junk-statmany-bench";
+	os::RemoveAll(root);
+	MakeTree(root, 400, 100);
+	vector<string> paths;
+	os::WalkDir(root, [&](const os::WalkEntry& e) {
+		paths.push_back(e.Path);
+		return os::WalkAction::Continue;
+	}, 1);
+
+	bool canDropCaches = bench::CanDropCaches();
+	for (int cold = 0; cold < 2; cold++) {
+		if (cold && !canDropCaches)
+			break;
+		vector<os::FileAttributes> attribs(paths.size());
+		os::AsyncIO                aio;
+		auto                       mask = os::StatMask::Size | os::StatMask::TimeModify;
+		// With a warm cache, run each method once before timing it, so that they all see the same state
+		auto c = [&](const string& name, std::function<void()> f) {
+			std::function<void()> prepare = f;
+			if (cold)
+				prepare = bench::DropCaches;
+			return bench::Case{name, f, prepare};
+		};
+		bench::Compare(tsf::fmt("Stat %v files, %v cache", paths.size(), cold ? "cold" : "warm"),
+		               {
+		                   c("Stat loop", [&]() {
+			                   for (size_t i = 0; i < paths.size(); i++)
+				                   os::Stat(paths[i], attribs[i]);
+		                   }),
+		                   c("StatMany", [&]() { os::StatMany(paths, mask, attribs); }),
+		                   c(tsf::fmt("StatMany with %v", aio.IsIOUring() ? "io_uring" : "thread pool"), [&]() { os::StatMany(paths, mask, attribs, nullptr, &aio); }),
+		               });
+	}
+	TTASSERT(os::RemoveAll(root).OK());
+}
+
+namespace os {
+// Reaches into Watcher's privates
+struct WatcherTester {
+	static void SimulateOverflow(Watcher& w) { w.SimulateOverflow(); }
+};
+} // namespace os
+
+// Collect events until none have arrived for quietMs
+static vector<os::WatchEvent> DrainEvents(os::Watcher& w, int quietMs) {
+	vector<os::WatchEvent> events;
+	auto                   last = time::Now();
+	while ((time::Now() - last).Milliseconds() < quietMs) {
+		os::WatchEvent ev;
+		if (w.Events.PopTail(ev)) {
+			events.push_back(ev);
+			last = time::Now();
+		} else {
+			os::Sleep(time::Millisecond);
+		}
+	}
+	return events;
+}
+
+static uint32_t FindEvent(const vector<os::WatchEvent>& events, const string& path) {
+	for (const auto& ev : events) {
+		if (ev.Path == path)
+			return (uint32_t) ev.Events;
+	}
+	return 0;
+}
+
+TESTFUNC(Watcher) {
+#ifdef BMHPAL_PLATFORM_LINUX
+	const string root = "junk-watcher";
+	os::RemoveAll(root);
+	TTASSERT(os::MkDir(root));
+	TTASSERT(os::MkDir(root + "/existing"));
+
+	os::Watcher w;
+	TTASSERT(w.Add(root).OK());
+	TTASSERT(w.Start(time::Millisecond * 20).OK());
+	TTASSERT(w.NumWatches() == 2);
+
+	// Many writes are coalesced into one event
+	os::FileWriter f(16);
+	TTASSERT(f.Open(root + "/a").OK());
+	for (int i = 0; i < 100; i++)
+		TTASSERT(f.Write("0123456789abcdef0123456789abcdef").OK());
+	TTASSERT(f.Close().OK());
+	auto events = DrainEvents(w, 100);
+	TTASSERT(events.size() == 1);
+	TTASSERT(events[0].Path == root + "/a");
+	TTASSERT(events[0].Events == (os::WatchEvents::Create | os::WatchEvents::Modify));
+	TTASSERT(!events[0].IsDir);
+
+	// A new directory is watched, and files that were created in it before the watch was added are reported
+	TTASSERT(os::MkDir(root + "/sub"));
+	TTASSERT(os::WriteFile(root + "/sub/x", "x").OK());
+	events = DrainEvents(w, 100);
+	TTASSERT(FindEvent(events, root + "/sub") == (uint32_t) os::WatchEvents::Create);
+	TTASSERT(FindEvent(events, root + "/sub/x") & (uint32_t) os::WatchEvents::Create);
+	TTASSERT(events[0].Path == root + "/sub" && events[0].IsDir);
+	TTASSERT(w.NumWatches() == 3);
+	TTASSERT(os::WriteFile(root + "/existing/y", "y").OK());
+	TTASSERT(os::WriteFile(root + "/sub/x", "xx").OK());
+	events = DrainEvents(w, 100);
+	TTASSERT(events.size() == 2);
+	TTASSERT(FindEvent(events, root + "/sub/x") == (uint32_t) os::WatchEvents::Modify);
+	TTASSERT(FindEvent(events, root + "/existing/y") & (uint32_t) os::WatchEvents::Create);
+
+	// A short lived file produces nothing
+	TTASSERT(os::WriteFile(root + "/tmp", "x").OK());
+	TTASSERT(os::Remove(root + "/tmp").OK());
+	// Renames
+	TTASSERT(os::Rename(root + "/a", root + "/b").OK());
+	TTASSERT(os::Rename(root + "/sub", root + "/sub2").OK());
+	events = DrainEvents(w, 100);
+	TTASSERT(events.size() == 5);
+	TTASSERT(FindEvent(events, root + "/tmp") == 0);
+	TTASSERT(FindEvent(events, root + "/a") == (uint32_t) os::WatchEvents::Delete);
+	TTASSERT(FindEvent(events, root + "/b") == (uint32_t) os::WatchEvents::Create);
+	TTASSERT(FindEvent(events, root + "/sub") == (uint32_t) os::WatchEvents::Delete);
+	TTASSERT(FindEvent(events, root + "/sub2") == (uint32_t) os::WatchEvents::Create);
+	TTASSERT(FindEvent(events, root + "/sub2/x") == (uint32_t) os::WatchEvents::Create); // The contents of a directory that moves in are new paths
+	TTASSERT(os::WriteFile(root + "/sub2/z", "z").OK());
+	events = DrainEvents(w, 100);
+	TTASSERT(FindEvent(events, root + "/sub2/z") & (uint32_t) os::WatchEvents::Create);
+	TTASSERT(w.NumWatches() == 3);
+
+	// Deleting a directory releases its watch
+	TTASSERT(os::RemoveAll(root + "/sub2").OK());
+	events = DrainEvents(w, 100);
+	TTASSERT(FindEvent(events, root + "/sub2") == (uint32_t) os::WatchEvents::Delete);
+	TTASSERT(w.NumWatches() == 2);
+
+	// When the kernel's queue overflows, we can't know what was lost, so the whole root must be rescanned
+	os::WatcherTester::SimulateOverflow(w);
+	events = DrainEvents(w, 100);
+	TTASSERT(events.size() == 1);
+	TTASSERT(FindEvent(events, root) == (uint32_t) os::WatchEvents::Rescan);
+	TTASSERT(w.NumWatches() == 2);
+
+	w.Stop();
+	TTASSERT(os::RemoveAll(root).OK());
+#endif
+}
+
+BENCHFUNC(WatcherBench) {
+#ifdef BMHPAL_PLATFORM_LINUX
+	const string root = "junk-watcher-bench";
+	os::RemoveAll(root);
+	MakeTree(root, 200, 100);
+
+	// Detect changes by rescanning, the way we used to
+	auto scan = [&](vector<string>& paths, vector<os::FileAttributes>& attribs) {
+		paths.clear();
+		os::WalkDir(root, [&](const os::WalkEntry& e) {
+			paths.push_back(e.Path);
+			return os::WalkAction::Continue;
+		}, 1);
+		os::StatMany(paths, os::StatMask::Size | os::StatMask::TimeModify, attribs);
+	};
+	vector<string>             paths1, paths2;
+	vector<os::FileAttributes> attribs1, attribs2;
+	scan(paths1, attribs1);
+
+	os::Watcher w;
+	TTASSERT(w.Add(root).OK());
+	TTASSERT(w.Start(time::Millisecond * 5).OK());
+	for (int i = 0; i < 10; i++)
+		TTASSERT(os::WriteFile(root + tsf::fmt("/%v/%v/file-%v", i, i * 11, i), "changed").OK());
+
+	time::Benchmark b;
+	size_t          events = 0;
+	os::WatchEvent  ev;
+	while (events < 10) {
+		w.Events.Semaphore.wait();
+		w.Events.PopTail(ev);
+		events++;
+	}
+	double watch = b.Seconds();
+
+	b.Start();
+	scan(paths2, attribs2);
+	size_t changed = 0;
+	for (size_t i = 0; i < attribs2.size(); i++)
+		changed += attribs2[i].TimeModifyNS != attribs1[i].TimeModifyNS || attribs2[i].Size != attribs1[i].Size;
+	double rescan = b.Seconds();
+
+	TTASSERT(changed == 10);
+	tsf::print("Detect 10 changes in %v files. Rescan: %.1f ms, Watcher: %.1f ms after the last write (including 5 ms debounce), %v inotify watches\n", paths1.size(), rescan * 1000, watch * 1000, w.NumWatches());
+	w.Stop();
+	TTASSERT(os::RemoveAll(root).OK());
+#endif
+}
+
+TESTFUNC(Process) {
+#ifdef BMHPAL_PLATFORM_LINUX
+	os::SpawnOptions capture;
+	capture.Stdout = os::StdioMode::Buffer;
+	capture.Stderr = os::StdioMode::Buffer;
+
+	{
+		os::Process p;
+		TTASSERT(p.Start("/bin/sh", {"-c", "echo hello; echo oops >&2; exit 3"}, capture).OK());
+		TTASSERT(p.Wait().OK());
+		TTASSERT(p.Output == "hello\n");
+		TTASSERT(p.ErrorOutput == "oops\n");
+		TTASSERT(p.ExitCode == 3);
+		TTASSERT(p.Exited());
+	}
+
+	{
+		// stderr goes wherever stdout goes
+		auto opt   = capture;
+		opt.Stderr = os::StdioMode::Stdout;
+		os::Process p;
+		TTASSERT(p.Start("/bin/sh", {"-c", "echo a; echo b >&2"}, opt).OK());
+		TTASSERT(p.Wait().OK());
+		TTASSERT(p.Output == "a\nb\n");
+		TTASSERT(p.ExitCode == 0);
+	}
+
+	{
+		// Far more input and output than fits in a pipe's buffer
+		auto opt  = capture;
+		opt.Stdin = os::StdioMode::Buffer;
+		opt.Input.resize(1024 * 1024);
+		for (size_t i = 0; i < opt.Input.size(); i++)
+			opt.Input[i] = 'a' + i % 26;
+		opt.Flags = os::ExecFlags::UseSearchPath;
+		os::Process p;
+		TTASSERT(p.Start("cat", {}, opt).OK());
+		TTASSERT(p.Wait().OK());
+		TTASSERT(p.Output == opt.Input);
+	}
+
+	{
+		// Environment and working directory
+		auto opt = capture;
+		opt.Env  = {"PAL_TEST_VAR=xyz"};
+		opt.Cwd  = "/tmp";
+		os::Process p;
+		TTASSERT(p.Start("/bin/sh", {"-c", "echo $PAL_TEST_VAR; pwd; echo ${HOME:+home}"}, opt).OK());
+		TTASSERT(p.Wait().OK());
+		TTASSERT(p.Output == (os::GetEnv("HOME") != "" ? "xyz\n/tmp\nhome\n" : "xyz\n/tmp\n\n"));
+
+		opt.ClearEnv = true;
+		os::Process p2;
+		TTASSERT(p2.Start("/bin/sh", {"-c", "echo $PAL_TEST_VAR; echo ${HOME:+home}"}, opt).OK());
+		TTASSERT(p2.Wait().OK());
+		TTASSERT(p2.Output == "xyz\n\n");
+	}
+
+	{
+		// A missing executable is reported by Start, not by a child that exits with an error
+		os::Process p;
+		TTASSERT(!p.Start("/a_bogus_path/that_should_not.exist", {}, capture).OK());
+		os::ProcessHandle h;
+		TTASSERT(!os::Exec("/a_bogus_path/that_should_not.exist", {}, os::ExecFlags::None, h).OK());
+	}
+
+	{
+		// Timeout, and Kill
+		os::Process p;
+		TTASSERT(p.Start("/bin/sleep", {"10"}).OK());
+		TTASSERT(p.Wait(50) == os::ErrTimeout);
+		TTASSERT(!p.Exited());
+		TTASSERT(p.Kill().OK());
+		TTASSERT(p.Wait().OK());
+		TTASSERT(p.ExitCode == 128 + SIGKILL);
+	}
+
+	{
+		// Pipe, where we do the reading and writing ourselves
+		os::SpawnOptions opt;
+		opt.Stdin  = os::StdioMode::Pipe;
+		opt.Stdout = os::StdioMode::Pipe;
+		os::Process p;
+		TTASSERT(p.Start("/bin/cat", {}, opt).OK());
+		TTASSERT(write(p.StdinPipe, "ping", 4) == 4);
+		close(p.StdinPipe);
+		p.StdinPipe = -1;
+		string out;
+		char   buf[16];
+		while (true) {
+			auto n = read(p.StdoutPipe, buf, sizeof(buf));
+			if (n == 0)
+				break;
+			if (n > 0)
+				out.append(buf, n);
+			else
+				usleep(1000);
+		}
+		TTASSERT(out == "ping");
+		TTASSERT(p.Wait().OK());
+		TTASSERT(p.ExitCode == 0);
+	}
+
+	{
+		// Many processes, all driven by one event loop
+		const int                       n = 50;
+		vector<unique_ptr<os::Process>> procs;
+		vector<os::Process*>            raw;
+		for (int i = 0; i < n; i++) {
+			procs.emplace_back(new os::Process());
+			TTASSERT(procs.back()->Start("/bin/sh", {"-c", tsf::fmt("echo %v; exit %v", i, i % 7)}, capture).OK());
+			raw.push_back(procs.back().get());
+		}
+		TTASSERT(os::Process::WaitAll(raw).OK());
+		for (int i = 0; i < n; i++) {
+			TTASSERT(procs[i]->Output == tsf::fmt("%v\n", i));
+			TTASSERT(procs[i]->ExitCode == i % 7);
+		}
+	}
+#endif
+}
+
+BENCHFUNC(ProcessBench) {
+#ifdef BMHPAL_PLATFORM_LINUX
+	// fork has to copy our page tables, so it gets slower as we grow. posix_spawn doesn't.
+	vector<char> ballast(256 * 1024 * 1024);
+	for (size_t i = 0; i < ballast.size(); i += 4096)
+		ballast[i] = 1;
+
+	const int n = 100;
+
+	bench::Compare(tsf::fmt("Launch /bin/true %v times, with %v MB resident", n, ResidentBytes() / (1024 * 1024)),
+	               {
+	                   {"fork+exec", [&]() {
+		                    for (int i = 0; i < n; i++) {
+			                    pid_t pid = fork();
+			                    if (pid == 0) {
+				                    execl("/bin/true", "/bin/true", nullptr);
+				                    _exit(1);
+			                    }
+			                    int status = 0;
+			                    waitpid(pid, &status, 0);
+			                    TTASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+		                    }
+	                    }},
+	                   {"Process", [&]() {
+		                    for (int i = 0; i < n; i++) {
+			                    os::Process p;
+			                    TTASSERT(p.Start("/bin/true", {}).OK());
+			                    TTASSERT(p.Wait().OK());
+			                    TTASSERT(p.ExitCode == 0);
+		                    }
+	                    }},
+	               });
+#endif
+}
+
 } // namespace bmhpal
\ No newline at end of file
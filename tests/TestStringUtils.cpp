@@ -35,6 +35,463 @@ TESTFUNC(EqualsNoCase) {
 	TTASSERT(!strings::EqualsNoCase("a", ""));
 }
 
+TESTFUNC(StringTrimView) {
+	string s = "\t a b \r\n";
+	auto   v = strings::TrimSpaceView(s);
+	TTASSERT(v == "a b");
+	TTASSERT(v.data() == s.data() + 2);
+	TTASSERT(strings::TrimSpaceView(strings::StringView("")).empty());
+	TTASSERT(strings::TrimSpaceView(strings::StringView("   ")).empty());
+	TTASSERT(v.substr(2) == "b");
+	TTASSERT(v.substr(5).empty());
+
+	strings::TrimSpaceInPlace(s);
+	TTASSEQ(s, "a b");
+	s = "  ";
+	strings::TrimSpaceInPlace(s);
+	TTASSEQ(s, "");
+	s = "ab";
+	strings::TrimSpaceInPlace(s);
+	TTASSEQ(s, "ab");
+}
+
+TESTFUNC(StringCase) {
+	// Cover the vector bodies and scalar tails, and every byte value
+	string all;
+	for (int i = 0; i < 256; i++)
+		all += (char) i;
+	for (size_t len = 0; len < 300; len += 7) {
+		string s;
+		for (size_t i = 0; i < len; i++)
+			s += all[(i * 37) % 256];
+		string lo = s, up = s;
+		for (auto& c : lo)
+			c = (c >= 'A' && c <= 'Z') ? c + 32 : c;
+		for (auto& c : up)
+			c = (c >= 'a' && c <= 'z') ? c - 32 : c;
+		TTASSERT(strings::tolower(s) == lo);
+		TTASSERT(strings::toupper(s) == up);
+		TTASSERT(strings::EqualsNoCase(lo, up));
+		TTASSERT(strings::EqualsNoCase(strings::StringView(s), strings::StringView(up)));
+		if (len != 0) {
+			// A difference at any position must be detected
+			for (size_t i = 0; i < len; i++) {
+				string t = up;
+				t[i] ^= (t[i] >= 'A' && t[i] <= 'Z') || (t[i] >= 'a' && t[i] <= 'z') ? 1 : 0x20;
+				TTASSERT(!strings::EqualsNoCase(lo, t));
+			}
+		}
+	}
+	TTASSERT(!strings::EqualsNoCase(string("@"), string("`")));
+	TTASSERT(!strings::EqualsNoCase(string("[{"), string("{[")));
+	TTASSERT(strings::tolower(wstring(L"AbC\u00C0")) == L"abc\u00C0");
+	TTASSERT(strings::EqualsNoCase(wstring(L"AbC"), wstring(L"aBc")));
+}
+
+BENCHFUNC(StringCaseBench) {
+	auto naiveLower = [](const string& s) {
+		string r;
+		r.reserve(s.size());
+		for (char c : s)
+			r += (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+		return r;
+	};
+	auto naiveEquals = [](const string& a, const string& b) {
+		if (a.size() != b.size())
+			return false;
+		for (size_t i = 0; i < a.size(); i++) {
+			int _a = a[i];
+			int _b = b[i];
+			_a     = (_a >= 'A' && _a <= 'Z') ? _a + 'a' - 'A' : _a;
+			_b     = (_b >= 'A' && _b <= 'Z') ? _b + 'a' - 'A' : _b;
+			if (_a != _b)
+				return false;
+		}
+		return true;
+	};
+
+	// HTTP header names, and a large mixed-case document
+	vector<string> headers = {"Content-Type", "Content-Length", "Accept-Encoding", "X-Forwarded-For", "Access-Control-Allow-Origin", "Strict-Transport-Security"};
+	string         big;
+	while (big.size() < 4 * 1024 * 1024)
+		big += "The Quick Brown Fox Jumps Over The Lazy Dog. ";
+
+	for (int large = 0; large < 2; large++) {
+		vector<string> in = large ? vector<string>{big} : headers;
+		vector<string> upper;
+		size_t         bytes = 0;
+		for (const auto& s : in) {
+			upper.push_back(strings::toupper(s));
+			bytes += s.size();
+		}
+		int    reps = large ? 20 : 200000;
+		size_t sum  = 0;
+
+		time::Benchmark b;
+		for (int r = 0; r < reps; r++) {
+			for (const auto& s : in)
+				sum += naiveLower(s).size();
+		}
+		double lowerNaive = b.Seconds();
+
+		b.Start();
+		for (int r = 0; r < reps; r++) {
+			for (auto& s : upper)
+				strings::ToLowerInPlace(s);
+		}
+		double lowerFast = b.Seconds();
+
+		b.Start();
+		for (int r = 0; r < reps; r++) {
+			for (size_t i = 0; i < in.size(); i++)
+				sum += naiveEquals(in[i], upper[i]);
+		}
+		double eqNaive = b.Seconds();
+
+		b.Start();
+		for (int r = 0; r < reps; r++) {
+			for (size_t i = 0; i < in.size(); i++)
+				sum += strings::EqualsNoCase(in[i], upper[i]);
+		}
+		double eqFast = b.Seconds();
+
+		double mb = (double) (bytes * reps) / (1024 * 1024);
+		tsf::print("%-7v (MB/s, naive / vector): tolower %5.0f / %5.0f, EqualsNoCase %5.0f / %5.0f (%v)\n", large ? "4 MB" : "headers",
+		           mb / lowerNaive, mb / lowerFast, mb / eqNaive, mb / eqFast, sum);
+	}
+}
+
+static vector<string> SplitToVector(strings::Splitter sp) {
+	vector<string> r;
+	for (auto f : sp)
+		r.push_back(f.str());
+	return r;
+}
+
+TESTFUNC(Splitter) {
+	typedef vector<string> vs;
+	TTASSERT(SplitToVector(strings::SplitView("", ',')) == vs());
+	TTASSERT(SplitToVector(strings::SplitView("a", ',')) == vs({"a"}));
+	TTASSERT(SplitToVector(strings::SplitView(",", ',')) == vs({"", ""}));
+	TTASSERT(SplitToVector(strings::SplitView("a,,b,", ',')) == vs({"a", "", "b", ""}));
+	TTASSERT(SplitToVector(strings::SplitView("a, b, c", ", ")) == vs({"a", "b", "c"}));
+	TTASSERT(SplitToVector(strings::SplitView("a\r\n\r\nb\r", "\r\n")) == vs({"a", "", "b\r"}));
+	TTASSERT(SplitToVector(strings::SplitView("aaa", "aa")) == vs({"", "a"}));
+	TTASSERT(SplitToVector(strings::SplitView("abc", "")) == vs({"abc"}));
+	TTASSERT(SplitToVector(strings::SplitAnyOf("a,b;c", ",;")) == vs({"a", "b", "c"}));
+	TTASSERT(SplitToVector(strings::SplitAnyOf("a,;b", ",;")) == vs({"a", "", "b"}));
+	TTASSERT(SplitToVector(strings::Tokenize("  the quick\tbrown \r\n fox  ")) == vs({"the", "quick", "brown", "fox"}));
+	TTASSERT(SplitToVector(strings::Tokenize(" \t ")) == vs());
+
+	// Long inputs go through the vector paths, with sets small enough to vectorize and too large to
+	string set = "0123456789";
+	for (size_t setLen : {2, 3, 8, 9}) {
+		string line;
+		vs     expect;
+		for (int i = 0; i < 200; i++) {
+			string f(i % 23, 'x');
+			expect.push_back(f);
+			line += f;
+			if (i != 199)
+				line += set[i % setLen];
+		}
+		TTASSERT(SplitToVector(strings::SplitAnyOf(line, strings::StringView(set.data(), setLen))) == expect);
+		const char* p = strings::FindAnyOf(line.data(), line.size(), set.data(), setLen);
+		TTASSERT(p == line.data() + line.find_first_of(set.substr(0, setLen)));
+	}
+
+	string              s  = "k1=v1&k2=v2";
+	strings::Splitter   sp = strings::SplitView(s, '&');
+	strings::StringView f;
+	TTASSERT(sp.Next(f) && f == "k1=v1" && f.data() == s.data());
+	TTASSERT(sp.Remaining() == "k2=v2");
+	TTASSERT(sp.Next(f) && f == "k2=v2");
+	TTASSERT(!sp.Next(f));
+}
+
+BENCHFUNC(SplitterBench) {
+	// CSV-like log lines
+	string text;
+	int    nLines = 200000;
+	for (int i = 0; i < nLines; i++)
+		text += tsf::fmt("2024-01-%02d 12:%02d:%02d,INFO,server%v,GET,/api/v1/items/%v,200,%v\n", i % 28 + 1, i % 60, i % 60, i % 16, i, i % 1000);
+
+	time::Benchmark b;
+	size_t          sum = 0;
+	for (const auto& line : strings::Split(text, '\n')) {
+		for (const auto& field : strings::Split(line, ','))
+			sum += field.size();
+	}
+	double copy = b.Seconds();
+
+	b.Start();
+	for (auto line : strings::SplitView(text, '\n')) {
+		for (auto field : strings::SplitView(line, ','))
+			sum += field.size();
+	}
+	double view = b.Seconds();
+
+	b.Start();
+	for (auto line : strings::SplitView(text, '\n')) {
+		for (auto field : strings::SplitAnyOf(line, ",/"))
+			sum += field.size();
+	}
+	double anyOf = b.Seconds();
+
+	double mb = (double) text.size() / (1024 * 1024);
+	tsf::print("Split %v lines (MB/s): Split %.0f, SplitView %.0f, SplitAnyOf %.0f (%v)\n", nLines, mb / copy, mb / view, mb / anyOf, sum);
+}
+
+// Leftmost-longest reference for MultiMatcher
+static vector<strings::MultiMatcher::Match> NaiveFindAll(const string& s, const vector<string>& patterns, bool noCase) {
+	vector<strings::MultiMatcher::Match> r;
+	for (size_t i = 0; i < s.size();) {
+		size_t best = -1;
+		for (size_t j = 0; j < patterns.size(); j++) {
+			const auto& p = patterns[j];
+			if (!p.empty() && p.size() <= s.size() - i && (best == -1 || p.size() > patterns[best].size()) &&
+			    (noCase ? strings::EqualsNoCase(p.data(), p.size(), s.data() + i, p.size()) : s.compare(i, p.size(), p) == 0))
+				best = j;
+		}
+		if (best == -1) {
+			i++;
+		} else {
+			r.push_back({i, patterns[best].size(), best});
+			i += patterns[best].size();
+		}
+	}
+	return r;
+}
+
+TESTFUNC(MultiMatcher) {
+	{
+		strings::MultiMatcher m({"he", "she", "his", "hers"});
+		TTASSEQ(m.ReplaceAll("ushers", {"1", "2", "3", "4"}), "u2rs");
+		TTASSEQ(m.ReplaceAll("hishershe", {"1", "2", "3", "4"}), "341");
+		strings::MultiMatcher::Match match;
+		TTASSERT(m.Find("a his", match) && match.Pos == 2 && match.Len == 3 && match.Pattern == 2);
+		TTASSERT(!m.Find("xyz", match));
+	}
+	{
+		strings::MultiMatcher m({"password", "PASS", ""}, true);
+		TTASSEQ(m.ReplaceAll("Password=x pass=y", {"*", "#", "?"}), "*=x #=y");
+	}
+
+	// Compare against the naive search, with a small alphabet so that patterns overlap a lot, and in streaming mode
+	uint32_t seed = 7;
+	auto     rnd  = [&]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 8;
+	};
+	for (int iter = 0; iter < 300; iter++) {
+		bool           noCase = iter % 3 == 0;
+		vector<string> patterns;
+		int            nPat = 1 + rnd() % 12;
+		for (int i = 0; i < nPat; i++) {
+			string p;
+			int    len = 1 + rnd() % 5;
+			for (int j = 0; j < len; j++)
+				p += "abcAB"[rnd() % (noCase ? 5 : 3)];
+			patterns.push_back(p);
+		}
+		string s;
+		int    len = rnd() % 200;
+		for (int j = 0; j < len; j++)
+			s += "abcdAB"[rnd() % 6];
+
+		strings::MultiMatcher                m(patterns, noCase);
+		vector<strings::MultiMatcher::Match> matches;
+		m.FindAll(s, matches);
+		auto expect = NaiveFindAll(s, patterns, noCase);
+		TTASSERT(matches == expect);
+
+		vector<string> reps;
+		for (size_t i = 0; i < patterns.size(); i++)
+			reps.push_back(tsf::fmt("<%v>", i));
+		string                               replaced = m.ReplaceAll(s, reps);
+		string                               streamed;
+		vector<strings::MultiMatcher::Match> streamMatches;
+		strings::MultiMatchStream            find(m, [&](const strings::MultiMatcher::Match& x) { streamMatches.push_back(x); });
+		strings::MultiMatchStream            replace(m, reps, [&](const char* buf, size_t n) { streamed.append(buf, n); });
+		for (size_t i = 0; i < s.size();) {
+			size_t n = std::min(s.size() - i, (size_t) (rnd() % 8));
+			find.Write(s.data() + i, n);
+			replace.Write(s.data() + i, n);
+			i += n;
+		}
+		find.Finish();
+		replace.Finish();
+		TTASSERT(streamMatches == expect);
+		TTASSEQ(streamed, replaced);
+	}
+}
+
+BENCHFUNC(MultiMatcherBench) {
+	// Scrub a log of a few hundred secret tokens
+	uint32_t seed = 1;
+	auto     rnd  = [&]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 8;
+	};
+	vector<string> patterns, reps;
+	for (int i = 0; i < 300; i++) {
+		patterns.push_back(tsf::fmt("token_%v_%v", i * 7919, rnd() % 100000));
+		reps.push_back("[redacted]");
+	}
+	string text;
+	while (text.size() < 8 * 1024 * 1024) {
+		text += tsf::fmt("2024-01-01 12:00:00 INFO request from user %v completed in %vms", rnd() % 10000, rnd() % 1000);
+		if (rnd() % 10 == 0)
+			text += " auth=" + patterns[rnd() % patterns.size()];
+		text += "\n";
+	}
+	// Repeated Replace makes one pass per pattern, so it only gets one round
+	time::Benchmark b;
+	string          a = text;
+	for (size_t i = 0; i < patterns.size(); i++)
+		a = strings::Replace(a, patterns[i], reps[i]);
+	double loop = b.Seconds();
+
+	const int             rounds = 5;
+	strings::MultiMatcher m(patterns);
+	b.Start();
+	string c;
+	for (int r = 0; r < rounds; r++) {
+		c.clear();
+		m.ReplaceAll(text, reps, c);
+	}
+	double multi = b.Seconds() / rounds;
+	TTASSERT(a == c);
+
+	double gb = (double) text.size() / (1024 * 1024 * 1024);
+	tsf::print("Replace %v patterns in %v MB (GB/s): repeated Replace %.3f, MultiMatcher %.3f\n", patterns.size(), text.size() / (1024 * 1024), gb / loop, gb / multi);
+}
+
+// The original recursive matcher, which is exponential on patterns such as *a*a*a*b
+static bool RecursiveWildcard(const char* s, const char* p, bool caseSensitive) {
+	if (*p == '*') {
+		while (*p == '*')
+			++p;
+		if (*p == 0)
+			return true;
+		while (*s != 0 && !RecursiveWildcard(s, p, caseSensitive)) {
+			int cp;
+			if (!utfz::next(s, cp))
+				break;
+		}
+		return *s != 0;
+	} else if (*p == 0 || *s == 0) {
+		return *p == *s;
+	} else {
+		int px = utfz::decode(p);
+		int sx = utfz::decode(s);
+		if ((caseSensitive ? (px == sx) : ::tolower(px) == ::tolower(sx)) || *p == '?') {
+			int cp;
+			utfz::next(s, cp);
+			utfz::next(p, cp);
+			return RecursiveWildcard(s, p, caseSensitive);
+		} else {
+			return false;
+		}
+	}
+}
+
+TESTFUNC(Wildcard) {
+	TTASSERT(strings::MatchWildcard("", ""));
+	TTASSERT(strings::MatchWildcard("", "*"));
+	TTASSERT(!strings::MatchWildcard("", "?"));
+	TTASSERT(strings::MatchWildcard("foo.txt", "*.txt"));
+	TTASSERT(!strings::MatchWildcard("foo.txt", "*.TXT"));
+	TTASSERT(strings::MatchWildcardNoCase("foo.txt", "*.TXT"));
+	TTASSERT(strings::MatchWildcard("\xC3\xA9t\xC3\xA9", "?t?"));
+	TTASSERT(strings::Wildcard("?t?").Match("\xC3\xA9t\xC3\xA9"));
+	TTASSERT(!strings::Wildcard("?t?").Match("\xC3\xA9t\xC3\xA9x"));
+	TTASSERT(strings::Wildcard("*\xC3\xA9").Match("t\xC3\xA9"));
+	TTASSERT(strings::Wildcard("a*b*c").Match("abc"));
+	TTASSERT(!strings::Wildcard("ab*bc").Match("abc"));
+	TTASSERT(strings::Wildcard("ab*bc").Match("abbc"));
+
+	// Compare both matchers against the original, on random strings from a small alphabet, including multibyte characters
+	const char* alpha[] = {"a", "b", "A", "\xC3\xA9", "\xE2\x82\xAC"};
+	uint32_t    seed    = 3;
+	auto        rnd     = [&]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 8;
+	};
+	for (int iter = 0; iter < 20000; iter++) {
+		string p, s;
+		int    plen = rnd() % 8;
+		for (int i = 0; i < plen; i++) {
+			int r = rnd() % 8;
+			p += r == 5 ? "*" : r == 6 ? "?" : r == 7 ? "*" : alpha[r];
+		}
+		int slen = rnd() % 10;
+		for (int i = 0; i < slen; i++)
+			s += alpha[rnd() % 5];
+		for (bool cs : {true, false}) {
+			bool expect = RecursiveWildcard(s.c_str(), p.c_str(), cs);
+			TTASSERT((cs ? strings::MatchWildcard(s, p) : strings::MatchWildcardNoCase(s, p)) == expect);
+			TTASSERT(strings::Wildcard(p, cs).Match(s) == expect);
+		}
+	}
+
+	// Adversarial patterns must not blow up
+	string a(10000, 'a');
+	TTASSERT(!strings::MatchWildcard(a, "*a*a*a*a*a*a*a*a*b"));
+	TTASSERT(!strings::Wildcard("*a*a*a*a*a*a*a*a*b").Match(a));
+	TTASSERT(!strings::Wildcard("*a*a*a*a*a*a*a*a*b*").Match(a));
+	TTASSERT(strings::Wildcard("*a*a*a*a*a*a*a*a*").Match(a));
+}
+
+TESTFUNC(WildcardSet) {
+	vector<string>       patterns = {"*.o", "*.TMP", "build*", "?", "*.cpp", "", "a*z"};
+	vector<bool>         nocase   = {false, true, false, false, false, false, false};
+	vector<string>       names    = {"x.o", "x.tmp", "X.TmP", "build", "builder.cpp", "q", "", "main.cpp", "abz", "abc", "x.O"};
+	strings::WildcardSet set;
+	for (size_t i = 0; i < patterns.size(); i++)
+		set.Add(patterns[i], !nocase[i]);
+	vector<int> result;
+	set.MatchMany(names, result);
+	for (size_t i = 0; i < names.size(); i++) {
+		int expect = -1;
+		for (size_t j = 0; j < patterns.size() && expect == -1; j++) {
+			if (strings::Wildcard(patterns[j], !nocase[j]).Match(names[i]))
+				expect = (int) j;
+		}
+		TTASSEQ(result[i], expect);
+	}
+	TTASSEQ(result[4], 2);
+	TTASSERT(!set.MatchAny("abc"));
+}
+
+BENCHFUNC(WildcardBench) {
+	vector<string> names;
+	for (int i = 0; i < 100000; i++)
+		names.push_back(tsf::fmt("source_file_number_%v.%v", i, i % 3 == 0 ? "cpp" : i % 3 == 1 ? "h" : "o"));
+
+	for (const char* p : {"*.cpp", "source_*_9*.h", "*e*e*e*e*e*e*x"}) {
+		size_t          n = 0;
+		time::Benchmark b;
+		for (const auto& name : names)
+			n += RecursiveWildcard(name.c_str(), p, true);
+		double recursive = b.Seconds();
+
+		b.Start();
+		for (const auto& name : names)
+			n += strings::MatchWildcard(name, p);
+		double iterative = b.Seconds();
+
+		strings::Wildcard wc(p);
+		b.Start();
+		for (const auto& name : names)
+			n += wc.Match(name);
+		double compiled = b.Seconds();
+
+		tsf::print("%-16v (ns/name): recursive %6.1f, MatchWildcard %6.1f, Wildcard %6.1f (%v)\n", p, recursive * 1e9 / names.size(),
+		           iterative * 1e9 / names.size(), compiled * 1e9 / names.size(), n);
+	}
+}
+
 TESTFUNC(StringDiff) {
 	auto check = [](string a, string b) {
 		auto dist = diff::StringDistance(a, b);
@@ -79,3 +536,81 @@ TESTFUNC(ByteFormat) {
 	TTASSEQ(strings::FormatBytes(1024 * 1024 * 1024 * (int64_t) 1024 * (int64_t) 1024), "1.0000 PB");
 	TTASSEQ(strings::FormatBytes(1325 * 1024 * 1024 * (int64_t) 1024 * (int64_t) 1024), "1.2939 PB");
 }
+
+TESTFUNC(Interner) {
+	strings::Interner in(256);
+	TTASSERT(in.Find("x") == strings::Interner::NotFound);
+	auto empty = in.Intern("");
+	TTASSERT(in.Get(empty).size() == 0);
+	TTASSEQ(in.CStr(empty), string(""));
+
+	// Enough strings to grow the hash tables and directories, including some that need their own block
+	vector<string>                 strs;
+	vector<strings::Interner::ID> ids;
+	for (int i = 0; i < 50000; i++) {
+		strs.push_back(tsf::fmt("str-%v", i) + (i % 1000 == 0 ? string(200, 'z') : ""));
+		ids.push_back(in.Intern(strs.back()));
+	}
+	TTASSEQ(in.Size(), strs.size() + 1);
+	for (size_t i = 0; i < strs.size(); i++) {
+		TTASSERT(in.Intern(strs[i]) == ids[i]);
+		TTASSERT(in.Find(strs[i]) == ids[i]);
+		TTASSERT(in.Get(ids[i]) == strs[i]);
+		TTASSERT(strlen(in.CStr(ids[i])) == strs[i].size());
+	}
+	TTASSERT(in.Find("str-50000") == strings::Interner::NotFound);
+	TTASSERT(in.Find("str-") == strings::Interner::NotFound);
+
+	// Concurrent writers with overlapping strings, and readers of previously returned IDs
+	strings::Interner                     shared;
+	const int                             nthreads = 8;
+	vector<vector<strings::Interner::ID>> threadIDs(nthreads);
+	vector<thread>                        threads;
+	for (int t = 0; t < nthreads; t++) {
+		threads.emplace_back([&, t]() {
+			for (int i = 0; i < 20000; i++) {
+				string s  = tsf::fmt("%v", (i * 7 + t * 3) % 30000);
+				auto   id = shared.Intern(s);
+				if (shared.Get(id) != s)
+					id = strings::Interner::NotFound;
+				threadIDs[t].push_back(id);
+			}
+		});
+	}
+	for (auto& th : threads)
+		th.join();
+	TTASSEQ(shared.Size(), 30000);
+	for (int t = 0; t < nthreads; t++) {
+		for (int i = 0; i < 20000; i++) {
+			string s = tsf::fmt("%v", (i * 7 + t * 3) % 30000);
+			TTASSERT(threadIDs[t][i] == shared.Find(s));
+		}
+	}
+}
+
+BENCHFUNC(InternerBench) {
+	vector<string> words;
+	uint32_t       seed = 3;
+	for (int i = 0; i < 1000000; i++) {
+		seed = seed * 1103515245 + 12345;
+		words.push_back(tsf::fmt("word%v", (seed >> 8) % 200000));
+	}
+
+	time::Benchmark         b;
+	ohash::map<string, int> map;
+	vector<string>          mapStrs;
+	for (const auto& w : words) {
+		if (map.insert(w, (int) mapStrs.size()))
+			mapStrs.push_back(w);
+	}
+	double mapTime = b.Seconds();
+
+	b.Start();
+	strings::Interner in;
+	for (const auto& w : words)
+		in.Intern(w);
+	double internTime = b.Seconds();
+
+	size_t mapBytes = map.size() * sizeof(string) * 2 + mapStrs.capacity() * sizeof(string);
+	tsf::print("Intern 1M words (%v distinct): ohash::map<string> %.1f ms (> %v), Interner %.1f ms (%v)\n", in.Size(), mapTime * 1000, strings::FormatBytes(mapBytes), internTime * 1000, strings::FormatBytes(in.BytesAllocated()));
+}
@@ -6,3 +6,5 @@
 #include <src/pal.h>
 
 #include <third_party/TinyTest/TinyTest.h>
+
+#include "Bench.h"